@@ -7,6 +7,8 @@
 #include "scisim/Math/MathUtilities.h"
 #include "scisim/Utilities.h"
 #include "scisim/Math/Rational.h"
+#include "scisim/Math/SpaceFillingCurve.h"
+#include "scisim/Timer/Profiler.h"
 
 #include "Constraints/BallBallConstraint.h"
 #include "Constraints/KinematicKickBallBallConstraint.h"
@@ -27,6 +29,7 @@
 #endif
 
 #include <iostream>
+#include <set>
 
 Ball2DState& Ball2DSim::state()
 {
@@ -165,11 +168,15 @@ void Ball2DSim::computeActiveSet( const VectorXs& q0, const VectorXs& qp, const
     computeBallBallActiveSetSpatialGridWithPortals( q0, qp, active_set );
   }
 
-  // Check all ball-drum pairs
-  computeBallDrumActiveSetAllPairs( q0, qp, active_set );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::NARROW_PHASE };
+
+    // Check all ball-drum pairs
+    computeBallDrumActiveSetAllPairs( q0, qp, active_set );
 
-  // Check all ball-half-plane pairs
-  computeBallPlaneActiveSetAllPairs( q0, qp, active_set );
+    // Check all ball-half-plane pairs
+    computeBallPlaneActiveSetAllPairs( q0, qp, active_set );
+  }
 }
 
 void Ball2DSim::computeImpactBases( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& impact_bases ) const
@@ -256,8 +263,30 @@ void Ball2DSim::computeNumberOfCollisions( std::map<std::string,unsigned>& colli
   }
 }
 
+void Ball2DSim::renumberBalls()
+{
+  std::vector<unsigned> order;
+  SpaceFillingCurve::computeMortonOrder2D( m_state.q(), order );
+  std::vector<unsigned> new_index;
+  SpaceFillingCurve::invertOrder( order, new_index );
+
+  m_state.permuteBalls( order );
+  m_constraint_cache.renumberBalls( new_index );
+}
+
+void Ball2DSim::renumberBallsIfScheduled( const unsigned iteration )
+{
+  const unsigned frequency{ m_state.renumberingFrequency() };
+  if( frequency != 0 && iteration % frequency == 0 )
+  {
+    renumberBalls();
+  }
+}
+
 void Ball2DSim::flow( PythonScripting& call_back, const unsigned iteration, const Rational<std::intmax_t>& dt, UnconstrainedMap& umap )
 {
+  renumberBallsIfScheduled( iteration );
+
   call_back.setState( m_state );
   call_back.startOfStepCallback( iteration, dt );
   call_back.forgetState();
@@ -281,6 +310,8 @@ void Ball2DSim::flow( PythonScripting& call_back, const unsigned iteration, cons
 
 void Ball2DSim::flow( PythonScripting& call_back, const unsigned iteration, const Rational<std::intmax_t>& dt, UnconstrainedMap& umap, ImpactOperator& iop, const scalar& CoR, ImpactMap& imap )
 {
+  renumberBallsIfScheduled( iteration );
+
   call_back.setState( m_state );
   call_back.startOfStepCallback( iteration, dt );
   call_back.forgetState();
@@ -304,6 +335,8 @@ void Ball2DSim::flow( PythonScripting& call_back, const unsigned iteration, cons
 
 void Ball2DSim::flow( PythonScripting& call_back, const unsigned iteration, const Rational<std::intmax_t>& dt, UnconstrainedMap& umap, const scalar& CoR, const scalar& mu, FrictionSolver& solver, ImpactFrictionMap& ifmap )
 {
+  renumberBallsIfScheduled( iteration );
+
   call_back.setState( m_state );
   call_back.startOfStepCallback( iteration, dt );
   call_back.forgetState();
@@ -336,6 +369,7 @@ void Ball2DSim::updatePeriodicBoundaryConditionsStartOfStep( const unsigned next
 
 void Ball2DSim::enforcePeriodicBoundaryConditions()
 {
+  const ProfilerScope profiler_scope{ ProfilerTimer::BOUNDARY };
   const unsigned nbodies{ m_state.nballs() };
 
   // For each portal
@@ -365,54 +399,54 @@ void Ball2DSim::enforcePeriodicBoundaryConditions()
   }
 }
 
-void Ball2DSim::computeBallBallActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const
+void Ball2DSim::computeBallBallActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set )
 {
   assert( q0.size() % 2 == 0 ); assert( q0.size() == q1.size() );
   assert( m_state.r().size() == q0.size() / 2 );
 
   const unsigned nbodies{ m_state.nballs() };
 
-  // Candidate bodies that might overlap
-  std::set<std::pair<unsigned,unsigned>> possible_overlaps;
   // Map from teleported AABB indices and body and portal indices
   std::map<unsigned,TeleportedBall> teleported_aabb_body_indices;
+  // Compute an AABB for each ball
+  std::vector<AABB> aabbs;
+  aabbs.reserve( nbodies );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
-    // Compute an AABB for each ball
-    std::vector<AABB> aabbs;
-    aabbs.reserve( nbodies );
-    for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-    {
-      aabbs.emplace_back( q1.segment<2>( 2 * bdy_idx ).array() - m_state.r()( bdy_idx ), q1.segment<2>( 2 * bdy_idx ).array() + m_state.r()( bdy_idx ) );
-    }
-    assert( aabbs.size() == nbodies );
+    aabbs.emplace_back( q1.segment<2>( 2 * bdy_idx ).array() - m_state.r()( bdy_idx ), q1.segment<2>( 2 * bdy_idx ).array() + m_state.r()( bdy_idx ) );
+  }
+  assert( aabbs.size() == nbodies );
 
-    // Compute an AABB for each teleported particle
-    auto aabb_bdy_map_itr = teleported_aabb_body_indices.cbegin();
-    // For each portal
-    using st = std::vector<PlanarPortal>::size_type;
-    for( st prtl_idx = 0; prtl_idx < m_state.planarPortals().size(); ++prtl_idx )
+  // Compute an AABB for each teleported particle
+  auto aabb_bdy_map_itr = teleported_aabb_body_indices.cbegin();
+  // For each portal
+  using st = std::vector<PlanarPortal>::size_type;
+  for( st prtl_idx = 0; prtl_idx < m_state.planarPortals().size(); ++prtl_idx )
+  {
+    // For each body
+    for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
     {
-      // For each body
-      for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+      // If the body is inside a portal
+      bool intersecting_plane_index;
+      if( m_state.planarPortals()[prtl_idx].ballTouchesPortal( q1.segment<2>( 2 * bdy_idx ), m_state.r()( bdy_idx ), intersecting_plane_index )  )
       {
-        // If the body is inside a portal
-        bool intersecting_plane_index;
-        if( m_state.planarPortals()[prtl_idx].ballTouchesPortal( q1.segment<2>( 2 * bdy_idx ), m_state.r()( bdy_idx ), intersecting_plane_index )  )
-        {
-          // Teleport to the other side of the portal
-          Vector2s x_out;
-          m_state.planarPortals()[prtl_idx].teleportBall( q1.segment<2>( 2 * bdy_idx ), m_state.r()( bdy_idx ), x_out );
-          // Compute an AABB for the teleported particle
-          aabbs.emplace_back( x_out.array() - m_state.r()( bdy_idx ), x_out.array() + m_state.r()( bdy_idx ) );
+        // Teleport to the other side of the portal
+        Vector2s x_out;
+        m_state.planarPortals()[prtl_idx].teleportBall( q1.segment<2>( 2 * bdy_idx ), m_state.r()( bdy_idx ), x_out );
+        // Compute an AABB for the teleported particle
+        aabbs.emplace_back( x_out.array() - m_state.r()( bdy_idx ), x_out.array() + m_state.r()( bdy_idx ) );
 
-          aabb_bdy_map_itr = teleported_aabb_body_indices.insert( aabb_bdy_map_itr, std::make_pair( aabbs.size() - 1, TeleportedBall{ bdy_idx, static_cast<unsigned>(prtl_idx), intersecting_plane_index } ) );
-        }
+        aabb_bdy_map_itr = teleported_aabb_body_indices.insert( aabb_bdy_map_itr, std::make_pair( aabbs.size() - 1, TeleportedBall{ bdy_idx, static_cast<unsigned>(prtl_idx), intersecting_plane_index } ) );
       }
     }
+  }
 
-    // Determine which bodies possibly overlap
-    SpatialGridDetector::getPotentialOverlaps( aabbs, possible_overlaps );
+  // Determine which bodies possibly overlap
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::BROAD_PHASE };
+    m_spatial_grid.computePotentialOverlaps( aabbs );
   }
+  const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps{ m_spatial_grid.potentialOverlaps() };
 
   std::set<TeleportedCollision> teleported_collisions;
 
@@ -490,7 +524,6 @@ void Ball2DSim::computeBallBallActiveSetSpatialGridWithPortals( const VectorXs&
       }
     }
   }
-  possible_overlaps.clear();
   teleported_aabb_body_indices.clear();
 
   #ifndef NDEBUG
@@ -550,31 +583,31 @@ void Ball2DSim::computeBallBallActiveSetSpatialGridWithPortals( const VectorXs&
 }
 
 
-void Ball2DSim::computeBallBallActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const
+void Ball2DSim::computeBallBallActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set )
 {
   assert( q0.size() % 2 == 0 ); assert( q0.size() == q1.size() );
   assert( m_state.r().size() == q0.size() / 2 );
 
   const unsigned nbodies{ m_state.nballs() };
 
-  // Candidate bodies that might overlap
-  std::set<std::pair<unsigned,unsigned>> possible_overlaps;
+  // Compute an AABB for each ball
+  std::vector<AABB> aabbs;
+  aabbs.reserve( nbodies );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
-    // Compute an AABB for each ball
-    std::vector<AABB> aabbs;
-    aabbs.reserve( nbodies );
-    for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-    {
-      const Array2s min{ q1.segment<2>( 2 * bdy_idx ).array().min( q0.segment<2>( 2 * bdy_idx ).array() ) };
-      const Array2s max{ q1.segment<2>( 2 * bdy_idx ).array().max( q0.segment<2>( 2 * bdy_idx ).array() ) };
-      assert( ( min <= max ).all() );
-      aabbs.emplace_back( min - m_state.r()( bdy_idx ), max + m_state.r()( bdy_idx ) );
-    }
-    assert( aabbs.size() == nbodies );
+    const Array2s min{ q1.segment<2>( 2 * bdy_idx ).array().min( q0.segment<2>( 2 * bdy_idx ).array() ) };
+    const Array2s max{ q1.segment<2>( 2 * bdy_idx ).array().max( q0.segment<2>( 2 * bdy_idx ).array() ) };
+    assert( ( min <= max ).all() );
+    aabbs.emplace_back( min - m_state.r()( bdy_idx ), max + m_state.r()( bdy_idx ) );
+  }
+  assert( aabbs.size() == nbodies );
 
-    // Determine which bodies possibly overlap
-    SpatialGridDetector::getPotentialOverlaps( aabbs, possible_overlaps );
+  // Determine which bodies possibly overlap
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::BROAD_PHASE };
+    m_spatial_grid.computePotentialOverlaps( aabbs );
   }
+  const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps{ m_spatial_grid.potentialOverlaps() };
 
   // Create constraints for balls that actually overlap
   for( const auto& possible_overlap_pair : possible_overlaps )
@@ -780,6 +813,12 @@ void Ball2DSim::writeBinaryState( HDF5File& output_file ) const
       const VectorXs m{ Eigen::Map<const VectorXs>( &m_state.M().data().value(0), m_state.q().size() ) };
       output_file.write( "m", m );
     }
+    // Balls may have been renumbered, so record the id of each ball
+    {
+      const std::vector<unsigned> ball_ids{ m_state.ballIds() };
+      const VectorXu ids{ Eigen::Map<const VectorXu>{ ball_ids.data(), m_state.nballs() } };
+      output_file.write( "ids", ids );
+    }
   }
   // Output the static planes
   if( !m_state.staticPlanes().empty() )
@@ -812,6 +851,7 @@ void Ball2DSim::serialize( std::ostream& output_stream ) const
   assert( output_stream.good() );
   m_state.serialize( output_stream );
   m_constraint_cache.serialize( output_stream );
+  // Nothing to serialize for m_spatial_grid
 }
 
 void Ball2DSim::deserialize( std::istream& input_stream )
@@ -7,6 +7,7 @@
 
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/Constraints/ConstrainedSystem.h"
+#include "scisim/CollisionDetection/SortedCellGrid.h"
 #include "Ball2DState.h"
 #include "ConstraintCache.h"
 
@@ -38,6 +39,9 @@ public:
   Ball2DState& state();
   const Ball2DState& state() const;
 
+  // Renumbers the balls along a space filling curve so that balls close in space are close in memory
+  void renumberBalls();
+
   bool empty() const;
 
   // Inherited from FlowableSystem
@@ -98,18 +102,20 @@ private:
 
   void updatePeriodicBoundaryConditionsStartOfStep( const unsigned next_iteration, const scalar& dt );
   void enforcePeriodicBoundaryConditions();
+  void renumberBallsIfScheduled( const unsigned iteration );
 
   void getTeleportedBallBallCenters( const VectorXs& q, const TeleportedCollision& teleported_collision, Vector2s& x0, Vector2s& x1 ) const;
   bool teleportedBallBallCollisionHappens( const VectorXs& q, const TeleportedCollision& teleported_collision ) const;
   void generateTeleportedBallBallCollision( const VectorXs& q0, const VectorXs& q1, const VectorXs& r, const TeleportedCollision& teleported_collision, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
 
-  void computeBallBallActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
-  void computeBallBallActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
+  void computeBallBallActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set );
+  void computeBallBallActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set );
   void computeBallDrumActiveSetAllPairs( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
   void computeBallPlaneActiveSetAllPairs( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
 
   Ball2DState m_state;
   ConstraintCache m_constraint_cache;
+  SortedCellGrid<2> m_spatial_grid;
 
 };
 
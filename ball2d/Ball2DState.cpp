@@ -9,12 +9,29 @@
 #include "scisim/Utilities.h"
 #include "scisim/StringUtilities.h"
 #include "Forces/Ball2DGravityForce.h"
+#include "Forces/PenaltyForce.h"
 
 #include "StaticGeometry/StaticDrum.h"
 #include "StaticGeometry/StaticPlane.h"
 #include "Portals/PlanarPortal.h"
 
 #include <iostream>
+#include <numeric>
+
+Ball2DState::Ball2DState()
+: m_q()
+, m_v()
+, m_r()
+, m_fixed()
+, m_M()
+, m_Minv()
+, m_static_drums()
+, m_static_planes()
+, m_planar_portals()
+, m_forces()
+, m_ids()
+, m_renumbering_frequency( 0 )
+{}
 
 Ball2DState::Ball2DState( const Ball2DState& other )
 : m_q( other.m_q )
@@ -27,6 +44,8 @@ Ball2DState::Ball2DState( const Ball2DState& other )
 , m_static_planes( other.m_static_planes )
 , m_planar_portals( other.m_planar_portals )
 , m_forces( Utilities::clone( other.m_forces ) )
+, m_ids( other.m_ids )
+, m_renumbering_frequency( other.m_renumbering_frequency )
 {}
 
 Ball2DState& Ball2DState::operator=( const Ball2DState& other )
@@ -269,6 +288,8 @@ void Ball2DState::serialize( std::ostream& output_stream ) const
   Utilities::serialize( m_static_planes, output_stream );
   Utilities::serialize( m_planar_portals, output_stream );
   Utilities::serialize( m_forces, output_stream );
+  Utilities::serialize( m_ids, output_stream );
+  Utilities::serialize( m_renumbering_frequency, output_stream );
 }
 
 void Ball2DState::deserialize( std::istream& input_stream )
@@ -303,6 +324,10 @@ void Ball2DState::deserialize( std::istream& input_stream )
       {
         m_forces[force_idx] = std::unique_ptr<Ball2DForce>{ new Ball2DGravityForce{ input_stream } };
       }
+      else if( "hertzian_penalty" == force_name )
+      {
+        m_forces[force_idx] = std::unique_ptr<Ball2DForce>{ new PenaltyForce{ input_stream } };
+      }
       else
       {
         std::cerr << "Unknown force in deserialize." << std::endl;
@@ -310,6 +335,9 @@ void Ball2DState::deserialize( std::istream& input_stream )
       }
     }
   }
+  m_ids = Utilities::deserialize<std::vector<unsigned>>( input_stream );
+  assert( m_ids.empty() || m_ids.size() == m_fixed.size() );
+  m_renumbering_frequency = Utilities::deserialize<unsigned>( input_stream );
 }
 
 void Ball2DState::pushBallBack( const Vector2s& q, const Vector2s& v, const scalar& r, const scalar& m, const bool fixed )
@@ -328,6 +356,11 @@ void Ball2DState::pushBallBack( const Vector2s& q, const Vector2s& v, const scal
   m_r( original_num_balls ) = r;
   // Update fixed balls
   m_fixed.push_back( fixed );
+  // Update the ids, if the balls have been renumbered
+  if( !m_ids.empty() )
+  {
+    m_ids.push_back( original_num_balls );
+  }
   // Update the mass matrix
   {
     SparseMatrixsc M( 2 * new_num_balls, 2 * new_num_balls );
@@ -367,3 +400,54 @@ void Ball2DState::pushBallBack( const Vector2s& q, const Vector2s& v, const scal
     m_Minv.swap( Minv );
   }
 }
+
+std::vector<unsigned> Ball2DState::ballIds() const
+{
+  if( m_ids.empty() )
+  {
+    std::vector<unsigned> ids( nballs() );
+    std::iota( ids.begin(), ids.end(), 0 );
+    return ids;
+  }
+  assert( m_ids.size() == nballs() );
+  return m_ids;
+}
+
+void Ball2DState::permuteBalls( const std::vector<unsigned>& order )
+{
+  assert( order.size() == nballs() );
+
+  const std::vector<unsigned> ids_old{ ballIds() };
+  const VectorXs q_old{ m_q };
+  const VectorXs v_old{ m_v };
+  const VectorXs r_old{ m_r };
+  const std::vector<bool> fixed_old{ m_fixed };
+  const VectorXs m_old{ Eigen::Map<const VectorXs>{ m_M.valuePtr(), m_M.nonZeros() } };
+  const VectorXs minv_old{ Eigen::Map<const VectorXs>{ m_Minv.valuePtr(), m_Minv.nonZeros() } };
+  assert( m_old.size() == 2 * long( nballs() ) ); assert( minv_old.size() == 2 * long( nballs() ) );
+
+  m_ids.resize( order.size() );
+  for( unsigned new_idx = 0; new_idx < order.size(); ++new_idx )
+  {
+    const unsigned old_idx{ order[new_idx] };
+    assert( old_idx < nballs() );
+    m_q.segment<2>( 2 * new_idx ) = q_old.segment<2>( 2 * old_idx );
+    m_v.segment<2>( 2 * new_idx ) = v_old.segment<2>( 2 * old_idx );
+    m_r( new_idx ) = r_old( old_idx );
+    m_fixed[new_idx] = fixed_old[old_idx];
+    // The mass matrices are diagonal, so only the values move
+    Eigen::Map<VectorXs>{ m_M.valuePtr(), m_M.nonZeros() }.segment<2>( 2 * new_idx ) = m_old.segment<2>( 2 * old_idx );
+    Eigen::Map<VectorXs>{ m_Minv.valuePtr(), m_Minv.nonZeros() }.segment<2>( 2 * new_idx ) = minv_old.segment<2>( 2 * old_idx );
+    m_ids[new_idx] = ids_old[old_idx];
+  }
+}
+
+void Ball2DState::setRenumberingFrequency( const unsigned steps )
+{
+  m_renumbering_frequency = steps;
+}
+
+unsigned Ball2DState::renumberingFrequency() const
+{
+  return m_renumbering_frequency;
+}
@@ -19,7 +19,7 @@ class Ball2DState final
 
 public:
 
-  Ball2DState() = default;
+  Ball2DState();
 
   Ball2DState( const Ball2DState& other );
   Ball2DState( Ball2DState&& ) = default;
@@ -74,6 +74,16 @@ public:
   // NOTE: This is currently quite slow...
   void pushBallBack( const Vector2s& q, const Vector2s& v, const scalar& r, const scalar& m, const bool fixed );
 
+  // Id of each ball, its index before the balls were first renumbered
+  std::vector<unsigned> ballIds() const;
+
+  // Renumbers the balls so that ball order[i] becomes ball i. All per-ball state moves with its ball.
+  void permuteBalls( const std::vector<unsigned>& order );
+
+  // Number of steps between renumberings of the balls along a space filling curve, 0 to disable
+  void setRenumberingFrequency( const unsigned steps );
+  unsigned renumberingFrequency() const;
+
 private:
 
   VectorXs m_q;
@@ -90,6 +100,10 @@ private:
 
   std::vector<std::unique_ptr<Ball2DForce>> m_forces;
 
+  // Empty until the balls are first renumbered
+  std::vector<unsigned> m_ids;
+  unsigned m_renumbering_frequency;
+
 };
 
 #endif
@@ -122,6 +122,37 @@ void ConstraintCache::getCachedConstraint( const Constraint& constraint, VectorX
   r.setZero();
 }
 
+// Renumbers the second object of each cached pair, and the first too if it is a ball
+static void renumberCache( const std::vector<unsigned>& new_index, const bool first_is_ball, std::map<std::pair<unsigned,unsigned>,VectorXs>& constraint_cache )
+{
+  std::map<std::pair<unsigned,unsigned>,VectorXs> renumbered_cache;
+  for( auto iterator = constraint_cache.begin(); iterator != constraint_cache.end(); ++iterator )
+  {
+    std::pair<unsigned,unsigned> objects{ iterator->first };
+    assert( objects.second < new_index.size() );
+    objects.second = new_index[objects.second];
+    if( first_is_ball )
+    {
+      assert( objects.first < new_index.size() );
+      objects.first = new_index[objects.first];
+      // The normal follows the order of the balls, so the cached impulse is stale
+      if( objects.first > objects.second )
+      {
+        continue;
+      }
+    }
+    renumbered_cache.emplace( objects, std::move( iterator->second ) );
+  }
+  constraint_cache.swap( renumbered_cache );
+}
+
+void ConstraintCache::renumberBalls( const std::vector<unsigned>& new_index )
+{
+  renumberCache( new_index, true, m_ball_ball_constraints );
+  renumberCache( new_index, false, m_plane_ball_constraints );
+  renumberCache( new_index, false, m_drum_ball_constraints );
+}
+
 static void serializeCache( const std::map<std::pair<unsigned,unsigned>,VectorXs>& constraint_cache, std::ostream& output_stream )
 {
   assert( output_stream.good() );
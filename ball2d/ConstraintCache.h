@@ -20,6 +20,10 @@ public:
   void clear();
   bool empty() const;
 
+  // Updates the cached constraints after the balls are renumbered, with ball i becoming ball
+  // new_index[i]. Ball-ball constraints whose balls change order are discarded.
+  void renumberBalls( const std::vector<unsigned>& new_index );
+
   void serialize( std::ostream& output_stream ) const;
   void deserialize( std::istream& input_stream );
 
@@ -8,46 +8,122 @@
 #include "scisim/StringUtilities.h"
 #include "scisim/Utilities.h"
 
-PenaltyForce::PenaltyForce( const scalar& k, const scalar& power )
+#include <algorithm>
+#include <numeric>
+
+PenaltyForce::PenaltyForce( const scalar& k, const scalar& power, const scalar& skin )
 : m_k( k )
 , m_power( power )
+, m_skin( skin )
+, m_grid()
+, m_aabbs()
+, m_q_built()
+, m_r_built()
+, m_pairs()
+, m_neighbor_starts()
+, m_neighbors()
+, m_num_builds( 0 )
 {
-  assert( m_k > 0.0 );
+  assert( m_k > 0.0 ); assert( m_skin >= 0.0 );
 }
 
 PenaltyForce::PenaltyForce( std::istream& input_stream )
 : m_k( Utilities::deserialize<scalar>( input_stream ) )
 , m_power( Utilities::deserialize<scalar>( input_stream ) )
+, m_skin( Utilities::deserialize<scalar>( input_stream ) )
+, m_grid()
+, m_aabbs()
+, m_q_built()
+, m_r_built()
+, m_pairs()
+, m_neighbor_starts()
+, m_neighbors()
+, m_num_builds( 0 )
 {
-  assert( m_k > 0.0 );
+  assert( m_k > 0.0 ); assert( m_skin >= 0.0 );
+}
+
+void PenaltyForce::updateNeighborList( const VectorXs& q, const VectorXs& r ) const
+{
+  assert( q.size() == 2 * r.size() );
+
+  // The list remains valid until some ball travels more than half of the skin
+  if( m_q_built.size() == q.size() && m_r_built.size() == r.size() && ( m_r_built.array() == r.array() ).all() )
+  {
+    scalar max_displacement_squared{ 0.0 };
+    for( int ball_idx = 0; ball_idx < r.size(); ++ball_idx )
+    {
+      max_displacement_squared = std::max( max_displacement_squared, ( q.segment<2>( 2 * ball_idx ) - m_q_built.segment<2>( 2 * ball_idx ) ).squaredNorm() );
+    }
+    if( 4.0 * max_displacement_squared <= m_skin * m_skin )
+    {
+      return;
+    }
+  }
+
+  const unsigned nballs{ unsigned( r.size() ) };
+
+  // Pad each ball by half of the skin, so pairs within skin of touching are reported
+  m_aabbs.resize( nballs );
+  for( unsigned ball_idx = 0; ball_idx < nballs; ++ball_idx )
+  {
+    const scalar extent{ r( ball_idx ) + 0.5 * m_skin };
+    m_aabbs[ball_idx].min() = q.segment<2>( 2 * ball_idx ).array() - extent;
+    m_aabbs[ball_idx].max() = q.segment<2>( 2 * ball_idx ).array() + extent;
+  }
+  m_pairs = m_grid.computePotentialOverlaps( m_aabbs );
+
+  // Invert the pairs into per ball neighbor lists
+  m_neighbor_starts.assign( nballs + 1, 0 );
+  for( const std::pair<unsigned,unsigned>& pair : m_pairs )
+  {
+    ++m_neighbor_starts[pair.first + 1];
+    ++m_neighbor_starts[pair.second + 1];
+  }
+  std::partial_sum( m_neighbor_starts.begin(), m_neighbor_starts.end(), m_neighbor_starts.begin() );
+  m_neighbors.resize( m_neighbor_starts.back() );
+  std::vector<unsigned> cursors{ m_neighbor_starts.begin(), m_neighbor_starts.end() - 1 };
+  for( const std::pair<unsigned,unsigned>& pair : m_pairs )
+  {
+    m_neighbors[cursors[pair.first]++] = pair.second;
+    m_neighbors[cursors[pair.second]++] = pair.first;
+  }
+
+  m_q_built = q;
+  m_r_built = r;
+  ++m_num_builds;
 }
 
 scalar PenaltyForce::computePotential( const VectorXs& q, const SparseMatrixsc& M, const VectorXs& r ) const
 {
   assert( q.size() % 2 == 0 ); assert( q.size() == M.rows() ); assert( q.size() == M.cols() ); assert( r.size() == q.size() / 2 );
 
+  updateNeighborList( q, r );
+
   scalar U{ 0.0 };
-  // For each ball
-  for( unsigned ball0 = 0; ball0 < r.size(); ++ball0 )
+  const int npairs{ int( m_pairs.size() ) };
+  // For each pair of nearby balls
+  #ifdef _OPENMP
+  #pragma omp parallel for reduction( + : U )
+  #endif
+  for( int pair_idx = 0; pair_idx < npairs; ++pair_idx )
   {
-    // For each subsequent ball
-    for( unsigned ball1 = ball0 + 1; ball1 < r.size(); ++ball1 )
+    const unsigned ball0{ m_pairs[pair_idx].first };
+    const unsigned ball1{ m_pairs[pair_idx].second };
+    // Compute the total radius
+    const scalar total_radius{ r(ball0) + r(ball1) };
+    // Compute a vector pointing from ball0 to ball1
+    const Vector2s n{ q.segment<2>( 2 * ball1 ) - q.segment<2>( 2 * ball0 ) };
+    // If the squared distance is greater or equal to the sum of the radii squared, no force
+    if( n.squaredNorm() > total_radius * total_radius )
     {
-      // Compute the total radius
-      const scalar total_radius{ r(ball0) + r(ball1) };
-      // Compute a vector pointing from ball0 to ball1
-      const Vector2s n{ q.segment<2>( 2 * ball1 ) - q.segment<2>( 2 * ball0 ) };
-      // If the squared distance is greater or equal to the sum of the radii squared, no force
-      if( n.squaredNorm() > total_radius * total_radius )
-      {
-        continue;
-      }
-      // Compute the penetration depth
-      const scalar delta{ n.norm() - total_radius };
-      assert( delta < 0.0 );
-      // U = 0.5 * k * pen_depth ^ power
-      U += 0.5 * m_k * std::pow( -delta, m_power );
+      continue;
     }
+    // Compute the penetration depth
+    const scalar delta{ n.norm() - total_radius };
+    assert( delta < 0.0 );
+    // U = 0.5 * k * pen_depth ^ power
+    U += 0.5 * m_k * std::pow( -delta, m_power );
   }
 
   return U;
@@ -58,12 +134,21 @@ void PenaltyForce::computeForce( const VectorXs& q, const VectorXs& v, const Spa
   assert( q.size() % 2 == 0 ); assert( q.size() == v.size() ); assert( q.size() == M.rows() );
   assert( q.size() == M.cols() ); assert( r.size() == q.size() / 2 ); assert( q.size() == result.size() );
 
-  // For each ball
-  for( unsigned ball0 = 0; ball0 < r.size(); ++ball0 )
+  updateNeighborList( q, r );
+
+  // Each ball gathers the force from all of its neighbors, so every pair is evaluated twice, but
+  // each ball's force is only written by one thread
+  const int nballs{ int( r.size() ) };
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule( dynamic, 64 )
+  #endif
+  for( int ball0 = 0; ball0 < nballs; ++ball0 )
   {
-    // For each subsequent ball
-    for( unsigned ball1 = ball0 + 1; ball1 < r.size(); ++ball1 )
+    Vector2s F_total{ Vector2s::Zero() };
+    // For each nearby ball
+    for( unsigned neighbor_idx = m_neighbor_starts[ball0]; neighbor_idx < m_neighbor_starts[ball0 + 1]; ++neighbor_idx )
     {
+      const unsigned ball1{ m_neighbors[neighbor_idx] };
       // Compute the total radius
       const scalar total_radius{ r(ball0) + r(ball1) };
       // Compute a vector pointing from ball0 to ball1
@@ -83,18 +168,21 @@ void PenaltyForce::computeForce( const VectorXs& q, const VectorXs& v, const Spa
       // Compute the penetration depth
       d -= total_radius;
       assert( d < 0.0 );
-      // F = 5 * k * pen_depth^(3/2) * n
-      // F = 0.5 * k * power * pen_depth ^ ( power - 1.0 )
-      const Vector2s F{ 0.5 * m_k * m_power * std::pow( -d, m_power - 1.0 ) * n };
-      result.segment<2>( 2 * ball1 ) += F;
-      result.segment<2>( 2 * ball0 ) -= F;
+      // F = 0.5 * k * power * pen_depth ^ ( power - 1.0 ), pushing ball0 away from ball1
+      F_total -= 0.5 * m_k * m_power * std::pow( -d, m_power - 1.0 ) * n;
     }
+    result.segment<2>( 2 * ball0 ) += F_total;
   }
 }
 
+unsigned PenaltyForce::numNeighborListBuilds() const
+{
+  return m_num_builds;
+}
+
 std::unique_ptr<Ball2DForce> PenaltyForce::clone() const
 {
-  return std::unique_ptr<Ball2DForce>{ new PenaltyForce{ m_k, m_power } };
+  return std::unique_ptr<Ball2DForce>{ new PenaltyForce{ m_k, m_power, m_skin } };
 }
 
 void PenaltyForce::serialize( std::ostream& output_stream ) const
@@ -103,4 +191,5 @@ void PenaltyForce::serialize( std::ostream& output_stream ) const
   StringUtilities::serialize( "hertzian_penalty", output_stream );
   Utilities::serialize( m_k, output_stream );
   Utilities::serialize( m_power, output_stream );
+  Utilities::serialize( m_skin, output_stream );
 }
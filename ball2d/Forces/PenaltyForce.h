@@ -8,12 +8,21 @@
 
 #include "Ball2DForce.h"
 
+#include "ball2d/SpatialGridDetector.h"
+#include "scisim/CollisionDetection/SortedCellGrid.h"
+
+#include <vector>
+
+// Pairwise penalty between overlapping balls. Candidate pairs come from a uniform grid neighbor
+// list that is kept between evaluations. Balls within skin of touching are kept in the list, and
+// the list is rebuilt once any ball has moved more than half the skin since the last build. With
+// a skin of zero, the list is rebuilt whenever the positions change.
 class PenaltyForce final : public Ball2DForce
 {
 
 public:
 
-  PenaltyForce( const scalar& k, const scalar& power );
+  PenaltyForce( const scalar& k, const scalar& power, const scalar& skin );
   explicit PenaltyForce( std::istream& input_stream );
 
   virtual ~PenaltyForce() override = default;
@@ -27,10 +36,29 @@ public:
 
   virtual void serialize( std::ostream& output_stream ) const override;
 
+  // Number of times the neighbor list has been built
+  unsigned numNeighborListBuilds() const;
+
 private:
 
+  void updateNeighborList( const VectorXs& q, const VectorXs& r ) const;
+
   const scalar m_k;
   const scalar m_power;
+  const scalar m_skin;
+
+  // The neighbor list is a cache, forces are evaluated through const methods
+  mutable SortedCellGrid<2> m_grid;
+  mutable std::vector<AABB> m_aabbs;
+  // Positions and radii the neighbor list was built from
+  mutable VectorXs m_q_built;
+  mutable VectorXs m_r_built;
+  // Sorted and unique pairs of balls that may overlap
+  mutable std::vector<std::pair<unsigned,unsigned>> m_pairs;
+  // Neighbors of each ball in compressed row form; each pair is listed for both of its balls
+  mutable std::vector<unsigned> m_neighbor_starts;
+  mutable std::vector<unsigned> m_neighbors;
+  mutable unsigned m_num_builds;
 
 };
 
@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "ball2d/Constraints/BallBallConstraint.h"
+#include "scisim/ConstrainedMaps/ContactIslands.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ColoredGaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/IslandImpactOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorAPGD.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/MinMapImpact.h"
+
+// Square lattices of touching balls with random masses and velocities, and a constraint between
+// each pair of horizontal and vertical neighbors. Lattices sit side by side without touching.
+struct BallLattice final
+{
+  VectorXs q;
+  VectorXs v;
+  SparseMatrixsc M;
+  SparseMatrixsc Minv;
+  SparseMatrixsc N;
+  std::vector<std::unique_ptr<Constraint>> cons;
+};
+
+static void generateBallLattice( const unsigned side, const unsigned nlattices, std::mt19937_64& mt, BallLattice& lattice )
+{
+  const unsigned nballs{ nlattices * side * side };
+  std::uniform_real_distribution<scalar> mass_gen{ 0.5, 2.0 };
+  std::uniform_real_distribution<scalar> vel_gen{ -1.0, 1.0 };
+  lattice.q.resize( 2 * nballs );
+  lattice.v.resize( 2 * nballs );
+  lattice.M.resize( 2 * nballs, 2 * nballs );
+  lattice.M.reserve( VectorXi::Ones( 2 * nballs ) );
+  lattice.Minv.resize( 2 * nballs, 2 * nballs );
+  lattice.Minv.reserve( VectorXi::Ones( 2 * nballs ) );
+  for( unsigned row = 0; row < nlattices * side; ++row )
+  {
+    for( unsigned col = 0; col < side; ++col )
+    {
+      const unsigned ball{ row * side + col };
+      lattice.q.segment<2>( 2 * ball ) << scalar( ( side + 1 ) * ( row / side ) + col ), scalar( row % side );
+      lattice.v.segment<2>( 2 * ball ) << vel_gen( mt ), vel_gen( mt );
+      const scalar m{ mass_gen( mt ) };
+      for( unsigned dof = 0; dof < 2; ++dof )
+      {
+        lattice.M.insert( 2 * ball + dof, 2 * ball + dof ) = m;
+        lattice.Minv.insert( 2 * ball + dof, 2 * ball + dof ) = 1.0 / m;
+      }
+    }
+  }
+  lattice.M.makeCompressed();
+  lattice.Minv.makeCompressed();
+
+  lattice.cons.clear();
+  std::vector<Eigen::Triplet<scalar>> triplets;
+  const auto add_constraint = [&lattice,&triplets]( const unsigned ball0, const unsigned ball1 )
+  {
+    const unsigned con_idx{ unsigned( lattice.cons.size() ) };
+    lattice.cons.emplace_back( new BallBallConstraint{ ball0, ball1, lattice.q, 0.5, 0.5, false } );
+    const Vector2s n{ ( lattice.q.segment<2>( 2 * ball0 ) - lattice.q.segment<2>( 2 * ball1 ) ).normalized() };
+    for( unsigned dof = 0; dof < 2; ++dof )
+    {
+      triplets.emplace_back( 2 * ball0 + dof, con_idx, n( dof ) );
+      triplets.emplace_back( 2 * ball1 + dof, con_idx, - n( dof ) );
+    }
+  };
+  for( unsigned row = 0; row < nlattices * side; ++row )
+  {
+    for( unsigned col = 0; col < side; ++col )
+    {
+      const unsigned ball{ row * side + col };
+      if( col + 1 < side )
+      {
+        add_constraint( ball, ball + 1 );
+      }
+      if( row % side + 1 < side )
+      {
+        add_constraint( ball, ball + side );
+      }
+    }
+  }
+  lattice.N.resize( 2 * nballs, SparseMatrixsc::Index( lattice.cons.size() ) );
+  lattice.N.setFromTriplets( triplets.begin(), triplets.end() );
+}
+
+// Every constraint receives exactly one color and no two constraints of a color share a ball
+static int executeColoredGaussSeidelTest00()
+{
+  std::mt19937_64 mt{ 1357 };
+  BallLattice lattice;
+  generateBallLattice( 30, 1, mt, lattice );
+
+  std::vector<std::vector<unsigned>> colors;
+  ColoredGaussSeidelOperator::colorConstraints( lattice.cons, colors );
+  // Greedy coloring of a lattice needs at most one color more than the maximum degree of the line graph
+  if( colors.empty() || colors.size() > 7 )
+  {
+    std::cerr << "Unexpected number of colors: " << colors.size() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<unsigned> times_colored( lattice.cons.size(), 0 );
+  for( const std::vector<unsigned>& color : colors )
+  {
+    std::vector<bool> ball_used( lattice.q.size() / 2, false );
+    for( const unsigned con_idx : color )
+    {
+      ++times_colored[con_idx];
+      std::pair<int,int> bodies;
+      lattice.cons[con_idx]->getSimulatedBodyIndices( bodies );
+      if( ball_used[bodies.first] || ball_used[bodies.second] )
+      {
+        std::cerr << "Constraints of a color share a ball" << std::endl;
+        return EXIT_FAILURE;
+      }
+      ball_used[bodies.first] = true;
+      ball_used[bodies.second] = true;
+    }
+  }
+  for( const unsigned count : times_colored )
+  {
+    if( count != 1 )
+    {
+      std::cerr << "Each constraint should be colored exactly once" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// The resolved velocity satisfies every constraint and conserves momentum
+static int executeColoredGaussSeidelTest01()
+{
+  std::mt19937_64 mt{ 2468 };
+  BallLattice lattice;
+  generateBallLattice( 30, 1, mt, lattice );
+  const int ncons{ int( lattice.cons.size() ) };
+
+  constexpr scalar v_tol{ 1.0e-9 };
+  ColoredGaussSeidelOperator colored_gauss_seidel{ v_tol };
+  VectorXs alpha{ VectorXs::Zero( ncons ) };
+  colored_gauss_seidel.flow( lattice.cons, lattice.M, lattice.Minv, lattice.q, lattice.v, lattice.v, lattice.N, SparseMatrixsc{}, VectorXs::Zero( ncons ), VectorXs::Constant( ncons, 0.5 ), alpha );
+
+  if( ( alpha.array() < 0.0 ).any() )
+  {
+    std::cerr << "Impulses should be non-negative" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const VectorXs v1{ lattice.v + lattice.Minv * lattice.N * alpha };
+  for( const std::unique_ptr<Constraint>& con : lattice.cons )
+  {
+    if( con->evalNdotV( lattice.q, v1 ) < - v_tol - 1.0e-9 )
+    {
+      std::cerr << "Constraint violated after impact: " << con->evalNdotV( lattice.q, v1 ) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  const VectorXs p0{ lattice.M * lattice.v };
+  const VectorXs p1{ lattice.M * v1 };
+  const Vector2s momentum_change{ Eigen::Map<const MatrixXXsc>{ p1.data(), 2, p1.size() / 2 }.rowwise().sum() - Eigen::Map<const MatrixXXsc>{ p0.data(), 2, p0.size() / 2 }.rowwise().sum() };
+  if( momentum_change.lpNorm<Eigen::Infinity>() > 1.0e-9 )
+  {
+    std::cerr << "Momentum not conserved: " << momentum_change.transpose() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// A ball touching its own periodic image through a portal is colored like a contact on one ball
+static int executeColoredGaussSeidelTest02()
+{
+  std::mt19937_64 mt{ 2468 };
+  BallLattice lattice;
+  generateBallLattice( 3, 1, mt, lattice );
+  const Vector2s x0{ lattice.q.segment<2>( 0 ) };
+  lattice.cons.emplace_back( new BallBallConstraint{ 0, 0, x0, Vector2s{ x0 - Vector2s{ 1.0, 0.0 } }, 0.5, 0.5, true } );
+  const unsigned self_con_idx{ unsigned( lattice.cons.size() - 1 ) };
+
+  std::vector<std::vector<unsigned>> colors;
+  ColoredGaussSeidelOperator::colorConstraints( lattice.cons, colors );
+
+  std::vector<unsigned> times_colored( lattice.cons.size(), 0 );
+  for( const std::vector<unsigned>& color : colors )
+  {
+    unsigned ball0_uses{ 0 };
+    for( const unsigned con_idx : color )
+    {
+      ++times_colored[con_idx];
+      std::pair<int,int> bodies;
+      lattice.cons[con_idx]->getSimulatedBodyIndices( bodies );
+      if( bodies.first == 0 || bodies.second == 0 )
+      {
+        ++ball0_uses;
+      }
+    }
+    if( ball0_uses > 1 )
+    {
+      std::cerr << "Constraints of a color share the ball touching its image" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if( times_colored[self_con_idx] != 1 || std::count( times_colored.cbegin(), times_colored.cend(), 1u ) != int( times_colored.size() ) )
+  {
+    std::cerr << "Each constraint should be colored exactly once" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Each lattice forms its own island, and small islands are merged into groups
+static int executeContactIslandsTest00()
+{
+  std::mt19937_64 mt{ 3579 };
+  constexpr unsigned side{ 10 };
+  constexpr unsigned nlattices{ 5 };
+  BallLattice lattice;
+  generateBallLattice( side, nlattices, mt, lattice );
+  const unsigned cons_per_lattice{ 2 * side * ( side - 1 ) };
+
+  std::vector<std::vector<unsigned>> islands;
+  ContactIslands::partition( lattice.cons, 0, islands );
+  if( islands.size() != nlattices )
+  {
+    std::cerr << "Expected one island per lattice, found " << islands.size() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::vector<int> ball_island( lattice.q.size() / 2, -1 );
+  std::vector<unsigned> times_grouped( lattice.cons.size(), 0 );
+  for( std::vector<std::vector<unsigned>>::size_type island_idx = 0; island_idx < islands.size(); ++island_idx )
+  {
+    if( islands[island_idx].size() != cons_per_lattice )
+    {
+      std::cerr << "Island " << island_idx << " has " << islands[island_idx].size() << " constraints, expected " << cons_per_lattice << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( const unsigned con_idx : islands[island_idx] )
+    {
+      ++times_grouped[con_idx];
+      std::pair<int,int> bodies;
+      lattice.cons[con_idx]->getSimulatedBodyIndices( bodies );
+      for( const int ball : { bodies.first, bodies.second } )
+      {
+        if( ball_island[ball] != -1 && ball_island[ball] != int( island_idx ) )
+        {
+          std::cerr << "Islands share a ball" << std::endl;
+          return EXIT_FAILURE;
+        }
+        ball_island[ball] = int( island_idx );
+      }
+    }
+  }
+  for( const unsigned count : times_grouped )
+  {
+    if( count != 1 )
+    {
+      std::cerr << "Each constraint should belong to exactly one island" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Pairs of lattices reach the minimum, and the leftover lattice joins the last pair
+  ContactIslands::partition( lattice.cons, cons_per_lattice + 1, islands );
+  if( islands.size() != 2 || islands[0].size() != 2 * cons_per_lattice || islands[1].size() != 3 * cons_per_lattice )
+  {
+    std::cerr << "Unexpected grouping of small islands" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( !std::is_sorted( islands[1].begin(), islands[1].end() ) )
+  {
+    std::cerr << "Constraint indices within a group should be sorted" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Solving islands independently matches solving the whole problem at once
+static int executeIslandImpactOperatorTest00()
+{
+  std::mt19937_64 mt{ 4680 };
+  BallLattice lattice;
+  generateBallLattice( 6, 6, mt, lattice );
+  const int ncons{ int( lattice.cons.size() ) };
+  const VectorXs nrel{ VectorXs::Zero( ncons ) };
+  const VectorXs CoR{ VectorXs::Constant( ncons, 0.5 ) };
+
+  constexpr scalar tol{ 1.0e-7 };
+  LCPOperatorAPGD apgd{ tol, 100000 };
+  SparseMatrixsc Q;
+  ImpactOperatorUtilities::computeDelassusOperator( lattice.N, lattice.Minv, Q );
+  VectorXs alpha{ VectorXs::Zero( ncons ) };
+  apgd.flow( lattice.cons, lattice.M, lattice.Minv, lattice.q, lattice.v, lattice.v, lattice.N, Q, nrel, CoR, alpha );
+
+  IslandImpactOperator islands{ 0, apgd };
+  if( islands.usesDelassusOperator() )
+  {
+    std::cerr << "Island operator should form the Delassus operator of each island itself" << std::endl;
+    return EXIT_FAILURE;
+  }
+  VectorXs alpha_islands{ VectorXs::Zero( ncons ) };
+  islands.flow( lattice.cons, lattice.M, lattice.Minv, lattice.q, lattice.v, lattice.v, lattice.N, SparseMatrixsc{}, nrel, CoR, alpha_islands );
+
+  VectorXs b;
+  ImpactOperatorUtilities::computeLCPQPLinearTerm( lattice.N, nrel, CoR, lattice.v, lattice.v, b );
+  const scalar residual{ MinMapImpact{}( alpha_islands, Q * alpha_islands + b ) };
+  if( residual > tol )
+  {
+    std::cerr << "Island solution residual " << residual << " exceeds tolerance" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const scalar error{ ( alpha - alpha_islands ).lpNorm<Eigen::Infinity>() };
+  if( error > 1.0e-5 )
+  {
+    std::cerr << "Island solution differs from the monolithic solution by " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Operators that index constraints by column, like colored Gauss-Seidel, solve each island with only
+// the island's constraints
+static int executeIslandImpactOperatorTest01()
+{
+  std::mt19937_64 mt{ 1357 };
+  BallLattice lattice;
+  generateBallLattice( 5, 6, mt, lattice );
+  const int ncons{ int( lattice.cons.size() ) };
+
+  constexpr scalar v_tol{ 1.0e-9 };
+  IslandImpactOperator islands{ 0, ColoredGaussSeidelOperator{ v_tol } };
+  VectorXs alpha{ VectorXs::Zero( ncons ) };
+  islands.flow( lattice.cons, lattice.M, lattice.Minv, lattice.q, lattice.v, lattice.v, lattice.N, SparseMatrixsc{}, VectorXs::Zero( ncons ), VectorXs::Constant( ncons, 0.5 ), alpha );
+
+  if( ( alpha.array() < 0.0 ).any() )
+  {
+    std::cerr << "Impulses should be non-negative" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const VectorXs v1{ lattice.v + lattice.Minv * lattice.N * alpha };
+  for( const std::unique_ptr<Constraint>& con : lattice.cons )
+  {
+    if( con == nullptr )
+    {
+      std::cerr << "Island solve released a constraint" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( con->evalNdotV( lattice.q, v1 ) < - v_tol - 1.0e-9 )
+    {
+      std::cerr << "Constraint violated after impact: " << con->evalNdotV( lattice.q, v1 ) << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "colored_gauss_seidel_00" )
+  {
+    return executeColoredGaussSeidelTest00();
+  }
+  else if( test_name == "colored_gauss_seidel_01" )
+  {
+    return executeColoredGaussSeidelTest01();
+  }
+  else if( test_name == "colored_gauss_seidel_02" )
+  {
+    return executeColoredGaussSeidelTest02();
+  }
+  else if( test_name == "contact_islands_00" )
+  {
+    return executeContactIslandsTest00();
+  }
+  else if( test_name == "island_impact_operator_00" )
+  {
+    return executeIslandImpactOperatorTest00();
+  }
+  else if( test_name == "island_impact_operator_01" )
+  {
+    return executeIslandImpactOperatorTest01();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
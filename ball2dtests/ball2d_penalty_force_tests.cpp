@@ -0,0 +1,181 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "ball2d/Forces/PenaltyForce.h"
+
+// Randomly placed balls of varying radii, dense enough that many balls overlap
+static void generateBalls( const unsigned nballs, std::mt19937_64& mt, VectorXs& q, VectorXs& v, SparseMatrixsc& M, VectorXs& r )
+{
+  const scalar extent{ std::sqrt( scalar( nballs ) ) };
+  std::uniform_real_distribution<scalar> pos_gen{ 0.0, extent };
+  std::uniform_real_distribution<scalar> radius_gen{ 0.3, 0.7 };
+  q.resize( 2 * nballs );
+  v.setZero( 2 * nballs );
+  r.resize( nballs );
+  for( unsigned ball_idx = 0; ball_idx < nballs; ++ball_idx )
+  {
+    q( 2 * ball_idx + 0 ) = pos_gen( mt );
+    q( 2 * ball_idx + 1 ) = pos_gen( mt );
+    r( ball_idx ) = radius_gen( mt );
+  }
+  M.resize( 2 * nballs, 2 * nballs );
+  M.setIdentity();
+}
+
+// Reference all pairs evaluation of the penalty force and potential
+static void computeAllPairs( const scalar& k, const scalar& power, const VectorXs& q, const VectorXs& r, VectorXs& F, scalar& U )
+{
+  F.setZero( q.size() );
+  U = 0.0;
+  for( int ball0 = 0; ball0 < r.size(); ++ball0 )
+  {
+    for( int ball1 = ball0 + 1; ball1 < r.size(); ++ball1 )
+    {
+      const Vector2s n{ q.segment<2>( 2 * ball1 ) - q.segment<2>( 2 * ball0 ) };
+      const scalar pen_depth{ r( ball0 ) + r( ball1 ) - n.norm() };
+      if( pen_depth < 0.0 )
+      {
+        continue;
+      }
+      U += 0.5 * k * std::pow( pen_depth, power );
+      const Vector2s f{ 0.5 * k * power * std::pow( pen_depth, power - 1.0 ) * n.normalized() };
+      F.segment<2>( 2 * ball1 ) += f;
+      F.segment<2>( 2 * ball0 ) -= f;
+    }
+  }
+}
+
+static bool forceMatchesAllPairs( const PenaltyForce& penalty, const scalar& k, const scalar& power, const VectorXs& q, const VectorXs& v, const SparseMatrixsc& M, const VectorXs& r )
+{
+  VectorXs F_expected;
+  scalar U_expected;
+  computeAllPairs( k, power, q, r, F_expected, U_expected );
+
+  VectorXs F{ VectorXs::Zero( q.size() ) };
+  penalty.computeForce( q, v, M, r, F );
+  const scalar U{ penalty.computePotential( q, M, r ) };
+
+  const scalar force_error{ ( F - F_expected ).lpNorm<Eigen::Infinity>() };
+  const scalar potential_error{ std::fabs( U - U_expected ) };
+  if( force_error > 1.0e-9 * std::max( scalar( 1.0 ), F_expected.lpNorm<Eigen::Infinity>() ) )
+  {
+    std::cerr << "Penalty force differs from all pairs force by " << force_error << std::endl;
+    return false;
+  }
+  if( potential_error > 1.0e-9 * std::max( scalar( 1.0 ), U_expected ) )
+  {
+    std::cerr << "Penalty potential differs from all pairs potential by " << potential_error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Without a skin, the neighbor list is rebuilt for each new configuration
+static int executePenaltyForceTest00()
+{
+  std::mt19937_64 mt{ 1337 };
+  VectorXs q;
+  VectorXs v;
+  SparseMatrixsc M;
+  VectorXs r;
+  generateBalls( 2000, mt, q, v, M, r );
+
+  constexpr scalar k{ 100.0 };
+  constexpr scalar power{ 2.5 };
+  const PenaltyForce penalty{ k, power, 0.0 };
+
+  if( !forceMatchesAllPairs( penalty, k, power, q, v, M, r ) )
+  {
+    return EXIT_FAILURE;
+  }
+  // Identical positions reuse the list
+  if( !forceMatchesAllPairs( penalty, k, power, q, v, M, r ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( penalty.numNeighborListBuilds() != 1 )
+  {
+    std::cerr << "Expected 1 neighbor list build, found " << penalty.numNeighborListBuilds() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  q.segment<2>( 0 ).array() += 1.0e-3;
+  if( !forceMatchesAllPairs( penalty, k, power, q, v, M, r ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( penalty.numNeighborListBuilds() != 2 )
+  {
+    std::cerr << "Expected 2 neighbor list builds, found " << penalty.numNeighborListBuilds() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// With a skin, the list is reused while balls move by less than half of the skin
+static int executePenaltyForceTest01()
+{
+  std::mt19937_64 mt{ 42 };
+  VectorXs q;
+  VectorXs v;
+  SparseMatrixsc M;
+  VectorXs r;
+  generateBalls( 2000, mt, q, v, M, r );
+
+  constexpr scalar k{ 50.0 };
+  constexpr scalar power{ 2.0 };
+  constexpr scalar skin{ 0.2 };
+  const PenaltyForce penalty{ k, power, skin };
+
+  // Each step moves every ball by at most 0.01 along each axis
+  std::uniform_real_distribution<scalar> step_gen{ -0.01, 0.01 };
+  constexpr unsigned nsteps{ 50 };
+  for( unsigned step = 0; step < nsteps; ++step )
+  {
+    if( !forceMatchesAllPairs( penalty, k, power, q, v, M, r ) )
+    {
+      std::cerr << "Mismatch at step " << step << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( int dof = 0; dof < q.size(); ++dof )
+    {
+      q( dof ) += step_gen( mt );
+    }
+  }
+
+  // A ball travels at most 0.01 * sqrt( 2 ) per step, so at least 7 steps pass between rebuilds
+  if( penalty.numNeighborListBuilds() < 2 || penalty.numNeighborListBuilds() > ( nsteps + 6 ) / 7 )
+  {
+    std::cerr << "Unexpected number of neighbor list builds: " << penalty.numNeighborListBuilds() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "penalty_force_00" )
+  {
+    return executePenaltyForceTest00();
+  }
+  else if( test_name == "penalty_force_01" )
+  {
+    return executePenaltyForceTest01();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
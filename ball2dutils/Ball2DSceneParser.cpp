@@ -8,8 +8,6 @@
 #include <iostream>
 #include <fstream>
 
-#include "Ball2D.h"
-
 #include "ball2d/Ball2DState.h"
 #include "ball2d/Forces/Ball2DForce.h"
 #include "ball2d/Forces/Ball2DGravityForce.h"
@@ -29,17 +27,25 @@
 #include "scisim/ConstrainedMaps/SymplecticEulerImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ColoredGaussSeidelOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/JacobiOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GROperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GRROperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/IslandImpactOperator.h"
 #include "scisim/ConstrainedMaps/FrictionMaps/FrictionOperator.h"
 #include "scisim/ConstrainedMaps/FrictionSolver.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorAPGD.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorMatrixFreeAPGD.h"
 #include "scisim/ConstrainedMaps/StaggeredProjections.h"
 #include "scisim/ConstrainedMaps/Sobogus.h"
+#include "scisim/ConstrainedMaps/IslandFrictionSolver.h"
 
 #include "rapidxml.hpp"
 
+#ifdef USE_HDF5
+#include "scisim/HDF5File.h"
+#endif
+
 #ifdef IPOPT_FOUND
 #include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorIpopt.h"
 #endif
@@ -55,19 +61,25 @@ static bool loadTextFileIntoVector( const std::string& filename, std::vector<cha
   assert( xmlchars.empty() );
 
   // Attempt to open the text file for reading
-  std::ifstream textfile{ filename };
+  std::ifstream textfile{ filename, std::ios::binary | std::ios::ate };
   if( !textfile.is_open() )
   {
     return false;
   }
 
-  // Read the entire file into a single string
-  std::string line;
-  while( getline( textfile, line ) )
+  // Read the entire file with a single allocation, as scene files with many bodies can be large
+  const std::streamoff file_size{ textfile.tellg() };
+  if( file_size < 0 )
   {
-    std::copy( line.cbegin(), line.cend(), back_inserter( xmlchars ) );
+    return false;
   }
-  xmlchars.emplace_back( '\0' );
+  xmlchars.resize( std::vector<char>::size_type( file_size ) + 1 );
+  textfile.seekg( 0 );
+  if( !textfile.read( xmlchars.data(), file_size ) )
+  {
+    return false;
+  }
+  xmlchars.back() = '\0';
 
   return true;
 }
@@ -215,6 +227,25 @@ static bool loadEndTime( const rapidxml::xml_node<>& node, scalar& end_time )
   return true;
 }
 
+static bool loadBallRenumbering( const rapidxml::xml_node<>& node, Ball2DState& state )
+{
+  // Attempt to parse the number of steps between renumberings
+  const rapidxml::xml_attribute<>* steps_attrib{ node.first_attribute( "steps" ) };
+  if( !steps_attrib )
+  {
+    std::cerr << "Failed to locate steps attribute for body_renumbering node." << std::endl;
+    return false;
+  }
+  unsigned steps;
+  if( !StringUtilities::extractFromString( steps_attrib->value(), steps ) || steps == 0 )
+  {
+    std::cerr << "Failed to parse steps attribute for body_renumbering. Value must be a positive integer." << std::endl;
+    return false;
+  }
+  state.setRenumberingFrequency( steps );
+  return true;
+}
+
 static bool loadScriptingSetup( const rapidxml::xml_node<>& node, std::string& scripting_callback )
 {
   assert( scripting_callback.empty() );
@@ -238,52 +269,141 @@ static bool loadScriptingSetup( const rapidxml::xml_node<>& node, std::string& s
   return true;
 }
 
-static bool loadBalls( const rapidxml::xml_node<>& node, std::vector<Ball2D>& balls )
+namespace
+{
+
+  // Balls stored column by column in an HDF5 file, for scenes too large to list ball by ball in XML
+  struct BallList final
+  {
+    Matrix2Xsc x;
+    Matrix2Xsc v;
+    Eigen::Matrix<scalar,1,Eigen::Dynamic> m;
+    Eigen::Matrix<scalar,1,Eigen::Dynamic> r;
+    // Optional, balls are not fixed if empty
+    Eigen::Matrix<int,1,Eigen::Dynamic> fixed;
+  };
+
+}
+
+static bool loadBallList( const std::string& file_name, BallList& ball_list )
 {
+  #ifdef USE_HDF5
+  try
+  {
+    const HDF5File list_file{ file_name, HDF5AccessType::READ_ONLY };
+    ball_list.x = list_file.read<Matrix2Xsc>( "balls/x" );
+    ball_list.v = list_file.read<Matrix2Xsc>( "balls/v" );
+    ball_list.m = list_file.read<Eigen::Matrix<scalar,1,Eigen::Dynamic>>( "balls/m" );
+    ball_list.r = list_file.read<Eigen::Matrix<scalar,1,Eigen::Dynamic>>( "balls/r" );
+    if( list_file.exists( "balls/fixed" ) )
+    {
+      ball_list.fixed = list_file.read<Eigen::Matrix<int,1,Eigen::Dynamic>>( "balls/fixed" );
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << "Failed to load ball_list " << file_name << ": " << error << std::endl;
+    return false;
+  }
+  const int nballs{ int( ball_list.r.size() ) };
+  if( ball_list.x.cols() != nballs || ball_list.v.cols() != nballs || ball_list.m.size() != nballs || ( ball_list.fixed.size() != 0 && ball_list.fixed.size() != nballs ) )
+  {
+    std::cerr << "Failed to load ball_list " << file_name << ", every data set must have one column per ball" << std::endl;
+    return false;
+  }
+  return true;
+  #else
+  std::cerr << "Error, loading ball_list " << file_name << " requires HDF5 support. Please recompile with USE_HDF5=ON." << std::endl;
+  return false;
+  #endif
+}
+
+// Balls listed in the scene file are loaded first, followed by the balls of any companion ball lists
+// in document order. All balls are counted up front so that state is allocated only once.
+static bool loadBalls( const rapidxml::xml_node<>& node, VectorXs& q, VectorXs& v, VectorXs& m, VectorXs& r, std::vector<bool>& fixed )
+{
+  unsigned nballs{ 0 };
   for( rapidxml::xml_node<>* nd = node.first_node( "ball" ); nd; nd = nd->next_sibling( "ball" ) )
   {
-    // Attempt to parse the ball's position
-    Vector2s x;
+    ++nballs;
+  }
+  std::vector<BallList> ball_lists;
+  for( rapidxml::xml_node<>* nd = node.first_node( "ball_list" ); nd; nd = nd->next_sibling( "ball_list" ) )
+  {
+    const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "filename" ) };
+    if( !attrib )
+    {
+      std::cerr << "Failed to locate filename attribute for ball_list" << std::endl;
+      return false;
+    }
+    ball_lists.emplace_back();
+    if( !loadBallList( attrib->value(), ball_lists.back() ) )
+    {
+      return false;
+    }
+    nballs += unsigned( ball_lists.back().r.size() );
+  }
 
+  q.resize( 2 * nballs );
+  v.resize( 2 * nballs );
+  m.resize( 2 * nballs );
+  r.resize( nballs );
+  fixed.resize( nballs );
+
+  unsigned ball_idx{ 0 };
+  for( rapidxml::xml_node<>* nd = node.first_node( "ball" ); nd; nd = nd->next_sibling( "ball" ), ++ball_idx )
+  {
+    // Attempt to parse the ball's position
     const rapidxml::xml_attribute<>* const x_attrib{ nd->first_attribute( "x" ) };
     if( !x_attrib ) { return false; }
-    StringUtilities::extractFromString( x_attrib->value(), x.x() );
+    StringUtilities::extractFromString( x_attrib->value(), q( 2 * ball_idx ) );
 
     const rapidxml::xml_attribute<>* const y_attrib{ nd->first_attribute( "y" ) };
     if( !y_attrib ) { return false; }
-    StringUtilities::extractFromString( y_attrib->value(), x.y() );
+    StringUtilities::extractFromString( y_attrib->value(), q( 2 * ball_idx + 1 ) );
 
     // Attempt to parse the ball's velocity
-    Vector2s v;
-
     const rapidxml::xml_attribute<>* const vx_attrib{ nd->first_attribute( "vx" ) };
     if( !vx_attrib ) { return false; }
-    StringUtilities::extractFromString( vx_attrib->value(), v.x() );
+    StringUtilities::extractFromString( vx_attrib->value(), v( 2 * ball_idx ) );
 
     const rapidxml::xml_attribute<>* const vy_attrib{ nd->first_attribute( "vy" ) };
     if( !vy_attrib ) { return false; }
-    StringUtilities::extractFromString( vy_attrib->value(), v.y() );
+    StringUtilities::extractFromString( vy_attrib->value(), v( 2 * ball_idx + 1 ) );
 
     // Attempt to parse the ball's mass
-    scalar m;
     const rapidxml::xml_attribute<>* const m_attrib{ nd->first_attribute( "m" ) };
     if( !m_attrib ) { return false; }
-    StringUtilities::extractFromString( m_attrib->value(), m );
+    StringUtilities::extractFromString( m_attrib->value(), m( 2 * ball_idx ) );
+    m( 2 * ball_idx + 1 ) = m( 2 * ball_idx );
 
     // Attempt to parse the ball's radius
-    scalar r;
     const rapidxml::xml_attribute<>* const r_attrib{ nd->first_attribute( "r" ) };
     if( !r_attrib ) { return false; }
-    StringUtilities::extractFromString( r_attrib->value(), r );
+    StringUtilities::extractFromString( r_attrib->value(), r( ball_idx ) );
 
     // Attempt to parse whether the ball is fixed
-    bool fixed;
+    bool ball_fixed;
     const rapidxml::xml_attribute<>* const fixed_attrib{ nd->first_attribute( "fixed" ) };
     if( !fixed_attrib ) { return false; }
-    StringUtilities::extractFromString( fixed_attrib->value(), fixed );
+    StringUtilities::extractFromString( fixed_attrib->value(), ball_fixed );
+    fixed[ ball_idx ] = ball_fixed;
+  }
 
-    balls.emplace_back( x, v, m, r, fixed );
+  for( const BallList& ball_list : ball_lists )
+  {
+    const unsigned list_size{ unsigned( ball_list.r.size() ) };
+    Eigen::Map<Matrix2Xsc>{ q.data() + 2 * ball_idx, 2, list_size } = ball_list.x;
+    Eigen::Map<Matrix2Xsc>{ v.data() + 2 * ball_idx, 2, list_size } = ball_list.v;
+    Eigen::Map<Matrix2Xsc>{ m.data() + 2 * ball_idx, 2, list_size } = ball_list.m.colwise().replicate<2>();
+    r.segment( ball_idx, list_size ) = ball_list.r.transpose();
+    for( unsigned list_idx = 0; list_idx < list_size; ++list_idx )
+    {
+      fixed[ ball_idx + list_idx ] = ball_list.fixed.size() != 0 && ball_list.fixed( list_idx ) != 0;
+    }
+    ball_idx += list_size;
   }
+  assert( ball_idx == nballs );
 
   return true;
 }
@@ -684,6 +804,40 @@ static bool loadLCPSolver( const rapidxml::xml_node<>& node, std::unique_ptr<Imp
     }
     impact_operator.reset( new LCPOperatorAPGD{ tol, max_iters } );
   }
+  else if( solver_name == "apgd_matrix_free" )
+  {
+    // Attempt to parse the solver tolerance
+    scalar tol;
+    {
+      const rapidxml::xml_attribute<>* const tol_nd{ node.first_attribute( "tol" ) };
+      if( tol_nd == nullptr )
+      {
+        std::cerr << "Could not locate tol for apgd_matrix_free solver" << std::endl;
+        return false;
+      }
+      if( !StringUtilities::extractFromString( std::string{ tol_nd->value() }, tol ) || tol <= 0.0 )
+      {
+        std::cerr << "Could not load tol for apgd_matrix_free solver, value must be a positive scalar" << std::endl;
+        return false;
+      }
+    }
+    // Attempt to parse the max number of iterations
+    unsigned max_iters;
+    {
+      const rapidxml::xml_attribute<>* const itr_nd{ node.first_attribute( "max_iters" ) };
+      if( itr_nd == nullptr )
+      {
+        std::cerr << "Could not locate max_iters for apgd_matrix_free solver" << std::endl;
+        return false;
+      }
+      if( !StringUtilities::extractFromString( std::string{ itr_nd->value() }, max_iters ) )
+      {
+        std::cerr << "Could not load max_iters for apgd_matrix_free solver, value must be an unsigned integer" << std::endl;
+        return false;
+      }
+    }
+    impact_operator.reset( new LCPOperatorMatrixFreeAPGD{ tol, max_iters } );
+  }
   #ifdef QL_FOUND
   else if( solver_name == "ql_vp" )
   {
@@ -794,7 +948,7 @@ static bool loadImpactOperatorNoCoR( const rapidxml::xml_node<>& node, std::uniq
   }
 
   scalar v_tol = std::numeric_limits<scalar>::signaling_NaN();
-  if( type == "gauss_seidel" || type == "jacobi" || type == "gr" )
+  if( type == "gauss_seidel" || type == "colored_gauss_seidel" || type == "jacobi" || type == "gr" )
   {
     // Attempt to load the termination tolerance
     const rapidxml::xml_attribute<>* const v_tol_nd{ node.first_attribute( "v_tol" ) };
@@ -814,6 +968,10 @@ static bool loadImpactOperatorNoCoR( const rapidxml::xml_node<>& node, std::uniq
   {
     impact_operator.reset( new GaussSeidelOperator{ v_tol } );
   }
+  else if( type == "colored_gauss_seidel" )
+  {
+    impact_operator.reset( new ColoredGaussSeidelOperator{ v_tol } );
+  }
   else if( type == "jacobi" )
   {
     impact_operator.reset( new JacobiOperator{ v_tol } );
@@ -1418,7 +1576,50 @@ static bool loadSobogusFrictionSolver( const rapidxml::xml_node<>& node, std::un
     return false;
   }
 
-  friction_solver.reset( new Sobogus{ SobogusSolverType::Balls2D, static_cast<unsigned>( eval_every ) } );
+  SobogusSettings settings;
+  if( !loadSobogusSettings( node, settings ) )
+  {
+    return false;
+  }
+
+  friction_solver.reset( new Sobogus{ SobogusSolverType::Balls2D, static_cast<unsigned>( eval_every ), settings } );
+
+  return true;
+}
+
+// Splits the impact or friction solve into independent groups of contacts. Example:
+//  <contact_islands min_contacts="64"/>
+static bool loadContactIslands( const rapidxml::xml_node<>& node, std::unique_ptr<ImpactOperator>& impact_operator, std::unique_ptr<FrictionSolver>& friction_solver )
+{
+  // Attempt to load the smallest number of contacts in a group
+  int min_contacts;
+  {
+    const rapidxml::xml_attribute<>* const attrib_nd{ node.first_attribute( "min_contacts" ) };
+    if( attrib_nd == nullptr )
+    {
+      std::cerr << "Could not locate min_contacts for contact_islands" << std::endl;
+      return false;
+    }
+    if( !StringUtilities::extractFromString( attrib_nd->value(), min_contacts ) || min_contacts < 0 )
+    {
+      std::cerr << "Could not load min_contacts value for contact_islands, value of min_contacts must be a nonnegative integer" << std::endl;
+      return false;
+    }
+  }
+
+  if( impact_operator != nullptr )
+  {
+    impact_operator.reset( new IslandImpactOperator{ unsigned( min_contacts ), *impact_operator } );
+  }
+  else if( friction_solver != nullptr )
+  {
+    friction_solver.reset( new IslandFrictionSolver{ unsigned( min_contacts ), *friction_solver } );
+  }
+  else
+  {
+    std::cerr << "Error loading contact_islands, no impact_operator or friction solver specified" << std::endl;
+    return false;
+  }
 
   return true;
 }
@@ -1477,7 +1678,21 @@ static bool loadPenaltyForce( const rapidxml::xml_node<>& node, std::vector<std:
       }
     }
 
-    forces.emplace_back( new PenaltyForce{ stiffness, potential_power } );
+    // Optional distance within which nearby balls are kept in the neighbor list
+    scalar skin{ 0.0 };
+    {
+      const rapidxml::xml_attribute<>* skin_attrib{ nd->first_attribute( "skin" ) };
+      if( skin_attrib != nullptr )
+      {
+        if( !StringUtilities::extractFromString( skin_attrib->value(), skin ) || skin < 0.0 )
+        {
+          std::cerr << "Failed to load skin attribute for penalty. Value must be a non-negative scalar." << std::endl;
+          return false;
+        }
+      }
+    }
+
+    forces.emplace_back( new PenaltyForce{ stiffness, potential_power, skin } );
   }
   
   return true;
@@ -1485,7 +1700,11 @@ static bool loadPenaltyForce( const rapidxml::xml_node<>& node, std::vector<std:
 
 static bool loadSimulationState( const rapidxml::xml_node<>& root_node, const std::string& file_name, std::string& scripting_callback_name, Ball2DState& state, std::unique_ptr<UnconstrainedMap>& integrator, std::string& dt_string, Rational<std::intmax_t>& dt, scalar& end_time, std::unique_ptr<ImpactOperator>& impact_operator, std::unique_ptr<ImpactMap>& impact_map, scalar& CoR, std::unique_ptr<FrictionSolver>& friction_solver, scalar& mu, std::unique_ptr<ImpactFrictionMap>& if_map )
 {
-  std::vector<Ball2D> balls;
+  VectorXs q;
+  VectorXs v;
+  VectorXs m;
+  VectorXs r;
+  std::vector<bool> fixed;
   std::vector<StaticDrum> drums;
   std::vector<StaticPlane> planes;
   std::vector<PlanarPortal> planar_portals;
@@ -1594,6 +1813,16 @@ static bool loadSimulationState( const rapidxml::xml_node<>& root_node, const st
 
   // TODO: GRR friction solver goes here
 
+  // Split the solve into contact islands, if requested
+  if( root_node.first_node( "contact_islands" ) != nullptr )
+  {
+    if( !loadContactIslands( *root_node.first_node( "contact_islands" ), impact_operator, friction_solver ) )
+    {
+      std::cerr << "Failed to load contact_islands in xml scene file: " << file_name << std::endl;
+      return false;
+    }
+  }
+
   // Attempt to load any user-provided static drums
   if( !loadStaticDrums( root_node, drums ) )
   {
@@ -1616,26 +1845,12 @@ static bool loadSimulationState( const rapidxml::xml_node<>& root_node, const st
   }
 
   // Attempt to load any user-provided balls
-  if( !loadBalls( root_node, balls ) )
+  if( !loadBalls( root_node, q, v, m, r, fixed ) )
   {
     std::cerr << "Failed to load balls: " << file_name << std::endl;
     return false;
   }
 
-  VectorXs q{ static_cast<VectorXs::Index>( 2 * balls.size() ) };
-  VectorXs v{ static_cast<VectorXs::Index>( 2 * balls.size() ) };
-  VectorXs m{ static_cast<VectorXs::Index>( 2 * balls.size() ) };
-  VectorXs r{ static_cast<VectorXs::Index>(  balls.size() ) };
-  std::vector<bool> fixed( balls.size() );
-  for( std::vector<Ball2D>::size_type ball_idx = 0; ball_idx < balls.size(); ++ball_idx )
-  {
-    q.segment<2>( 2 * ball_idx ) = balls[ball_idx].x();
-    v.segment<2>( 2 * ball_idx ) = balls[ball_idx].v();
-    m.segment<2>( 2 * ball_idx ).setConstant( balls[ball_idx].m() );
-    r( ball_idx ) = balls[ball_idx].r();
-    fixed[ ball_idx ] = balls[ball_idx].fixed();
-  }
-
   using std::swap;
   swap( q, state.q() );
   swap( v, state.v() );
@@ -1647,6 +1862,16 @@ static bool loadSimulationState( const rapidxml::xml_node<>& root_node, const st
   swap( planar_portals, state.planarPortals() );
   swap( forces, state.forces() );
 
+  // Load the frequency of ball renumbering, if present
+  if( root_node.first_node( "body_renumbering" ) != nullptr )
+  {
+    if( !loadBallRenumbering( *root_node.first_node( "body_renumbering" ), state ) )
+    {
+      std::cerr << "Failed to load body_renumbering in xml scene file: " << file_name << std::endl;
+      return false;
+    }
+  }
+
   return true;
 }
 
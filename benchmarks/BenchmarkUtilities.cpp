@@ -0,0 +1,300 @@
+#include "BenchmarkUtilities.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <getopt.h>
+
+#include "scisim/CompileDefinitions.h"
+#include "scisim/StringUtilities.h"
+#include "scisim/ConstrainedMaps/GeometricImpactFrictionMap.h"
+#include "scisim/ConstrainedMaps/StabilizedImpactFrictionMap.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ColoredGaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/GaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorAPGD.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorMatrixFreeAPGD.h"
+#include "scisim/Timer/Profiler.h"
+
+static const std::vector<BenchmarkSolver> ALL_SOLVERS
+{
+  BenchmarkSolver::GAUSS_SEIDEL,
+  BenchmarkSolver::COLORED_GAUSS_SEIDEL,
+  BenchmarkSolver::LCP_APGD,
+  BenchmarkSolver::LCP_MATRIX_FREE_APGD,
+  BenchmarkSolver::SOBOGUS_GEOMETRIC,
+  BenchmarkSolver::SOBOGUS_STABILIZED
+};
+
+// Solver settings shared by all scenes
+static constexpr scalar IMPACT_TOLERANCE{ 1.0e-6 };
+static constexpr unsigned MAX_ITERATIONS{ 500 };
+static constexpr unsigned SOBOGUS_EVAL_EVERY{ 25 };
+static constexpr scalar COEFFICIENT_OF_RESTITUTION{ 0.5 };
+static constexpr scalar COEFFICIENT_OF_FRICTION{ 0.3 };
+
+static const char* const RESULTS_HEADER{ "scene,bodies,steps,solver,setup_seconds,total_step_seconds,mean_step_seconds,min_step_seconds,max_step_seconds,git_sha1" };
+
+std::string BenchmarkUtilities::name( const BenchmarkSolver solver )
+{
+  switch( solver )
+  {
+    case BenchmarkSolver::GAUSS_SEIDEL:
+      return "gauss_seidel";
+    case BenchmarkSolver::COLORED_GAUSS_SEIDEL:
+      return "colored_gauss_seidel";
+    case BenchmarkSolver::LCP_APGD:
+      return "lcp_apgd";
+    case BenchmarkSolver::LCP_MATRIX_FREE_APGD:
+      return "lcp_matrix_free_apgd";
+    case BenchmarkSolver::SOBOGUS_GEOMETRIC:
+      return "sobogus_geometric";
+    case BenchmarkSolver::SOBOGUS_STABILIZED:
+      return "sobogus_stabilized";
+  }
+  assert( false );
+  return "";
+}
+
+void BenchmarkUtilities::createSolvers( const BenchmarkSolver solver, const SobogusSolverType sobogus_type, BenchmarkSolverSet& solvers )
+{
+  solvers.impact_operator.reset();
+  solvers.friction_solver.reset();
+  solvers.impact_friction_map.reset();
+  solvers.CoR = COEFFICIENT_OF_RESTITUTION;
+  solvers.mu = COEFFICIENT_OF_FRICTION;
+  switch( solver )
+  {
+    case BenchmarkSolver::GAUSS_SEIDEL:
+      solvers.impact_operator.reset( new GaussSeidelOperator{ IMPACT_TOLERANCE } );
+      break;
+    case BenchmarkSolver::COLORED_GAUSS_SEIDEL:
+      solvers.impact_operator.reset( new ColoredGaussSeidelOperator{ IMPACT_TOLERANCE } );
+      break;
+    case BenchmarkSolver::LCP_APGD:
+      solvers.impact_operator.reset( new LCPOperatorAPGD{ IMPACT_TOLERANCE, MAX_ITERATIONS } );
+      break;
+    case BenchmarkSolver::LCP_MATRIX_FREE_APGD:
+      solvers.impact_operator.reset( new LCPOperatorMatrixFreeAPGD{ IMPACT_TOLERANCE, MAX_ITERATIONS } );
+      break;
+    case BenchmarkSolver::SOBOGUS_GEOMETRIC:
+      solvers.friction_solver.reset( new Sobogus{ sobogus_type, SOBOGUS_EVAL_EVERY, SobogusSettings{} } );
+      solvers.impact_friction_map.reset( new GeometricImpactFrictionMap{ IMPACT_TOLERANCE, MAX_ITERATIONS, ImpulsesToCache::NONE } );
+      break;
+    case BenchmarkSolver::SOBOGUS_STABILIZED:
+      solvers.friction_solver.reset( new Sobogus{ sobogus_type, SOBOGUS_EVAL_EVERY, SobogusSettings{} } );
+      solvers.impact_friction_map.reset( new StabilizedImpactFrictionMap{ IMPACT_TOLERANCE, MAX_ITERATIONS, false, false } );
+      break;
+  }
+}
+
+static void printUsage( const std::string& executable_name, const BenchmarkUtilities::SceneSolvers& scenes )
+{
+  std::cout << "Usage: " << executable_name << " scene num_bodies num_steps results_file [scene_arguments] [options]" << std::endl;
+  std::cout << "Scenes and their supported solvers are:" << std::endl;
+  for( const auto& scene : scenes )
+  {
+    std::cout << "   " << scene.first << ':';
+    for( const BenchmarkSolver solver : scene.second )
+    {
+      std::cout << ' ' << BenchmarkUtilities::name( solver );
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "Options are:" << std::endl;
+  std::cout << "   -h/--help                : prints this help message and exits" << std::endl;
+  std::cout << "   -s/--solver name         : only benchmarks the given solver instead of all solvers the scene supports" << std::endl;
+  std::cout << "   -p/--profile_dir dir     : saves a per phase profile of each solver's run as json to the given directory" << std::endl;
+}
+
+static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_enabled, std::unique_ptr<BenchmarkSolver>& solver, std::string& profile_dir )
+{
+  const struct option long_options[] =
+  {
+    { "help", no_argument, nullptr, 'h' },
+    { "solver", required_argument, nullptr, 's' },
+    { "profile_dir", required_argument, nullptr, 'p' },
+    { nullptr, 0, nullptr, 0 }
+  };
+
+  while( true )
+  {
+    int option_index = 0;
+    const int c{ getopt_long( *argc, *argv, "hs:p:", long_options, &option_index ) };
+    if( c == -1 )
+    {
+      break;
+    }
+    switch( c )
+    {
+      case 'h':
+      {
+        help_mode_enabled = true;
+        break;
+      }
+      case 's':
+      {
+        const auto solver_itr{ std::find_if( ALL_SOLVERS.cbegin(), ALL_SOLVERS.cend(), []( const BenchmarkSolver solver ) { return BenchmarkUtilities::name( solver ) == optarg; } ) };
+        if( solver_itr == ALL_SOLVERS.cend() )
+        {
+          std::cerr << "Failed to read value for argument for -s/--solver. Invalid solver: " << optarg << std::endl;
+          return false;
+        }
+        solver.reset( new BenchmarkSolver{ *solver_itr } );
+        break;
+      }
+      case 'p':
+      {
+        profile_dir = optarg;
+        break;
+      }
+      case '?':
+      {
+        return false;
+      }
+      default:
+      {
+        std::cerr << "This is a bug in the command line parser. Please file a report." << std::endl;
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static bool writeResult( const std::string& results_file_name, const std::string& scene, const unsigned num_bodies, const std::string& solver_name, const double setup_seconds, const std::vector<double>& step_seconds )
+{
+  // Only a new or empty results file receives the header
+  bool write_header;
+  {
+    std::ifstream existing_file{ results_file_name, std::ios::ate };
+    write_header = !existing_file.is_open() || existing_file.tellg() == 0;
+  }
+
+  std::ofstream results_file{ results_file_name, std::ios::app };
+  if( !results_file.is_open() )
+  {
+    return false;
+  }
+  if( write_header )
+  {
+    results_file << RESULTS_HEADER << '\n';
+  }
+  results_file.precision( 9 );
+
+  assert( !step_seconds.empty() );
+  const double total_seconds{ std::accumulate( step_seconds.cbegin(), step_seconds.cend(), 0.0 ) };
+  results_file << scene << ',' << num_bodies << ',' << step_seconds.size() << ',' << solver_name << ',' << setup_seconds << ',' << total_seconds << ',' << total_seconds / double( step_seconds.size() ) << ',';
+  results_file << *std::min_element( step_seconds.cbegin(), step_seconds.cend() ) << ',' << *std::max_element( step_seconds.cbegin(), step_seconds.cend() ) << ',' << CompileDefinitions::GitSHA1 << '\n';
+
+  results_file.close();
+  return !results_file.fail();
+}
+
+int BenchmarkUtilities::runBenchmarks( int argc, char** argv, const SceneSolvers& scenes, const SobogusSolverType sobogus_type, const SceneGenerator& generate_scene, const SceneStepper& step_scene )
+{
+  bool help_mode_enabled{ false };
+  std::unique_ptr<BenchmarkSolver> requested_solver{ nullptr };
+  std::string profile_dir;
+  if( !parseCommandLineOptions( &argc, &argv, help_mode_enabled, requested_solver, profile_dir ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( help_mode_enabled )
+  {
+    printUsage( argv[0], scenes );
+    return EXIT_SUCCESS;
+  }
+
+  if( argc < optind + 4 )
+  {
+    std::cerr << "Invalid arguments. Must provide a scene, the number of bodies, the number of steps, and a results file." << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string scene{ argv[optind] };
+  const SceneSolvers::const_iterator scene_itr{ scenes.find( scene ) };
+  if( scene_itr == scenes.cend() )
+  {
+    std::cerr << "Invalid scene specified: " << scene << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::vector<BenchmarkSolver> solvers{ scene_itr->second };
+  if( requested_solver != nullptr )
+  {
+    if( std::find( solvers.cbegin(), solvers.cend(), *requested_solver ) == solvers.cend() )
+    {
+      std::cerr << "Solver " << name( *requested_solver ) << " does not support scene " << scene << std::endl;
+      return EXIT_FAILURE;
+    }
+    solvers = { *requested_solver };
+  }
+  unsigned num_bodies;
+  if( !StringUtilities::extractFromString( std::string{ argv[optind + 1] }, num_bodies ) || num_bodies == 0 )
+  {
+    std::cerr << "Error, num_bodies must be a positive integer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  unsigned num_steps;
+  if( !StringUtilities::extractFromString( std::string{ argv[optind + 2] }, num_steps ) || num_steps == 0 )
+  {
+    std::cerr << "Error, num_steps must be a positive integer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string results_file_name{ argv[optind + 3] };
+  const std::vector<std::string> scene_arguments( argv + optind + 4, argv + argc );
+
+  for( const BenchmarkSolver solver : solvers )
+  {
+    const std::string solver_name{ name( solver ) };
+
+    BenchmarkSolverSet solver_set;
+    createSolvers( solver, sobogus_type, solver_set );
+
+    const auto setup_start{ std::chrono::steady_clock::now() };
+    if( !generate_scene( scene, num_bodies, scene_arguments ) )
+    {
+      return EXIT_FAILURE;
+    }
+    const std::chrono::duration<double> setup_time{ std::chrono::steady_clock::now() - setup_start };
+
+    if( !profile_dir.empty() )
+    {
+      const std::string profile_file_name{ profile_dir + "/" + scene + "_" + StringUtilities::convertToString( num_bodies ) + "_" + solver_name + ".json" };
+      if( !Profiler::open( profile_file_name ) )
+      {
+        std::cerr << "Failed to open profile file " << profile_file_name << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    std::vector<double> step_seconds( num_steps );
+    for( unsigned iteration = 0; iteration < num_steps; ++iteration )
+    {
+      const auto step_start{ std::chrono::steady_clock::now() };
+      {
+        const ProfilerScope step_scope{ ProfilerTimer::STEP };
+        step_scene( iteration + 1, solver_set );
+      }
+      step_seconds[iteration] = std::chrono::duration<double>{ std::chrono::steady_clock::now() - step_start }.count();
+      Profiler::endStep( iteration + 1 );
+    }
+
+    if( !Profiler::close() )
+    {
+      std::cerr << "Failed to write profile for " << solver_name << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( !writeResult( results_file_name, scene, num_bodies, solver_name, setup_time.count(), step_seconds ) )
+    {
+      std::cerr << "Failed to write results to " << results_file_name << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << scene << " with " << num_bodies << " bodies, " << solver_name << ": " << setup_time.count() << " s setup, ";
+    std::cout << *std::max_element( step_seconds.cbegin(), step_seconds.cend() ) << " s slowest step, " << std::accumulate( step_seconds.cbegin(), step_seconds.cend(), 0.0 ) / double( num_steps ) << " s mean step" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_UTILITIES_H
+#define BENCHMARK_UTILITIES_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "scisim/ConstrainedMaps/Sobogus.h"
+
+class ImpactOperator;
+class FrictionSolver;
+class ImpactFrictionMap;
+
+// Impact and friction solver combinations that benchmark scenes are stepped with. Solvers that
+// require optional dependencies (QL, Ipopt) are left out so that results are comparable across builds.
+enum class BenchmarkSolver
+{
+  GAUSS_SEIDEL,
+  COLORED_GAUSS_SEIDEL,
+  LCP_APGD,
+  LCP_MATRIX_FREE_APGD,
+  SOBOGUS_GEOMETRIC,
+  SOBOGUS_STABILIZED
+};
+
+// The solvers of a combination. Impact solvers only set impact_operator, friction solvers only set
+// friction_solver and impact_friction_map.
+struct BenchmarkSolverSet final
+{
+  std::unique_ptr<ImpactOperator> impact_operator;
+  std::unique_ptr<FrictionSolver> friction_solver;
+  std::unique_ptr<ImpactFrictionMap> impact_friction_map;
+  scalar CoR;
+  scalar mu;
+};
+
+namespace BenchmarkUtilities
+{
+
+  // Generates the named scene with the given number of bodies, returning false for an unknown
+  // scene. Arguments that follow the results file on the command line are passed through.
+  using SceneGenerator = std::function<bool( const std::string& scene, const unsigned num_bodies, const std::vector<std::string>& scene_arguments )>;
+
+  // Each scene and the solvers that it is benchmarked with. The Gauss-Seidel solvers only support
+  // some constraint types, so not every scene can be stepped with every solver.
+  using SceneSolvers = std::map<std::string,std::vector<BenchmarkSolver>>;
+
+  // Takes a single step of the current scene
+  using SceneStepper = std::function<void( const unsigned iteration, BenchmarkSolverSet& solvers )>;
+
+  std::string name( const BenchmarkSolver solver );
+
+  void createSolvers( const BenchmarkSolver solver, const SobogusSolverType sobogus_type, BenchmarkSolverSet& solvers );
+
+  // Parses the command line, then generates and steps the scene once per supported solver and
+  // appends a row of timings per solver to the results file, a CSV file whose columns never
+  // change so that results can be compared across revisions.
+  int runBenchmarks( int argc, char** argv, const SceneSolvers& scenes, const SobogusSolverType sobogus_type, const SceneGenerator& generate_scene, const SceneStepper& step_scene );
+
+}
+
+#endif
@@ -0,0 +1,145 @@
+// Times the ball2d step pipeline on generated scenes of any size, for each impact and friction solver
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "scisim/Math/Rational.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactMap.h"
+
+#include "ball2d/Ball2DSim.h"
+#include "ball2d/PythonScripting.h"
+#include "ball2d/VerletMap.h"
+#include "ball2d/Forces/Ball2DGravityForce.h"
+
+#include "BenchmarkUtilities.h"
+
+static const Rational<std::intmax_t> DT{ 1, 100 };
+// Balls sit on a square lattice with this spacing; radii are at most 0.5
+static constexpr scalar SPACING{ 1.05 };
+// Seed shared by the generators so that scenes are reproducible across runs
+static constexpr std::uint_fast64_t SCENE_SEED{ 8675309 };
+
+static Ball2DSim g_sim;
+static VerletMap g_unconstrained_map;
+static std::unique_ptr<ImpactMap> g_impact_map{ nullptr };
+static PythonScripting g_scripting;
+
+// Balls of varying radii settling under gravity in a box open at the top
+static void generatePile( const unsigned num_balls, Ball2DState& state )
+{
+  const unsigned side{ unsigned( std::ceil( std::sqrt( scalar( num_balls ) ) ) ) };
+  const scalar half_width{ 0.5 * SPACING * scalar( side ) };
+
+  std::mt19937_64 mt{ SCENE_SEED };
+  std::uniform_real_distribution<scalar> radius_gen{ 0.4, 0.5 };
+  std::uniform_real_distribution<scalar> jitter_gen{ -0.02, 0.02 };
+
+  VectorXs q{ 2 * num_balls };
+  VectorXs v{ VectorXs::Zero( 2 * num_balls ) };
+  VectorXs r{ num_balls };
+  VectorXs m{ 2 * num_balls };
+  for( unsigned ball = 0; ball < num_balls; ++ball )
+  {
+    const unsigned col{ ball % side };
+    const unsigned row{ ball / side };
+    q.segment<2>( 2 * ball ) << - half_width + SPACING * ( scalar( col ) + 0.5 ) + jitter_gen( mt ), SPACING * ( scalar( row ) + 0.5 ) + jitter_gen( mt );
+    r( ball ) = radius_gen( mt );
+    m.segment<2>( 2 * ball ).setConstant( PI<scalar> * r( ball ) * r( ball ) );
+  }
+
+  using std::swap;
+  swap( q, state.q() );
+  swap( v, state.v() );
+  swap( r, state.r() );
+  state.fixed() = std::vector<bool>( num_balls, false );
+  state.setMass( m );
+  state.staticPlanes() = { StaticPlane{ Vector2s{ 0.0, 0.0 }, Vector2s{ 0.0, 1.0 } }, StaticPlane{ Vector2s{ - half_width, 0.0 }, Vector2s{ 1.0, 0.0 } }, StaticPlane{ Vector2s{ half_width, 0.0 }, Vector2s{ -1.0, 0.0 } } };
+  state.forces().emplace_back( new Ball2DGravityForce{ Vector2s{ 0.0, -10.0 } } );
+}
+
+// Densely packed balls with random velocities in a periodic square cell. The left and right sides of
+// the cell form a Lees-Edwards portal that shears the packing.
+static void generateShearCell( const unsigned num_balls, Ball2DState& state )
+{
+  constexpr scalar radius{ 0.5 };
+  constexpr scalar shear_velocity{ 1.0 };
+  const unsigned side{ unsigned( std::ceil( std::sqrt( scalar( num_balls ) ) ) ) };
+  const scalar half_width{ 0.5 * SPACING * scalar( side ) };
+
+  std::mt19937_64 mt{ SCENE_SEED };
+  std::uniform_real_distribution<scalar> jitter_gen{ -0.02, 0.02 };
+  std::uniform_real_distribution<scalar> velocity_gen{ -1.0, 1.0 };
+
+  VectorXs q{ 2 * num_balls };
+  VectorXs v{ 2 * num_balls };
+  VectorXs r{ VectorXs::Constant( num_balls, radius ) };
+  const VectorXs m{ VectorXs::Constant( 2 * num_balls, PI<scalar> * radius * radius ) };
+  for( unsigned ball = 0; ball < num_balls; ++ball )
+  {
+    const unsigned col{ ball % side };
+    const unsigned row{ ball / side };
+    q.segment<2>( 2 * ball ) << - half_width + SPACING * ( scalar( col ) + 0.5 ) + jitter_gen( mt ), - half_width + SPACING * ( scalar( row ) + 0.5 ) + jitter_gen( mt );
+    v.segment<2>( 2 * ball ) << velocity_gen( mt ), velocity_gen( mt );
+  }
+
+  using std::swap;
+  swap( q, state.q() );
+  swap( v, state.v() );
+  swap( r, state.r() );
+  state.fixed() = std::vector<bool>( num_balls, false );
+  state.setMass( m );
+  state.planarPortals() =
+  {
+    PlanarPortal{ StaticPlane{ Vector2s{ - half_width, 0.0 }, Vector2s{ 1.0, 0.0 } }, StaticPlane{ Vector2s{ half_width, 0.0 }, Vector2s{ -1.0, 0.0 } }, shear_velocity, half_width },
+    PlanarPortal{ StaticPlane{ Vector2s{ 0.0, - half_width }, Vector2s{ 0.0, 1.0 } }, StaticPlane{ Vector2s{ 0.0, half_width }, Vector2s{ 0.0, -1.0 } }, 0.0, 0.0 }
+  };
+}
+
+static bool generateScene( const std::string& scene, const unsigned num_bodies, const std::vector<std::string>& )
+{
+  Ball2DState state;
+  if( scene == "ball2d_pile" )
+  {
+    generatePile( num_bodies, state );
+  }
+  else if( scene == "ball2d_shear_cell" )
+  {
+    generateShearCell( num_bodies, state );
+  }
+  else
+  {
+    std::cerr << "Invalid scene specified: " << scene << std::endl;
+    return false;
+  }
+  g_sim.state() = std::move( state );
+  g_sim.clearConstraintCache();
+  g_impact_map.reset( new ImpactMap{ false } );
+  return true;
+}
+
+static void stepScene( const unsigned iteration, BenchmarkSolverSet& solvers )
+{
+  if( solvers.impact_operator != nullptr )
+  {
+    g_sim.flow( g_scripting, iteration, DT, g_unconstrained_map, *solvers.impact_operator, solvers.CoR, *g_impact_map );
+  }
+  else
+  {
+    g_sim.flow( g_scripting, iteration, DT, g_unconstrained_map, solvers.CoR, solvers.mu, *solvers.friction_solver, *solvers.impact_friction_map );
+  }
+}
+
+int main( int argc, char** argv )
+{
+  // Gauss-Seidel does not support ball-plane constraints
+  const BenchmarkUtilities::SceneSolvers scenes
+  {
+    { "ball2d_pile", { BenchmarkSolver::LCP_APGD, BenchmarkSolver::LCP_MATRIX_FREE_APGD, BenchmarkSolver::SOBOGUS_GEOMETRIC, BenchmarkSolver::SOBOGUS_STABILIZED } },
+    { "ball2d_shear_cell", { BenchmarkSolver::GAUSS_SEIDEL, BenchmarkSolver::COLORED_GAUSS_SEIDEL, BenchmarkSolver::LCP_APGD, BenchmarkSolver::LCP_MATRIX_FREE_APGD, BenchmarkSolver::SOBOGUS_GEOMETRIC, BenchmarkSolver::SOBOGUS_STABILIZED } }
+  };
+  return BenchmarkUtilities::runBenchmarks( argc, argv, scenes, SobogusSolverType::Balls2D, generateScene, stepScene );
+}
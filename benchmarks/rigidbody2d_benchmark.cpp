@@ -0,0 +1,118 @@
+// Times the rigidbody2d step pipeline on generated scenes of any size, for each impact and friction solver
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "scisim/Math/Rational.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactMap.h"
+
+#include "rigidbody2d/RigidBody2DSim.h"
+#include "rigidbody2d/PythonScripting.h"
+#include "rigidbody2d/VerletMap.h"
+#include "rigidbody2d/CircleGeometry.h"
+#include "rigidbody2d/BoxGeometry.h"
+#include "rigidbody2d/NearEarthGravityForce.h"
+
+#include "BenchmarkUtilities.h"
+
+static const Rational<std::intmax_t> DT{ 1, 100 };
+// Bodies sit on a square lattice with this spacing; the box diagonal is just over 1.08
+static constexpr scalar SPACING{ 1.15 };
+// Seed of the generator so that scenes are reproducible across runs
+static constexpr std::uint_fast64_t SCENE_SEED{ 8675309 };
+
+static RigidBody2DSim g_sim;
+static VerletMap g_unconstrained_map;
+static std::unique_ptr<ImpactMap> g_impact_map{ nullptr };
+static PythonScripting g_scripting;
+
+// Bodies at random orientations settling under gravity in a box open at the top. Mixed piles alternate
+// between circles and boxes.
+static void generatePile( const unsigned num_bodies, const bool mixed, RigidBody2DState& state )
+{
+  const unsigned side{ unsigned( std::ceil( std::sqrt( scalar( num_bodies ) ) ) ) };
+  const scalar half_width{ 0.5 * SPACING * scalar( side ) };
+
+  std::vector<std::unique_ptr<RigidBody2DGeometry>> geometry;
+  geometry.emplace_back( new CircleGeometry{ 0.5 } );
+  geometry.emplace_back( new BoxGeometry{ Vector2s{ 0.45, 0.3 } } );
+  std::vector<scalar> geometry_mass( geometry.size() );
+  std::vector<scalar> geometry_inertia( geometry.size() );
+  for( std::vector<std::unique_ptr<RigidBody2DGeometry>>::size_type geo_idx = 0; geo_idx < geometry.size(); ++geo_idx )
+  {
+    geometry[geo_idx]->computeMassAndInertia( 1.0, geometry_mass[geo_idx], geometry_inertia[geo_idx] );
+  }
+
+  std::mt19937_64 mt{ SCENE_SEED };
+  std::uniform_real_distribution<scalar> theta_gen{ - PI<scalar>, PI<scalar> };
+
+  VectorXs q{ 3 * num_bodies };
+  const VectorXs v{ VectorXs::Zero( 3 * num_bodies ) };
+  VectorXs m{ 3 * num_bodies };
+  VectorXu geometry_indices{ num_bodies };
+  for( unsigned bdy_idx = 0; bdy_idx < num_bodies; ++bdy_idx )
+  {
+    const unsigned col{ bdy_idx % side };
+    const unsigned row{ bdy_idx / side };
+    const unsigned geo_idx{ mixed ? ( col + row ) % 2 : 0 };
+    q.segment<3>( 3 * bdy_idx ) << - half_width + SPACING * ( scalar( col ) + 0.5 ), SPACING * ( scalar( row ) + 0.5 ), theta_gen( mt );
+    m.segment<2>( 3 * bdy_idx ).setConstant( geometry_mass[geo_idx] );
+    m( 3 * bdy_idx + 2 ) = geometry_inertia[geo_idx];
+    geometry_indices( bdy_idx ) = geo_idx;
+  }
+
+  std::vector<std::unique_ptr<RigidBody2DForce>> forces;
+  forces.emplace_back( new NearEarthGravityForce{ Vector2s{ 0.0, -10.0 } } );
+
+  const std::vector<RigidBody2DStaticPlane> planes{ { Vector2s{ 0.0, 0.0 }, Vector2s{ 0.0, 1.0 } }, { Vector2s{ - half_width, 0.0 }, Vector2s{ 1.0, 0.0 } }, { Vector2s{ half_width, 0.0 }, Vector2s{ -1.0, 0.0 } } };
+
+  state = RigidBody2DState{ q, v, m, std::vector<bool>( num_bodies, false ), geometry_indices, geometry, forces, planes, {} };
+}
+
+static bool generateScene( const std::string& scene, const unsigned num_bodies, const std::vector<std::string>& )
+{
+  if( scene == "rigidbody2d_circle_pile" )
+  {
+    generatePile( num_bodies, false, g_sim.state() );
+  }
+  else if( scene == "rigidbody2d_mixed_pile" )
+  {
+    generatePile( num_bodies, true, g_sim.state() );
+  }
+  else
+  {
+    std::cerr << "Invalid scene specified: " << scene << std::endl;
+    return false;
+  }
+  g_sim.clearConstraintCache();
+  g_impact_map.reset( new ImpactMap{ false } );
+  return true;
+}
+
+static void stepScene( const unsigned iteration, BenchmarkSolverSet& solvers )
+{
+  if( solvers.impact_operator != nullptr )
+  {
+    g_sim.flow( g_scripting, iteration, DT, g_unconstrained_map, *solvers.impact_operator, solvers.CoR, *g_impact_map );
+  }
+  else
+  {
+    g_sim.flow( g_scripting, iteration, DT, g_unconstrained_map, solvers.CoR, solvers.mu, *solvers.friction_solver, *solvers.impact_friction_map );
+  }
+}
+
+int main( int argc, char** argv )
+{
+  // Gauss-Seidel does not support two dimensional rigid body constraints and the LCP solvers only
+  // support constraints between circles and planes
+  const BenchmarkUtilities::SceneSolvers scenes
+  {
+    { "rigidbody2d_circle_pile", { BenchmarkSolver::LCP_APGD, BenchmarkSolver::LCP_MATRIX_FREE_APGD, BenchmarkSolver::SOBOGUS_GEOMETRIC, BenchmarkSolver::SOBOGUS_STABILIZED } },
+    { "rigidbody2d_mixed_pile", { BenchmarkSolver::SOBOGUS_GEOMETRIC, BenchmarkSolver::SOBOGUS_STABILIZED } }
+  };
+  return BenchmarkUtilities::runBenchmarks( argc, argv, scenes, SobogusSolverType::RigidBody2D, generateScene, stepScene );
+}
@@ -0,0 +1,157 @@
+// Times the rigidbody3d step pipeline on generated scenes of any size, for each impact and friction solver
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "scisim/Math/Rational.h"
+
+#include "rigidbody3d/RigidBody3DSim.h"
+#include "rigidbody3d/PythonScripting.h"
+#include "rigidbody3d/UnconstrainedMaps/SplitHamMap.h"
+#include "rigidbody3d/Geometry/RigidBodyBox.h"
+#include "rigidbody3d/Geometry/RigidBodySphere.h"
+#include "rigidbody3d/Geometry/RigidBodyTriangleMesh.h"
+#include "rigidbody3d/Forces/NearEarthGravityForce.h"
+#include "rigidbody3d/StaticGeometry/StaticPlane.h"
+
+#include "BenchmarkUtilities.h"
+
+static const Rational<std::intmax_t> DT{ 1, 1000 };
+// Seed of the generator so that scenes are reproducible across runs
+static constexpr std::uint_fast64_t SCENE_SEED{ 8675309 };
+
+static RigidBody3DSim g_sim;
+static SplitHamMap g_unconstrained_map;
+static PythonScripting g_scripting;
+
+// Copies of a single geometry at random orientations on a cubic lattice, settling under gravity in a
+// square bin open at the top. The lattice spacing is large enough that no two bodies overlap.
+static void generateBin( const unsigned num_bodies, std::unique_ptr<RigidBodyGeometry> body_geometry, RigidBody3DState& state )
+{
+  const bool is_sphere{ body_geometry->getType() == RigidBodyGeometryType::SPHERE };
+
+  scalar M;
+  Vector3s CM;
+  Vector3s I;
+  Matrix33sr R;
+  body_geometry->computeMassAndInertia( 1.0, M, CM, I, R );
+
+  scalar spacing;
+  {
+    Array3s min;
+    Array3s max;
+    body_geometry->computeAABB( Vector3s::Zero(), Matrix33sr::Identity(), min, max );
+    spacing = 1.02 * ( is_sphere ? ( max - min ).maxCoeff() : ( max - min ).matrix().norm() );
+  }
+
+  const unsigned side{ unsigned( std::ceil( std::cbrt( scalar( num_bodies ) ) ) ) };
+  const scalar half_width{ 0.5 * spacing * scalar( side ) };
+
+  std::mt19937_64 mt{ SCENE_SEED };
+  std::uniform_real_distribution<scalar> unit_gen{ -1.0, 1.0 };
+  std::uniform_real_distribution<scalar> angle_gen{ - PI<scalar>, PI<scalar> };
+
+  std::vector<Vector3s> xs;
+  std::vector<Vector3s> vs;
+  std::vector<VectorXs> Rs;
+  for( unsigned bdy_idx = 0; bdy_idx < num_bodies; ++bdy_idx )
+  {
+    const unsigned i{ bdy_idx % side };
+    const unsigned j{ bdy_idx / ( side * side ) };
+    const unsigned k{ ( bdy_idx / side ) % side };
+    xs.emplace_back( Vector3s{ - half_width + spacing * ( scalar( i ) + 0.5 ), spacing * ( scalar( j ) + 0.5 ), - half_width + spacing * ( scalar( k ) + 0.5 ) } + CM );
+    vs.emplace_back( 0.1 * Vector3s{ unit_gen( mt ), unit_gen( mt ), unit_gen( mt ) } );
+
+    Matrix33sr R0{ Matrix33sr::Identity() };
+    if( !is_sphere )
+    {
+      const Vector3s axis{ unit_gen( mt ), unit_gen( mt ), unit_gen( mt ) };
+      if( axis.norm() != 0.0 )
+      {
+        R0 = Eigen::AngleAxis<scalar>( angle_gen( mt ), axis.normalized() ).matrix();
+      }
+    }
+    Matrix33sr body_R{ R0 * R };
+    Rs.emplace_back( Eigen::Map<VectorXs>{ body_R.data(), 9, 1 } );
+  }
+
+  std::vector<std::unique_ptr<RigidBodyGeometry>> geometry;
+  geometry.emplace_back( std::move( body_geometry ) );
+
+  state.setState( xs, vs, std::vector<scalar>( num_bodies, M ), Rs, std::vector<Vector3s>( num_bodies, Vector3s::Zero() ), std::vector<Vector3s>( num_bodies, I ), std::vector<bool>( num_bodies, false ), std::vector<unsigned>( num_bodies, 0 ), geometry );
+  state.addForce( NearEarthGravityForce{ Vector3s{ 0.0, -9.81, 0.0 } } );
+  state.addStaticPlane( StaticPlane{ Vector3s{ 0.0, 0.0, 0.0 }, Vector3s{ 0.0, 1.0, 0.0 } } );
+  state.addStaticPlane( StaticPlane{ Vector3s{ - half_width, 0.0, 0.0 }, Vector3s{ 1.0, 0.0, 0.0 } } );
+  state.addStaticPlane( StaticPlane{ Vector3s{ half_width, 0.0, 0.0 }, Vector3s{ -1.0, 0.0, 0.0 } } );
+  state.addStaticPlane( StaticPlane{ Vector3s{ 0.0, 0.0, - half_width }, Vector3s{ 0.0, 0.0, 1.0 } } );
+  state.addStaticPlane( StaticPlane{ Vector3s{ 0.0, 0.0, half_width }, Vector3s{ 0.0, 0.0, -1.0 } } );
+}
+
+static bool generateScene( const std::string& scene, const unsigned num_bodies, const std::vector<std::string>& scene_arguments )
+{
+  std::unique_ptr<RigidBodyGeometry> body_geometry;
+  if( scene == "rigidbody3d_spheres" )
+  {
+    body_geometry.reset( new RigidBodySphere{ 0.5 } );
+  }
+  else if( scene == "rigidbody3d_boxes" )
+  {
+    body_geometry.reset( new RigidBodyBox{ Vector3s{ 0.5, 0.35, 0.25 } } );
+  }
+  else if( scene == "rigidbody3d_meshes" )
+  {
+    if( scene_arguments.size() != 1 )
+    {
+      std::cerr << "The rigidbody3d_meshes scene requires a single mesh file argument" << std::endl;
+      return false;
+    }
+    try
+    {
+      body_geometry.reset( new RigidBodyTriangleMesh{ scene_arguments.front() } );
+    }
+    catch( const std::string& error )
+    {
+      std::cerr << "Failed to load triangle mesh " << scene_arguments.front() << ": " << error << std::endl;
+      return false;
+    }
+  }
+  else
+  {
+    std::cerr << "Invalid scene specified: " << scene << std::endl;
+    return false;
+  }
+
+  RigidBody3DState state;
+  generateBin( num_bodies, std::move( body_geometry ), state );
+  g_sim.state() = std::move( state );
+  g_sim.clearConstraintCache();
+  return true;
+}
+
+static void stepScene( const unsigned iteration, BenchmarkSolverSet& solvers )
+{
+  if( solvers.impact_operator != nullptr )
+  {
+    g_sim.flow( g_scripting, iteration, DT, g_unconstrained_map, *solvers.impact_operator, solvers.CoR );
+  }
+  else
+  {
+    g_sim.flow( g_scripting, iteration, DT, g_unconstrained_map, solvers.CoR, solvers.mu, *solvers.friction_solver, *solvers.impact_friction_map );
+  }
+}
+
+int main( int argc, char** argv )
+{
+  // Gauss-Seidel only supports sphere-sphere and sphere-plane constraints
+  const BenchmarkUtilities::SceneSolvers scenes
+  {
+    { "rigidbody3d_spheres", { BenchmarkSolver::GAUSS_SEIDEL, BenchmarkSolver::COLORED_GAUSS_SEIDEL, BenchmarkSolver::LCP_APGD, BenchmarkSolver::LCP_MATRIX_FREE_APGD, BenchmarkSolver::SOBOGUS_GEOMETRIC, BenchmarkSolver::SOBOGUS_STABILIZED } },
+    { "rigidbody3d_boxes", { BenchmarkSolver::LCP_APGD, BenchmarkSolver::LCP_MATRIX_FREE_APGD, BenchmarkSolver::SOBOGUS_GEOMETRIC, BenchmarkSolver::SOBOGUS_STABILIZED } },
+    { "rigidbody3d_meshes", { BenchmarkSolver::LCP_APGD, BenchmarkSolver::LCP_MATRIX_FREE_APGD, BenchmarkSolver::SOBOGUS_GEOMETRIC, BenchmarkSolver::SOBOGUS_STABILIZED } }
+  };
+  return BenchmarkUtilities::runBenchmarks( argc, argv, scenes, SobogusSolverType::RigidBodies3D, generateScene, stepScene );
+}
@@ -0,0 +1,193 @@
+// Compares the cost of the original spatial grid detector, rebuilt every step, against a
+// persistent SortedCellGrid for a jittering lattice of spheres, as in a settled granular pile.
+// Only the spheres that cross a cell boundary move in the persistent grid, so the grid is also
+// timed when it is rebuilt from scratch every step.
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+
+#include "scisim/StringUtilities.h"
+#include "rigidbody3d/SpatialGridDetector.h"
+#include "scisim/CollisionDetection/SortedCellGrid.h"
+
+// Places unit radius spheres on a cubic lattice with a small gap between neighbors
+static void generateLattice( const unsigned num_bodies, std::vector<Array3s>& centers )
+{
+  const unsigned bodies_per_side{ unsigned( std::ceil( std::cbrt( scalar( num_bodies ) ) ) ) };
+  centers.resize( num_bodies );
+  for( unsigned bdy_idx = 0; bdy_idx < num_bodies; ++bdy_idx )
+  {
+    const unsigned x_idx{ bdy_idx % bodies_per_side };
+    const unsigned y_idx{ ( bdy_idx / bodies_per_side ) % bodies_per_side };
+    const unsigned z_idx{ bdy_idx / ( bodies_per_side * bodies_per_side ) };
+    centers[bdy_idx] = 2.05 * Array3s{ scalar( x_idx ), scalar( y_idx ), scalar( z_idx ) };
+  }
+}
+
+static void computeAABBs( const std::vector<Array3s>& centers, std::vector<AABB>& aabbs )
+{
+  aabbs.resize( centers.size() );
+  for( std::vector<AABB>::size_type bdy_idx = 0; bdy_idx < centers.size(); ++bdy_idx )
+  {
+    aabbs[bdy_idx].min() = centers[bdy_idx] - 1.0;
+    aabbs[bdy_idx].max() = centers[bdy_idx] + 1.0;
+  }
+}
+
+// The detector that SortedCellGrid replaced, kept as the baseline: a std::map from cell key to the
+// AABBs in the cell, rebuilt on every query, with the pairs collected in a std::set
+static void computeReferenceCellIndex( const Array3s& coord, const Array3s& min_coord, const scalar& h, Array3u& index )
+{
+  assert( ( coord > min_coord ).all() ); assert( h > 0.0 );
+  // Unsigned cast same as floor if input is positive
+  index = ( ( coord - min_coord ) / h ).cast<unsigned>();
+}
+
+static void getReferencePotentialOverlaps( const std::vector<AABB>& aabbs, std::set<std::pair<unsigned,unsigned>>& overlaps )
+{
+  // Compute a bounding box for all AABBs, inflated to account for FPA quantization errors
+  Array3s min_coord{ Array3s::Constant( SCALAR_INFINITY ) };
+  Array3s max_coord{ Array3s::Constant( -SCALAR_INFINITY ) };
+  Array3s delta{ Array3s::Zero() };
+  for( const AABB& aabb : aabbs )
+  {
+    min_coord = min_coord.min( aabb.min() );
+    max_coord = max_coord.max( aabb.max() );
+    delta += aabb.max() - aabb.min();
+  }
+  min_coord -= 2.0e-6;
+  max_coord += 2.0e-6;
+  const scalar h{ delta.maxCoeff() / scalar( aabbs.size() ) };
+  const Array3u dimensions{ ( ( max_coord - min_coord ) / h ).ceil().cast<unsigned>() };
+
+  std::map<unsigned,std::vector<unsigned>> voxels;
+  for( std::vector<AABB>::size_type aabb_idx = 0; aabb_idx < aabbs.size(); ++aabb_idx )
+  {
+    Array3u index_lower;
+    computeReferenceCellIndex( aabbs[aabb_idx].min() - 1.0e-6, min_coord, h, index_lower );
+    Array3u index_upper;
+    computeReferenceCellIndex( aabbs[aabb_idx].max() + 1.0e-6, min_coord, h, index_upper );
+    for( unsigned x_idx = index_lower.x(); x_idx <= index_upper.x(); ++x_idx )
+    {
+      for( unsigned y_idx = index_lower.y(); y_idx <= index_upper.y(); ++y_idx )
+      {
+        for( unsigned z_idx = index_lower.z(); z_idx <= index_upper.z(); ++z_idx )
+        {
+          const unsigned key{ x_idx + dimensions.x() * y_idx + dimensions.x() * dimensions.y() * z_idx };
+          voxels[key].emplace_back( unsigned( aabb_idx ) );
+        }
+      }
+    }
+  }
+
+  for( const std::pair<const unsigned,std::vector<unsigned>>& voxel : voxels )
+  {
+    for( std::vector<unsigned>::size_type idx0 = 0; idx0 + 1 < voxel.second.size(); ++idx0 )
+    {
+      for( std::vector<unsigned>::size_type idx1 = idx0 + 1; idx1 < voxel.second.size(); ++idx1 )
+      {
+        if( aabbs[voxel.second[idx0]].overlaps( aabbs[voxel.second[idx1]] ) )
+        {
+          overlaps.insert( std::make_pair( voxel.second[idx0], voxel.second[idx1] ) );
+        }
+      }
+    }
+  }
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 3 )
+  {
+    std::cerr << "Usage: " << argv[0] << " num_bodies num_steps" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  unsigned num_bodies;
+  if( !StringUtilities::extractFromString( std::string{ argv[1] }, num_bodies ) || num_bodies == 0 )
+  {
+    std::cerr << "Error, num_bodies must be a positive integer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  unsigned num_steps;
+  if( !StringUtilities::extractFromString( std::string{ argv[2] }, num_steps ) || num_steps == 0 )
+  {
+    std::cerr << "Error, num_steps must be a positive integer" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Array3s> centers;
+  generateLattice( num_bodies, centers );
+  std::vector<AABB> aabbs;
+
+  std::mt19937_64 mt{ 1729 };
+  std::uniform_real_distribution<scalar> displacement_gen{ -0.02, 0.02 };
+
+  std::chrono::duration<double> rebuild_time{ 0.0 };
+  std::chrono::duration<double> persistent_time{ 0.0 };
+  std::chrono::duration<double> grid_rebuild_time{ 0.0 };
+  std::size_t num_overlaps{ 0 };
+  std::size_t num_moved{ 0 };
+
+  SortedCellGrid<3> broad_phase;
+  SortedCellGrid<3> rebuilt_broad_phase;
+  std::set<std::pair<unsigned,unsigned>> rebuild_overlaps;
+
+  for( unsigned step = 0; step < num_steps; ++step )
+  {
+    for( Array3s& center : centers )
+    {
+      center += Array3s{ displacement_gen( mt ), displacement_gen( mt ), displacement_gen( mt ) };
+    }
+    computeAABBs( centers, aabbs );
+
+    const auto rebuild_start{ std::chrono::steady_clock::now() };
+    rebuild_overlaps.clear();
+    getReferencePotentialOverlaps( aabbs, rebuild_overlaps );
+    const auto rebuild_end{ std::chrono::steady_clock::now() };
+    rebuild_time += rebuild_end - rebuild_start;
+
+    const auto persistent_start{ std::chrono::steady_clock::now() };
+    const std::vector<std::pair<unsigned,unsigned>>& persistent_overlaps{ broad_phase.computePotentialOverlaps( aabbs ) };
+    const auto persistent_end{ std::chrono::steady_clock::now() };
+    persistent_time += persistent_end - persistent_start;
+
+    const auto grid_rebuild_start{ std::chrono::steady_clock::now() };
+    rebuilt_broad_phase.clear();
+    const std::vector<std::pair<unsigned,unsigned>>& rebuilt_overlaps{ rebuilt_broad_phase.computePotentialOverlaps( aabbs ) };
+    const auto grid_rebuild_end{ std::chrono::steady_clock::now() };
+    grid_rebuild_time += grid_rebuild_end - grid_rebuild_start;
+
+    if( !std::equal( persistent_overlaps.begin(), persistent_overlaps.end(), rebuild_overlaps.begin(), rebuild_overlaps.end() ) || persistent_overlaps != rebuilt_overlaps )
+    {
+      std::cerr << "Error, broad phase results disagree at step " << step << std::endl;
+      return EXIT_FAILURE;
+    }
+    num_overlaps += persistent_overlaps.size();
+    // The first query builds the grid, so only count moves after that
+    if( step != 0 )
+    {
+      num_moved += broad_phase.numMovedAABBs();
+    }
+  }
+
+  std::cout << "Bodies:                         " << num_bodies << std::endl;
+  std::cout << "Steps:                          " << num_steps << std::endl;
+  std::cout << "Mean overlaps per step:         " << scalar( num_overlaps ) / scalar( num_steps ) << std::endl;
+  std::cout << "Mean moved bodies per step:     " << ( num_steps > 1 ? scalar( num_moved ) / scalar( num_steps - 1 ) : 0.0 ) << std::endl;
+  std::cout << "Reference detector time (s):    " << rebuild_time.count() << std::endl;
+  std::cout << "SortedCellGrid time (s):        " << persistent_time.count() << std::endl;
+  std::cout << "Speedup:                        " << rebuild_time.count() / persistent_time.count() << std::endl;
+  std::cout << "Rebuilt SortedCellGrid time (s): " << grid_rebuild_time.count() << std::endl;
+  std::cout << "Speedup over rebuilding:        " << grid_rebuild_time.count() / persistent_time.count() << std::endl;
+
+  return EXIT_SUCCESS;
+}
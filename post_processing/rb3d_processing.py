@@ -135,6 +135,11 @@ class CollisionState(object):
             assert self.time >= 0
             self.timestep = h5_file['timestep'][:][0, 0]
             assert self.timestep >= 0.0
+            # Id of each body indexed by the collision indices, absent in files written before bodies were renumbered
+            if 'state/body_ids' in h5_file:
+                self.body_ids = h5_file['state/body_ids'][:, 0]
+            else:
+                self.body_ids = None
         except KeyError as key_exception:
             sys.exit('HDF5 Key Error: ' + key_exception.message)
 
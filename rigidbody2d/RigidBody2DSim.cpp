@@ -7,6 +7,7 @@
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactMap.h"
 #include "scisim/ConstrainedMaps/ImpactFrictionMap.h"
 #include "scisim/Utilities.h"
+#include "scisim/Timer/Profiler.h"
 
 #include "CircleBoxTools.h"
 #include "BoxBoxTools.h"
@@ -28,6 +29,7 @@
 #endif
 
 #include <iostream>
+#include <set>
 
 RigidBody2DState& RigidBody2DSim::state()
 {
@@ -710,7 +712,10 @@ void RigidBody2DSim::computeActiveSet( const VectorXs& q0, const VectorXs& q1, c
   }
 
   // Check all body-plane pairs
-  computeBodyPlaneActiveSetAllPairs( q0, q1, active_set );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::NARROW_PHASE };
+    computeBodyPlaneActiveSetAllPairs( q0, q1, active_set );
+  }
 }
 
 void RigidBody2DSim::computeImpactBases( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& impact_bases ) const
@@ -841,6 +846,7 @@ void RigidBody2DSim::updatePeriodicBoundaryConditionsStartOfStep( const unsigned
 
 void RigidBody2DSim::enforcePeriodicBoundaryConditions( VectorXs& q, VectorXs& v )
 {
+  const ProfilerScope profiler_scope{ ProfilerTimer::BOUNDARY };
   assert( q.size() % 3 == 0 );
   assert( q.size() == v.size() );
 
@@ -874,59 +880,59 @@ void RigidBody2DSim::enforcePeriodicBoundaryConditions( VectorXs& q, VectorXs& v
   }
 }
 
-void RigidBody2DSim::computeBodyBodyActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set ) const
+void RigidBody2DSim::computeBodyBodyActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set )
 {
   assert( q0.size() % 3 == 0 ); assert( q0.size() == q1.size() );
 
   const unsigned nbodies{ static_cast<unsigned>( q0.size() / 3 ) };
 
-  // Candidate bodies that might overlap
-  std::set<std::pair<unsigned,unsigned>> possible_overlaps;
   // Map from teleported AABB indices and body and portal indices
   std::map<unsigned,TeleportedBody> teleported_aabb_body_indices;
+  // Compute an AABB for each body
+  std::vector<AABB> aabbs;
+  aabbs.reserve( nbodies );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
-    // Compute an AABB for each body
-    std::vector<AABB> aabbs;
-    aabbs.reserve( nbodies );
-    for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-    {
-      Array2s min;
-      Array2s max;
-      m_state.bodyGeometry( bdy_idx )->computeAABB( q1.segment<2>( 3 * bdy_idx ), q1( 3 * bdy_idx + 2 ), min, max );
-      aabbs.emplace_back( min, max );
-    }
-    assert( aabbs.size() == nbodies );
+    Array2s min;
+    Array2s max;
+    m_state.bodyGeometry( bdy_idx )->computeAABB( q1.segment<2>( 3 * bdy_idx ), q1( 3 * bdy_idx + 2 ), min, max );
+    aabbs.emplace_back( min, max );
+  }
+  assert( aabbs.size() == nbodies );
 
-    // Compute an AABB for each teleported body
-    auto aabb_bdy_map_itr = teleported_aabb_body_indices.cbegin();
-    // For each portal
-    using st = std::vector<PlanarPortal>::size_type;
-    for( st prtl_idx = 0; prtl_idx < m_state.planarPortals().size(); ++prtl_idx )
+  // Compute an AABB for each teleported body
+  auto aabb_bdy_map_itr = teleported_aabb_body_indices.cbegin();
+  // For each portal
+  using st = std::vector<PlanarPortal>::size_type;
+  for( st prtl_idx = 0; prtl_idx < m_state.planarPortals().size(); ++prtl_idx )
+  {
+    // For each body
+    for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
     {
-      // For each body
-      for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+      // If the body is inside a portal
+      bool intersecting_plane_index;
+      if( m_state.planarPortals()[prtl_idx].aabbTouchesPortal( aabbs[bdy_idx].min(), aabbs[bdy_idx].max(), intersecting_plane_index )  )
       {
-        // If the body is inside a portal
-        bool intersecting_plane_index;
-        if( m_state.planarPortals()[prtl_idx].aabbTouchesPortal( aabbs[bdy_idx].min(), aabbs[bdy_idx].max(), intersecting_plane_index )  )
-        {
-          // Teleport to the other side of the portal
-          Vector2s x_out;
-          m_state.planarPortals()[prtl_idx].teleportPoint( q1.segment<2>( 3 * bdy_idx ), intersecting_plane_index, x_out );
-          // Compute an AABB for the teleported particle
-          Array2s min;
-          Array2s max;
-          m_state.bodyGeometry( bdy_idx )->computeAABB( x_out, q1( 3 * bdy_idx + 2 ), min, max );
-          aabbs.emplace_back( min, max );
-
-          aabb_bdy_map_itr = teleported_aabb_body_indices.insert( aabb_bdy_map_itr, std::make_pair( aabbs.size() - 1, TeleportedBody{ bdy_idx, static_cast<unsigned>(prtl_idx), intersecting_plane_index } ) );
-        }
+        // Teleport to the other side of the portal
+        Vector2s x_out;
+        m_state.planarPortals()[prtl_idx].teleportPoint( q1.segment<2>( 3 * bdy_idx ), intersecting_plane_index, x_out );
+        // Compute an AABB for the teleported particle
+        Array2s min;
+        Array2s max;
+        m_state.bodyGeometry( bdy_idx )->computeAABB( x_out, q1( 3 * bdy_idx + 2 ), min, max );
+        aabbs.emplace_back( min, max );
+
+        aabb_bdy_map_itr = teleported_aabb_body_indices.insert( aabb_bdy_map_itr, std::make_pair( aabbs.size() - 1, TeleportedBody{ bdy_idx, static_cast<unsigned>(prtl_idx), intersecting_plane_index } ) );
       }
     }
+  }
 
-    // Determine which bodies possibly overlap
-    SpatialGrid::getPotentialOverlaps( aabbs, possible_overlaps );
+  // Determine which bodies possibly overlap
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::BROAD_PHASE };
+    m_spatial_grid.computePotentialOverlaps( aabbs );
   }
+  const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps{ m_spatial_grid.potentialOverlaps() };
 
   std::set<TeleportedCollision> teleported_collisions;
 
@@ -1003,7 +1009,6 @@ void RigidBody2DSim::computeBodyBodyActiveSetSpatialGridWithPortals( const Vecto
       }
     }
   }
-  possible_overlaps.clear();
   teleported_aabb_body_indices.clear();
 
   #ifndef NDEBUG
@@ -1063,30 +1068,30 @@ void RigidBody2DSim::computeBodyBodyActiveSetSpatialGridWithPortals( const Vecto
   //#endif
 }
 
-void RigidBody2DSim::computeBodyBodyActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set ) const
+void RigidBody2DSim::computeBodyBodyActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set )
 {
   assert( q0.size() % 3 == 0 ); assert( q0.size() == q1.size() );
 
   const unsigned nbodies{ static_cast<unsigned>( q0.size() / 3 ) };
 
-  // Candidate bodies that might overlap
-  std::set<std::pair<unsigned,unsigned>> possible_overlaps;
+  // Compute an AABB for each body
+  std::vector<AABB> aabbs;
+  aabbs.reserve( nbodies );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
-    // Compute an AABB for each body
-    std::vector<AABB> aabbs;
-    aabbs.reserve( nbodies );
-    for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-    {
-      Array2s min;
-      Array2s max;
-      m_state.bodyGeometry( bdy_idx )->computeCollisionAABB( q0.segment<2>( 3 * bdy_idx ), q0( 3 * bdy_idx + 2 ), q1.segment<2>( 3 * bdy_idx ), q1( 3 * bdy_idx + 2 ), min, max );
-      aabbs.emplace_back( min, max );
-    }
-    assert( aabbs.size() == nbodies );
+    Array2s min;
+    Array2s max;
+    m_state.bodyGeometry( bdy_idx )->computeCollisionAABB( q0.segment<2>( 3 * bdy_idx ), q0( 3 * bdy_idx + 2 ), q1.segment<2>( 3 * bdy_idx ), q1( 3 * bdy_idx + 2 ), min, max );
+    aabbs.emplace_back( min, max );
+  }
+  assert( aabbs.size() == nbodies );
 
-    // Determine which bodies possibly overlap
-    SpatialGrid::getPotentialOverlaps( aabbs, possible_overlaps );
+  // Determine which bodies possibly overlap
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::BROAD_PHASE };
+    m_spatial_grid.computePotentialOverlaps( aabbs );
   }
+  const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps{ m_spatial_grid.potentialOverlaps() };
 
   // Create constraints for bodies that actually overlap
   for( const auto& possible_overlap_pair : possible_overlaps )
@@ -1142,6 +1147,7 @@ void RigidBody2DSim::serialize( std::ostream& output_stream ) const
   assert( output_stream.good() );
   m_state.serialize( output_stream );
   m_constraint_cache.serialize( output_stream );
+  // Nothing to serialize for m_spatial_grid
 }
 
 void RigidBody2DSim::deserialize( std::istream& input_stream )
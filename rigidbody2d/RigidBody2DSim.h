@@ -5,6 +5,7 @@
 #include "rigidbody2d/RigidBody2DState.h"
 
 #include "scisim/Constraints/ConstrainedSystem.h"
+#include "scisim/CollisionDetection/SortedCellGrid.h"
 #include "ConstraintCache.h"
 
 class UnconstrainedMap;
@@ -107,8 +108,8 @@ private:
   void dispatchTeleportedNarrowPhaseCollision( const TeleportedCollision& teleported_collision, const std::unique_ptr<RigidBody2DGeometry>& geo0, const std::unique_ptr<RigidBody2DGeometry>& geo1, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
   bool teleportedCollisionIsActive( const TeleportedCollision& teleported_collision, const std::unique_ptr<RigidBody2DGeometry>& geo0, const std::unique_ptr<RigidBody2DGeometry>& geo1, const VectorXs& q ) const;
 
-  void computeBodyBodyActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
-  void computeBodyBodyActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
+  void computeBodyBodyActiveSetSpatialGrid( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set );
+  void computeBodyBodyActiveSetSpatialGridWithPortals( const VectorXs& q0, const VectorXs& q1, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set );
   void computeBodyPlaneActiveSetAllPairs( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
 
   void boxBoxNarrowPhaseCollision( const unsigned idx0, const unsigned idx1, const BoxGeometry& box0, const BoxGeometry& box1, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
@@ -117,6 +118,7 @@ private:
 
   RigidBody2DState m_state;
   ConstraintCache m_constraint_cache;
+  SortedCellGrid<2> m_spatial_grid;
 
 };
 
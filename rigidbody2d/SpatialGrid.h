@@ -8,7 +8,6 @@
 
 #include "scisim/Math/MathDefines.h"
 
-#include <set>
 #include <vector>
 
 class AABB final
@@ -32,7 +31,7 @@ private:
 
 namespace SpatialGrid
 {
-  void getPotentialOverlaps( const std::vector<AABB>& aabbs, std::set<std::pair<unsigned,unsigned>>& overlaps );
+  void getPotentialOverlaps( const std::vector<AABB>& aabbs, std::vector<std::pair<unsigned,unsigned>>& overlaps );
   // TODO: Can make this faster by actually using the grid
   // TODO: Create a version that caches the grid for multiple lookups
   void getPotentialOverlaps( const AABB& trial_aabb, const std::vector<AABB>& aabbs, std::vector<unsigned>& overlaps );
@@ -14,6 +14,7 @@
 #include "scisim/StringUtilities.h"
 #include "scisim/CompileDefinitions.h"
 #include "scisim/ConstrainedMaps/ImpactFrictionMap.h"
+#include "scisim/Timer/Profiler.h"
 #include "scisim/Timer/TimeUtils.h"
 #include "scisim/ConstrainedMaps/ConstrainedMapUtilities.h"
 #include "scisim/UnconstrainedMaps/UnconstrainedMap.h"
@@ -61,6 +62,9 @@ static unsigned g_save_number_width{ 0 };
 static bool g_serialize_snapshots{ false };
 static bool g_overwrite_snapshots{ true };
 
+// CSV or JSON file receiving step timings, empty if profiling is disabled
+static std::string g_profile_file_name;
+
 // Magic number to print in front of binary output to aid in debugging
 static constexpr unsigned MAGIC_BINARY_NUMBER{ 1337 };
 
@@ -308,6 +312,7 @@ static int deserializeSystem( const std::string& file_name )
 
 static int exportConfigurationData()
 {
+  const ProfilerScope profiler_scope{ ProfilerTimer::OUTPUT };
   assert( g_steps_per_save != 0 );
   if( g_iteration % g_steps_per_save == 0 )
   {
@@ -344,6 +349,7 @@ static std::string generateOutputConstraintForceDataFileName()
 
 static int stepSystem()
 {
+  const ProfilerScope profiler_scope{ ProfilerTimer::STEP };
   const unsigned next_iter{ g_iteration + 1 };
 
   #ifdef USE_HDF5
@@ -411,12 +417,27 @@ static int stepSystem()
   else if( g_unconstrained_map != nullptr && g_impact_operator == nullptr && g_impact_map == nullptr && g_friction_solver != nullptr && g_impact_friction_map != nullptr )
   {
     #ifdef USE_HDF5
+    ImpactSolution impact_solution;
     if( force_file.is_open() )
     {
-      g_impact_friction_map->exportForcesNextStep( force_file );
+      g_impact_friction_map->exportForcesNextStep( impact_solution );
     }
     #endif
     g_sim.flow( g_scripting, next_iter, g_dt, *g_unconstrained_map, g_CoR, g_mu, *g_friction_solver, *g_impact_friction_map );
+    #ifdef USE_HDF5
+    if( force_file.is_open() )
+    {
+      try
+      {
+        impact_solution.writeSolution( force_file );
+      }
+      catch( const std::string& error )
+      {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    #endif
   }
   else
   {
@@ -449,12 +470,18 @@ static int executeSimLoop()
         {
           return EXIT_FAILURE;
         }
+        Profiler::endStep( g_iteration );
       }
       #endif
       // User-provided end of simulation python callback
       g_scripting.setState( g_sim.state() );
       g_scripting.endOfSimCallback();
       g_scripting.forgetState();
+      if( !Profiler::close() )
+      {
+        std::cerr << "Failed to write profile to " << g_profile_file_name << std::endl;
+        return EXIT_FAILURE;
+      }
       std::cout << "Simulation complete at time " << g_iteration * scalar( g_dt ) << ". Exiting." << std::endl;
       return EXIT_SUCCESS;
     }
@@ -463,6 +490,7 @@ static int executeSimLoop()
     {
       return EXIT_FAILURE;
     }
+    Profiler::endStep( g_iteration );
   }
 }
 
@@ -479,6 +507,7 @@ static void printUsage( const std::string& executable_name )
   #endif
   std::cout << "   -f/--frequency integer   : rate at which to save simulation data, in Hz; ignored if no output directory specified" << std::endl;
   std::cout << "   -s/--serialize_snapshots bool : save a bit identical, resumable snapshot; if 0 overwrites the snapshot each timestep, if 1 saves a new snapshot for each timestep" << std::endl;
+  std::cout << "   -p/--profile file        : records the time spent in each phase of the step; a .csv file receives one row per step, a .json file receives totals, means, and maxima" << std::endl;
 }
 
 static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_enabled, scalar& end_time_override, unsigned& output_frequency, std::string& serialized_file_name )
@@ -494,6 +523,7 @@ static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_en
     { "output_dir", required_argument, nullptr, 'o' },
     #endif
     { "frequency", required_argument, nullptr, 'f' },
+    { "profile", required_argument, nullptr, 'p' },
     { nullptr, 0, nullptr, 0 }
   };
 
@@ -501,9 +531,9 @@ static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_en
   {
     int option_index = 0;
     #ifdef USE_HDF5
-    constexpr char command_line_options[]{ "his:r:e:o:f:" };
+    constexpr char command_line_options[]{ "his:r:e:o:f:p:" };
     #else
-    constexpr char command_line_options[]{ "hs:r:e:f:" };
+    constexpr char command_line_options[]{ "hs:r:e:f:p:" };
     #endif
     const int c{ getopt_long( *argc, *argv, command_line_options, long_options, &option_index ) };
     if( c == -1 )
@@ -568,6 +598,11 @@ static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_en
         }
         break;
       }
+      case 'p':
+      {
+        g_profile_file_name = optarg;
+        break;
+      }
       case '?':
       {
         return false;
@@ -620,6 +655,12 @@ int main( int argc, char** argv )
   }
   #endif
 
+  if( !g_profile_file_name.empty() && !Profiler::open( g_profile_file_name ) )
+  {
+    std::cerr << "Failed to open profile file " << g_profile_file_name << ". The file name must end in .csv or .json." << std::endl;
+    return EXIT_FAILURE;
+  }
+
   #ifdef USE_PYTHON
   // Initialize the Python interpreter
   Py_SetProgramName( argv[0] );
@@ -27,14 +27,22 @@
 #include "scisim/ConstrainedMaps/StabilizedImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ColoredGaussSeidelOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/JacobiOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GROperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GRROperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/IslandImpactOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorMatrixFreeAPGD.h"
 #include "scisim/ConstrainedMaps/FrictionSolver.h"
 #include "scisim/ConstrainedMaps/StaggeredProjections.h"
 #include "scisim/ConstrainedMaps/Sobogus.h"
+#include "scisim/ConstrainedMaps/IslandFrictionSolver.h"
 #include "scisim/ConstrainedMaps/FrictionMaps/FrictionOperator.h"
 
+#ifdef USE_HDF5
+#include "scisim/HDF5File.h"
+#endif
+
 #ifdef IPOPT_FOUND
 #include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorIpopt.h"
 #endif
@@ -51,19 +59,25 @@ static bool loadTextFileIntoVector( const std::string& filename, std::vector<cha
   assert( xmlchars.empty() );
 
   // Attempt to open the text file for reading
-  std::ifstream textfile( filename );
+  std::ifstream textfile{ filename, std::ios::binary | std::ios::ate };
   if( !textfile.is_open() )
   {
     return false;
   }
 
-  // Read the entire file into a single string
-  std::string line;
-  while( getline( textfile, line ) )
+  // Read the entire file with a single allocation, as scene files with many bodies can be large
+  const std::streamoff file_size{ textfile.tellg() };
+  if( file_size < 0 )
+  {
+    return false;
+  }
+  xmlchars.resize( std::vector<char>::size_type( file_size ) + 1 );
+  textfile.seekg( 0 );
+  if( !textfile.read( xmlchars.data(), file_size ) )
   {
-    std::copy( line.cbegin(), line.cend(), back_inserter( xmlchars ) );
+    return false;
   }
-  xmlchars.emplace_back( '\0' );
+  xmlchars.back() = '\0';
 
   return true;
 }
@@ -570,8 +584,42 @@ static bool loadLCPSolver( const rapidxml::xml_node<>& node, std::unique_ptr<Imp
 
   const std::string solver_name = std::string{ nd->value() };
 
+  if( solver_name == "apgd_matrix_free" )
+  {
+    // Attempt to parse the solver tolerance
+    scalar tol;
+    {
+      const rapidxml::xml_attribute<>* const tol_nd{ node.first_attribute( "tol" ) };
+      if( tol_nd == nullptr )
+      {
+        std::cerr << "Could not locate tol for apgd_matrix_free solver" << std::endl;
+        return false;
+      }
+      if( !StringUtilities::extractFromString( std::string{ tol_nd->value() }, tol ) || tol <= 0.0 )
+      {
+        std::cerr << "Could not load tol for apgd_matrix_free solver, value must be a positive scalar" << std::endl;
+        return false;
+      }
+    }
+    // Attempt to parse the max number of iterations
+    unsigned max_iters;
+    {
+      const rapidxml::xml_attribute<>* const itr_nd{ node.first_attribute( "max_iters" ) };
+      if( itr_nd == nullptr )
+      {
+        std::cerr << "Could not locate max_iters for apgd_matrix_free solver" << std::endl;
+        return false;
+      }
+      if( !StringUtilities::extractFromString( std::string{ itr_nd->value() }, max_iters ) )
+      {
+        std::cerr << "Could not load max_iters for apgd_matrix_free solver, value must be an unsigned integer" << std::endl;
+        return false;
+      }
+    }
+    impact_operator.reset( new LCPOperatorMatrixFreeAPGD{ tol, max_iters } );
+  }
   #ifdef QL_FOUND
-  if( solver_name == "ql_vp" )
+  else if( solver_name == "ql_vp" )
   {
     // Attempt to parse the solver tolerance
     const rapidxml::xml_attribute<>* const tol_nd{ node.first_attribute( "tol" ) };
@@ -605,10 +653,9 @@ static bool loadLCPSolver( const rapidxml::xml_node<>& node, std::unique_ptr<Imp
     }
     impact_operator.reset( new LCPOperatorQL{ tol } );
   }
-  else
   #endif
   #ifdef IPOPT_FOUND
-  if( solver_name == "ipopt" )
+  else if( solver_name == "ipopt" )
   {
     // Attempt to read the desired linear solvers
     std::vector<std::string> linear_solvers;
@@ -658,19 +705,14 @@ static bool loadLCPSolver( const rapidxml::xml_node<>& node, std::unique_ptr<Imp
     }
     impact_operator.reset( new LCPOperatorIpopt{ linear_solvers, con_tol } );
   }
-  else
   #endif
-  #if defined(QL_FOUND) || defined(IPOPT_FOUND)
+  else
   {
     std::cerr << "Invalid lcp solver name: " << solver_name << std::endl;
     return false;
   }
 
   return true;
-  #else
-  std::cerr << "Invalid lcp solver name: " << solver_name << std::endl;
-  return false;
-  #endif
 }
 
 // TODO: Clean this function up, pull into SCISim
@@ -689,7 +731,7 @@ static bool loadImpactOperatorNoCoR( const rapidxml::xml_node<>& node, std::uniq
   }
 
   scalar v_tol = std::numeric_limits<scalar>::signaling_NaN();
-  if( type == "gauss_seidel" || type == "jacobi" || type == "gr" )
+  if( type == "gauss_seidel" || type == "colored_gauss_seidel" || type == "jacobi" || type == "gr" )
   {
     // Attempt to load the termination tolerance
     const rapidxml::xml_attribute<>* const v_tol_nd{ node.first_attribute( "v_tol" ) };
@@ -709,6 +751,10 @@ static bool loadImpactOperatorNoCoR( const rapidxml::xml_node<>& node, std::uniq
   {
     impact_operator.reset( new GaussSeidelOperator( v_tol ) );
   }
+  else if( type == "colored_gauss_seidel" )
+  {
+    impact_operator.reset( new ColoredGaussSeidelOperator( v_tol ) );
+  }
   else if( type == "jacobi" )
   {
     impact_operator.reset( new JacobiOperator( v_tol ) );
@@ -1248,7 +1294,50 @@ static bool loadSobogusFrictionSolver( const rapidxml::xml_node<>& node, std::un
     return false;
   }
 
-  friction_solver.reset( new Sobogus{ SobogusSolverType::RigidBody2D, unsigned( eval_every ) } );
+  SobogusSettings settings;
+  if( !loadSobogusSettings( node, settings ) )
+  {
+    return false;
+  }
+
+  friction_solver.reset( new Sobogus{ SobogusSolverType::RigidBody2D, unsigned( eval_every ), settings } );
+
+  return true;
+}
+
+// Splits the impact or friction solve into independent groups of contacts. Example:
+//  <contact_islands min_contacts="64"/>
+static bool loadContactIslands( const rapidxml::xml_node<>& node, std::unique_ptr<ImpactOperator>& impact_operator, std::unique_ptr<FrictionSolver>& friction_solver )
+{
+  // Attempt to load the smallest number of contacts in a group
+  int min_contacts;
+  {
+    const rapidxml::xml_attribute<>* const attrib_nd{ node.first_attribute( "min_contacts" ) };
+    if( attrib_nd == nullptr )
+    {
+      std::cerr << "Could not locate min_contacts for contact_islands" << std::endl;
+      return false;
+    }
+    if( !StringUtilities::extractFromString( attrib_nd->value(), min_contacts ) || min_contacts < 0 )
+    {
+      std::cerr << "Could not load min_contacts value for contact_islands, value of min_contacts must be a nonnegative integer" << std::endl;
+      return false;
+    }
+  }
+
+  if( impact_operator != nullptr )
+  {
+    impact_operator.reset( new IslandImpactOperator{ unsigned( min_contacts ), *impact_operator } );
+  }
+  else if( friction_solver != nullptr )
+  {
+    friction_solver.reset( new IslandFrictionSolver{ unsigned( min_contacts ), *friction_solver } );
+  }
+  else
+  {
+    std::cerr << "Error loading contact_islands, no impact_operator or friction solver specified" << std::endl;
+    return false;
+  }
 
   return true;
 }
@@ -1337,17 +1426,102 @@ static bool loadGeometry( const rapidxml::xml_node<>& node, std::vector<std::uni
   return true;
 }
 
+namespace
+{
+
+  // Bodies stored column by column in an HDF5 file, for scenes too large to list body by body in XML
+  struct RigidBodyList final
+  {
+    Matrix2Xsc x;
+    Eigen::Matrix<scalar,1,Eigen::Dynamic> theta;
+    Matrix2Xsc v;
+    Eigen::Matrix<scalar,1,Eigen::Dynamic> omega;
+    Eigen::Matrix<scalar,1,Eigen::Dynamic> rho;
+    Eigen::Matrix<int,1,Eigen::Dynamic> geo_idx;
+    // Optional, bodies are not fixed if empty
+    Eigen::Matrix<int,1,Eigen::Dynamic> fixed;
+  };
+
+}
+
+static bool loadRigidBodyList( const std::string& file_name, RigidBodyList& body_list )
+{
+  #ifdef USE_HDF5
+  try
+  {
+    const HDF5File list_file{ file_name, HDF5AccessType::READ_ONLY };
+    body_list.x = list_file.read<Matrix2Xsc>( "bodies/x" );
+    body_list.theta = list_file.read<Eigen::Matrix<scalar,1,Eigen::Dynamic>>( "bodies/theta" );
+    body_list.v = list_file.read<Matrix2Xsc>( "bodies/v" );
+    body_list.omega = list_file.read<Eigen::Matrix<scalar,1,Eigen::Dynamic>>( "bodies/omega" );
+    body_list.rho = list_file.read<Eigen::Matrix<scalar,1,Eigen::Dynamic>>( "bodies/rho" );
+    body_list.geo_idx = list_file.read<Eigen::Matrix<int,1,Eigen::Dynamic>>( "bodies/geo_idx" );
+    if( list_file.exists( "bodies/fixed" ) )
+    {
+      body_list.fixed = list_file.read<Eigen::Matrix<int,1,Eigen::Dynamic>>( "bodies/fixed" );
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << "Failed to load rigid_body_list " << file_name << ": " << error << std::endl;
+    return false;
+  }
+  const int nbodies{ int( body_list.rho.size() ) };
+  if( body_list.x.cols() != nbodies || body_list.theta.size() != nbodies || body_list.v.cols() != nbodies || body_list.omega.size() != nbodies || body_list.geo_idx.size() != nbodies || ( body_list.fixed.size() != 0 && body_list.fixed.size() != nbodies ) )
+  {
+    std::cerr << "Failed to load rigid_body_list " << file_name << ", every data set must have one column per body" << std::endl;
+    return false;
+  }
+  if( ( body_list.rho.array() <= 0.0 ).any() )
+  {
+    std::cerr << "Failed to load rigid_body_list " << file_name << ", rho must be positive" << std::endl;
+    return false;
+  }
+  return true;
+  #else
+  std::cerr << "Error, loading rigid_body_list " << file_name << " requires HDF5 support. Please recompile with USE_HDF5=ON." << std::endl;
+  return false;
+  #endif
+}
+
+// Bodies listed in the scene file are loaded first, followed by the bodies of any companion body
+// lists in document order. All bodies are counted up front so that state is allocated only once.
 static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std::unique_ptr<RigidBody2DGeometry>>& geometry, VectorXs& q, VectorXs& v, VectorXs& m, VectorXu& indices, std::vector<bool>& fixed )
 {
-  std::vector<Vector2s> xs;
-  std::vector<scalar> thetas;
-  std::vector<Vector2s> vs;
-  std::vector<scalar> omegas;
-  std::vector<scalar> densities;
-  std::vector<unsigned> geometry_indices;
   assert( fixed.empty() );
 
+  unsigned nbodies{ 0 };
   for( rapidxml::xml_node<>* nd = node.first_node( "rigid_body" ); nd; nd = nd->next_sibling( "rigid_body" ) )
+  {
+    ++nbodies;
+  }
+  std::vector<RigidBodyList> body_lists;
+  for( rapidxml::xml_node<>* nd = node.first_node( "rigid_body_list" ); nd; nd = nd->next_sibling( "rigid_body_list" ) )
+  {
+    const rapidxml::xml_attribute<>* const filename_attrib{ nd->first_attribute( "filename" ) };
+    if( filename_attrib == nullptr )
+    {
+      std::cerr << "Failed to locate filename attribute for rigid_body_list node." << std::endl;
+      return false;
+    }
+    body_lists.emplace_back();
+    if( !loadRigidBodyList( filename_attrib->value(), body_lists.back() ) )
+    {
+      return false;
+    }
+    nbodies += unsigned( body_lists.back().rho.size() );
+  }
+
+  q.resize( 3 * nbodies );
+  v.resize( 3 * nbodies );
+  m.resize( 3 * nbodies );
+  indices.resize( nbodies );
+  fixed.resize( nbodies );
+  // Masses are computed from the densities once every geometry index is known
+  VectorXs densities{ nbodies };
+
+  unsigned bdy_idx{ 0 };
+  for( rapidxml::xml_node<>* nd = node.first_node( "rigid_body" ); nd; nd = nd->next_sibling( "rigid_body" ), ++bdy_idx )
   {
     // Load the center of mass' position
     {
@@ -1363,7 +1537,7 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
         std::cerr << "Failed to load x attribute for rigid_body node, must provide two scalars." << std::endl;
         return false;
       }
-      xs.emplace_back( x );
+      q.segment<2>( 3 * bdy_idx ) = x;
     }
 
     // Load the rotation about the center of mass
@@ -1374,13 +1548,11 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
         std::cerr << "Failed to locate theta attribute for rigid_body node." << std::endl;
         return false;
       }
-      scalar theta;
-      if( !StringUtilities::extractFromString( theta_attrib->value(), theta ) )
+      if( !StringUtilities::extractFromString( theta_attrib->value(), q( 3 * bdy_idx + 2 ) ) )
       {
         std::cerr << "Failed to load theta attribute for rigid_body node, must provide a single scalar." << std::endl;
         return false;
       }
-      thetas.emplace_back( theta );
     }
 
     // Load the center of mass' velocity
@@ -1397,7 +1569,7 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
         std::cerr << "Failed to load v attribute for rigid_body node, must provide two scalars." << std::endl;
         return false;
       }
-      vs.emplace_back( v_body );
+      v.segment<2>( 3 * bdy_idx ) = v_body;
     }
 
     // Load the angular velocity
@@ -1408,13 +1580,11 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
         std::cerr << "Failed to locate omega attribute for rigid_body node." << std::endl;
         return false;
       }
-      scalar omega;
-      if( !StringUtilities::extractFromString( omega_attrib->value(), omega ) )
+      if( !StringUtilities::extractFromString( omega_attrib->value(), v( 3 * bdy_idx + 2 ) ) )
       {
         std::cerr << "Failed to load omega attribute for rigid_body node, must provide a single scalar." << std::endl;
         return false;
       }
-      omegas.emplace_back( omega );
     }
 
     // Load the density
@@ -1425,13 +1595,11 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
         std::cerr << "Failed to locate rho attribute for rigid_body node." << std::endl;
         return false;
       }
-      scalar rho;
-      if( !StringUtilities::extractFromString( rho_attrib->value(), rho ) || rho <= 0.0 )
+      if( !StringUtilities::extractFromString( rho_attrib->value(), densities( bdy_idx ) ) || densities( bdy_idx ) <= 0.0 )
       {
         std::cerr << "Failed to load rho attribute for rigid_body node, must provide a single positive scalar." << std::endl;
         return false;
       }
-      densities.emplace_back( rho );
     }
 
     // Load the index of this body's geometry
@@ -1448,7 +1616,7 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
         std::cerr << "Failed to load geo_idx attribute for rigid_body node, must provide an unsigned integer less than the number of geometry instances." << std::endl;
         return false;
       }
-      geometry_indices.emplace_back( unsigned( geometry_index ) );
+      indices( bdy_idx ) = unsigned( geometry_index );
     }
 
     // Load the optional fixed attribute
@@ -1456,7 +1624,7 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
       const rapidxml::xml_attribute<>* const fixed_attrib{ nd->first_attribute( "fixed" ) };
       if( fixed_attrib == nullptr )
       {
-        fixed.push_back( false );
+        fixed[bdy_idx] = false;
       }
       else
       {
@@ -1466,39 +1634,37 @@ static bool loadBodies( const rapidxml::xml_node<>& node, const std::vector<std:
           std::cerr << "Failed to load fixed attribute for rigid_body node, fixed must be a boolean." << std::endl;
           return false;
         }
-        fixed.push_back( fixed_val );
+        fixed[bdy_idx] = fixed_val;
       }
     }
   }
 
-  const unsigned nbodies{ static_cast<unsigned>( xs.size() ) };
-
-  // Build the generalized configuration
-  q.resize( 3 * nbodies );
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-  {
-    q.segment<2>( 3 * bdy_idx ) = xs[bdy_idx];
-    q( 3 * bdy_idx + 2 ) = thetas[ bdy_idx ];
-  }
-
-  // Build the generalized velocity
-  v.resize( 3 * nbodies );
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  for( const RigidBodyList& body_list : body_lists )
   {
-    v.segment<2>( 3 * bdy_idx ) = vs[bdy_idx];
-    v( 3 * bdy_idx + 2 ) = omegas[ bdy_idx ];
+    if( ( body_list.geo_idx.array() < 0 ).any() || ( body_list.geo_idx.array() >= int( geometry.size() ) ).any() )
+    {
+      std::cerr << "Failed to load geo_idx of rigid_body_list, must provide unsigned integers less than the number of geometry instances." << std::endl;
+      return false;
+    }
+    for( int list_idx = 0; list_idx < body_list.rho.size(); ++list_idx, ++bdy_idx )
+    {
+      q.segment<2>( 3 * bdy_idx ) = body_list.x.col( list_idx );
+      q( 3 * bdy_idx + 2 ) = body_list.theta( list_idx );
+      v.segment<2>( 3 * bdy_idx ) = body_list.v.col( list_idx );
+      v( 3 * bdy_idx + 2 ) = body_list.omega( list_idx );
+      densities( bdy_idx ) = body_list.rho( list_idx );
+      indices( bdy_idx ) = unsigned( body_list.geo_idx( list_idx ) );
+      fixed[bdy_idx] = body_list.fixed.size() != 0 && body_list.fixed( list_idx ) != 0;
+    }
   }
-
-  // Copy the geometry indices to the output
-  indices = Eigen::Map<VectorXu>( geometry_indices.data(), nbodies );
+  assert( bdy_idx == nbodies );
 
   // Build the diagonal of the mass matrix
-  m.resize( 3 * nbodies );
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  for( bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
     scalar mass;
     scalar inertia;
-    geometry[ indices(bdy_idx) ]->computeMassAndInertia( densities[bdy_idx], mass, inertia );
+    geometry[ indices(bdy_idx) ]->computeMassAndInertia( densities(bdy_idx), mass, inertia );
     m.segment<2>( 3 * bdy_idx ).setConstant( mass );
     m( 3 * bdy_idx + 2 ) = inertia;
   }
@@ -1609,6 +1775,15 @@ bool RigidBody2DSceneParser::parseXMLSceneFile( const std::string& file_name, st
     }
   }
 
+  // Split the solve into contact islands, if requested
+  if( root_node.first_node( "contact_islands" ) != nullptr )
+  {
+    if( !loadContactIslands( *root_node.first_node( "contact_islands" ), impact_operator, friction_solver ) )
+    {
+      return false;
+    }
+  }
+
   // Load forces
   std::vector<std::unique_ptr<RigidBody2DForce>> forces;
   // Attempt to load a gravity force
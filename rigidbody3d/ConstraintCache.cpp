@@ -11,7 +11,71 @@
 #include "Constraints/StaticCylinderSphereConstraint.h"
 #include "Constraints/KinematicObjectSphereConstraint.h"
 
-void ConstraintCache::cacheConstraint( const Constraint& constraint, const VectorXs& r )
+// Pair of objects in contact: the two bodies, or the static geometry followed by the body
+static std::pair<unsigned,unsigned> contactObjects( const Constraint& constraint )
+{
+  std::pair<int,int> bodies;
+  constraint.getBodyIndices( bodies );
+  assert( bodies.first >= 0 );
+  if( bodies.second >= 0 )
+  {
+    return std::make_pair( unsigned( bodies.first ), unsigned( bodies.second ) );
+  }
+  return std::make_pair( constraint.getStaticObjectIndex(), unsigned( bodies.first ) );
+}
+
+// Contact point in the frame of the first simulated body
+static Vector3s localContactPoint( const Constraint& constraint, const VectorXs& q )
+{
+  assert( q.size() % 12 == 0 );
+  const unsigned nbodies{ unsigned( q.size() / 12 ) };
+  const unsigned body{ unsigned( constraint.simulatedBody0() ) };
+  assert( body < nbodies );
+  VectorXs contact_point;
+  constraint.getWorldSpaceContactPoint( q, contact_point );
+  const Matrix33sr R{ Eigen::Map<const Matrix33sr>{ q.segment<9>( 3 * nbodies + 9 * body ).data() } };
+  return R.transpose() * ( contact_point - q.segment<3>( 3 * body ) );
+}
+
+ConstraintCache::PointContactCache* ConstraintCache::pointContactCache( const std::string& constraint_name )
+{
+  return const_cast<PointContactCache*>( static_cast<const ConstraintCache&>( *this ).pointContactCache( constraint_name ) );
+}
+
+const ConstraintCache::PointContactCache* ConstraintCache::pointContactCache( const std::string& constraint_name ) const
+{
+  if( constraint_name == "body_body" )
+  {
+    return &m_body_body_constraint_cache;
+  }
+  else if( constraint_name == "kinematic_object_body" )
+  {
+    return &m_kinematic_object_body_constraint_cache;
+  }
+  else if( constraint_name == "kinematic_object_sphere" )
+  {
+    return &m_kinematic_object_sphere_constraint_cache;
+  }
+  else if( constraint_name == "static_plane_body" )
+  {
+    return &m_static_plane_body_constraint_cache;
+  }
+  else if( constraint_name == "static_plane_box" )
+  {
+    return &m_static_plane_box_constraint_cache;
+  }
+  else if( constraint_name == "static_cylinder_body" )
+  {
+    return &m_static_cylinder_body_constraint_cache;
+  }
+  else if( constraint_name == "teleported_sphere_sphere" )
+  {
+    return &m_teleported_sphere_sphere_constraint_cache;
+  }
+  return nullptr;
+}
+
+void ConstraintCache::cacheConstraint( const Constraint& constraint, const VectorXs& q, const VectorXs& r )
 {
   if( constraint.name() == "sphere_sphere" )
   {
@@ -53,16 +117,11 @@ void ConstraintCache::cacheConstraint( const Constraint& constraint, const Vecto
     m_kinematic_sphere_sphere_constraint_cache.insert( std::make_pair( std::make_pair( kinematic_sphere_sphere.kinematicIdx(), kinematic_sphere_sphere.sphereIdx() ), r ) );
     assert( insert_return.second ); // Should not re-encounter constraints
   }
-  // else if( constraint.name() == "kinematic_object_sphere" )
-  // {
-  //   const KinematicObjectSphereConstraint& kinematic_vs_sphere{ static_cast<const KinematicObjectSphereConstraint&>( constraint ) };
-  //   // Insert this constraint into the cache
-  //   #ifndef NDEBUG
-  //   const auto insert_return =
-  //   #endif
-  //   m_kinematic_object_sphere_constraint_cache.insert( std::make_pair( std::make_pair( kinematic_vs_sphere.kinematicIdx(), kinematic_vs_sphere.sphereIdx() ), r ) );
-  //   assert( insert_return.second ); // Should not re-encounter constraints
-  // }
+  else if( PointContactCache* const point_cache = pointContactCache( constraint.name() ) )
+  {
+    // A pair of objects can touch at several points, so store each contact point with its impulse
+    ( *point_cache )[ contactObjects( constraint ) ].push_back( CachedContact{ localContactPoint( constraint, q ), r } );
+  }
   else
   {
     // Unhandled constraint, warn the user!
@@ -77,15 +136,26 @@ void ConstraintCache::clear()
   m_static_plane_sphere_constraint_cache.clear();
   m_static_cylinder_sphere_constraint_cache.clear();
   m_kinematic_sphere_sphere_constraint_cache.clear();
+  m_body_body_constraint_cache.clear();
+  m_kinematic_object_body_constraint_cache.clear();
+  m_kinematic_object_sphere_constraint_cache.clear();
+  m_static_plane_body_constraint_cache.clear();
+  m_static_plane_box_constraint_cache.clear();
+  m_static_cylinder_body_constraint_cache.clear();
+  m_teleported_sphere_sphere_constraint_cache.clear();
 }
 
 bool ConstraintCache::empty() const
 {
   return m_sphere_sphere_constraint_cache.empty() && m_static_plane_sphere_constraint_cache.empty() &&
-         m_static_cylinder_sphere_constraint_cache.empty() && m_kinematic_sphere_sphere_constraint_cache.empty();
+         m_static_cylinder_sphere_constraint_cache.empty() && m_kinematic_sphere_sphere_constraint_cache.empty() &&
+         m_body_body_constraint_cache.empty() && m_kinematic_object_body_constraint_cache.empty() &&
+         m_kinematic_object_sphere_constraint_cache.empty() && m_static_plane_body_constraint_cache.empty() &&
+         m_static_plane_box_constraint_cache.empty() && m_static_cylinder_body_constraint_cache.empty() &&
+         m_teleported_sphere_sphere_constraint_cache.empty();
 }
 
-void ConstraintCache::getCachedConstraint( const Constraint& constraint, VectorXs& r ) const
+void ConstraintCache::getCachedConstraint( const Constraint& constraint, const VectorXs& q, VectorXs& r ) const
 {
   if( constraint.name() == "sphere_sphere" )
   {
@@ -143,20 +213,42 @@ void ConstraintCache::getCachedConstraint( const Constraint& constraint, VectorX
       return;
     }
   }
-  // else if( constraint.name() == "kinematic_object_sphere" )
-  // {
-  //   const KinematicObjectSphereConstraint& kinematic_vs_sphere{ static_cast<const KinematicObjectSphereConstraint&>( constraint ) };
-  //   // Try to retrieve this constraint from the cache
-  //   using itr_type = std::map<std::pair<unsigned,unsigned>,VectorXs>::const_iterator;
-  //   const itr_type map_iterator{ m_kinematic_object_sphere_constraint_cache.find( std::make_pair( kinematic_vs_sphere.kinematicIdx(), kinematic_vs_sphere.sphereIdx() ) ) };
-  //   // If object is in the cache, return the force
-  //   if( map_iterator != m_kinematic_object_sphere_constraint_cache.cend() )
-  //   {
-  //     assert( r.size() == map_iterator->second.size() );
-  //     r = map_iterator->second;
-  //     return;
-  //   }
-  // }
+  else if( const PointContactCache* const point_cache = pointContactCache( constraint.name() ) )
+  {
+    // Try to retrieve the contacts between this pair of objects from the cache
+    const PointContactCache::const_iterator map_iterator{ point_cache->find( contactObjects( constraint ) ) };
+    if( map_iterator != point_cache->cend() )
+    {
+      // Find the two cached contact points nearest this contact point
+      const Vector3s local_point{ localContactPoint( constraint, q ) };
+      const CachedContact* nearest{ nullptr };
+      scalar nearest_dist{ SCALAR_INFINITY };
+      scalar second_nearest_dist{ SCALAR_INFINITY };
+      for( const CachedContact& cached_contact : map_iterator->second )
+      {
+        const scalar dist{ ( cached_contact.local_point - local_point ).squaredNorm() };
+        if( dist < nearest_dist )
+        {
+          second_nearest_dist = nearest_dist;
+          nearest_dist = dist;
+          nearest = &cached_contact;
+        }
+        else if( dist < second_nearest_dist )
+        {
+          second_nearest_dist = dist;
+        }
+      }
+      // Only reuse the nearest contact if it is clearly closer than any other, otherwise the
+      // contact point moved too far relative to the spacing of the contacts to identify it
+      assert( nearest != nullptr );
+      if( 4.0 * nearest_dist < second_nearest_dist )
+      {
+        assert( r.size() == nearest->r.size() );
+        r = nearest->r;
+        return;
+      }
+    }
+  }
   else
   {
     std::cerr << constraint.name() << " not supported in ConstraintCache::getCachedConstraint, exiting." << std::endl;
@@ -167,6 +259,54 @@ void ConstraintCache::getCachedConstraint( const Constraint& constraint, VectorX
   r.setZero();
 }
 
+// How the pair of objects that keys a cached contact changes when bodies are renumbered
+enum class CachedObjects
+{
+  STATIC_AND_BODY,  // Static geometry and a body, only the body is renumbered
+  BODY_AND_BODY,    // Two bodies with distinct roles, e.g. kinematic and simulated
+  ORDERED_BODIES    // Two bodies with the lower index first
+};
+
+template<typename CachedValue>
+static void renumberCache( const std::vector<unsigned>& new_index, const CachedObjects objects, std::map<std::pair<unsigned,unsigned>,CachedValue>& constraint_cache )
+{
+  std::map<std::pair<unsigned,unsigned>,CachedValue> renumbered_cache;
+  for( auto iterator = constraint_cache.begin(); iterator != constraint_cache.end(); ++iterator )
+  {
+    std::pair<unsigned,unsigned> objects_pair{ iterator->first };
+    if( objects != CachedObjects::STATIC_AND_BODY )
+    {
+      assert( objects_pair.first < new_index.size() );
+      objects_pair.first = new_index[objects_pair.first];
+    }
+    assert( objects_pair.second < new_index.size() );
+    objects_pair.second = new_index[objects_pair.second];
+    // The contact frame and normal follow the order of the bodies, so the cached impulse is stale
+    if( objects == CachedObjects::ORDERED_BODIES && objects_pair.first > objects_pair.second )
+    {
+      continue;
+    }
+    renumbered_cache.emplace( objects_pair, std::move( iterator->second ) );
+  }
+  constraint_cache.swap( renumbered_cache );
+}
+
+void ConstraintCache::renumberBodies( const std::vector<unsigned>& new_index )
+{
+  renumberCache( new_index, CachedObjects::ORDERED_BODIES, m_sphere_sphere_constraint_cache );
+  renumberCache( new_index, CachedObjects::STATIC_AND_BODY, m_static_plane_sphere_constraint_cache );
+  renumberCache( new_index, CachedObjects::STATIC_AND_BODY, m_static_cylinder_sphere_constraint_cache );
+  renumberCache( new_index, CachedObjects::BODY_AND_BODY, m_kinematic_sphere_sphere_constraint_cache );
+  // Contact points are stored in the frame of a body, so they are unaffected by the renumbering
+  renumberCache( new_index, CachedObjects::ORDERED_BODIES, m_body_body_constraint_cache );
+  renumberCache( new_index, CachedObjects::BODY_AND_BODY, m_kinematic_object_body_constraint_cache );
+  renumberCache( new_index, CachedObjects::BODY_AND_BODY, m_kinematic_object_sphere_constraint_cache );
+  renumberCache( new_index, CachedObjects::STATIC_AND_BODY, m_static_plane_body_constraint_cache );
+  renumberCache( new_index, CachedObjects::STATIC_AND_BODY, m_static_plane_box_constraint_cache );
+  renumberCache( new_index, CachedObjects::STATIC_AND_BODY, m_static_cylinder_body_constraint_cache );
+  renumberCache( new_index, CachedObjects::ORDERED_BODIES, m_teleported_sphere_sphere_constraint_cache );
+}
+
 static void serializeCache( const std::map<std::pair<unsigned,unsigned>,VectorXs>& constraint_cache, std::ostream& output_stream )
 {
   assert( output_stream.good() );
@@ -180,6 +320,23 @@ static void serializeCache( const std::map<std::pair<unsigned,unsigned>,VectorXs
   }
 }
 
+void ConstraintCache::serializePointCache( const PointContactCache& constraint_cache, std::ostream& output_stream )
+{
+  assert( output_stream.good() );
+  Utilities::serialize( constraint_cache.size(), output_stream );
+  for( auto iterator = constraint_cache.cbegin(); iterator != constraint_cache.cend(); ++iterator )
+  {
+    Utilities::serialize( iterator->first.first, output_stream );
+    Utilities::serialize( iterator->first.second, output_stream );
+    Utilities::serialize( iterator->second.size(), output_stream );
+    for( const CachedContact& cached_contact : iterator->second )
+    {
+      MathUtilities::serialize( cached_contact.local_point, output_stream );
+      MathUtilities::serialize( cached_contact.r, output_stream );
+    }
+  }
+}
+
 void ConstraintCache::serialize( std::ostream& output_stream ) const
 {
   assert( output_stream.good() );
@@ -187,6 +344,13 @@ void ConstraintCache::serialize( std::ostream& output_stream ) const
   serializeCache( m_static_plane_sphere_constraint_cache, output_stream );
   serializeCache( m_static_cylinder_sphere_constraint_cache, output_stream );
   serializeCache( m_kinematic_sphere_sphere_constraint_cache, output_stream );
+  serializePointCache( m_body_body_constraint_cache, output_stream );
+  serializePointCache( m_kinematic_object_body_constraint_cache, output_stream );
+  serializePointCache( m_kinematic_object_sphere_constraint_cache, output_stream );
+  serializePointCache( m_static_plane_body_constraint_cache, output_stream );
+  serializePointCache( m_static_plane_box_constraint_cache, output_stream );
+  serializePointCache( m_static_cylinder_body_constraint_cache, output_stream );
+  serializePointCache( m_teleported_sphere_sphere_constraint_cache, output_stream );
 }
 
 static void deserializeCache( std::map<std::pair<unsigned,unsigned>,VectorXs>& constraint_cache, std::istream& input_stream )
@@ -206,6 +370,26 @@ static void deserializeCache( std::map<std::pair<unsigned,unsigned>,VectorXs>& c
   }
 }
 
+void ConstraintCache::deserializePointCache( PointContactCache& constraint_cache, std::istream& input_stream )
+{
+  assert( input_stream.good() );
+  constraint_cache.clear();
+  const PointContactCache::size_type npairs{ Utilities::deserialize<PointContactCache::size_type>( input_stream ) };
+  for( PointContactCache::size_type pair_num = 0; pair_num < npairs; ++pair_num )
+  {
+    const unsigned first_index{ Utilities::deserialize<unsigned>( input_stream ) };
+    const unsigned second_index{ Utilities::deserialize<unsigned>( input_stream ) };
+    std::vector<CachedContact>& contacts{ constraint_cache[ std::make_pair( first_index, second_index ) ] };
+    assert( contacts.empty() ); // Should not re-encounter pairs
+    contacts.resize( Utilities::deserialize<std::vector<CachedContact>::size_type>( input_stream ) );
+    for( CachedContact& cached_contact : contacts )
+    {
+      cached_contact.local_point = MathUtilities::deserialize<Vector3s>( input_stream );
+      cached_contact.r = MathUtilities::deserialize<VectorXs>( input_stream );
+    }
+  }
+}
+
 void ConstraintCache::deserialize( std::istream& input_stream )
 {
   assert( input_stream.good() );
@@ -217,4 +401,11 @@ void ConstraintCache::deserialize( std::istream& input_stream )
   deserializeCache( m_static_cylinder_sphere_constraint_cache, input_stream );
   m_kinematic_sphere_sphere_constraint_cache.clear();
   deserializeCache( m_kinematic_sphere_sphere_constraint_cache, input_stream );
+  deserializePointCache( m_body_body_constraint_cache, input_stream );
+  deserializePointCache( m_kinematic_object_body_constraint_cache, input_stream );
+  deserializePointCache( m_kinematic_object_sphere_constraint_cache, input_stream );
+  deserializePointCache( m_static_plane_body_constraint_cache, input_stream );
+  deserializePointCache( m_static_plane_box_constraint_cache, input_stream );
+  deserializePointCache( m_static_cylinder_body_constraint_cache, input_stream );
+  deserializePointCache( m_teleported_sphere_sphere_constraint_cache, input_stream );
 }
@@ -3,6 +3,10 @@
 
 #include "scisim/Math/MathDefines.h"
 
+#include <map>
+#include <string>
+#include <vector>
+
 class Constraint;
 
 class ConstraintCache final
@@ -10,21 +14,50 @@ class ConstraintCache final
 
 public:
 
-  void cacheConstraint( const Constraint& constraint, const VectorXs& r );
-  void getCachedConstraint( const Constraint& constraint, VectorXs& r ) const;
+  // q is the configuration the constraint was generated from. Sphere contacts are identified by
+  // the pair of objects involved. All other contacts can touch a pair of objects at several
+  // points, and are further identified by the contact point in the frame of the simulated body.
+  void cacheConstraint( const Constraint& constraint, const VectorXs& q, const VectorXs& r );
+  void getCachedConstraint( const Constraint& constraint, const VectorXs& q, VectorXs& r ) const;
   void clear();
   bool empty() const;
 
+  // Updates the cached contacts after the bodies are renumbered, with body i becoming body
+  // new_index[i]. Contacts between two bodies that are identified by the order of the bodies'
+  // indices are discarded if that order changes.
+  void renumberBodies( const std::vector<unsigned>& new_index );
+
   void serialize( std::ostream& output_stream ) const;
   void deserialize( std::istream& input_stream );
 
 private:
 
+  struct CachedContact final
+  {
+    Vector3s local_point;
+    VectorXs r;
+  };
+  using PointContactCache = std::map<std::pair<unsigned,unsigned>,std::vector<CachedContact>>;
+
+  PointContactCache* pointContactCache( const std::string& constraint_name );
+  const PointContactCache* pointContactCache( const std::string& constraint_name ) const;
+
+  static void serializePointCache( const PointContactCache& constraint_cache, std::ostream& output_stream );
+  static void deserializePointCache( PointContactCache& constraint_cache, std::istream& input_stream );
+
   std::map<std::pair<unsigned,unsigned>,VectorXs> m_sphere_sphere_constraint_cache;
   std::map<std::pair<unsigned,unsigned>,VectorXs> m_static_plane_sphere_constraint_cache;
   std::map<std::pair<unsigned,unsigned>,VectorXs> m_static_cylinder_sphere_constraint_cache;
   std::map<std::pair<unsigned,unsigned>,VectorXs> m_kinematic_sphere_sphere_constraint_cache;
 
+  PointContactCache m_body_body_constraint_cache;
+  PointContactCache m_kinematic_object_body_constraint_cache;
+  PointContactCache m_kinematic_object_sphere_constraint_cache;
+  PointContactCache m_static_plane_body_constraint_cache;
+  PointContactCache m_static_plane_box_constraint_cache;
+  PointContactCache m_static_cylinder_body_constraint_cache;
+  PointContactCache m_teleported_sphere_sphere_constraint_cache;
+
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include "BodyBodyConstraint.h"
 
 #include "FrictionUtilities.h"
+#include "scisim/Constraints/ContactBatch.h"
 
 #ifndef NDEBUG
 #include "scisim/Math/MathUtilities.h"
@@ -227,6 +228,12 @@ void BodyBodyConstraint::evalH( const VectorXs& q, const MatrixXXsc& basis, Matr
   H1.block<1,3>(2,3) = m_r1.cross( t );
 }
 
+bool BodyBodyConstraint::addToContactBatch( const VectorXs& q, ContactBatch& batch ) const
+{
+  batch.addContact( int( m_idx0 ), int( m_idx1 ), m_n, m_r0, m_r1, Vector3s::Zero(), true );
+  return true;
+}
+
 void BodyBodyConstraint::getBodyIndices( std::pair<int,int>& bodies ) const
 {
   this->getSimulatedBodyIndices( bodies );
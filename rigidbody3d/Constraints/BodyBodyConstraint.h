@@ -31,6 +31,7 @@ public:
   virtual void getSimulatedBodyIndices( std::pair<int,int>& bodies ) const override;
   virtual void evalKinematicNormalRelVel( const VectorXs& q, const int strt_idx, VectorXs& gdotN ) const override;
   virtual void evalH( const VectorXs& q, const MatrixXXsc& basis, MatrixXXsc& H0, MatrixXXsc& H1 ) const override;
+  virtual bool addToContactBatch( const VectorXs& q, ContactBatch& batch ) const override;
   virtual void getBodyIndices( std::pair<int,int>& bodies ) const override;
   virtual bool conservesTranslationalMomentum() const override;
   virtual bool conservesAngularMomentumUnderImpact() const override;
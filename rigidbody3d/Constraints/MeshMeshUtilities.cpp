@@ -11,55 +11,37 @@ void MeshMeshUtilities::computeActiveSet( const Vector3s& cm0, const Matrix33sr&
                                           const Vector3s& cm1, const Matrix33sr& R1, const RigidBodyTriangleMesh& mesh1,
                                           std::vector<Vector3s>& p, std::vector<Vector3s>& n )
 {
+  assert( p.size() == n.size() );
+
   // mesh0 against mesh1
   {
-    const Matrix3Xsc& samples0{ mesh0.samples() };
-    // Transformation to take points in mesh0 to mesh1
+    const std::vector<Vector3s>::size_type first_collision{ p.size() };
+    // Test the clusters of mesh0's samples that reach mesh1's distance field
     const Matrix3s R01{ R1.transpose() * R0 };
     const Vector3s x01{ R1.transpose() * ( cm0 - cm1 ) };
-    // For each surface sample of mesh0
-    for( int smp_num = 0; smp_num < samples0.cols(); ++smp_num )
+    mesh1.detectCollisions( R01, x01, mesh0.sampleHierarchy(), p, n );
+    // Transform the contact points and normals from mesh1's frame to world space
+    for( std::vector<Vector3s>::size_type col_num = first_collision; col_num < p.size(); ++col_num )
     {
-      // Transform mesh0's sample into mesh1's frame
-      const Vector3s x{ R01 * samples0.col( smp_num ) + x01 };
-      // Determine if a collision occurs
-      Vector3s normal;
-      const bool collision_occurs{ mesh1.detectCollision( x, normal ) };
-      // Cache out the world space collision point and normal if a collision happens
-      if( collision_occurs )
-      {
-        assert( fabs( normal.norm() - 1.0 ) <= 1.0e-6 );
-        assert( ( R1 * x + cm1 - R0 * samples0.col( smp_num ) - cm0 ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-        // Transform the contact point and normal from mesh1's frame to world space
-        p.emplace_back( R1 * x + cm1 );
-        n.emplace_back( R1 * normal );
-      }
+      assert( fabs( n[col_num].norm() - 1.0 ) <= 1.0e-6 );
+      p[col_num] = R1 * p[col_num] + cm1;
+      n[col_num] = R1 * n[col_num];
     }
   }
 
   // mesh1 against mesh0
   {
-    const Matrix3Xsc& samples1{ mesh1.samples() };
-    // Transformation to take points in mesh1 to mesh0
+    const std::vector<Vector3s>::size_type first_collision{ p.size() };
+    // Test the clusters of mesh1's samples that reach mesh0's distance field
     const Matrix3s R10{ R0.transpose() * R1 };
     const Vector3s x10{ R0.transpose() * ( cm1 - cm0 ) };
-    // For each surface sample of mesh1
-    for( int smp_num = 0; smp_num < samples1.cols(); ++smp_num )
+    mesh0.detectCollisions( R10, x10, mesh1.sampleHierarchy(), p, n );
+    // Transform the contact points and normals back to world space
+    for( std::vector<Vector3s>::size_type col_num = first_collision; col_num < p.size(); ++col_num )
     {
-      // Transform mesh1's sample into mesh0's frame
-      const Vector3s x{ R10 * samples1.col( smp_num ) + x10 };
-      // Determine if a collision occurs
-      Vector3s normal;
-      const bool collision_occurs{ mesh0.detectCollision( x, normal ) };
-      // Cache out the world space collision point and normal if a collision happens
-      if( collision_occurs )
-      {
-        assert( fabs( normal.norm() - 1.0 ) <= 1.0e-6 );
-        assert( ( R0 * x + cm0 - R1 * samples1.col( smp_num ) - cm1 ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-        // Transform the contact point and normal back to world space
-        p.emplace_back( R0 * x + cm0 );
-        n.emplace_back( - R0 * normal );
-      }
+      assert( fabs( n[col_num].norm() - 1.0 ) <= 1.0e-6 );
+      p[col_num] = R0 * p[col_num] + cm0;
+      n[col_num] = - R0 * n[col_num];
     }
   }
 }
@@ -1,6 +1,7 @@
 #include "SphereSphereConstraint.h"
 
 #include "FrictionUtilities.h"
+#include "scisim/Constraints/ContactBatch.h"
 
 #ifndef NDEBUG
 #include "scisim/Math/MathUtilities.h"
@@ -270,6 +271,13 @@ void SphereSphereConstraint::evalH( const VectorXs& q, const MatrixXXsc& basis,
   H1.block<1,3>(2,3) = rj.cross( t );
 }
 
+bool SphereSphereConstraint::addToContactBatch( const VectorXs& q, ContactBatch& batch ) const
+{
+  // n || r, so the normal impulse exerts no torque
+  batch.addContact( int( m_idx0 ), int( m_idx1 ), m_n, m_p - q.segment<3>( 3 * m_idx0 ), m_p - q.segment<3>( 3 * m_idx1 ), Vector3s::Zero(), false );
+  return true;
+}
+
 void SphereSphereConstraint::computeContactBasis( const VectorXs& q, const VectorXs& v, MatrixXXsc& basis ) const
 {
   assert( fabs( m_n.norm() - 1.0 ) <= 1.0e-6 );
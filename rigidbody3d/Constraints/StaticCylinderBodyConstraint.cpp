@@ -15,6 +15,7 @@ StaticCylinderBodyConstraint::StaticCylinderBodyConstraint( const unsigned body_
 : m_idx_body( body_index )
 , m_r( collision_point - q.segment<3>( 3 * body_index ) )
 , m_cyl( cyl )
+, m_idx_cyl( cylinder_index )
 {}
 
 scalar StaticCylinderBodyConstraint::evalNdotV( const VectorXs& q, const VectorXs& v ) const
@@ -37,6 +38,11 @@ void StaticCylinderBodyConstraint::getSimulatedBodyIndices( std::pair<int,int>&
   bodies.second = -1;
 }
 
+void StaticCylinderBodyConstraint::getBodyIndices( std::pair<int,int>& bodies ) const
+{
+  this->getSimulatedBodyIndices( bodies );
+}
+
 void StaticCylinderBodyConstraint::evalH( const VectorXs& q, const MatrixXXsc& basis, MatrixXXsc& H0, MatrixXXsc& H1 ) const
 {
   assert( H0.rows() == 3 );
@@ -81,6 +87,16 @@ std::string StaticCylinderBodyConstraint::name() const
   return "static_cylinder_body";
 }
 
+void StaticCylinderBodyConstraint::getWorldSpaceContactPoint( const VectorXs& q, VectorXs& contact_point ) const
+{
+  contact_point = q.segment<3>( 3 * m_idx_body ) + m_r;
+}
+
+unsigned StaticCylinderBodyConstraint::getStaticObjectIndex() const
+{
+  return m_idx_cyl;
+}
+
 Vector3s StaticCylinderBodyConstraint::computeN( const VectorXs& q ) const
 {
   const Vector3s x_body{ q.segment<3>( 3 * m_idx_body ) };
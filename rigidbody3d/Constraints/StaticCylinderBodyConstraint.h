@@ -21,12 +21,16 @@ public:
   virtual scalar evalNdotV( const VectorXs& q, const VectorXs& v ) const final override;
   virtual int impactStencilSize() const final override;
   virtual void getSimulatedBodyIndices( std::pair<int,int>& bodies ) const override;
+  virtual void getBodyIndices( std::pair<int,int>& bodies ) const override;
   virtual void evalH( const VectorXs& q, const MatrixXXsc& basis, MatrixXXsc& H0, MatrixXXsc& H1 ) const override;
   virtual bool conservesTranslationalMomentum() const final override;
   virtual bool conservesAngularMomentumUnderImpact() const final override;
   virtual bool conservesAngularMomentumUnderImpactAndFriction() const final override;
   virtual std::string name() const final override;
 
+  virtual void getWorldSpaceContactPoint( const VectorXs& q, VectorXs& contact_point ) const override;
+  virtual unsigned getStaticObjectIndex() const override;
+
 private:
 
   virtual void computeContactBasis( const VectorXs& q, const VectorXs& v, MatrixXXsc& basis ) const override;
@@ -46,6 +50,7 @@ private:
 
   // Cylinder involved in this collision
   const StaticCylinder& m_cyl;
+  const unsigned m_idx_cyl;
 
 };
 
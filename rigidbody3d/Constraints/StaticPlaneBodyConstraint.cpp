@@ -6,6 +6,7 @@
 #include "StaticPlaneBodyConstraint.h"
 
 #include "FrictionUtilities.h"
+#include "scisim/Constraints/ContactBatch.h"
 
 #ifndef NDEBUG
 #include "scisim/Math/MathUtilities.h"
@@ -203,6 +204,12 @@ void StaticPlaneBodyConstraint::evalH( const VectorXs& q, const MatrixXXsc& basi
   H0.block<1,3>(2,3) = m_r.cross( t );
 }
 
+bool StaticPlaneBodyConstraint::addToContactBatch( const VectorXs& q, ContactBatch& batch ) const
+{
+  batch.addContact( int( m_idx_body ), -1, m_n, m_r, Vector3s::Zero(), Vector3s::Zero(), true );
+  return true;
+}
+
 bool StaticPlaneBodyConstraint::conservesTranslationalMomentum() const
 {
   return false;
@@ -1,6 +1,7 @@
 #include "StaticPlaneSphereConstraint.h"
 
 #include "FrictionUtilities.h"
+#include "scisim/Constraints/ContactBatch.h"
 
 #include "rigidbody3d/StaticGeometry/StaticPlane.h"
 
@@ -222,6 +223,14 @@ void StaticPlaneSphereConstraint::evalH( const VectorXs& q, const MatrixXXsc& ba
   H0.block<1,3>(2,3) = r_world.cross( t );
 }
 
+bool StaticPlaneSphereConstraint::addToContactBatch( const VectorXs& q, ContactBatch& batch ) const
+{
+  assert( m_r >= 0.0 );
+  const Vector3s n{ m_plane.n() };
+  batch.addContact( int( m_sphere_idx ), -1, n, - m_r * n, Vector3s::Zero(), computePlaneCollisionPointVelocity( q ), false );
+  return true;
+}
+
 bool StaticPlaneSphereConstraint::conservesTranslationalMomentum() const
 {
   return false;
@@ -1,162 +1,25 @@
 #include "RigidBodyTriangleMesh.h"
 
-#include "scisim/Math/MathUtilities.h"
-#include "scisim/StringUtilities.h"
-#include "scisim/Utilities.h"
-
-#ifndef NDEBUG
-#include "rigidbody3d/Geometry/MomentTools.h"
-#endif
+#include "TriangleMeshCache.h"
+#include "TriangleMeshData.h"
 
-#ifdef USE_HDF5
-#include "scisim/HDF5File.h"
-#endif
-
-#include <iostream>
+#include "scisim/Utilities.h"
 
-// TODO: Make value return versions of HDF5 readMatrix
-// TODO: Call the HDF5 version from the thing below
+#include <algorithm>
+#include <numeric>
 
 RigidBodyTriangleMesh::RigidBodyTriangleMesh( const std::string& input_file_name )
-: m_input_file_name( input_file_name )
-, m_verts()
-, m_faces()
-, m_volume()
-, m_I_on_rho()
-, m_center_of_mass()
-, m_R()
-, m_samples()
-, m_convex_hull_samples()
-, m_cell_delta()
-, m_grid_dimensions()
-, m_grid_origin()
-, m_signed_distance()
-, m_grid_end()
-{
-  #ifdef USE_HDF5
-  HDF5File mesh_file( input_file_name, HDF5AccessType::READ_ONLY );
-
-  // Load the mesh
-  m_verts = mesh_file.read<Matrix3Xsc>( "mesh/vertices" );
-  m_faces = mesh_file.read<Matrix3Xuc>( "mesh/faces" );
-  assert( ( m_faces.array() < unsigned( m_verts.cols() ) ).all() );
-  // Verify that each vertex is part of a face
-  #ifndef NDEBUG
-  {
-    std::vector<bool> vertex_in_face( m_verts.cols(), false );
-    for( int fce_num = 0; fce_num < m_faces.cols(); ++fce_num )
-    {
-      vertex_in_face[m_faces(0,fce_num)] = true;
-      vertex_in_face[m_faces(1,fce_num)] = true;
-      vertex_in_face[m_faces(2,fce_num)] = true;
-    }
-    assert( std::all_of( vertex_in_face.cbegin(), vertex_in_face.cend(), [](const bool in_face){ return in_face; } ) );
-  }
-  #endif
-
-  // Load the moments
-  m_volume = mesh_file.read<scalar>( "moments/volume" );
-  assert( m_volume > 0.0 );
-  m_I_on_rho = mesh_file.read<Vector3s>( "moments/I_on_rho" );
-  assert( ( m_I_on_rho.array() > 0.0 ).all() );
-  m_center_of_mass = mesh_file.read<Vector3s>( "moments/x" );
-  m_R = mesh_file.read<Matrix3s>( "moments/R" );
-  assert( fabs( m_R.determinant() - 1.0 ) <= 1.0e-6 );
-  assert( ( m_R * m_R.transpose() - Eigen::Matrix3d::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-  // TODO: Remove these checks and the duplicated code
-  #ifndef NDEBUG
-  {
-    scalar volume_test;
-    Vector3s I_test;
-    Vector3s cm_test;
-    Matrix3s R_test;
-    MomentTools::computeMoments( m_verts, m_faces, volume_test, I_test, cm_test, R_test );
-    assert( fabs( volume_test - m_volume ) <= 1.0e-6 );
-    assert( ( I_test - m_I_on_rho ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-    assert( ( cm_test - Vector3s::Zero() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-    // TODO: Get the code so it doesn't try to rotate a diagonal again needlessly
-    //assert( ( R_test - Matrix3s::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-  }
-  #endif
-
-  // Load the surface samples
-  m_samples = mesh_file.read<Matrix3Xsc>( "surface_samples/samples" );
-
-  // Load the convex hull samples
-  m_convex_hull_samples = mesh_file.read<Matrix3Xsc>( "convex_hull/vertices" );
-
-  // Load the signed distance field
-  m_cell_delta = mesh_file.read<Vector3s>( "sdf/cell_delta" );
-  assert( ( m_cell_delta.array() > 0.0 ).all() );
-  m_grid_dimensions = mesh_file.read<Vector3u>( "sdf/grid_dimensions" );
-  assert( ( m_grid_dimensions.array() >= 1 ).all() );
-  m_grid_origin = mesh_file.read<Vector3s>( "sdf/grid_origin" );
-  m_signed_distance = mesh_file.read<VectorXs>( "sdf/signed_distance" );
-  if( !m_signed_distance.array().unaryExpr( []( const scalar& v ) { return std::isfinite( v ); } ).all() )
-  {
-    std::cerr << "Error, signed distance field for " << input_file_name << " is not finite. Please check the settings used to prcoess the mesh. Exiting." << std::endl;
-    std::exit( EXIT_FAILURE );
-  }
-
-  // For convienience, cache the opposite corner of the grid to the origin
-  m_grid_end = m_grid_origin + ( ( m_grid_dimensions.array() - 1 ).cast<scalar>() * m_cell_delta.array() ).matrix();
-  #else
-  std::cerr << "Error, loading rigid body triangle meshes requires HDF5 support. Please recompile with USE_HDF5=ON." << std::endl;
-  std::exit( EXIT_FAILURE );
-  #endif
-}
+: m_data( TriangleMeshCache::load( input_file_name ) )
+{}
 
 RigidBodyTriangleMesh::RigidBodyTriangleMesh( std::istream& input_stream )
-: m_input_file_name( StringUtilities::deserialize( input_stream ) )
-, m_verts( MathUtilities::deserialize<Matrix3Xsc>( input_stream ) )
-, m_faces( MathUtilities::deserialize<Matrix3Xuc>( input_stream ))
-, m_volume( Utilities::deserialize<scalar>( input_stream ) )
-, m_I_on_rho( MathUtilities::deserialize<Vector3s>( input_stream ) )
-, m_center_of_mass( MathUtilities::deserialize<Vector3s>( input_stream ) )
-, m_R( MathUtilities::deserialize<Matrix3s>( input_stream ) )
-, m_samples( MathUtilities::deserialize<Matrix3Xsc>( input_stream ) )
-, m_convex_hull_samples( MathUtilities::deserialize<Matrix3Xsc>( input_stream ) )
-, m_cell_delta( MathUtilities::deserialize<Vector3s>( input_stream ) )
-, m_grid_dimensions( MathUtilities::deserialize<Vector3u>( input_stream ) )
-, m_grid_origin( MathUtilities::deserialize<Vector3s>( input_stream ) )
-, m_signed_distance( MathUtilities::deserialize<VectorXs>( input_stream ) )
-, m_grid_end( MathUtilities::deserialize<Vector3s>( input_stream ) )
+: m_data( TriangleMeshCache::deserialize( input_stream ) )
+{}
+
+RigidBodyTriangleMesh::RigidBodyTriangleMesh( const std::shared_ptr<const TriangleMeshData>& data )
+: m_data( data )
 {
-  assert( ( m_faces.array() < unsigned( m_verts.cols() ) ).all() );
-  // Verify that each vertex is part of a face
-  #ifndef NDEBUG
-  {
-    std::vector<bool> vertex_in_face( m_verts.cols(), false );
-    for( int fce_num = 0; fce_num < m_faces.cols(); ++fce_num )
-    {
-      vertex_in_face[m_faces(0,fce_num)] = true;
-      vertex_in_face[m_faces(1,fce_num)] = true;
-      vertex_in_face[m_faces(2,fce_num)] = true;
-    }
-    assert( std::all_of( vertex_in_face.cbegin(), vertex_in_face.cend(), [](const bool in_face){ return in_face; } ) );
-  }
-  #endif
-  assert( m_volume > 0.0 );
-  assert( ( m_I_on_rho.array() > 0.0 ).all() );
-  assert( fabs( m_R.determinant() - 1.0 ) <= 1.0e-6 );
-  assert( ( m_R * m_R.transpose() - Eigen::Matrix3d::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-  // TODO: Remove these checks and the duplicated code
-  #ifndef NDEBUG
-  {
-    scalar volume_test;
-    Vector3s I_test;
-    Vector3s cm_test;
-    Matrix3s R_test;
-    MomentTools::computeMoments( m_verts, m_faces, volume_test, I_test, cm_test, R_test );
-    assert( fabs( volume_test - m_volume ) <= 1.0e-6 );
-    assert( ( I_test - m_I_on_rho ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-    assert( ( cm_test - Vector3s::Zero() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-    // TODO: Get the code so it doesn't try to rotate a diagonal again needlessly
-    //assert( ( R_test - Matrix3s::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-  }
-  #endif
-  assert( ( m_cell_delta.array() > 0.0 ).all() );
-  assert( ( m_grid_dimensions.array() >= 1 ).all() );
+  assert( m_data != nullptr );
 }
 
 RigidBodyGeometryType RigidBodyTriangleMesh::getType() const
@@ -166,22 +29,7 @@ RigidBodyGeometryType RigidBodyTriangleMesh::getType() const
 
 std::unique_ptr<RigidBodyGeometry> RigidBodyTriangleMesh::clone() const
 {
-  RigidBodyTriangleMesh* otherMesh = new RigidBodyTriangleMesh;
-  otherMesh->m_input_file_name = m_input_file_name;
-  otherMesh->m_verts = m_verts;
-  otherMesh->m_faces = m_faces;
-  otherMesh->m_volume = m_volume;
-  otherMesh->m_I_on_rho = m_I_on_rho;
-  otherMesh->m_center_of_mass = m_center_of_mass;
-  otherMesh->m_R = m_R;
-  otherMesh->m_samples = m_samples;
-  otherMesh->m_convex_hull_samples = m_convex_hull_samples;
-  otherMesh->m_cell_delta = m_cell_delta;
-  otherMesh->m_grid_dimensions = m_grid_dimensions;
-  otherMesh->m_grid_origin = m_grid_origin;
-  otherMesh->m_signed_distance = m_signed_distance;
-  otherMesh->m_grid_end = m_grid_end;
-  return std::unique_ptr<RigidBodyGeometry>{ otherMesh };
+  return std::unique_ptr<RigidBodyGeometry>{ new RigidBodyTriangleMesh{ m_data } };
 }
 
 void RigidBodyTriangleMesh::computeAABB( const Vector3s& cm, const Matrix33sr& R, Array3s& min, Array3s& max ) const
@@ -190,9 +38,10 @@ void RigidBodyTriangleMesh::computeAABB( const Vector3s& cm, const Matrix33sr& R
   max.setConstant( -std::numeric_limits<scalar>::infinity() );
 
   // For each vertex
-  for( int vrt_num = 0; vrt_num < m_verts.cols(); ++vrt_num )
+  const Matrix3Xsc& verts{ m_data->vertices() };
+  for( int vrt_num = 0; vrt_num < verts.cols(); ++vrt_num )
   {
-    const Array3s transformed_vertex{ R * m_verts.col( vrt_num ) + cm };
+    const Array3s transformed_vertex{ R * verts.col( vrt_num ) + cm };
     min = min.min( transformed_vertex );
     max = max.max( transformed_vertex );
   }
@@ -201,10 +50,10 @@ void RigidBodyTriangleMesh::computeAABB( const Vector3s& cm, const Matrix33sr& R
 
 void RigidBodyTriangleMesh::computeMassAndInertia( const scalar& density, scalar& M, Vector3s& CM, Vector3s& I, Matrix33sr& R ) const
 {
-  M = density * m_volume;
-  CM = m_center_of_mass;
-  I = density * m_I_on_rho;
-  R = m_R;
+  M = density * m_data->volume();
+  CM = m_data->centerOfMass();
+  I = density * m_data->IOnRho();
+  R = m_data->R();
 }
 
 std::string RigidBodyTriangleMesh::name() const
@@ -215,84 +64,172 @@ std::string RigidBodyTriangleMesh::name() const
 void RigidBodyTriangleMesh::serialize( std::ostream& output_stream ) const
 {
   Utilities::serialize( RigidBodyGeometryType::TRIANGLE_MESH, output_stream );
-  StringUtilities::serialize( m_input_file_name, output_stream );
-  MathUtilities::serialize( m_verts, output_stream );
-  MathUtilities::serialize( m_faces, output_stream );
-  Utilities::serialize( m_volume, output_stream );
-  MathUtilities::serialize( m_I_on_rho, output_stream );
-  MathUtilities::serialize( m_center_of_mass, output_stream );
-  MathUtilities::serialize( m_R, output_stream );
-  MathUtilities::serialize( m_samples, output_stream );
-  MathUtilities::serialize( m_convex_hull_samples, output_stream );
-  MathUtilities::serialize( m_cell_delta, output_stream );
-  MathUtilities::serialize( m_grid_dimensions, output_stream );
-  MathUtilities::serialize( m_grid_origin, output_stream );
-  MathUtilities::serialize( m_signed_distance, output_stream );
-  MathUtilities::serialize( m_grid_end, output_stream );
+  m_data->serialize( output_stream );
 }
 
 scalar RigidBodyTriangleMesh::volume() const
 {
-  return m_volume;
+  return m_data->volume();
 }
 
 const Matrix3Xsc& RigidBodyTriangleMesh::vertices() const
 {
-  return m_verts;
+  return m_data->vertices();
 }
 
 const Matrix3Xuc& RigidBodyTriangleMesh::faces() const
 {
-  return m_faces;
+  return m_data->faces();
 }
 
 const Matrix3Xsc& RigidBodyTriangleMesh::convexHullVertices() const
 {
-  return m_convex_hull_samples;
+  return m_data->convexHullSamples();
 }
 
 const std::string& RigidBodyTriangleMesh::inputFileName() const
 {
-  return m_input_file_name;
+  return m_data->inputFileName();
 }
 
 const Matrix3s& RigidBodyTriangleMesh::R() const
 {
-  return m_R;
+  return m_data->R();
 }
 
 const Matrix3Xsc& RigidBodyTriangleMesh::samples() const
 {
-  return m_samples;
+  return m_data->samples();
+}
+
+const SampleHierarchy& RigidBodyTriangleMesh::sampleHierarchy() const
+{
+  return m_data->sampleHierarchy();
+}
+
+const TriangleMeshData& RigidBodyTriangleMesh::data() const
+{
+  return *m_data;
 }
 
 const scalar& RigidBodyTriangleMesh::v( const unsigned i, const unsigned j, const unsigned k ) const
 {
-  assert( i < m_grid_dimensions.x() ); assert( j < m_grid_dimensions.y() ); assert( k < m_grid_dimensions.z() );
-  assert( ( k * m_grid_dimensions.y() + j ) * m_grid_dimensions.x() + i < m_signed_distance.size() );
-  return m_signed_distance( ( k * m_grid_dimensions.y() + j ) * m_grid_dimensions.x() + i );
+  const Vector3u& grid_dimensions{ m_data->gridDimensions() };
+  assert( i < grid_dimensions.x() ); assert( j < grid_dimensions.y() ); assert( k < grid_dimensions.z() );
+  assert( ( k * grid_dimensions.y() + j ) * grid_dimensions.x() + i < m_data->signedDistance().size() );
+  return m_data->signedDistance().data()[ ( k * grid_dimensions.y() + j ) * grid_dimensions.x() + i ];
 }
 
 bool RigidBodyTriangleMesh::detectCollision( const Vector3s& x, Vector3s& n ) const
 {
+  const Vector3s& grid_origin{ m_data->gridOrigin() };
+  const Vector3s& grid_end{ m_data->gridEnd() };
+
   // If the point lies outside the grid, no collisions are possible
-  if( ( x.array() < m_grid_origin.array() ).any() )
+  if( ( x.array() < grid_origin.array() ).any() )
   {
     return false;
   }
-  if( ( x.array() > m_grid_end.array() ).any() )
+  if( ( x.array() > grid_end.array() ).any() )
   {
     return false;
   }
-  assert( ( x.array() >= m_grid_origin.array() ).all() );
-  assert( ( x.array() <= m_grid_end.array() ).all() );
+
+  return detectCollisionInGrid( x, n );
+}
+
+// Samples are transformed in fixed size blocks that stay in cache, so the transform and bounds tests vectorize
+static constexpr int SAMPLE_BLOCK_SIZE{ 64 };
+
+void RigidBodyTriangleMesh::detectCollisions( const Matrix3s& R, const Vector3s& t, const Matrix3Xsc& samples, std::vector<Vector3s>& x, std::vector<Vector3s>& n ) const
+{
+  assert( x.size() == n.size() );
+  for( int first_sample = 0; first_sample < int( samples.cols() ); first_sample += SAMPLE_BLOCK_SIZE )
+  {
+    const int num_samples{ std::min( SAMPLE_BLOCK_SIZE, int( samples.cols() ) - first_sample ) };
+    detectCollisionsInBlock( R, t, samples, first_sample, num_samples, nullptr, x, n );
+  }
+}
+
+void RigidBodyTriangleMesh::detectCollisions( const Matrix3s& R, const Vector3s& t, const SampleHierarchy& samples, std::vector<Vector3s>& x, std::vector<Vector3s>& n ) const
+{
+  assert( x.size() == n.size() );
+
+  // Only leaves whose transformed boxes reach the grid are tested
+  std::vector<int> colliding_samples;
+  std::vector<Vector3s> leaf_x;
+  std::vector<Vector3s> leaf_n;
+  samples.visitOverlappingLeaves( R, t, m_data->gridOrigin().array(), m_data->gridEnd().array(),
+                                  [&]( const int first_sample, const int num_samples )
+                                  {
+                                    assert( num_samples <= SAMPLE_BLOCK_SIZE );
+                                    detectCollisionsInBlock( R, t, samples.samples(), first_sample, num_samples, &colliding_samples, leaf_x, leaf_n );
+                                  } );
+
+  // Report collisions in the order of the original samples
+  std::vector<std::vector<int>::size_type> order( colliding_samples.size() );
+  std::iota( order.begin(), order.end(), 0 );
+  std::sort( order.begin(), order.end(), [&]( const std::vector<int>::size_type a, const std::vector<int>::size_type b )
+                                         { return samples.originalIndex( colliding_samples[a] ) < samples.originalIndex( colliding_samples[b] ); } );
+  for( const std::vector<int>::size_type col_num : order )
+  {
+    x.emplace_back( leaf_x[col_num] );
+    n.emplace_back( leaf_n[col_num] );
+  }
+}
+
+void RigidBodyTriangleMesh::detectCollisionsInBlock( const Matrix3s& R, const Vector3s& t, const Matrix3Xsc& samples, const int first_sample, const int num_samples, std::vector<int>* colliding_samples, std::vector<Vector3s>& x, std::vector<Vector3s>& n ) const
+{
+  assert( num_samples > 0 ); assert( num_samples <= SAMPLE_BLOCK_SIZE );
+  assert( first_sample + num_samples <= samples.cols() );
+
+  const Array3s grid_origin{ m_data->gridOrigin() };
+  const Array3s grid_end{ m_data->gridEnd() };
+
+  using SampleBlock = Eigen::Matrix<scalar,3,Eigen::Dynamic,Eigen::ColMajor,3,SAMPLE_BLOCK_SIZE>;
+  const SampleBlock block{ ( R * samples.middleCols( first_sample, num_samples ) ).colwise() + t };
+
+  // Skip the whole block if its bounding box misses the grid
+  const Array3s block_min{ block.rowwise().minCoeff() };
+  const Array3s block_max{ block.rowwise().maxCoeff() };
+  if( ( block_max < grid_origin ).any() || ( block_min > grid_end ).any() )
+  {
+    return;
+  }
+
+  const Eigen::Array<bool,1,Eigen::Dynamic,Eigen::RowMajor,1,SAMPLE_BLOCK_SIZE> in_grid{ ( block.array() >= grid_origin.replicate( 1, num_samples ) ).colwise().all() && ( block.array() <= grid_end.replicate( 1, num_samples ) ).colwise().all() };
+  for( int smp_num = 0; smp_num < num_samples; ++smp_num )
+  {
+    if( !in_grid( smp_num ) )
+    {
+      continue;
+    }
+    Vector3s normal;
+    if( detectCollisionInGrid( block.col( smp_num ), normal ) )
+    {
+      if( colliding_samples != nullptr )
+      {
+        colliding_samples->emplace_back( first_sample + smp_num );
+      }
+      x.emplace_back( block.col( smp_num ) );
+      n.emplace_back( normal );
+    }
+  }
+}
+
+bool RigidBodyTriangleMesh::detectCollisionInGrid( const Vector3s& x, Vector3s& n ) const
+{
+  const Vector3s& grid_origin{ m_data->gridOrigin() };
+  const Vector3s& cell_delta{ m_data->cellDelta() };
+  assert( ( x.array() >= grid_origin.array() ).all() );
+  assert( ( x.array() <= m_data->gridEnd().array() ).all() );
 
   // Determine which cell this point lies within
-  const Array3u indices{ ( ( x - m_grid_origin ).array() / m_cell_delta.array() ).unaryExpr( [](const scalar& y) { return floor(y); } ).cast<unsigned>() };
-  assert( ( indices + 1 < m_grid_dimensions.array() ).all() );
+  const Array3u indices{ ( ( x - grid_origin ).array() / cell_delta.array() ).unaryExpr( [](const scalar& y) { return floor(y); } ).cast<unsigned>() };
+  assert( ( indices + 1 < m_data->gridDimensions().array() ).all() );
 
   // Compute the 'barycentric' coordinates of the point in the cell
-  const Vector3s bc{ ( x.array() - ( m_grid_origin.array() + indices.cast<scalar>().array() * m_cell_delta.array() ) ) / m_cell_delta.array() };
+  const Vector3s bc{ ( x.array() - ( grid_origin.array() + indices.cast<scalar>().array() * cell_delta.array() ) ) / cell_delta.array() };
   assert( ( bc.array() >= 0.0 ).all() ); assert( ( bc.array() <= 1.0 ).all() );
 
   // One minus the barycentric coordinates
@@ -327,7 +264,7 @@ bool RigidBodyTriangleMesh::detectCollision( const Vector3s& x, Vector3s& n ) co
   n.z() = bci.y() * ( bci.x() * ( v001 - v000 ) + bc.x() * ( v101 - v100 ) )
          + bc.y() * ( bci.x() * ( v011 - v010 ) + bc.x() * ( v111 - v110 ) );
 
-  n.array() /= m_cell_delta.array();
+  n.array() /= cell_delta.array();
   n.normalize();
   assert(std::fabs(n.norm() - 1.0) <= 1.0e-6);
 
@@ -1,26 +1,32 @@
 #ifndef RIGID_BODY_TRIANGLE_MESH
 #define RIGID_BODY_TRIANGLE_MESH
 
+#include <memory>
+#include <vector>
+
 #include "RigidBodyGeometry.h"
 
+class SampleHierarchy;
+class TriangleMeshData;
+
 class RigidBodyTriangleMesh final : public RigidBodyGeometry
 {
 
 public:
 
-  // TODO: Fix up constructors, custom copy not needed
-
-  // TODO: Move the reading of files to a support routine with sensible error checking
+  // Meshes loaded from the same file share their data through TriangleMeshCache
   #ifndef USE_HDF5
   [[noreturn]]
   #endif
   explicit RigidBodyTriangleMesh( const std::string& input_file_name );
 
+  // Deserialized meshes share their data with meshes loaded from the same file
   explicit RigidBodyTriangleMesh( std::istream& input_stream );
   virtual ~RigidBodyTriangleMesh() override = default;
 
   virtual RigidBodyGeometryType getType() const override;
 
+  // Clones share the mesh data
   virtual std::unique_ptr<RigidBodyGeometry> clone() const override;
 
   virtual void computeAABB( const Vector3s& cm, const Matrix33sr& R, Array3s& min, Array3s& max ) const override;
@@ -44,37 +50,35 @@ public:
   const Matrix3s& R() const;
   const Matrix3Xsc& samples() const;
 
+  const TriangleMeshData& data() const;
+
   // N.b: Sample point must be expressed in local frame of this body,
   // and if the point is inside the distance field, the returned normal
   // is expressed in the local frame
   bool detectCollision( const Vector3s& x, Vector3s& n ) const;
 
-private:
+  // Batched detectCollision for the sample points R * samples + t in the local frame of this body.
+  // Appends the local position and normal of each colliding point to x and n, in sample order.
+  void detectCollisions( const Matrix3s& R, const Vector3s& t, const Matrix3Xsc& samples, std::vector<Vector3s>& x, std::vector<Vector3s>& n ) const;
 
-  const scalar& v( const unsigned i, const unsigned j, const unsigned k ) const;
+  // As above, but clusters of samples that cannot reach the signed distance grid are culled as a whole
+  void detectCollisions( const Matrix3s& R, const Vector3s& t, const SampleHierarchy& samples, std::vector<Vector3s>& x, std::vector<Vector3s>& n ) const;
+
+  const SampleHierarchy& sampleHierarchy() const;
 
-  RigidBodyTriangleMesh() = default;
+private:
 
-  std::string m_input_file_name;
+  explicit RigidBodyTriangleMesh( const std::shared_ptr<const TriangleMeshData>& data );
 
-  // Note: These are not const because I don't have return value version of matrix reading from HDF5, yet
-  Matrix3Xsc m_verts;
-  Matrix3Xuc m_faces;
+  const scalar& v( const unsigned i, const unsigned j, const unsigned k ) const;
 
-  scalar m_volume;
-  Vector3s m_I_on_rho;
-  Vector3s m_center_of_mass;
-  Matrix3s m_R;
+  // Appends the collisions of samples [first_sample, first_sample + num_samples), and their columns if requested
+  void detectCollisionsInBlock( const Matrix3s& R, const Vector3s& t, const Matrix3Xsc& samples, const int first_sample, const int num_samples, std::vector<int>* colliding_samples, std::vector<Vector3s>& x, std::vector<Vector3s>& n ) const;
 
-  Matrix3Xsc m_samples;
-  Matrix3Xsc m_convex_hull_samples;
+  // Collision test for a point known to lie within the signed distance grid
+  bool detectCollisionInGrid( const Vector3s& x, Vector3s& n ) const;
 
-  Vector3s m_cell_delta;
-  Vector3u m_grid_dimensions;
-  Vector3s m_grid_origin;
-  VectorXs m_signed_distance;
-  // Derivable from the above quantities, just stored for convienience
-  Vector3s m_grid_end;
+  std::shared_ptr<const TriangleMeshData> m_data;
 
 };
 
@@ -0,0 +1,72 @@
+#include "SampleHierarchy.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Leaves hold at most this many samples
+static constexpr int MAX_LEAF_SIZE{ 32 };
+
+SampleHierarchy::SampleHierarchy()
+: m_nodes()
+, m_samples()
+, m_original_indices()
+{}
+
+SampleHierarchy::SampleHierarchy( const Matrix3Xsc& samples )
+: m_nodes()
+, m_samples( samples )
+, m_original_indices( std::size_t( samples.cols() ) )
+{
+  if( samples.cols() == 0 )
+  {
+    return;
+  }
+  std::iota( m_original_indices.begin(), m_original_indices.end(), 0 );
+  build( 0, int( samples.cols() ) );
+  // Gather the samples in leaf order
+  for( int smp_num = 0; smp_num < int( m_original_indices.size() ); ++smp_num )
+  {
+    m_samples.col( smp_num ) = samples.col( m_original_indices[smp_num] );
+  }
+}
+
+void SampleHierarchy::build( const int first, const int count )
+{
+  assert( count > 0 );
+
+  Array3s min{ Array3s::Constant( std::numeric_limits<scalar>::infinity() ) };
+  Array3s max{ Array3s::Constant( -std::numeric_limits<scalar>::infinity() ) };
+  for( int smp_num = first; smp_num < first + count; ++smp_num )
+  {
+    min = min.min( m_samples.col( m_original_indices[smp_num] ).array() );
+    max = max.max( m_samples.col( m_original_indices[smp_num] ).array() );
+  }
+
+  const int node_idx{ int( m_nodes.size() ) };
+  m_nodes.emplace_back( Node{ 0.5 * ( min + max ).matrix(), 0.5 * ( max - min ).matrix(), first, count, -1 } );
+  if( count <= MAX_LEAF_SIZE )
+  {
+    return;
+  }
+
+  // Split at the median along the longest axis of the box
+  int axis;
+  ( max - min ).maxCoeff( &axis );
+  const int left_count{ count / 2 };
+  std::nth_element( m_original_indices.begin() + first, m_original_indices.begin() + first + left_count, m_original_indices.begin() + first + count,
+                    [this,axis]( const int a, const int b ) { return m_samples( axis, a ) < m_samples( axis, b ); } );
+  build( first, left_count );
+  m_nodes[node_idx].right_child = int( m_nodes.size() );
+  build( first + left_count, count - left_count );
+}
+
+const Matrix3Xsc& SampleHierarchy::samples() const
+{
+  return m_samples;
+}
+
+int SampleHierarchy::originalIndex( const int sample ) const
+{
+  assert( sample >= 0 ); assert( sample < int( m_original_indices.size() ) );
+  return m_original_indices[sample];
+}
@@ -0,0 +1,83 @@
+#ifndef SAMPLE_HIERARCHY_H
+#define SAMPLE_HIERARCHY_H
+
+#include <cassert>
+#include <vector>
+
+#include "scisim/Math/MathDefines.h"
+
+// Bounding volume hierarchy over the surface samples of a mesh. Samples are stored grouped by leaf
+// so that each leaf is a contiguous block of columns, and subtrees whose boxes cannot reach a
+// query region are culled without touching their samples.
+class SampleHierarchy final
+{
+
+public:
+
+  SampleHierarchy();
+  explicit SampleHierarchy( const Matrix3Xsc& samples );
+
+  // Samples reordered so that each leaf is contiguous
+  const Matrix3Xsc& samples() const;
+
+  // Column of each reordered sample in the original sample matrix
+  int originalIndex( const int sample ) const;
+
+  // Calls visit( first, count ) for each leaf whose box, under x -> R * x + t, may intersect the box [min, max]
+  template<typename Visitor>
+  void visitOverlappingLeaves( const Matrix3s& R, const Vector3s& t, const Array3s& min, const Array3s& max, Visitor&& visit ) const
+  {
+    if( m_nodes.empty() )
+    {
+      return;
+    }
+    const Matrix3s abs_R{ R.cwiseAbs() };
+    int stack[64];
+    int stack_size{ 0 };
+    stack[stack_size++] = 0;
+    while( stack_size != 0 )
+    {
+      const int node_idx{ stack[--stack_size] };
+      const Node& node{ m_nodes[node_idx] };
+      // Box of the transformed node box
+      const Array3s center{ R * node.center + t };
+      const Array3s half_width{ abs_R * node.half_width };
+      if( ( center + half_width < min ).any() || ( center - half_width > max ).any() )
+      {
+        continue;
+      }
+      if( node.right_child < 0 )
+      {
+        visit( node.first, node.count );
+      }
+      else
+      {
+        assert( stack_size + 2 <= 64 );
+        stack[stack_size++] = node.right_child;
+        stack[stack_size++] = node_idx + 1;
+      }
+    }
+  }
+
+private:
+
+  struct Node final
+  {
+    Vector3s center;
+    Vector3s half_width;
+    // Range of samples below this node
+    int first;
+    int count;
+    // The left child immediately follows its parent, -1 for leaves
+    int right_child;
+  };
+
+  void build( const int first, const int count );
+
+  std::vector<Node> m_nodes;
+  Matrix3Xsc m_samples;
+  std::vector<int> m_original_indices;
+
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "TriangleMeshCache.h"
+
+#include "TriangleMeshData.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+static std::mutex s_cache_mutex;
+// Entries expire when the last mesh sharing their data is destroyed
+static std::map<std::string,std::weak_ptr<const TriangleMeshData>> s_cache;
+
+std::shared_ptr<const TriangleMeshData> TriangleMeshCache::load( const std::string& file_name )
+{
+  std::lock_guard<std::mutex> lock{ s_cache_mutex };
+  std::weak_ptr<const TriangleMeshData>& entry{ s_cache[file_name] };
+  std::shared_ptr<const TriangleMeshData> data{ entry.lock() };
+  if( data == nullptr )
+  {
+    data = std::make_shared<const TriangleMeshData>( file_name, signedDistanceFieldFileName( file_name ) );
+    entry = data;
+  }
+  return data;
+}
+
+std::shared_ptr<const TriangleMeshData> TriangleMeshCache::deserialize( std::istream& input_stream )
+{
+  std::shared_ptr<const TriangleMeshData> deserialized_data{ std::make_shared<const TriangleMeshData>( input_stream ) };
+  std::lock_guard<std::mutex> lock{ s_cache_mutex };
+  std::weak_ptr<const TriangleMeshData>& entry{ s_cache[deserialized_data->inputFileName()] };
+  std::shared_ptr<const TriangleMeshData> data{ entry.lock() };
+  if( data == nullptr )
+  {
+    data = std::move( deserialized_data );
+    entry = data;
+  }
+  return data;
+}
+
+std::string TriangleMeshCache::signedDistanceFieldFileName( const std::string& mesh_file_name )
+{
+  return mesh_file_name + ".sdf";
+}
+
+static constexpr char SDF_MAGIC[8]{ 'S', 'C', 'I', 'S', 'D', 'F', '\0', '\0' };
+static constexpr std::uint32_t SDF_VERSION{ 2 };
+
+// The values follow the header directly, so it must keep them aligned
+static_assert( sizeof( TriangleMeshCache::SignedDistanceFieldHeader ) % alignof( scalar ) == 0, "Signed distance field header misaligns the values" );
+
+// 64 bit FNV-1a hash of the contents of a file, zero if the file can not be read
+static std::uint64_t hashFile( const std::string& file_name )
+{
+  std::ifstream input_stream{ file_name, std::ios::binary };
+  if( !input_stream.is_open() )
+  {
+    return 0;
+  }
+  std::uint64_t hash{ 14695981039346656037ULL };
+  std::vector<char> buffer( 1 << 16 );
+  while( input_stream )
+  {
+    input_stream.read( buffer.data(), std::streamsize( buffer.size() ) );
+    const std::streamsize count{ input_stream.gcount() };
+    for( std::streamsize byte_idx = 0; byte_idx < count; ++byte_idx )
+    {
+      hash = ( hash ^ std::uint64_t( static_cast<unsigned char>( buffer[byte_idx] ) ) ) * 1099511628211ULL;
+    }
+  }
+  return input_stream.eof() ? hash : 0;
+}
+
+TriangleMeshCache::SignedDistanceFieldHeader TriangleMeshCache::signedDistanceFieldHeader( const TriangleMeshData& data )
+{
+  SignedDistanceFieldHeader header;
+  std::memset( &header, 0, sizeof( header ) );
+  std::memcpy( header.magic, SDF_MAGIC, sizeof( header.magic ) );
+  header.version = SDF_VERSION;
+  header.scalar_size = sizeof( scalar );
+  for( int axis = 0; axis < 3; ++axis )
+  {
+    header.grid_dimensions[axis] = data.gridDimensions()( axis );
+    header.grid_origin[axis] = data.gridOrigin()( axis );
+    header.cell_delta[axis] = data.cellDelta()( axis );
+  }
+  header.mesh_file_hash = hashFile( data.inputFileName() );
+  return header;
+}
+
+bool TriangleMeshCache::signedDistanceFieldHeaderMatches( const SignedDistanceFieldHeader& header, const TriangleMeshData& data )
+{
+  const SignedDistanceFieldHeader expected{ signedDistanceFieldHeader( data ) };
+  return expected.mesh_file_hash != 0 && std::memcmp( &header, &expected, sizeof( header ) ) == 0;
+}
+
+bool TriangleMeshCache::writeSignedDistanceField( const TriangleMeshData& data, const std::string& file_name )
+{
+  const Eigen::Map<const VectorXs> signed_distance{ data.signedDistance() };
+  // Mapped fields are not checked when loaded, so only finite fields are written
+  if( !signed_distance.array().unaryExpr( []( const scalar& v ) { return std::isfinite( v ); } ).all() )
+  {
+    std::cerr << "Signed distance field of " << data.inputFileName() << " is not finite, not writing: " << file_name << std::endl;
+    return false;
+  }
+
+  const SignedDistanceFieldHeader header{ signedDistanceFieldHeader( data ) };
+  if( header.mesh_file_hash == 0 )
+  {
+    std::cerr << "Failed to read mesh file " << data.inputFileName() << ", not writing: " << file_name << std::endl;
+    return false;
+  }
+
+  const std::string temporary_file_name{ file_name + ".tmp" };
+  {
+    std::ofstream output_stream{ temporary_file_name, std::ios::binary };
+    if( !output_stream.is_open() )
+    {
+      std::cerr << "Failed to open signed distance field file: " << temporary_file_name << std::endl;
+      return false;
+    }
+    output_stream.write( reinterpret_cast<const char*>( &header ), std::streamsize( sizeof( header ) ) );
+    output_stream.write( reinterpret_cast<const char*>( signed_distance.data() ), std::streamsize( signed_distance.size() * sizeof(scalar) ) );
+    output_stream.close();
+    if( !output_stream.good() )
+    {
+      std::cerr << "Failed to write signed distance field file: " << temporary_file_name << std::endl;
+      std::remove( temporary_file_name.c_str() );
+      return false;
+    }
+  }
+  if( std::rename( temporary_file_name.c_str(), file_name.c_str() ) != 0 )
+  {
+    std::cerr << "Failed to move " << temporary_file_name << " to " << file_name << std::endl;
+    std::remove( temporary_file_name.c_str() );
+    return false;
+  }
+  return true;
+}
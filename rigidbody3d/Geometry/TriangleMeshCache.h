@@ -0,0 +1,56 @@
+#ifndef TRIANGLE_MESH_CACHE_H
+#define TRIANGLE_MESH_CACHE_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include "scisim/Math/MathDefines.h"
+
+class TriangleMeshData;
+
+namespace TriangleMeshCache
+{
+
+  // Data of the mesh in the given HDF5 file. Each file is loaded once and its data is shared by all
+  // meshes that refer to it; the data is released when the last of those meshes is destroyed. If the
+  // file's signed distance field side file exists, the field is memory mapped from it.
+  std::shared_ptr<const TriangleMeshData> load( const std::string& file_name );
+
+  // Data of a serialized mesh. If the mesh's file is already loaded, the loaded data is shared and
+  // the serialized copy discarded; otherwise the serialized data is shared by later loads of the file.
+  std::shared_ptr<const TriangleMeshData> deserialize( std::istream& input_stream );
+
+  // Side file of a mesh: a SignedDistanceFieldHeader followed by the raw signed distance values,
+  // all in native byte order
+  std::string signedDistanceFieldFileName( const std::string& mesh_file_name );
+
+  // Describes the grid of a side file and the mesh file it was written from, so that a stale or
+  // foreign file is rejected without reading the values themselves
+  struct SignedDistanceFieldHeader final
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t scalar_size;
+    std::uint32_t grid_dimensions[3];
+    std::uint32_t reserved;
+    scalar grid_origin[3];
+    scalar cell_delta[3];
+    // Hash of the contents of the mesh file
+    std::uint64_t mesh_file_hash;
+  };
+
+  SignedDistanceFieldHeader signedDistanceFieldHeader( const TriangleMeshData& data );
+
+  // True if header was written by writeSignedDistanceField for a mesh with the same grid and mesh
+  // file contents as data
+  bool signedDistanceFieldHeaderMatches( const SignedDistanceFieldHeader& header, const TriangleMeshData& data );
+
+  // Writes the signed distance field of a mesh to the given file, returns false on failure or if
+  // the field is not finite. The file is replaced atomically, so meshes that map it are unaffected.
+  bool writeSignedDistanceField( const TriangleMeshData& data, const std::string& file_name );
+
+}
+
+#endif
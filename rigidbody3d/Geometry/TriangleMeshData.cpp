@@ -0,0 +1,292 @@
+#include "TriangleMeshData.h"
+
+#include "TriangleMeshCache.h"
+
+#include "scisim/Math/MathUtilities.h"
+#include "scisim/StringUtilities.h"
+#include "scisim/Utilities.h"
+
+#ifndef NDEBUG
+#include "rigidbody3d/Geometry/MomentTools.h"
+#endif
+
+#ifdef USE_HDF5
+#include "scisim/HDF5File.h"
+#endif
+
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TriangleMeshData::TriangleMeshData( const std::string& input_file_name, const std::string& signed_distance_file_name )
+: m_input_file_name( input_file_name )
+, m_verts()
+, m_faces()
+, m_volume()
+, m_I_on_rho()
+, m_center_of_mass()
+, m_R()
+, m_samples()
+, m_convex_hull_samples()
+, m_sample_hierarchy()
+, m_cell_delta()
+, m_grid_dimensions()
+, m_grid_origin()
+, m_signed_distance_storage()
+, m_mapped_signed_distance( nullptr )
+, m_mapped_size( 0 )
+, m_signed_distance( nullptr )
+, m_grid_end()
+{
+  #ifdef USE_HDF5
+  HDF5File mesh_file( input_file_name, HDF5AccessType::READ_ONLY );
+
+  // Load the mesh
+  m_verts = mesh_file.read<Matrix3Xsc>( "mesh/vertices" );
+  m_faces = mesh_file.read<Matrix3Xuc>( "mesh/faces" );
+
+  // Load the moments
+  m_volume = mesh_file.read<scalar>( "moments/volume" );
+  m_I_on_rho = mesh_file.read<Vector3s>( "moments/I_on_rho" );
+  m_center_of_mass = mesh_file.read<Vector3s>( "moments/x" );
+  m_R = mesh_file.read<Matrix3s>( "moments/R" );
+
+  // Load the surface samples
+  m_samples = mesh_file.read<Matrix3Xsc>( "surface_samples/samples" );
+  m_sample_hierarchy = SampleHierarchy{ m_samples };
+
+  // Load the convex hull samples
+  m_convex_hull_samples = mesh_file.read<Matrix3Xsc>( "convex_hull/vertices" );
+
+  // Load the signed distance field
+  m_cell_delta = mesh_file.read<Vector3s>( "sdf/cell_delta" );
+  m_grid_dimensions = mesh_file.read<Vector3u>( "sdf/grid_dimensions" );
+  m_grid_origin = mesh_file.read<Vector3s>( "sdf/grid_origin" );
+  // A mapped field is validated by its header alone, so that pages are only read when queried
+  const bool mapped{ !signed_distance_file_name.empty() && access( signed_distance_file_name.c_str(), R_OK ) == 0 && mapSignedDistance( signed_distance_file_name ) };
+  if( !mapped )
+  {
+    m_signed_distance_storage = mesh_file.read<VectorXs>( "sdf/signed_distance" );
+    m_signed_distance = m_signed_distance_storage.data();
+    if( !m_signed_distance_storage.array().unaryExpr( []( const scalar& v ) { return std::isfinite( v ); } ).all() )
+    {
+      std::cerr << "Error, signed distance field for " << input_file_name << " is not finite. Please check the settings used to prcoess the mesh. Exiting." << std::endl;
+      std::exit( EXIT_FAILURE );
+    }
+  }
+
+  // For convienience, cache the opposite corner of the grid to the origin
+  m_grid_end = m_grid_origin + ( ( m_grid_dimensions.array() - 1 ).cast<scalar>() * m_cell_delta.array() ).matrix();
+
+  checkMesh();
+  #else
+  std::cerr << "Error, loading rigid body triangle meshes requires HDF5 support. Please recompile with USE_HDF5=ON." << std::endl;
+  std::exit( EXIT_FAILURE );
+  #endif
+}
+
+TriangleMeshData::TriangleMeshData( std::istream& input_stream )
+: m_input_file_name( StringUtilities::deserialize( input_stream ) )
+, m_verts( MathUtilities::deserialize<Matrix3Xsc>( input_stream ) )
+, m_faces( MathUtilities::deserialize<Matrix3Xuc>( input_stream ))
+, m_volume( Utilities::deserialize<scalar>( input_stream ) )
+, m_I_on_rho( MathUtilities::deserialize<Vector3s>( input_stream ) )
+, m_center_of_mass( MathUtilities::deserialize<Vector3s>( input_stream ) )
+, m_R( MathUtilities::deserialize<Matrix3s>( input_stream ) )
+, m_samples( MathUtilities::deserialize<Matrix3Xsc>( input_stream ) )
+, m_convex_hull_samples( MathUtilities::deserialize<Matrix3Xsc>( input_stream ) )
+, m_sample_hierarchy( m_samples )
+, m_cell_delta( MathUtilities::deserialize<Vector3s>( input_stream ) )
+, m_grid_dimensions( MathUtilities::deserialize<Vector3u>( input_stream ) )
+, m_grid_origin( MathUtilities::deserialize<Vector3s>( input_stream ) )
+, m_signed_distance_storage( MathUtilities::deserialize<VectorXs>( input_stream ) )
+, m_mapped_signed_distance( nullptr )
+, m_mapped_size( 0 )
+, m_signed_distance( m_signed_distance_storage.data() )
+, m_grid_end( MathUtilities::deserialize<Vector3s>( input_stream ) )
+{
+  checkMesh();
+}
+
+TriangleMeshData::~TriangleMeshData()
+{
+  if( m_mapped_signed_distance != nullptr )
+  {
+    munmap( m_mapped_signed_distance, m_mapped_size );
+  }
+}
+
+void TriangleMeshData::checkMesh() const
+{
+  assert( ( m_faces.array() < unsigned( m_verts.cols() ) ).all() );
+  // Verify that each vertex is part of a face
+  #ifndef NDEBUG
+  {
+    std::vector<bool> vertex_in_face( m_verts.cols(), false );
+    for( int fce_num = 0; fce_num < m_faces.cols(); ++fce_num )
+    {
+      vertex_in_face[m_faces(0,fce_num)] = true;
+      vertex_in_face[m_faces(1,fce_num)] = true;
+      vertex_in_face[m_faces(2,fce_num)] = true;
+    }
+    assert( std::all_of( vertex_in_face.cbegin(), vertex_in_face.cend(), [](const bool in_face){ return in_face; } ) );
+  }
+  #endif
+  assert( m_volume > 0.0 );
+  assert( ( m_I_on_rho.array() > 0.0 ).all() );
+  assert( fabs( m_R.determinant() - 1.0 ) <= 1.0e-6 );
+  assert( ( m_R * m_R.transpose() - Eigen::Matrix3d::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
+  // The stored moments match those of the surface, which is stored in its principal frame
+  #ifndef NDEBUG
+  {
+    scalar volume_test;
+    Vector3s I_test;
+    Vector3s cm_test;
+    Matrix3s R_test;
+    MomentTools::computeMoments( m_verts, m_faces, volume_test, I_test, cm_test, R_test );
+    assert( fabs( volume_test - m_volume ) <= 1.0e-6 );
+    assert( ( I_test - m_I_on_rho ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
+    assert( ( cm_test - Vector3s::Zero() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
+    // R_test is not compared: the eigensolver only recovers the principal axes up to their order
+    // and sign, and up to any rotation among axes with equal moments
+  }
+  #endif
+  assert( ( m_cell_delta.array() > 0.0 ).all() );
+  assert( ( m_grid_dimensions.array() >= 1 ).all() );
+  assert( m_signed_distance != nullptr );
+  assert( signedDistance().size() == Eigen::Index( m_grid_dimensions.x() ) * Eigen::Index( m_grid_dimensions.y() ) * Eigen::Index( m_grid_dimensions.z() ) );
+}
+
+bool TriangleMeshData::mapSignedDistance( const std::string& signed_distance_file_name )
+{
+  using Header = TriangleMeshCache::SignedDistanceFieldHeader;
+  const std::size_t expected_size{ sizeof( Header ) + std::size_t( m_grid_dimensions.x() ) * m_grid_dimensions.y() * m_grid_dimensions.z() * sizeof(scalar) };
+  const int file_descriptor{ open( signed_distance_file_name.c_str(), O_RDONLY ) };
+  if( file_descriptor < 0 )
+  {
+    std::cerr << "Warning, failed to open signed distance field file " << signed_distance_file_name << ", reading the field from " << m_input_file_name << " instead." << std::endl;
+    return false;
+  }
+  struct stat file_status;
+  Header header;
+  if( fstat( file_descriptor, &file_status ) != 0 || std::size_t( file_status.st_size ) != expected_size
+      || pread( file_descriptor, &header, sizeof( header ), 0 ) != ssize_t( sizeof( header ) ) || !TriangleMeshCache::signedDistanceFieldHeaderMatches( header, *this ) )
+  {
+    close( file_descriptor );
+    std::cerr << "Warning, signed distance field file " << signed_distance_file_name << " does not match " << m_input_file_name << ", reading the field from the mesh file instead." << std::endl;
+    return false;
+  }
+  void* const mapped_signed_distance{ mmap( nullptr, expected_size, PROT_READ, MAP_SHARED, file_descriptor, 0 ) };
+  close( file_descriptor );
+  if( mapped_signed_distance == MAP_FAILED )
+  {
+    std::cerr << "Warning, failed to map signed distance field file " << signed_distance_file_name << ", reading the field from " << m_input_file_name << " instead." << std::endl;
+    return false;
+  }
+  m_mapped_signed_distance = mapped_signed_distance;
+  m_mapped_size = expected_size;
+  m_signed_distance = reinterpret_cast<const scalar*>( static_cast<const char*>( m_mapped_signed_distance ) + sizeof( Header ) );
+  return true;
+}
+
+void TriangleMeshData::serialize( std::ostream& output_stream ) const
+{
+  StringUtilities::serialize( m_input_file_name, output_stream );
+  MathUtilities::serialize( m_verts, output_stream );
+  MathUtilities::serialize( m_faces, output_stream );
+  Utilities::serialize( m_volume, output_stream );
+  MathUtilities::serialize( m_I_on_rho, output_stream );
+  MathUtilities::serialize( m_center_of_mass, output_stream );
+  MathUtilities::serialize( m_R, output_stream );
+  MathUtilities::serialize( m_samples, output_stream );
+  MathUtilities::serialize( m_convex_hull_samples, output_stream );
+  MathUtilities::serialize( m_cell_delta, output_stream );
+  MathUtilities::serialize( m_grid_dimensions, output_stream );
+  MathUtilities::serialize( m_grid_origin, output_stream );
+  MathUtilities::serialize( signedDistance(), output_stream );
+  MathUtilities::serialize( m_grid_end, output_stream );
+}
+
+const std::string& TriangleMeshData::inputFileName() const
+{
+  return m_input_file_name;
+}
+
+const Matrix3Xsc& TriangleMeshData::vertices() const
+{
+  return m_verts;
+}
+
+const Matrix3Xuc& TriangleMeshData::faces() const
+{
+  return m_faces;
+}
+
+const scalar& TriangleMeshData::volume() const
+{
+  return m_volume;
+}
+
+const Vector3s& TriangleMeshData::IOnRho() const
+{
+  return m_I_on_rho;
+}
+
+const Vector3s& TriangleMeshData::centerOfMass() const
+{
+  return m_center_of_mass;
+}
+
+const Matrix3s& TriangleMeshData::R() const
+{
+  return m_R;
+}
+
+const Matrix3Xsc& TriangleMeshData::samples() const
+{
+  return m_samples;
+}
+
+const Matrix3Xsc& TriangleMeshData::convexHullSamples() const
+{
+  return m_convex_hull_samples;
+}
+
+const SampleHierarchy& TriangleMeshData::sampleHierarchy() const
+{
+  return m_sample_hierarchy;
+}
+
+const Vector3s& TriangleMeshData::cellDelta() const
+{
+  return m_cell_delta;
+}
+
+const Vector3u& TriangleMeshData::gridDimensions() const
+{
+  return m_grid_dimensions;
+}
+
+const Vector3s& TriangleMeshData::gridOrigin() const
+{
+  return m_grid_origin;
+}
+
+const Vector3s& TriangleMeshData::gridEnd() const
+{
+  return m_grid_end;
+}
+
+Eigen::Map<const VectorXs> TriangleMeshData::signedDistance() const
+{
+  const Eigen::Index size{ m_mapped_signed_distance != nullptr ? Eigen::Index( ( m_mapped_size - sizeof( TriangleMeshCache::SignedDistanceFieldHeader ) ) / sizeof(scalar) ) : m_signed_distance_storage.size() };
+  return Eigen::Map<const VectorXs>{ m_signed_distance, size };
+}
+
+bool TriangleMeshData::signedDistanceIsMapped() const
+{
+  return m_mapped_signed_distance != nullptr;
+}
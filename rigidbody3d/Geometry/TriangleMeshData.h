@@ -0,0 +1,94 @@
+#ifndef TRIANGLE_MESH_DATA_H
+#define TRIANGLE_MESH_DATA_H
+
+#include <iosfwd>
+#include <string>
+
+#include "scisim/Math/MathDefines.h"
+#include "SampleHierarchy.h"
+
+// Data of a triangle mesh that does not change once loaded: the surface, moments, samples, and signed
+// distance field. Meshes loaded from the same file share one instance through TriangleMeshCache.
+class TriangleMeshData final
+{
+
+public:
+
+  // Loads the mesh from an HDF5 file. If signed_distance_file_name names an existing side file, as
+  // written by TriangleMeshCache::writeSignedDistanceField, the signed distance field is memory
+  // mapped from that file rather than read from the mesh file. Only the header of the side file is
+  // checked, so pages of the field are read as they are queried. A side file that does not match
+  // the mesh file, or can not be mapped, is ignored with a warning.
+  #ifndef USE_HDF5
+  [[noreturn]]
+  #endif
+  TriangleMeshData( const std::string& input_file_name, const std::string& signed_distance_file_name );
+
+  explicit TriangleMeshData( std::istream& input_stream );
+
+  ~TriangleMeshData();
+
+  TriangleMeshData( const TriangleMeshData& ) = delete;
+  TriangleMeshData( TriangleMeshData&& ) = delete;
+  TriangleMeshData& operator=( const TriangleMeshData& ) = delete;
+  TriangleMeshData& operator=( TriangleMeshData&& ) = delete;
+
+  void serialize( std::ostream& output_stream ) const;
+
+  const std::string& inputFileName() const;
+
+  const Matrix3Xsc& vertices() const;
+  const Matrix3Xuc& faces() const;
+
+  const scalar& volume() const;
+  const Vector3s& IOnRho() const;
+  const Vector3s& centerOfMass() const;
+  const Matrix3s& R() const;
+
+  const Matrix3Xsc& samples() const;
+  const Matrix3Xsc& convexHullSamples() const;
+  const SampleHierarchy& sampleHierarchy() const;
+
+  const Vector3s& cellDelta() const;
+  const Vector3u& gridDimensions() const;
+  const Vector3s& gridOrigin() const;
+  const Vector3s& gridEnd() const;
+  Eigen::Map<const VectorXs> signedDistance() const;
+
+  // True if the signed distance field is memory mapped from a side file
+  bool signedDistanceIsMapped() const;
+
+private:
+
+  void checkMesh() const;
+  bool mapSignedDistance( const std::string& signed_distance_file_name );
+
+  std::string m_input_file_name;
+
+  Matrix3Xsc m_verts;
+  Matrix3Xuc m_faces;
+
+  scalar m_volume;
+  Vector3s m_I_on_rho;
+  Vector3s m_center_of_mass;
+  Matrix3s m_R;
+
+  Matrix3Xsc m_samples;
+  Matrix3Xsc m_convex_hull_samples;
+  // Derived from the surface samples, not serialized
+  SampleHierarchy m_sample_hierarchy;
+
+  Vector3s m_cell_delta;
+  Vector3u m_grid_dimensions;
+  Vector3s m_grid_origin;
+  // Signed distance values, either in m_signed_distance_storage or in a mapped file
+  VectorXs m_signed_distance_storage;
+  void* m_mapped_signed_distance;
+  std::size_t m_mapped_size;
+  const scalar* m_signed_distance;
+  // Derivable from the above quantities, just stored for convienience
+  Vector3s m_grid_end;
+
+};
+
+#endif
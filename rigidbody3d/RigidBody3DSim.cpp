@@ -1,11 +1,18 @@
 #include "RigidBody3DSim.h"
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
 
 #include "scisim/UnconstrainedMaps/UnconstrainedMap.h"
 #include "scisim/ConstrainedMaps/ImpactFrictionMap.h"
+#include "scisim/Checkpoint.h"
 #include "scisim/Utilities.h"
 #include "scisim/Math/Rational.h"
+#include "scisim/Math/SpaceFillingCurve.h"
+#include "scisim/Timer/Profiler.h"
 #include "Forces/Force.h"
 #include "Geometry/RigidBodyBox.h"
 #include "Geometry/RigidBodySphere.h"
@@ -26,6 +33,7 @@
 #include "Constraints/KinematicObjectBodyConstraint.h"
 #include "Constraints/CollisionUtilities.h"
 #include "StaticGeometry/StaticCylinder.h"
+#include "StaticGeometry/StaticPlane.h"
 #include "UnconstrainedMaps/IntegrationTools.h"
 #include "SpatialGridDetector.h"
 #include "Portals/PlanarPortal.h"
@@ -163,7 +171,8 @@ unsigned RigidBody3DSim::ambientSpaceDimensions() const
 bool RigidBody3DSim::isKinematicallyScripted( const int i ) const
 {
   assert( i >= 0 ); assert( nvdofs() % 3 == 0 ); assert( i < nvdofs() / 3 );
-  return m_sim_state.isKinematicallyScripted( i );
+  // Sleeping bodies are held in place like scripted bodies until their island wakes
+  return m_sim_state.isKinematicallyScripted( i ) || m_sim_state.sleepingBodies().isAsleep( i );
 }
 
 void RigidBody3DSim::computeForce( const VectorXs& q, const VectorXs& v, const scalar& t, VectorXs& F )
@@ -195,7 +204,7 @@ void RigidBody3DSim::zeroOutForcesOnFixedBodies( VectorXs& F ) const
 
 void RigidBody3DSim::linearInertialConfigurationUpdate( const VectorXs& q0, const VectorXs& v0, const scalar& dt, VectorXs& q1 ) const
 {
-  IntegrationTools::exponentialEuler( q0, v0, m_sim_state.fixed(), dt, q1 );
+  IntegrationTools::exponentialEuler( q0, v0, m_sim_state.sleepingBodies().heldBodies(), dt, q1 );
 }
 
 const SparseMatrixsc& RigidBody3DSim::M() const
@@ -252,13 +261,23 @@ void RigidBody3DSim::computeActiveSet( const VectorXs& q0, const VectorXs& qp, c
   assert( q0.size() == qp.size() );
   assert( active_set.empty() );
 
+  detectCollisions( q0, qp, true, active_set );
+  recordContacts( active_set );
+  m_contact_batch.build( q0, active_set );
+}
+
+void RigidBody3DSim::detectCollisions( const VectorXs& q0, const VectorXs& q1, const bool wake_touched_islands, std::vector<std::unique_ptr<Constraint>>& active_set )
+{
   // Detect body-body collisions
-  computeActiveSetBodyBodySpatialGrid( q0, qp, active_set );
+  computeActiveSetBodyBodySpatialGrid( q0, q1, wake_touched_islands, active_set );
 
-  // Detect body-plane collisions
-  computeBodyPlaneActiveSetAllPairs( q0, qp, active_set );
-  // Detect body-cylinder collisions
-  computeBodyCylinderActiveSetAllPairs( q0, qp, active_set );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::NARROW_PHASE };
+    // Detect body-plane collisions
+    computeBodyPlaneActiveSetAllPairs( q0, q1, active_set );
+    // Detect body-cylinder collisions
+    computeBodyCylinderActiveSetAllPairs( q0, q1, active_set );
+  }
 }
 
 void RigidBody3DSim::computeImpactBases( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& impact_bases ) const
@@ -276,6 +295,13 @@ void RigidBody3DSim::computeImpactBases( const VectorXs& q, const std::vector<st
 
 void RigidBody3DSim::computeContactBases( const VectorXs& q, const VectorXs& v, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& contact_bases ) const
 {
+  const ContactBatch* const contact_batch{ contactBatch( q, active_set ) };
+  if( contact_batch != nullptr )
+  {
+    contact_batch->computeBases( v, contact_bases );
+    return;
+  }
+
   const unsigned ncols{ static_cast<unsigned>( active_set.size() ) };
   contact_bases.resize( 3, 3 * ncols );
   for( unsigned col_num = 0; col_num < ncols; ++col_num )
@@ -289,6 +315,15 @@ void RigidBody3DSim::computeContactBases( const VectorXs& q, const VectorXs& v,
   }
 }
 
+const ContactBatch* RigidBody3DSim::contactBatch( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set ) const
+{
+  if( active_set.empty() || !m_contact_batch.matches( q, active_set ) )
+  {
+    return nullptr;
+  }
+  return &m_contact_batch;
+}
+
 void RigidBody3DSim::clearConstraintCache()
 {
   m_constraint_cache.clear();
@@ -296,12 +331,12 @@ void RigidBody3DSim::clearConstraintCache()
 
 void RigidBody3DSim::cacheConstraint( const Constraint& constraint, const VectorXs& r )
 {
-  m_constraint_cache.cacheConstraint( constraint, r );
+  m_constraint_cache.cacheConstraint( constraint, m_sim_state.q(), r );
 }
 
 void RigidBody3DSim::getCachedConstraintImpulse( const Constraint& constraint, VectorXs& r ) const
 {
-  m_constraint_cache.getCachedConstraint( constraint, r );
+  m_constraint_cache.getCachedConstraint( constraint, m_sim_state.q(), r );
 }
 
 bool RigidBody3DSim::constraintCacheEmpty() const
@@ -314,8 +349,9 @@ void RigidBody3DSim::computeNumberOfCollisions( std::map<std::string,unsigned>&
   collision_counts.clear();
   collision_depths.clear();
   overlap_volumes.clear();
+  // Counting collisions must not change which bodies sleep
   std::vector<std::unique_ptr<Constraint>> active_set;
-  computeActiveSet( m_sim_state.q(), m_sim_state.q(), m_sim_state.v(), active_set );
+  detectCollisions( m_sim_state.q(), m_sim_state.q(), false, active_set );
   for( const std::unique_ptr<Constraint>& constraint : active_set )
   {
     const std::string constraint_name{ constraint->name() };
@@ -390,6 +426,7 @@ void RigidBody3DSim::runBoundaryExitTreatment() const
 
 void RigidBody3DSim::treatSimulationBoundary()
 {
+  const ProfilerScope profiler_scope{ ProfilerTimer::BOUNDARY };
   switch( m_sim_state.boundaryBehavior() )
   {
     case SimBoundaryBehavior::NONE:
@@ -404,8 +441,33 @@ void RigidBody3DSim::treatSimulationBoundary()
   }
 }
 
+void RigidBody3DSim::renumberBodies()
+{
+  std::vector<unsigned> order;
+  SpaceFillingCurve::computeMortonOrder3D( m_sim_state.q().segment( 0, 3 * m_sim_state.nbodies() ), order );
+  std::vector<unsigned> new_index;
+  SpaceFillingCurve::invertOrder( order, new_index );
+
+  m_sim_state.permuteBodies( order );
+  m_constraint_cache.renumberBodies( new_index );
+  // The broad phase only caches data derived from the state
+  m_broad_phase.clear();
+  m_aabb_of_sleeping_body.clear();
+}
+
+void RigidBody3DSim::renumberBodiesIfScheduled( const unsigned iteration )
+{
+  const unsigned frequency{ m_sim_state.renumberingFrequency() };
+  if( frequency != 0 && iteration % frequency == 0 )
+  {
+    renumberBodies();
+  }
+}
+
 void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration, const Rational<std::intmax_t>& dt, UnconstrainedMap& umap )
 {
+  renumberBodiesIfScheduled( iteration );
+
   call_back.setState( m_sim_state );
   call_back.startOfStepCallback( iteration, dt );
   call_back.forgetState();
@@ -437,6 +499,8 @@ void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration,
 
   umap.flow( m_sim_state.q(), m_sim_state.v(), *this, iteration, scalar( dt ), q1, v1 );
 
+  updateSleepingBodies( v1 );
+
   q1.swap( m_sim_state.q() );
   v1.swap( m_sim_state.v() );
   m_sim_state.updateMandMinv();
@@ -481,6 +545,8 @@ void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration,
 
 void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration, const Rational<std::intmax_t>& dt, UnconstrainedMap& umap, ImpactOperator& imap, const scalar& CoR )
 {
+  renumberBodiesIfScheduled( iteration );
+
   call_back.setState( m_sim_state );
   call_back.startOfStepCallback( iteration, dt );
   call_back.forgetState();
@@ -512,6 +578,8 @@ void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration,
 
   m_impact_map.flow( call_back, *this, *this, umap, imap, iteration, scalar( dt ), CoR, m_sim_state.q(), m_sim_state.v(), q1, v1 );
 
+  updateSleepingBodies( v1 );
+
   q1.swap( m_sim_state.q() );
   v1.swap( m_sim_state.v() );
   m_sim_state.updateMandMinv();
@@ -556,6 +624,8 @@ void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration,
 
 void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration, const Rational<std::intmax_t>& dt, UnconstrainedMap& umap, const scalar& CoR, const scalar& mu, FrictionSolver& solver, ImpactFrictionMap& ifmap )
 {
+  renumberBodiesIfScheduled( iteration );
+
   call_back.setState( m_sim_state );
   call_back.startOfStepCallback( iteration, dt );
   call_back.forgetState();
@@ -587,6 +657,8 @@ void RigidBody3DSim::flow( PythonScripting& call_back, const unsigned iteration,
 
   ifmap.flow( call_back, *this, *this, umap, solver, iteration, scalar( dt ), CoR, mu, m_sim_state.q(), m_sim_state.v(), q1, v1 );
 
+  updateSleepingBodies( v1 );
+
   q1.swap( m_sim_state.q() );
   v1.swap( m_sim_state.v() );
   m_sim_state.updateMandMinv();
@@ -641,6 +713,7 @@ RigidBody3DState& RigidBody3DSim::state()
 
 void RigidBody3DSim::enforcePeriodicBoundaryConditions()
 {
+  const ProfilerScope profiler_scope{ ProfilerTimer::BOUNDARY };
   const unsigned nbodies{ m_sim_state.nbodies() };
 
   // For each portal
@@ -820,9 +893,10 @@ void RigidBody3DSim::sphereSphereNarrowPhaseCollision( const unsigned first_body
 
 void RigidBody3DSim::stapleStapleNarrowPhaseCollision( const unsigned first_body, const unsigned second_body, const RigidBodyStaple& staple0, const RigidBodyStaple& staple1, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const
 {
+  assert( !isKinematicallyScripted( first_body ) ); // Sleeping rigid body should be listed second
   // TODO: Staple-staple kinematic collisions not currently supported
-  assert( !isKinematicallyScripted( first_body ) );
-  assert( !isKinematicallyScripted( second_body) );
+  assert( !m_sim_state.isKinematicallyScripted( first_body ) );
+  assert( !m_sim_state.isKinematicallyScripted( second_body ) );
 
   const Matrix33sr R0{ Eigen::Map<const Matrix33sr>{ q1.segment<9>( 3 * m_sim_state.nbodies() + 9 * first_body ).data() } };
   const Matrix33sr R1{ Eigen::Map<const Matrix33sr>{ q1.segment<9>( 3 * m_sim_state.nbodies() + 9 * second_body ).data() } };
@@ -834,9 +908,20 @@ void RigidBody3DSim::stapleStapleNarrowPhaseCollision( const unsigned first_body
     std::vector<Vector3s> n;
     StapleStapleUtilities::computeConstraints( q1.segment<3>( 3 * first_body ), R0, staple0, q1.segment<3>( 3 * second_body ), R1, staple1, p, n );
     assert( p.size() == n.size() );
-    for( std::vector<Vector3s>::size_type i = 0; i < p.size(); ++i )
+    // A sleeping staple is held in place like a kinematic body until its island wakes
+    if( !isKinematicallyScripted( second_body ) )
     {
-      active_set.emplace_back( new BodyBodyConstraint{ first_body, second_body, p[i], n[i], q0 } );
+      for( std::vector<Vector3s>::size_type i = 0; i < p.size(); ++i )
+      {
+        active_set.emplace_back( new BodyBodyConstraint{ first_body, second_body, p[i], n[i], q0 } );
+      }
+    }
+    else
+    {
+      for( std::vector<Vector3s>::size_type i = 0; i < p.size(); ++i )
+      {
+        active_set.emplace_back( new KinematicObjectBodyConstraint{ first_body, second_body, p[i], n[i], q0 } );
+      }
     }
   }
 }
@@ -961,6 +1046,41 @@ void RigidBody3DSim::dispatchNarrowPhaseCollision( const unsigned first_body, co
   std::exit(EXIT_FAILURE);
 }
 
+void RigidBody3DSim::dispatchNarrowPhaseCollisions( const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const
+{
+  const ProfilerScope profiler_scope{ ProfilerTimer::NARROW_PHASE };
+  const unsigned nbodies{ m_sim_state.nbodies() };
+
+  // Split the pairs into fixed size chunks, each with its own constraint buffer. Concatenating the buffers
+  // in chunk order reproduces the serial ordering of the constraints for any number of threads.
+  constexpr unsigned chunk_size{ 64 };
+  const unsigned num_chunks{ unsigned( ( possible_overlaps.size() + chunk_size - 1 ) / chunk_size ) };
+  std::vector<std::vector<std::unique_ptr<Constraint>>> chunk_active_sets( num_chunks );
+
+  // Narrow phase cost varies widely between geometry types, so balance the chunks dynamically
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule( dynamic )
+  #endif
+  for( unsigned chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx )
+  {
+    const std::size_t pair_end{ std::min( std::size_t( chunk_idx + 1 ) * chunk_size, possible_overlaps.size() ) };
+    for( std::size_t pair_idx = std::size_t( chunk_idx ) * chunk_size; pair_idx < pair_end; ++pair_idx )
+    {
+      // Pairs are ordered, so the second body has the larger index; skip pairs with a teleported body
+      if( possible_overlaps[pair_idx].second >= nbodies )
+      {
+        continue;
+      }
+      dispatchNarrowPhaseCollision( possible_overlaps[pair_idx].first, possible_overlaps[pair_idx].second, q0, q1, chunk_active_sets[chunk_idx] );
+    }
+  }
+
+  for( std::vector<std::unique_ptr<Constraint>>& chunk_active_set : chunk_active_sets )
+  {
+    active_set.insert( active_set.end(), std::make_move_iterator( chunk_active_set.begin() ), std::make_move_iterator( chunk_active_set.end() ) );
+  }
+}
+
 // TODO: Cleanup as above
 bool RigidBody3DSim::collisionIsActive( const unsigned first_body, const unsigned second_body, const VectorXs& q0, const VectorXs& q1 ) const
 {
@@ -1054,68 +1174,258 @@ bool RigidBody3DSim::collisionIsActive( const unsigned first_body, const unsigne
 }
 
 
-void RigidBody3DSim::generateAABBs( std::vector<AABB>& aabbs, const VectorXs& q )
+std::vector<AABB>& RigidBody3DSim::generateAABBs( const VectorXs& q )
 {
-  aabbs.resize( m_sim_state.nbodies() );
-  for( unsigned body = 0; body < m_sim_state.nbodies(); ++body )
+  const ProfilerScope profiler_scope{ ProfilerTimer::BROAD_PHASE };
+  const unsigned nbodies{ m_sim_state.nbodies() };
+  if( m_aabb_of_sleeping_body.size() != nbodies )
   {
+    m_aabb_of_sleeping_body.assign( nbodies, false );
+  }
+  // Drop the teleported boxes appended by the last collision detection
+  m_body_aabbs.resize( nbodies );
+  const SleepingBodies& sleeping_bodies{ m_sim_state.sleepingBodies() };
+  for( unsigned body = 0; body < nbodies; ++body )
+  {
+    // Sleeping bodies do not move, so their boxes are computed once when they fall asleep
+    const bool asleep{ sleeping_bodies.isAsleep( body ) };
+    if( asleep && m_aabb_of_sleeping_body[body] )
+    {
+      continue;
+    }
     const Vector3s cm{ q.segment<3>( 3 * body ) };
-    const Matrix33sr R{ Eigen::Map<const Matrix33sr>{ q.segment<9>( 3 * m_sim_state.nbodies() + 9 * body ).data() } };
+    const Matrix33sr R{ Eigen::Map<const Matrix33sr>{ q.segment<9>( 3 * nbodies + 9 * body ).data() } };
     assert( ( R * R.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
     assert( fabs( R.determinant() - 1.0 ) <= 1.0e-6 );
-    m_sim_state.getGeometryOfBody( body ).computeAABB( cm, R, aabbs[body].min(), aabbs[body].max() );
-    assert( ( aabbs[body].min() < aabbs[body].max() ).all() );
+    m_sim_state.getGeometryOfBody( body ).computeAABB( cm, R, m_body_aabbs[body].min(), m_body_aabbs[body].max() );
+    assert( ( m_body_aabbs[body].min() < m_body_aabbs[body].max() ).all() );
+    m_aabb_of_sleeping_body[body] = asleep;
+  }
+  return m_body_aabbs;
+}
+
+bool RigidBody3DSim::isMovingKinematicBody( const unsigned body ) const
+{
+  assert( body < m_sim_state.nbodies() );
+  if( !m_sim_state.isKinematicallyScripted( body ) )
+  {
+    return false;
+  }
+  const SleepingBodies& sleeping_bodies{ m_sim_state.sleepingBodies() };
+  const VectorXs& v{ m_sim_state.v() };
+  return v.segment<3>( 3 * body ).norm() > sleeping_bodies.linearVelocityThreshold() || v.segment<3>( 3 * m_sim_state.nbodies() + 3 * body ).norm() > sleeping_bodies.angularVelocityThreshold();
+}
+
+// Wakes sleeping bodies whose bounding box reaches a moving static plane or cylinder. Bodies
+// inside a cylinder touch it when their box reaches the cylinder's wall.
+void RigidBody3DSim::wakeIslandsTouchingMovingStaticGeometry( const std::vector<AABB>& aabbs )
+{
+  assert( aabbs.size() >= m_sim_state.nbodies() );
+  std::vector<unsigned> touched_bodies;
+  for( const StaticPlane& plane : m_sim_state.staticPlanes() )
+  {
+    if( plane.v().isZero( 0.0 ) && plane.omega().isZero( 0.0 ) )
+    {
+      continue;
+    }
+    const Array3s n{ plane.n() };
+    for( const unsigned body : m_sim_state.sleepingBodies().asleepBodies() )
+    {
+      // Corner of the box deepest along the plane's normal
+      const Array3s corner{ ( n >= 0.0 ).select( aabbs[body].min(), aabbs[body].max() ) };
+      if( plane.distanceToPoint( corner.matrix() ) <= 0.0 )
+      {
+        touched_bodies.emplace_back( body );
+      }
+    }
+  }
+  for( const StaticCylinder& cylinder : m_sim_state.staticCylinders() )
+  {
+    if( cylinder.v().isZero( 0.0 ) && cylinder.omega().isZero( 0.0 ) )
+    {
+      continue;
+    }
+    for( const unsigned body : m_sim_state.sleepingBodies().asleepBodies() )
+    {
+      const Vector3s center{ 0.5 * ( aabbs[body].min() + aabbs[body].max() ).matrix() };
+      const scalar half_diagonal{ 0.5 * ( aabbs[body].max() - aabbs[body].min() ).matrix().norm() };
+      const Vector3s d{ center - cylinder.x() - cylinder.axis().dot( center - cylinder.x() ) * cylinder.axis() };
+      if( d.norm() + half_diagonal >= cylinder.r() )
+      {
+        touched_bodies.emplace_back( body );
+      }
+    }
+  }
+  m_sim_state.sleepingBodies().wakeIslands( touched_bodies );
+}
+
+// Wakes the islands of sleeping bodies in contact with an awake simulated body, and of sleeping
+// bodies whose bounding box overlaps a moving kinematic body or, through a portal, a body that is
+// not asleep. Woken bodies can touch further islands, so pairs are revisited until no body wakes.
+void RigidBody3DSim::wakeTouchedIslands( const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps, const std::vector<unsigned>& aabb_bodies, const VectorXs& q0, const VectorXs& q1 )
+{
+  SleepingBodies& sleeping_bodies{ m_sim_state.sleepingBodies() };
+  const unsigned nbodies{ m_sim_state.nbodies() };
+  bool bodies_woke{ true };
+  while( bodies_woke && sleeping_bodies.numAsleep() != 0 )
+  {
+    std::vector<unsigned> touched_bodies;
+    for( const std::pair<unsigned,unsigned>& possible_overlap : possible_overlaps )
+    {
+      const unsigned body0{ aabb_bodies[possible_overlap.first] };
+      const unsigned body1{ aabb_bodies[possible_overlap.second] };
+      if( body0 == body1 || sleeping_bodies.isAsleep( body0 ) == sleeping_bodies.isAsleep( body1 ) )
+      {
+        continue;
+      }
+      const unsigned sleeping_body{ sleeping_bodies.isAsleep( body0 ) ? body0 : body1 };
+      const unsigned other_body{ sleeping_body == body0 ? body1 : body0 };
+      bool touched;
+      if( m_sim_state.isKinematicallyScripted( other_body ) )
+      {
+        touched = isMovingKinematicBody( other_body );
+      }
+      else if( possible_overlap.first >= nbodies || possible_overlap.second >= nbodies )
+      {
+        touched = true;
+      }
+      else
+      {
+        touched = collisionIsActive( sleeping_body, other_body, q0, q1 );
+      }
+      if( touched )
+      {
+        touched_bodies.emplace_back( sleeping_body );
+      }
+    }
+    bodies_woke = sleeping_bodies.wakeIslands( touched_bodies ) != 0;
+  }
+}
+
+void RigidBody3DSim::recordContacts( const std::vector<std::unique_ptr<Constraint>>& active_set )
+{
+  m_contacts.clear();
+  if( !m_sim_state.sleepingBodies().enabled() )
+  {
+    return;
+  }
+  for( const std::unique_ptr<Constraint>& constraint : active_set )
+  {
+    std::pair<int,int> bodies;
+    constraint->getBodyIndices( bodies );
+    if( bodies.first < 0 || bodies.second < 0 || bodies.first == bodies.second )
+    {
+      continue;
+    }
+    // Contacts with kinematic bodies do not join islands
+    if( isKinematicallyScripted( bodies.first ) || isKinematicallyScripted( bodies.second ) )
+    {
+      continue;
+    }
+    m_contacts.emplace_back( unsigned( bodies.first ), unsigned( bodies.second ) );
+  }
+}
+
+// Puts to sleep islands whose bodies rested for the configured number of steps, given the new
+// velocity v1 of the step. The impulse a body receives over the step is its change in momentum.
+void RigidBody3DSim::updateSleepingBodies( VectorXs& v1 )
+{
+  SleepingBodies& sleeping_bodies{ m_sim_state.sleepingBodies() };
+  if( !sleeping_bodies.enabled() )
+  {
+    m_contacts.clear();
+    return;
+  }
+
+  const unsigned nbodies{ m_sim_state.nbodies() };
+  const VectorXs& v0{ m_sim_state.v() };
+  assert( v1.size() == v0.size() );
+  m_at_rest.assign( nbodies, false );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  {
+    if( isKinematicallyScripted( bdy_idx ) )
+    {
+      continue;
+    }
+    const Vector3s v{ v1.segment<3>( 3 * bdy_idx ) };
+    const Vector3s omega{ v1.segment<3>( 3 * nbodies + 3 * bdy_idx ) };
+    const scalar linear_impulse{ m_sim_state.getTotalMass( bdy_idx ) * ( v - v0.segment<3>( 3 * bdy_idx ) ).norm() };
+    const scalar angular_impulse{ ( m_sim_state.getInertia( bdy_idx ) * ( omega - v0.segment<3>( 3 * nbodies + 3 * bdy_idx ) ) ).norm() };
+    m_at_rest[bdy_idx] = sleeping_bodies.isAtRest( v.norm(), omega.norm(), linear_impulse, angular_impulse );
+  }
+
+  std::vector<unsigned> fell_asleep;
+  sleeping_bodies.update( m_at_rest, m_contacts, m_sim_state.bodyIds(), fell_asleep );
+  m_contacts.clear();
+
+  // Sleeping bodies hold still
+  for( const unsigned bdy_idx : fell_asleep )
+  {
+    v1.segment<3>( 3 * bdy_idx ).setZero();
+    v1.segment<3>( 3 * nbodies + 3 * bdy_idx ).setZero();
   }
 }
 
 // TODO: Move as much of this code into helper methods as possible
-void RigidBody3DSim::computeActiveSetBodyBodySpatialGrid( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set )
+void RigidBody3DSim::computeActiveSetBodyBodySpatialGrid( const VectorXs& q0, const VectorXs& q1, const bool wake_touched_islands, std::vector<std::unique_ptr<Constraint>>& active_set )
 {
   assert( q0.size() == 12 * m_sim_state.nbodies() );
   assert( q0.size() == q1.size() );
 
   const unsigned nbodies{ m_sim_state.nbodies() };
   
-  // Candidate bodies that might overlap
-  std::set<std::pair<unsigned,unsigned>> possible_overlaps;
   // Map from teleported AABB indices and body and portal indices
   std::map<unsigned,TeleportedBody> teleported_aabb_body_indices;
-  {
-    // Compute an AABB for each body
-    std::vector<AABB> aabbs;
-    generateAABBs( aabbs, q1 );
-    assert( aabbs.size() == nbodies );
 
-    // Compute an AABB for each teleported particle
-    auto aabb_bdy_map_itr = teleported_aabb_body_indices.cbegin();
-    // For each portal
-    for( std::vector<PlanarPortal>::size_type prtl_idx = 0; prtl_idx < m_sim_state.numPlanarPortals(); ++prtl_idx )
+  // Compute an AABB for each body, updated in place in m_body_aabbs
+  std::vector<AABB>& aabbs{ generateAABBs( q1 ) };
+  assert( aabbs.size() == nbodies );
+
+  // Compute an AABB for each teleported particle
+  auto aabb_bdy_map_itr = teleported_aabb_body_indices.cbegin();
+  // For each portal
+  for( std::vector<PlanarPortal>::size_type prtl_idx = 0; prtl_idx < m_sim_state.numPlanarPortals(); ++prtl_idx )
+  {
+    // For each body
+    for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
     {
-      // For each body
-      for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+      // If the body is inside a portal
+      bool intersecting_plane_index;
+      if( m_sim_state.planarPortal( prtl_idx ).aabbTouchesPortal( aabbs[bdy_idx].min(), aabbs[bdy_idx].max(), intersecting_plane_index )  )
       {
-        // If the body is inside a portal
-        bool intersecting_plane_index;
-        if( m_sim_state.planarPortal( prtl_idx ).aabbTouchesPortal( aabbs[bdy_idx].min(), aabbs[bdy_idx].max(), intersecting_plane_index )  )
-        {
-          // Teleport to the other side of the portal
-          Vector3s x_out;
-          m_sim_state.planarPortal( prtl_idx ).teleportPoint( q1.segment<3>( 3 * bdy_idx ), intersecting_plane_index, x_out );
-
-          // Compute an AABB for the teleported body
-          AABB new_aabb;
-          const Matrix33sr R{ Eigen::Map<const Matrix33sr>{ q1.segment<9>( 3 * m_sim_state.nbodies() + 9 * bdy_idx ).data() } };
-          assert( ( R * R.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-          assert( fabs( R.determinant() - 1.0 ) <= 1.0e-6 );
-          m_sim_state.getGeometryOfBody( bdy_idx ).computeAABB( x_out, R, new_aabb.min(), new_aabb.max() );
-          aabbs.emplace_back( new_aabb );
-          aabb_bdy_map_itr = teleported_aabb_body_indices.insert( aabb_bdy_map_itr, std::make_pair( aabbs.size() - 1, TeleportedBody{ bdy_idx, unsigned( prtl_idx ), intersecting_plane_index } ) );
-        }
+        // Teleport to the other side of the portal
+        Vector3s x_out;
+        m_sim_state.planarPortal( prtl_idx ).teleportPoint( q1.segment<3>( 3 * bdy_idx ), intersecting_plane_index, x_out );
+
+        // Compute an AABB for the teleported body
+        AABB new_aabb;
+        const Matrix33sr R{ Eigen::Map<const Matrix33sr>{ q1.segment<9>( 3 * m_sim_state.nbodies() + 9 * bdy_idx ).data() } };
+        assert( ( R * R.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
+        assert( fabs( R.determinant() - 1.0 ) <= 1.0e-6 );
+        m_sim_state.getGeometryOfBody( bdy_idx ).computeAABB( x_out, R, new_aabb.min(), new_aabb.max() );
+        aabbs.emplace_back( new_aabb );
+        aabb_bdy_map_itr = teleported_aabb_body_indices.insert( aabb_bdy_map_itr, std::make_pair( aabbs.size() - 1, TeleportedBody{ bdy_idx, unsigned( prtl_idx ), intersecting_plane_index } ) );
       }
     }
+  }
 
-    // Determine which bodies possibly overlap
-    SpatialGridDetector::getPotentialOverlaps( aabbs, possible_overlaps );
+  // Determine which bodies possibly overlap
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::BROAD_PHASE };
+    m_broad_phase.computePotentialOverlaps( aabbs );
+  }
+  const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps{ m_broad_phase.potentialOverlaps() };
+
+  // Islands touched by moving bodies rejoin the simulation before any contacts are generated
+  if( wake_touched_islands && m_sim_state.sleepingBodies().numAsleep() != 0 )
+  {
+    wakeIslandsTouchingMovingStaticGeometry( aabbs );
+    std::vector<unsigned> aabb_bodies( aabbs.size() );
+    for( unsigned aabb_idx = 0; aabb_idx < aabbs.size(); ++aabb_idx )
+    {
+      aabb_bodies[aabb_idx] = aabb_idx < nbodies ? aabb_idx : teleported_aabb_body_indices.at( aabb_idx ).bodyIndex();
+    }
+    wakeTouchedIslands( possible_overlaps, aabb_bodies, q0, q1 );
   }
 
   std::set<TeleportedCollision> teleported_collisions;
@@ -1124,23 +1434,17 @@ void RigidBody3DSim::computeActiveSetBodyBodySpatialGrid( const VectorXs& q0, co
   std::vector<std::pair<unsigned,unsigned>> duplicate_indices;
   #endif
 
-  // Create constraints for bodies that actually overlap
+  // Create constraints for bodies that actually overlap and were not teleported
+  dispatchNarrowPhaseCollisions( possible_overlaps, q0, q1, active_set );
+
+  // Check the pairs where at least one body was teleported
   for( const auto& possible_overlap_pair : possible_overlaps )
   {
     const bool first_teleported{ possible_overlap_pair.first >= nbodies };
     const bool second_teleported{ possible_overlap_pair.second >= nbodies };
 
-    // If neither ball in the current collision was teleported
-    if( !first_teleported && !second_teleported )
-    {
-      if( isKinematicallyScripted( possible_overlap_pair.first ) && isKinematicallyScripted( possible_overlap_pair.second ) )
-      {
-        continue;
-      }
-      dispatchNarrowPhaseCollision( possible_overlap_pair.first, possible_overlap_pair.second, q0, q1, active_set );
-    }
     // If at least one of the balls was teleported
-    else
+    if( first_teleported || second_teleported )
     {
       unsigned bdy_idx_0{ possible_overlap_pair.first };
       unsigned bdy_idx_1{ possible_overlap_pair.second };
@@ -1197,7 +1501,6 @@ void RigidBody3DSim::computeActiveSetBodyBodySpatialGrid( const VectorXs& q0, co
       }
     }
   }
-  possible_overlaps.clear();
   teleported_aabb_body_indices.clear();
 
   #ifndef NDEBUG
@@ -1557,44 +1860,138 @@ void RigidBody3DSim::computeBodyCylinderActiveSetAllPairs( const VectorXs& q0, c
 }
 
 #ifdef USE_HDF5
-void RigidBody3DSim::writeBinaryState( HDF5File& output_file ) const
+void RigidBody3DSim::writeBinaryState( const RigidBody3DState& state, HDF5File& output_file )
 {
   // Output the simulated geometry
-  StateOutput::writeGeometryIndices( m_sim_state.geometry(), m_sim_state.indices(), "geometry", output_file );
-  StateOutput::writeGeometry( m_sim_state.geometry(), "geometry", output_file );
+  StateOutput::writeGeometryIndices( state.geometry(), state.indices(), "geometry", output_file );
+  StateOutput::writeGeometry( state.geometry(), "geometry", output_file );
   // Output the static geometry
-  if( !m_sim_state.staticPlanes().empty() )
+  if( !state.staticPlanes().empty() )
   {
-    StateOutput::writeStaticPlanes( m_sim_state.staticPlanes(), "static_geometry", output_file );
+    StateOutput::writeStaticPlanes( state.staticPlanes(), "static_geometry", output_file );
   }
-  if( !m_sim_state.staticCylinders().empty() )
+  if( !state.staticCylinders().empty() )
   {
-    StateOutput::writeStaticCylinders( m_sim_state.staticCylinders(), "static_geometry", output_file );
+    StateOutput::writeStaticCylinders( state.staticCylinders(), "static_geometry", output_file );
   }
   // Write out the state of each body
-  output_file.write( "state/q", m_sim_state.q() );
-  output_file.write( "state/v", m_sim_state.v() );
+  output_file.write( "state/q", state.q() );
+  output_file.write( "state/v", state.v() );
   {
-    const Eigen::Map<const VectorXs> M0(m_sim_state.M0().valuePtr(), m_sim_state.M0().nonZeros());
+    const Eigen::Map<const VectorXs> M0(state.M0().valuePtr(), state.M0().nonZeros());
     output_file.write( "state/M0", M0 );
   }
   {
-    VectorXu fixed{ m_sim_state.nbodies() };
-    for( unsigned body_index = 0; body_index < m_sim_state.nbodies(); ++body_index )
+    VectorXu fixed{ state.nbodies() };
+    for( unsigned body_index = 0; body_index < state.nbodies(); ++body_index )
     {
-      fixed( body_index ) = m_sim_state.isKinematicallyScripted( body_index ) ? 1 : 0;
+      fixed( body_index ) = state.isKinematicallyScripted( body_index ) ? 1 : 0;
     }
     output_file.write( "state/kinematically_scripted", fixed );
   }
+  // Bodies may have been renumbered, so record the id of each body
+  {
+    const VectorXu body_ids{ Eigen::Map<const VectorXu>{ state.bodyIds().data(), state.nbodies() } };
+    output_file.write( "state/body_ids", body_ids );
+  }
 }
 #endif
 
+#ifdef USE_HDF5
+// Index of the body with each id
+static std::vector<unsigned> bodiesInIdOrder( const RigidBody3DState& state )
+{
+  std::vector<unsigned> body_of_id;
+  SpaceFillingCurve::invertOrder( state.bodyIds(), body_of_id );
+  return body_of_id;
+}
+
+// Number of rows of the given size that fill roughly a megabyte
+static hsize_t trajectoryChunkRows( const hsize_t row_bytes )
+{
+  constexpr hsize_t target_chunk_bytes{ 1 << 20 };
+  return std::max( hsize_t( 1 ), target_chunk_bytes / std::max( row_bytes, hsize_t( 1 ) ) );
+}
+
+void RigidBody3DSim::writeBinaryTrajectoryHeader( const RigidBody3DState& state, HDF5File& output_file, const unsigned compression_level )
+{
+  const unsigned nbodies{ state.nbodies() };
+  const std::vector<unsigned> body_of_id{ bodiesInIdOrder( state ) };
+
+  // Output the simulated geometry
+  {
+    std::vector<unsigned> geometry_indices( nbodies );
+    for( unsigned id = 0; id < nbodies; ++id )
+    {
+      geometry_indices[id] = state.getGeometryIndexOfBody( body_of_id[id] );
+    }
+    StateOutput::writeGeometryIndices( state.geometry(), geometry_indices, "geometry", output_file );
+  }
+  StateOutput::writeGeometry( state.geometry(), "geometry", output_file );
+  // Output the static geometry
+  if( !state.staticPlanes().empty() )
+  {
+    StateOutput::writeStaticPlanes( state.staticPlanes(), "static_geometry", output_file );
+  }
+  if( !state.staticCylinders().empty() )
+  {
+    StateOutput::writeStaticCylinders( state.staticCylinders(), "static_geometry", output_file );
+  }
+  // Output the body-space masses and whether each body is kinematically scripted
+  {
+    const Eigen::Map<const VectorXs> M0{ state.M0().valuePtr(), state.M0().nonZeros() };
+    VectorXs M0_by_id{ M0.size() };
+    VectorXu fixed{ nbodies };
+    for( unsigned id = 0; id < nbodies; ++id )
+    {
+      const unsigned body{ body_of_id[id] };
+      M0_by_id.segment<3>( 3 * id ) = M0.segment<3>( 3 * body );
+      M0_by_id.segment<3>( 3 * nbodies + 3 * id ) = M0.segment<3>( 3 * nbodies + 3 * body );
+      fixed( id ) = state.isKinematicallyScripted( body ) ? 1 : 0;
+    }
+    output_file.write( "state/M0", M0_by_id );
+    output_file.write( "state/kinematically_scripted", fixed );
+  }
+
+  // One row per frame for the configuration and velocity
+  output_file.createExtendibleMatrix<scalar>( "trajectory/q", 12 * nbodies, trajectoryChunkRows( 12 * nbodies * sizeof( scalar ) ), compression_level );
+  output_file.createExtendibleMatrix<scalar>( "trajectory/v", 6 * nbodies, trajectoryChunkRows( 6 * nbodies * sizeof( scalar ) ), compression_level );
+}
+
+void RigidBody3DSim::appendBinaryTrajectoryFrame( const VectorXs& q_by_id, const VectorXs& v_by_id, HDF5File& output_file )
+{
+  output_file.appendRow( "trajectory/q", q_by_id );
+  output_file.appendRow( "trajectory/v", v_by_id );
+}
+#endif
+
+void RigidBody3DSim::computeStateInIdOrder( VectorXs& q_by_id, VectorXs& v_by_id ) const
+{
+  const unsigned nbodies{ m_sim_state.nbodies() };
+  std::vector<unsigned> body_of_id;
+  SpaceFillingCurve::invertOrder( m_sim_state.bodyIds(), body_of_id );
+
+  const VectorXs& q{ m_sim_state.q() };
+  const VectorXs& v{ m_sim_state.v() };
+  q_by_id.resize( q.size() );
+  v_by_id.resize( v.size() );
+  for( unsigned id = 0; id < nbodies; ++id )
+  {
+    const unsigned body{ body_of_id[id] };
+    q_by_id.segment<3>( 3 * id ) = q.segment<3>( 3 * body );
+    q_by_id.segment<9>( 3 * nbodies + 9 * id ) = q.segment<9>( 3 * nbodies + 9 * body );
+    v_by_id.segment<3>( 3 * id ) = v.segment<3>( 3 * body );
+    v_by_id.segment<3>( 3 * nbodies + 3 * id ) = v.segment<3>( 3 * nbodies + 3 * body );
+  }
+}
+
 void RigidBody3DSim::serialize( std::ostream& output_stream ) const
 {
   assert( output_stream.good() );
   m_sim_state.serialize( output_stream );
   // Nothing to serialize for m_impact_map
   m_constraint_cache.serialize( output_stream );
+  // Nothing to serialize for m_broad_phase
 }
 
 void RigidBody3DSim::deserialize( std::istream& input_stream )
@@ -1603,6 +2000,41 @@ void RigidBody3DSim::deserialize( std::istream& input_stream )
   m_sim_state.deserialize( input_stream );
   // Nothing to deserialize for m_impact_map
   m_constraint_cache.deserialize( input_stream );
+  // The broad phase and bounding boxes only cache data derived from the state
+  m_broad_phase.clear();
+  m_aabb_of_sleeping_body.clear();
+}
+
+void RigidBody3DSim::writeCheckpoint( CheckpointWriter& checkpoint ) const
+{
+  m_sim_state.writeCheckpoint( checkpoint );
+  std::ostringstream cache_stream{ std::ios::binary };
+  m_constraint_cache.serialize( cache_stream );
+  checkpoint.addSection( "sim/constraint_cache", cache_stream.str() );
+}
+
+void RigidBody3DSim::readCheckpoint( const CheckpointReader& checkpoint )
+{
+  m_sim_state.readCheckpoint( checkpoint );
+  m_constraint_cache.deserialize( *checkpoint.stream( "sim/constraint_cache" ) );
+  m_broad_phase.clear();
+  m_aabb_of_sleeping_body.clear();
+}
+
+void RigidBody3DSim::writeCheckpointDelta( CheckpointWriter& checkpoint ) const
+{
+  m_sim_state.writeCheckpointDelta( checkpoint );
+  std::ostringstream cache_stream{ std::ios::binary };
+  m_constraint_cache.serialize( cache_stream );
+  checkpoint.addSection( "sim/constraint_cache", cache_stream.str() );
+}
+
+void RigidBody3DSim::readCheckpointDelta( const CheckpointReader& checkpoint )
+{
+  m_sim_state.readCheckpointDelta( checkpoint );
+  m_constraint_cache.deserialize( *checkpoint.stream( "sim/constraint_cache" ) );
+  m_broad_phase.clear();
+  m_aabb_of_sleeping_body.clear();
 }
 
 ImpactMap& RigidBody3DSim::impactMap()
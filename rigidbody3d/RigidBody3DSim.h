@@ -10,9 +10,12 @@
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/Constraints/ConstrainedSystem.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactMap.h"
+#include "scisim/Constraints/ContactBatch.h"
+#include "scisim/CollisionDetection/SortedCellGrid.h"
 
 #include "RigidBody3DState.h"
 #include "ConstraintCache.h"
+#include "SpatialGridDetector.h"
 
 class UnconstrainedMap;
 class ImpactOperator;
@@ -21,10 +24,11 @@ class RigidBodyBox;
 class RigidBodySphere;
 class RigidBodyStaple;
 class RigidBodyTriangleMesh;
-class AABB;
 class TeleportedCollision;
 class FrictionSolver;
 class PythonScripting;
+class CheckpointWriter;
+class CheckpointReader;
 template<typename T> class Rational;
 
 #ifdef USE_HDF5
@@ -89,6 +93,7 @@ public:
   virtual void computeActiveSet( const VectorXs& q0, const VectorXs& qp, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set ) override;
   virtual void computeImpactBases( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& impact_bases ) const override;
   virtual void computeContactBases( const VectorXs& q, const VectorXs& v, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& contact_bases ) const override;
+  virtual const ContactBatch* contactBatch( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set ) const override;
   virtual void clearConstraintCache() override;
   virtual void cacheConstraint( const Constraint& constraint, const VectorXs& r ) override;
   virtual void getCachedConstraintImpulse( const Constraint& constraint, VectorXs& r ) const override;
@@ -110,13 +115,31 @@ public:
 
   RigidBody3DState& state();
 
+  // Renumbers the bodies along a space filling curve so that bodies close in space are close in memory
+  void renumberBodies();
+
   #ifdef USE_HDF5
-  void writeBinaryState( HDF5File& output_file ) const;
+  // State output takes the state explicitly so that a copy of the state can be written while the simulation continues
+  static void writeBinaryState( const RigidBody3DState& state, HDF5File& output_file );
+
+  // Trajectory output: data that does not change over the simulation is written once, then the
+  // configuration and velocity of each frame are appended to compressed, chunked matrices with one
+  // row per frame. Bodies are output in the order of their ids, so renumbering is not visible.
+  static void writeBinaryTrajectoryHeader( const RigidBody3DState& state, HDF5File& output_file, const unsigned compression_level );
+  static void appendBinaryTrajectoryFrame( const VectorXs& q_by_id, const VectorXs& v_by_id, HDF5File& output_file );
   #endif
 
+  // Configuration and velocity with the bodies in the order of their ids
+  void computeStateInIdOrder( VectorXs& q_by_id, VectorXs& v_by_id ) const;
+
   void serialize( std::ostream& output_stream ) const;
   void deserialize( std::istream& input_stream );
 
+  void writeCheckpoint( CheckpointWriter& checkpoint ) const;
+  void readCheckpoint( const CheckpointReader& checkpoint );
+  void writeCheckpointDelta( CheckpointWriter& checkpoint ) const;
+  void readCheckpointDelta( const CheckpointReader& checkpoint );
+
   ImpactMap& impactMap();
 
 private:
@@ -124,6 +147,7 @@ private:
   void enforcePeriodicBoundaryConditions();
   void runBoundaryExitTreatment() const;
   void treatSimulationBoundary();
+  void renumberBodiesIfScheduled( const unsigned iteration );
 
   void boxBoxNarrowPhaseCollision( const unsigned first_body, const unsigned second_body, const RigidBodyBox& box0, const RigidBodyBox& box1, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
   [[noreturn]] void boxSphereNarrowPhaseCollision( const unsigned first_body, const unsigned second_body, const RigidBodyBox& box, const RigidBodySphere& sphere, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
@@ -131,15 +155,24 @@ private:
   void stapleStapleNarrowPhaseCollision( const unsigned first_body, const unsigned second_body, const RigidBodyStaple& staple0, const RigidBodyStaple& staple1, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
   void meshMeshNarrowPhaseCollision( const unsigned first_body, const unsigned second_body, const RigidBodyTriangleMesh& mesh0, const RigidBodyTriangleMesh& mesh1, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
   void dispatchNarrowPhaseCollision( const unsigned first_body, const unsigned second_body, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
+  void dispatchNarrowPhaseCollisions( const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps, const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
   bool collisionIsActive( const unsigned first_body, const unsigned second_body, const VectorXs& q0, const VectorXs& q1 ) const;
 
-  void generateAABBs( std::vector<AABB>& aabbs, const VectorXs& q );
+  std::vector<AABB>& generateAABBs( const VectorXs& q );
+
+  // Body sleeping
+  bool isMovingKinematicBody( const unsigned body ) const;
+  void wakeIslandsTouchingMovingStaticGeometry( const std::vector<AABB>& aabbs );
+  void wakeTouchedIslands( const std::vector<std::pair<unsigned,unsigned>>& possible_overlaps, const std::vector<unsigned>& aabb_bodies, const VectorXs& q0, const VectorXs& q1 );
+  void recordContacts( const std::vector<std::unique_ptr<Constraint>>& active_set );
+  void updateSleepingBodies( VectorXs& v1 );
 
   bool teleportedCollisionHappens( const VectorXs& q, const TeleportedCollision& teleported_collision ) const;
   void getTeleportedCollisionCenters( const VectorXs& q, const TeleportedCollision& teleported_collision, Vector3s& x0, Vector3s& x1 ) const;
   void generateTeleportedCollision( const VectorXs& q, const TeleportedCollision& teleported_collision, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
 
-  void computeActiveSetBodyBodySpatialGrid( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set );
+  void detectCollisions( const VectorXs& q0, const VectorXs& q1, const bool wake_touched_islands, std::vector<std::unique_ptr<Constraint>>& active_set );
+  void computeActiveSetBodyBodySpatialGrid( const VectorXs& q0, const VectorXs& q1, const bool wake_touched_islands, std::vector<std::unique_ptr<Constraint>>& active_set );
   //void computeActiveSetBodyBodyAllPairs( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
 
   void computeBodyPlaneActiveSetAllPairs( const VectorXs& q0, const VectorXs& q1, std::vector<std::unique_ptr<Constraint>>& active_set ) const;
@@ -148,6 +181,17 @@ private:
   RigidBody3DState m_sim_state;
   ImpactMap m_impact_map;
   ConstraintCache m_constraint_cache;
+  SortedCellGrid<3> m_broad_phase;
+  // Bounding boxes of the bodies, followed by those of teleported bodies, from the last collision
+  // detection; the boxes of sleeping bodies are reused while m_aabb_of_sleeping_body is set
+  std::vector<AABB> m_body_aabbs;
+  std::vector<bool> m_aabb_of_sleeping_body;
+  // Pairs of awake simulated bodies in contact in the last active set, used to form islands
+  std::vector<std::pair<unsigned,unsigned>> m_contacts;
+  // Whether each body was at rest over the last step, storage reused across steps
+  std::vector<bool> m_at_rest;
+  // The last active set in structure of arrays form, built once and shared by the impact and friction operators
+  ContactBatch m_contact_batch;
 
 };
 
@@ -5,7 +5,9 @@
 
 #include "RigidBody3DState.h"
 
+#include "scisim/Checkpoint.h"
 #include "scisim/Math/MathUtilities.h"
+#include "scisim/Math/RigidBodyMass3D.h"
 #include "scisim/StringUtilities.h"
 #include "scisim/Utilities.h"
 
@@ -18,6 +20,9 @@
 #include "StaticGeometry/StaticPlane.h"
 
 #include <iostream>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
 
 RigidBody3DState::RigidBody3DState()
 : m_nbodies( 0 )
@@ -27,7 +32,9 @@ RigidBody3DState::RigidBody3DState()
 , m_Minv0()
 , m_M()
 , m_Minv()
+, m_inertia_orientations()
 , m_fixed()
+, m_sleeping_bodies()
 , m_geometry()
 , m_geometry_indices()
 , m_forces()
@@ -37,6 +44,8 @@ RigidBody3DState::RigidBody3DState()
 , m_boundary_behavior( SimBoundaryBehavior::NONE )
 , m_boundary_min( Vector3s::Constant( std::numeric_limits<scalar>::min() ) )
 , m_boundary_max( Vector3s::Constant( std::numeric_limits<scalar>::max() ) )
+, m_body_ids()
+, m_renumbering_frequency( 0 )
 {}
 
 RigidBody3DState::RigidBody3DState( const RigidBody3DState& other )
@@ -47,7 +56,9 @@ RigidBody3DState::RigidBody3DState( const RigidBody3DState& other )
 , m_Minv0( other.m_Minv0 )
 , m_M( other.m_M )
 , m_Minv( other.m_Minv )
+, m_inertia_orientations( other.m_inertia_orientations )
 , m_fixed( other.m_fixed )
+, m_sleeping_bodies( other.m_sleeping_bodies )
 , m_geometry( Utilities::clone( other.m_geometry ) )
 , m_geometry_indices( other.m_geometry_indices )
 , m_forces( Utilities::clone( other.m_forces ) )
@@ -57,6 +68,8 @@ RigidBody3DState::RigidBody3DState( const RigidBody3DState& other )
 , m_boundary_behavior( other.m_boundary_behavior )
 , m_boundary_min( other.m_boundary_min )
 , m_boundary_max( other.m_boundary_max )
+, m_body_ids( other.m_body_ids )
+, m_renumbering_frequency( other.m_renumbering_frequency )
 {}
 
 RigidBody3DState& RigidBody3DState::operator=( const RigidBody3DState& other )
@@ -67,10 +80,11 @@ RigidBody3DState& RigidBody3DState::operator=( const RigidBody3DState& other )
   return *this;
 }
 
-static SparseMatrixsc formBodySpaceMassMatrix( const std::vector<scalar>& M, const std::vector<Vector3s>& I0 )
+// M holds the total mass and each column of I0 the principal moments of inertia of a body
+static SparseMatrixsc formBodySpaceMassMatrix( const VectorXs& M, const Matrix3Xsc& I0 )
 {
-  assert( M.size() == I0.size() );
-  const unsigned nbodies{ static_cast<unsigned>( I0.size() ) };
+  assert( M.size() == I0.cols() );
+  const unsigned nbodies{ static_cast<unsigned>( I0.cols() ) };
   const unsigned nvdofs{ 6 * nbodies };
 
   SparseMatrixsc M0{ static_cast<SparseMatrixsc::Index>( nvdofs ), static_cast<SparseMatrixsc::Index>( nvdofs ) };
@@ -82,8 +96,8 @@ static SparseMatrixsc formBodySpaceMassMatrix( const std::vector<scalar>& M, con
     {
       const unsigned col{ 3 * bdy_idx + dof_idx };
       const unsigned row{ col };
-      assert( M[ bdy_idx ] > 0.0 );
-      M0.insert( row, col ) = M[ bdy_idx ];
+      assert( M( bdy_idx ) > 0.0 );
+      M0.insert( row, col ) = M( bdy_idx );
     }
   }
   // Load the inertia tensors
@@ -93,8 +107,8 @@ static SparseMatrixsc formBodySpaceMassMatrix( const std::vector<scalar>& M, con
     {
       const unsigned col{ 3 * nbodies + 3 * bdy_idx + dof_idx };
       const unsigned row{ col };
-      assert( I0[ bdy_idx ]( dof_idx ) > 0.0 );
-      M0.insert( row, col ) = I0[ bdy_idx ]( dof_idx );
+      assert( I0( dof_idx, bdy_idx ) > 0.0 );
+      M0.insert( row, col ) = I0( dof_idx, bdy_idx );
     }
   }
   assert( nvdofs == unsigned( M0.nonZeros() ) );
@@ -102,10 +116,10 @@ static SparseMatrixsc formBodySpaceMassMatrix( const std::vector<scalar>& M, con
   return M0;
 }
 
-static SparseMatrixsc formBodySpaceInverseMassMatrix( const std::vector<scalar>& M, const std::vector<Vector3s>& I0 )
+static SparseMatrixsc formBodySpaceInverseMassMatrix( const VectorXs& M, const Matrix3Xsc& I0 )
 {
-  assert( M.size() == I0.size() );
-  const unsigned nbodies{ static_cast<unsigned>( I0.size() ) };
+  assert( M.size() == I0.cols() );
+  const unsigned nbodies{ static_cast<unsigned>( I0.cols() ) };
   const unsigned nvdofs{ 6 * nbodies };
 
   SparseMatrixsc M0{ static_cast<SparseMatrixsc::Index>( nvdofs ), static_cast<SparseMatrixsc::Index>( nvdofs ) };
@@ -117,8 +131,8 @@ static SparseMatrixsc formBodySpaceInverseMassMatrix( const std::vector<scalar>&
     {
       const unsigned col{ 3 * bdy_idx + dof_idx };
       const unsigned row{ col };
-      assert( M[ bdy_idx ] > 0.0 );
-      M0.insert( row, col ) = 1.0 / M[ bdy_idx ];
+      assert( M( bdy_idx ) > 0.0 );
+      M0.insert( row, col ) = 1.0 / M( bdy_idx );
     }
   }
   // Load the inertia tensors
@@ -128,8 +142,8 @@ static SparseMatrixsc formBodySpaceInverseMassMatrix( const std::vector<scalar>&
     {
       const unsigned col{ 3 * nbodies + 3 * bdy_idx + dof_idx };
       const unsigned row{ col };
-      assert( I0[ bdy_idx ]( dof_idx ) > 0.0 );
-      M0.insert( row, col ) = 1.0 / I0[ bdy_idx ]( dof_idx );
+      assert( I0( dof_idx, bdy_idx ) > 0.0 );
+      M0.insert( row, col ) = 1.0 / I0( dof_idx, bdy_idx );
     }
   }
   assert( nvdofs == unsigned( M0.nonZeros() ) );
@@ -137,11 +151,12 @@ static SparseMatrixsc formBodySpaceInverseMassMatrix( const std::vector<scalar>&
   return M0;
 }
 
-static SparseMatrixsc formWorldSpaceMassMatrix( const std::vector<scalar>& M, const std::vector<Vector3s>& I0, const std::vector<VectorXs>& R )
+// The orientations are read from the generalized configuration q
+static SparseMatrixsc formWorldSpaceMassMatrix( const VectorXs& M, const Matrix3Xsc& I0, const VectorXs& q )
 {
-  assert( M.size() == I0.size() );
-  assert( M.size() == I0.size() );
-  const unsigned nbodies{ static_cast<unsigned>( I0.size() ) };
+  assert( M.size() == I0.cols() );
+  assert( q.size() == 12 * I0.cols() );
+  const unsigned nbodies{ static_cast<unsigned>( I0.cols() ) };
   const unsigned nvdofs{ 6 * nbodies };
 
   SparseMatrixsc Mbody{ static_cast<SparseMatrixsc::Index>( nvdofs ), static_cast<SparseMatrixsc::Index>( nvdofs ) };
@@ -158,8 +173,8 @@ static SparseMatrixsc formWorldSpaceMassMatrix( const std::vector<scalar>& M, co
     {
       const unsigned col{ 3 * bdy_idx + dof_idx };
       const unsigned row{ col };
-      assert( M[ bdy_idx ] > 0.0 );
-      Mbody.insert( row, col ) = M[ bdy_idx ];
+      assert( M( bdy_idx ) > 0.0 );
+      Mbody.insert( row, col ) = M( bdy_idx );
     }
   }
 
@@ -167,10 +182,10 @@ static SparseMatrixsc formWorldSpaceMassMatrix( const std::vector<scalar>& M, co
   for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
     // Transform from principal axes rep
-    const Eigen::Map<const Matrix33sr> Rmat{ R[bdy_idx].data() };
+    const Eigen::Map<const Matrix33sr> Rmat{ q.data() + 3 * nbodies + 9 * bdy_idx };
     assert( ( Rmat * Rmat.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-9 );
     assert( fabs( Rmat.determinant() - 1.0 ) <= 1.0e-9 );
-    const Matrix33sr I = Rmat * I0[bdy_idx].asDiagonal() * Rmat.transpose();
+    const Matrix33sr I = Rmat * I0.col( bdy_idx ).asDiagonal() * Rmat.transpose();
     assert( ( I - I.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-12 );
     assert( I.determinant() > 0.0 );
     for( unsigned row_idx = 0; row_idx < 3; ++row_idx )
@@ -188,11 +203,11 @@ static SparseMatrixsc formWorldSpaceMassMatrix( const std::vector<scalar>& M, co
   return Mbody;
 }
 
-static SparseMatrixsc formWorldSpaceInverseMassMatrix( const std::vector<scalar>& M, const std::vector<Vector3s>& I0, const std::vector<VectorXs>& R )
+static SparseMatrixsc formWorldSpaceInverseMassMatrix( const VectorXs& M, const Matrix3Xsc& I0, const VectorXs& q )
 {
-  assert( M.size() == I0.size() );
-  assert( M.size() == I0.size() );
-  const unsigned nbodies{ static_cast<unsigned>( I0.size() ) };
+  assert( M.size() == I0.cols() );
+  assert( q.size() == 12 * I0.cols() );
+  const unsigned nbodies{ static_cast<unsigned>( I0.cols() ) };
   const unsigned nvdofs{ 6 * nbodies };
 
   SparseMatrixsc Mbody{ static_cast<SparseMatrixsc::Index>( nvdofs ), static_cast<SparseMatrixsc::Index>( nvdofs ) };
@@ -209,8 +224,8 @@ static SparseMatrixsc formWorldSpaceInverseMassMatrix( const std::vector<scalar>
     {
       const unsigned col{ 3 * bdy_idx + dof_idx };
       const unsigned row{ col };
-      assert( M[ bdy_idx ] > 0.0 );
-      Mbody.insert( row, col ) = 1.0 / M[ bdy_idx ];
+      assert( M( bdy_idx ) > 0.0 );
+      Mbody.insert( row, col ) = 1.0 / M( bdy_idx );
     }
   }
 
@@ -218,10 +233,10 @@ static SparseMatrixsc formWorldSpaceInverseMassMatrix( const std::vector<scalar>
   for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
     // Transform from principal axes rep
-    const Eigen::Map<const Matrix33sr> Rmat{ R[bdy_idx].data() };
+    const Eigen::Map<const Matrix33sr> Rmat{ q.data() + 3 * nbodies + 9 * bdy_idx };
     assert( ( Rmat * Rmat.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() <= 1.0e-9 );
     assert( fabs( Rmat.determinant() - 1.0 ) <= 1.0e-9 );
-    const Matrix33sr Iinv = Rmat * I0[bdy_idx].array().inverse().matrix().asDiagonal() * Rmat.transpose();
+    const Matrix33sr Iinv = Rmat * I0.col( bdy_idx ).array().inverse().matrix().asDiagonal() * Rmat.transpose();
     assert( ( Iinv - Iinv.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-12 );
     assert( Iinv.determinant() > 0.0 );
     for( unsigned row_idx = 0; row_idx < 3; ++row_idx )
@@ -249,57 +264,66 @@ void RigidBody3DState::setState( const std::vector<Vector3s>& X, const std::vect
   assert( X.size() == fixed.size() );
   assert( X.size() == geom_indices.size() );
 
-  m_nbodies = unsigned( X.size() );
+  const unsigned nbodies{ unsigned( X.size() ) };
 
-  // Initialize q
-  const unsigned nqdofs{ 12 * unsigned( X.size() ) };
-  m_q.resize( nqdofs );
-  // Load in center of mass positions
-  for( std::vector<Vector3s>::size_type body_num = 0; body_num < X.size(); ++body_num )
-  {
-    m_q.segment<3>( 3 * body_num ) = X[body_num];
-  }
-  // Load in the orientations
-  for( std::vector<VectorXs>::size_type body_num = 0; body_num < R.size(); ++body_num )
+  VectorXs q{ 12 * nbodies };
+  VectorXs v{ 6 * nbodies };
+  VectorXs packed_M{ nbodies };
+  Matrix3Xsc packed_I0{ 3, nbodies };
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
-    m_q.segment<9>( 3 * m_nbodies + 9 * body_num ) = R[body_num];
-    #ifndef NDEBUG
-    {
-      const Eigen::Map<const Matrix33sr> Rmat{ R[body_num].data() };
-      assert( ( Rmat * Rmat.transpose()- Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() < 1.0e-9 );
-      assert( fabs( Rmat.determinant() - 1.0 ) <= 1.0e-9 );
-    }
-    #endif
+    q.segment<3>( 3 * bdy_idx ) = X[bdy_idx];
+    q.segment<9>( 3 * nbodies + 9 * bdy_idx ) = R[bdy_idx];
+    v.segment<3>( 3 * bdy_idx ) = V[bdy_idx];
+    v.segment<3>( 3 * nbodies + 3 * bdy_idx ) = omega[bdy_idx];
+    packed_M( bdy_idx ) = M[bdy_idx];
+    packed_I0.col( bdy_idx ) = I0[bdy_idx];
   }
 
-  // Initialize v
-  const unsigned nvdofs{ 6 * unsigned( omega.size() ) };
-  m_v.resize( nvdofs );
-  // Load in center mass velocities
-  for( std::vector<Vector3s>::size_type body_num = 0; body_num < V.size(); ++body_num )
-  {
-    m_v.segment<3>( 3 * body_num ) = V[body_num];
-  }
-  // Load in angular velocities
-  for( std::vector<Vector3s>::size_type body_num = 0; body_num < omega.size(); ++body_num )
+  setState( std::move( q ), std::move( v ), packed_M, packed_I0, fixed, geom_indices, geometry );
+}
+
+void RigidBody3DState::setState( VectorXs q, VectorXs v, const VectorXs& M, const Matrix3Xsc& I0, std::vector<bool> fixed, std::vector<unsigned> geom_indices, const std::vector<std::unique_ptr<RigidBodyGeometry>>& geometry )
+{
+  assert( q.size() % 12 == 0 );
+  m_nbodies = unsigned( q.size() / 12 );
+  assert( v.size() == 6 * m_nbodies );
+  assert( M.size() == m_nbodies );
+  assert( I0.cols() == m_nbodies );
+  assert( fixed.size() == m_nbodies );
+  assert( geom_indices.size() == m_nbodies );
+
+  #ifndef NDEBUG
+  for( unsigned bdy_idx = 0; bdy_idx < m_nbodies; ++bdy_idx )
   {
-    m_v.segment<3>( 3 * m_nbodies + 3 * body_num ) = omega[body_num];
+    const Eigen::Map<const Matrix33sr> Rmat{ q.data() + 3 * m_nbodies + 9 * bdy_idx };
+    assert( ( Rmat * Rmat.transpose()- Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() < 1.0e-9 );
+    assert( fabs( Rmat.determinant() - 1.0 ) <= 1.0e-9 );
   }
+  #endif
+
+  using std::swap;
+  swap( m_q, q );
+  swap( m_v, v );
 
   // Load the mass matrices
-  if( nvdofs > 0 )
+  if( m_nbodies > 0 )
   {
     m_M0 = formBodySpaceMassMatrix( M, I0 );
     m_Minv0 = formBodySpaceInverseMassMatrix( M, I0 );
-    m_M = formWorldSpaceMassMatrix( M, I0, R );
-    m_Minv = formWorldSpaceInverseMassMatrix( M, I0, R );
+    m_M = formWorldSpaceMassMatrix( M, I0, m_q );
+    m_Minv = formWorldSpaceInverseMassMatrix( M, I0, m_q );
   }
+  m_inertia_orientations.resize( 0 );
 
   assert( MathUtilities::isIdentity( m_M0 * m_Minv0, 1.0e-9 ) );
   assert( MathUtilities::isIdentity( m_M * m_Minv, 1.0e-9 ) );
 
-  m_fixed = fixed;
-  m_geometry_indices = geom_indices;
+  swap( m_fixed, fixed );
+  m_sleeping_bodies.reset( m_fixed );
+  swap( m_geometry_indices, geom_indices );
+  m_body_ids.resize( m_nbodies );
+  std::iota( m_body_ids.begin(), m_body_ids.end(), 0 );
 
   // Load the geometry
   m_geometry = Utilities::clone( geometry );
@@ -388,6 +412,16 @@ bool RigidBody3DState::isKinematicallyScripted( const unsigned bdy_idx ) const
   return m_fixed[bdy_idx];
 }
 
+SleepingBodies& RigidBody3DState::sleepingBodies()
+{
+  return m_sleeping_bodies;
+}
+
+const SleepingBodies& RigidBody3DState::sleepingBodies() const
+{
+  return m_sleeping_bodies;
+}
+
 const std::vector<std::unique_ptr<RigidBodyGeometry>>& RigidBody3DState::geometry() const
 {
   return m_geometry;
@@ -421,8 +455,18 @@ const scalar& RigidBody3DState::getTotalMass( const unsigned body ) const
 const Eigen::Map<const Matrix33sr> RigidBody3DState::getInertia( const unsigned body ) const
 {
   assert( body < nbodies() );
-  assert( ( Eigen::Map<const Matrix33sr>( &M().valuePtr()[ 3 * nbodies() + 9 * body ] ) - Eigen::Map<const Matrix33sr>( &M().valuePtr()[ 3 * nbodies() + 9 * body ] ).transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-12 );
-  return Eigen::Map<const Matrix33sr>( &M().valuePtr()[ 3 * nbodies() + 9 * body ] );
+  // The inertia is symmetric, so its column major storage can be read as row major
+  const Eigen::Map<const Matrix33sc> I{ RigidBodyMass3D::rotationalBlock( M(), body ) };
+  assert( ( I - I.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-12 );
+  return Eigen::Map<const Matrix33sr>( I.data() );
+}
+
+const Eigen::Map<const Matrix33sr> RigidBody3DState::getInverseInertia( const unsigned body ) const
+{
+  assert( body < nbodies() );
+  const Eigen::Map<const Matrix33sc> Iinv{ RigidBodyMass3D::rotationalBlock( Minv(), body ) };
+  assert( ( Iinv - Iinv.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-11 );
+  return Eigen::Map<const Matrix33sr>( Iinv.data() );
 }
 
 void RigidBody3DState::updateMandMinv()
@@ -432,6 +476,13 @@ void RigidBody3DState::updateMandMinv()
   assert( unsigned( m_M.nonZeros() ) == 12 * nbodies() );
   assert( m_M.nonZeros() == m_Minv.nonZeros() );
 
+  // Without cached orientations, every body is updated
+  const bool update_all{ m_inertia_orientations.size() != 9 * m_nbodies };
+  if( update_all )
+  {
+    m_inertia_orientations.resize( 9 * m_nbodies );
+  }
+
   for( unsigned bdy_idx = 0; bdy_idx < m_nbodies; ++bdy_idx )
   {
     // Orientation of the ith body
@@ -439,23 +490,36 @@ void RigidBody3DState::updateMandMinv()
     assert( fabs( ( R * R.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() ) <= 1.0e-9 );
     assert( fabs( R.determinant() - 1.0 ) <= 1.0e-9 );
 
-    // Inertia tensor of the ith body
+    // Skip bodies that have not rotated, such as kinematic and resting bodies
+    Eigen::Map<Matrix33sr> R_cached{ m_inertia_orientations.segment<9>( 9 * bdy_idx ).data() };
+    if( !update_all && R_cached == R )
     {
-      Eigen::Map<Matrix33sc> I{ &m_M.data().value( 3 * m_nbodies + 9 * bdy_idx ) };
-      const Eigen::Map<const Vector3s> I0{ &m_M0.data().value( 3 * m_nbodies + 3 * bdy_idx ) };
-      I = R * I0.asDiagonal() * R.transpose();
-      assert( ( I - I.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-12 );
-      assert( I.determinant() > 0.0 );
+      continue;
     }
+    R_cached = R;
 
-    // Inverse of the inertia tensor of the ith body
+    const Eigen::Map<const Vector3s> I0{ RigidBodyMass3D::principalMoments( m_M0, bdy_idx ) };
+    const Eigen::Map<const Vector3s> Iinv0{ RigidBodyMass3D::principalMoments( m_Minv0, bdy_idx ) };
+    Eigen::Map<Matrix33sc> I{ RigidBodyMass3D::rotationalBlock( m_M, bdy_idx ) };
+    Eigen::Map<Matrix33sc> Iinv{ RigidBodyMass3D::rotationalBlock( m_Minv, bdy_idx ) };
+
+    // Isotropic inertia, e.g. of a sphere, does not depend on the orientation
+    if( I0.x() == I0.y() && I0.x() == I0.z() )
     {
-      Eigen::Map<Matrix33sc> Iinv{ &m_Minv.data().value( 3 * m_nbodies + 9 * bdy_idx ) };
-      const Eigen::Map<const Vector3s> Iinv0{ &m_Minv0.data().value( 3 * m_nbodies + 3 * bdy_idx ) };
-      Iinv = R * Iinv0.asDiagonal() * R.transpose();
-      assert( ( Iinv - Iinv.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-11 );
-      assert( Iinv.determinant() > 0.0 );
+      I = I0.asDiagonal();
+      Iinv = Iinv0.asDiagonal();
+      continue;
     }
+
+    // Inertia tensor of the ith body
+    I = R * I0.asDiagonal() * R.transpose();
+    assert( ( I - I.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-12 );
+    assert( I.determinant() > 0.0 );
+
+    // Inverse of the inertia tensor of the ith body
+    Iinv = R * Iinv0.asDiagonal() * R.transpose();
+    assert( ( Iinv - Iinv.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-11 );
+    assert( Iinv.determinant() > 0.0 );
   }
 
   assert( MathUtilities::isIdentity( m_M * m_Minv, 1.0e-9 ) );
@@ -582,6 +646,76 @@ const Vector3s& RigidBody3DState::boundaryMax() const
   return m_boundary_max;
 }
 
+const std::vector<unsigned>& RigidBody3DState::bodyIds() const
+{
+  return m_body_ids;
+}
+
+// Permutes the per-body values of a block diagonal mass matrix: block_size values for each body's
+// linear degrees of freedom followed by inertia_size values for each body's angular degrees of freedom
+static void permuteMassMatrixValues( const std::vector<unsigned>& order, const unsigned inertia_size, SparseMatrixsc& M )
+{
+  const unsigned nbodies{ unsigned( order.size() ) };
+  assert( unsigned( M.nonZeros() ) == ( 3 + inertia_size ) * nbodies );
+  const VectorXs old_values{ Eigen::Map<const VectorXs>{ M.valuePtr(), M.nonZeros() } };
+  Eigen::Map<VectorXs> values{ M.valuePtr(), M.nonZeros() };
+  for( unsigned new_idx = 0; new_idx < nbodies; ++new_idx )
+  {
+    const unsigned old_idx{ order[new_idx] };
+    values.segment<3>( 3 * new_idx ) = old_values.segment<3>( 3 * old_idx );
+    values.segment( 3 * nbodies + inertia_size * new_idx, inertia_size ) = old_values.segment( 3 * nbodies + inertia_size * old_idx, inertia_size );
+  }
+}
+
+void RigidBody3DState::permuteBodies( const std::vector<unsigned>& order )
+{
+  assert( order.size() == m_nbodies );
+
+  const VectorXs q_old{ m_q };
+  const VectorXs v_old{ m_v };
+  const std::vector<bool> fixed_old{ m_fixed };
+  const std::vector<unsigned> geometry_indices_old{ m_geometry_indices };
+  const std::vector<unsigned> body_ids_old{ m_body_ids };
+  for( unsigned new_idx = 0; new_idx < m_nbodies; ++new_idx )
+  {
+    const unsigned old_idx{ order[new_idx] };
+    assert( old_idx < m_nbodies );
+    m_q.segment<3>( 3 * new_idx ) = q_old.segment<3>( 3 * old_idx );
+    m_q.segment<9>( 3 * m_nbodies + 9 * new_idx ) = q_old.segment<9>( 3 * m_nbodies + 9 * old_idx );
+    m_v.segment<3>( 3 * new_idx ) = v_old.segment<3>( 3 * old_idx );
+    m_v.segment<3>( 3 * m_nbodies + 3 * new_idx ) = v_old.segment<3>( 3 * m_nbodies + 3 * old_idx );
+    m_fixed[new_idx] = fixed_old[old_idx];
+    m_geometry_indices[new_idx] = geometry_indices_old[old_idx];
+    m_body_ids[new_idx] = body_ids_old[old_idx];
+  }
+  m_sleeping_bodies.permuteBodies( order );
+
+  // The sparsity pattern of the mass matrices is the same for every body, so only the values move
+  permuteMassMatrixValues( order, 3, m_M0 );
+  permuteMassMatrixValues( order, 3, m_Minv0 );
+  permuteMassMatrixValues( order, 9, m_M );
+  permuteMassMatrixValues( order, 9, m_Minv );
+  if( m_inertia_orientations.size() == 9 * m_nbodies )
+  {
+    const VectorXs inertia_orientations_old{ m_inertia_orientations };
+    for( unsigned new_idx = 0; new_idx < m_nbodies; ++new_idx )
+    {
+      m_inertia_orientations.segment<9>( 9 * new_idx ) = inertia_orientations_old.segment<9>( 9 * order[new_idx] );
+    }
+  }
+  assert( MathUtilities::isIdentity( m_M * m_Minv, 1.0e-9 ) );
+}
+
+void RigidBody3DState::setRenumberingFrequency( const unsigned steps )
+{
+  m_renumbering_frequency = steps;
+}
+
+unsigned RigidBody3DState::renumberingFrequency() const
+{
+  return m_renumbering_frequency;
+}
+
 void RigidBody3DState::serialize( std::ostream& output_stream ) const
 {
   assert( output_stream.good() );
@@ -603,6 +737,31 @@ void RigidBody3DState::serialize( std::ostream& output_stream ) const
   Utilities::serialize( m_boundary_behavior, output_stream );
   MathUtilities::serialize( m_boundary_min, output_stream );
   MathUtilities::serialize( m_boundary_max, output_stream );
+  Utilities::serialize( m_body_ids, output_stream );
+  Utilities::serialize( m_renumbering_frequency, output_stream );
+  m_sleeping_bodies.serialize( output_stream );
+}
+
+static std::unique_ptr<RigidBodyGeometry> deserializeGeometryInstance( std::istream& input_stream )
+{
+  // Read in the geometry type
+  const RigidBodyGeometryType geo_type{ Utilities::deserialize<RigidBodyGeometryType>( input_stream ) };
+  switch( geo_type )
+  {
+    case RigidBodyGeometryType::BOX:
+      return std::unique_ptr<RigidBodyGeometry>{ new RigidBodyBox{ input_stream } };
+    case RigidBodyGeometryType::SPHERE:
+      return std::unique_ptr<RigidBodyGeometry>{ new RigidBodySphere{ input_stream } };
+    case RigidBodyGeometryType::STAPLE:
+      std::cerr << "Staple geometry not yet supported in RigidBody3DState::deserialize" << std::endl;
+      std::cerr << "Exiting." << std::endl;
+      std::exit( EXIT_FAILURE );
+    case RigidBodyGeometryType::TRIANGLE_MESH:
+      return std::unique_ptr<RigidBodyGeometry>{ new RigidBodyTriangleMesh{ input_stream } };
+  }
+  std::cerr << "Unknown geometry type in RigidBody3DState::deserialize" << std::endl;
+  std::cerr << "Exiting." << std::endl;
+  std::exit( EXIT_FAILURE );
 }
 
 static std::vector<std::unique_ptr<RigidBodyGeometry>> deserializeGeometry( std::istream& input_stream )
@@ -612,24 +771,7 @@ static std::vector<std::unique_ptr<RigidBodyGeometry>> deserializeGeometry( std:
   assert( geometry.size() == ngeo );
   for( std::vector<std::unique_ptr<RigidBodyGeometry>>::size_type geo_idx = 0; geo_idx < geometry.size(); ++geo_idx )
   {
-    // Read in the geometry type
-    const RigidBodyGeometryType geo_type{ Utilities::deserialize<RigidBodyGeometryType>( input_stream ) };
-    switch( geo_type )
-    {
-      case RigidBodyGeometryType::BOX:
-        geometry[geo_idx].reset( new RigidBodyBox{ input_stream } );
-        break;
-      case RigidBodyGeometryType::SPHERE:
-        geometry[geo_idx].reset( new RigidBodySphere{ input_stream } );
-        break;
-      case RigidBodyGeometryType::STAPLE:
-        std::cerr << "Staple geometry not yet supported in RigidBody3DState::deserialize" << std::endl;
-        std::cerr << "Exiting." << std::endl;
-        std::exit( EXIT_FAILURE );
-      case RigidBodyGeometryType::TRIANGLE_MESH:
-        geometry[geo_idx].reset( new RigidBodyTriangleMesh{ input_stream } );
-        break;
-    }
+    geometry[geo_idx] = deserializeGeometryInstance( input_stream );
   }
   return geometry;
 }
@@ -666,6 +808,7 @@ void RigidBody3DState::deserialize( std::istream& input_stream )
   MathUtilities::deserialize( m_Minv0, input_stream );
   MathUtilities::deserialize( m_M, input_stream );
   MathUtilities::deserialize( m_Minv, input_stream );
+  m_inertia_orientations.resize( 0 );
   m_fixed = Utilities::deserialize<std::vector<bool>>( input_stream );
   m_geometry = deserializeGeometry( input_stream );
   m_geometry_indices = Utilities::deserialize<std::vector<unsigned>>( input_stream );
@@ -676,4 +819,211 @@ void RigidBody3DState::deserialize( std::istream& input_stream )
   m_boundary_behavior = Utilities::deserialize<SimBoundaryBehavior>( input_stream );
   m_boundary_min = MathUtilities::deserialize<Vector3s>( input_stream );
   m_boundary_max = MathUtilities::deserialize<Vector3s>( input_stream );
+  m_body_ids = Utilities::deserialize<std::vector<unsigned>>( input_stream );
+  m_renumbering_frequency = Utilities::deserialize<unsigned>( input_stream );
+  m_sleeping_bodies.deserialize( input_stream );
+  m_sleeping_bodies.setFixedBodies( m_fixed );
+}
+
+static std::string geometryBlobSectionName( const unsigned blob_idx )
+{
+  return "state/geometry_blob_" + StringUtilities::convertToString( blob_idx );
+}
+
+void RigidBody3DState::writeCheckpoint( CheckpointWriter& checkpoint ) const
+{
+  checkpoint.addArray( "state/q", m_q );
+  checkpoint.addArray( "state/v", m_v );
+  // M0 is diagonal; Minv0, M, and Minv are derived from it and the orientations
+  assert( unsigned( m_M0.nonZeros() ) == 6 * m_nbodies );
+  checkpoint.addArray( "state/M0", m_M0.valuePtr(), std::size_t( m_M0.nonZeros() ) );
+  {
+    const std::vector<std::uint8_t> fixed{ m_fixed.cbegin(), m_fixed.cend() };
+    checkpoint.addArray( "state/fixed", fixed.data(), fixed.size() );
+  }
+  checkpoint.addArray( "state/geometry_indices", m_geometry_indices.data(), m_geometry_indices.size() );
+  checkpoint.addArray( "state/body_ids", m_body_ids.data(), m_body_ids.size() );
+
+  // Geometry that serializes to the same bytes, such as many bodies loaded from one mesh file, is stored once
+  {
+    std::unordered_map<std::string,unsigned> blob_indices;
+    std::vector<unsigned> geometry_blobs( m_geometry.size() );
+    for( std::vector<std::unique_ptr<RigidBodyGeometry>>::size_type geo_idx = 0; geo_idx < m_geometry.size(); ++geo_idx )
+    {
+      std::ostringstream geometry_stream{ std::ios::binary };
+      m_geometry[geo_idx]->serialize( geometry_stream );
+      std::string blob{ geometry_stream.str() };
+      const std::unordered_map<std::string,unsigned>::const_iterator existing_blob{ blob_indices.find( blob ) };
+      if( existing_blob != blob_indices.cend() )
+      {
+        geometry_blobs[geo_idx] = existing_blob->second;
+        continue;
+      }
+      const unsigned blob_idx{ unsigned( blob_indices.size() ) };
+      checkpoint.addSection( geometryBlobSectionName( blob_idx ), blob );
+      blob_indices.emplace( std::move( blob ), blob_idx );
+      geometry_blobs[geo_idx] = blob_idx;
+    }
+    checkpoint.addArray( "state/geometry_blobs", geometry_blobs.data(), geometry_blobs.size() );
+  }
+
+  writeCheckpointOtherState( checkpoint );
+}
+
+void RigidBody3DState::writeCheckpointOtherState( CheckpointWriter& checkpoint ) const
+{
+  // The remaining state is small and is serialized as usual
+  std::ostringstream other_stream{ std::ios::binary };
+  Utilities::serialize( m_forces, other_stream );
+  Utilities::serialize( m_static_planes, other_stream );
+  Utilities::serialize( m_static_cylinders, other_stream );
+  Utilities::serialize( m_planar_portals, other_stream );
+  Utilities::serialize( m_boundary_behavior, other_stream );
+  MathUtilities::serialize( m_boundary_min, other_stream );
+  MathUtilities::serialize( m_boundary_max, other_stream );
+  Utilities::serialize( m_renumbering_frequency, other_stream );
+  checkpoint.addSection( "state/other", other_stream.str() );
+
+  // Rest counters and sleeping islands change every step, so they are part of every delta
+  std::ostringstream sleeping_stream{ std::ios::binary };
+  m_sleeping_bodies.serialize( sleeping_stream );
+  checkpoint.addSection( "state/sleeping_bodies", sleeping_stream.str() );
+}
+
+template<typename T>
+static std::vector<T> readCheckpointVector( const CheckpointReader& checkpoint, const std::string& name, const std::size_t expected_size )
+{
+  const Eigen::Map<const Eigen::Matrix<T,Eigen::Dynamic,1>> array{ checkpoint.array<T>( name ) };
+  if( std::size_t( array.size() ) != expected_size )
+  {
+    throw std::string{ "Checkpoint section " } + name + " has an incorrect size";
+  }
+  return std::vector<T>( array.data(), array.data() + array.size() );
+}
+
+void RigidBody3DState::readCheckpoint( const CheckpointReader& checkpoint )
+{
+  m_q = checkpoint.array<scalar>( "state/q" );
+  m_v = checkpoint.array<scalar>( "state/v" );
+  if( m_q.size() % 12 != 0 || m_v.size() != m_q.size() / 2 )
+  {
+    throw std::string{ "Checkpoint configuration and velocity have inconsistent sizes" };
+  }
+  m_nbodies = unsigned( m_q.size() / 12 );
+
+  // Rebuild the mass matrices from the body space masses and the orientations
+  {
+    const std::vector<scalar> M0{ readCheckpointVector<scalar>( checkpoint, "state/M0", 6 * m_nbodies ) };
+    const VectorXs M{ Eigen::Map<const VectorXs,0,Eigen::InnerStride<3>>{ M0.data(), m_nbodies } };
+    const Matrix3Xsc I0{ Eigen::Map<const Matrix3Xsc>{ M0.data() + 3 * m_nbodies, 3, m_nbodies } };
+    m_M0 = formBodySpaceMassMatrix( M, I0 );
+    m_Minv0 = formBodySpaceInverseMassMatrix( M, I0 );
+    m_M = formWorldSpaceMassMatrix( M, I0, m_q );
+    m_Minv = formWorldSpaceInverseMassMatrix( M, I0, m_q );
+    // Matches the world space matrices of an uninterrupted run exactly
+    m_inertia_orientations.resize( 0 );
+    updateMandMinv();
+  }
+
+  {
+    const std::vector<std::uint8_t> fixed{ readCheckpointVector<std::uint8_t>( checkpoint, "state/fixed", m_nbodies ) };
+    m_fixed.assign( fixed.cbegin(), fixed.cend() );
+  }
+  m_geometry_indices = readCheckpointVector<unsigned>( checkpoint, "state/geometry_indices", m_nbodies );
+  m_body_ids = readCheckpointVector<unsigned>( checkpoint, "state/body_ids", m_nbodies );
+
+  // Each blob is deserialized once, geometry sharing a blob receives a copy
+  {
+    const Eigen::Map<const Eigen::Matrix<unsigned,Eigen::Dynamic,1>> geometry_blobs{ checkpoint.array<unsigned>( "state/geometry_blobs" ) };
+    std::vector<const RigidBodyGeometry*> blob_geometry;
+    m_geometry.resize( std::size_t( geometry_blobs.size() ) );
+    for( std::vector<std::unique_ptr<RigidBodyGeometry>>::size_type geo_idx = 0; geo_idx < m_geometry.size(); ++geo_idx )
+    {
+      const unsigned blob_idx{ geometry_blobs( Eigen::Index( geo_idx ) ) };
+      if( blob_idx < blob_geometry.size() )
+      {
+        m_geometry[geo_idx] = blob_geometry[blob_idx]->clone();
+        continue;
+      }
+      if( blob_idx != blob_geometry.size() )
+      {
+        throw std::string{ "Checkpoint geometry blobs are out of order" };
+      }
+      m_geometry[geo_idx] = deserializeGeometryInstance( *checkpoint.stream( geometryBlobSectionName( blob_idx ) ) );
+      blob_geometry.emplace_back( m_geometry[geo_idx].get() );
+    }
+  }
+  if( !std::all_of( m_geometry_indices.cbegin(), m_geometry_indices.cend(), [this]( const unsigned idx ) { return idx < m_geometry.size(); } ) )
+  {
+    throw std::string{ "Checkpoint geometry indices are out of range" };
+  }
+
+  readCheckpointOtherState( checkpoint );
+}
+
+void RigidBody3DState::readCheckpointOtherState( const CheckpointReader& checkpoint )
+{
+  const std::unique_ptr<std::istream> other_stream{ checkpoint.stream( "state/other" ) };
+  m_forces = deserializeForces( *other_stream );
+  m_static_planes = Utilities::deserialize<std::vector<StaticPlane>>( *other_stream );
+  m_static_cylinders = Utilities::deserialize<std::vector<StaticCylinder>>( *other_stream );
+  m_planar_portals = Utilities::deserialize<std::vector<PlanarPortal>>( *other_stream );
+  m_boundary_behavior = Utilities::deserialize<SimBoundaryBehavior>( *other_stream );
+  m_boundary_min = MathUtilities::deserialize<Vector3s>( *other_stream );
+  m_boundary_max = MathUtilities::deserialize<Vector3s>( *other_stream );
+  m_renumbering_frequency = Utilities::deserialize<unsigned>( *other_stream );
+
+  m_sleeping_bodies.deserialize( *checkpoint.stream( "state/sleeping_bodies" ) );
+  if( m_sleeping_bodies.numBodies() != m_nbodies )
+  {
+    throw std::string{ "Checkpoint sleeping bodies do not match the number of bodies" };
+  }
+  m_sleeping_bodies.setFixedBodies( m_fixed );
+}
+
+void RigidBody3DState::writeCheckpointDelta( CheckpointWriter& checkpoint ) const
+{
+  checkpoint.addArray( "state/q", m_q );
+  checkpoint.addArray( "state/v", m_v );
+  checkpoint.addArray( "state/body_ids", m_body_ids.data(), m_body_ids.size() );
+  writeCheckpointOtherState( checkpoint );
+}
+
+void RigidBody3DState::readCheckpointDelta( const CheckpointReader& checkpoint )
+{
+  const std::vector<unsigned> body_ids{ readCheckpointVector<unsigned>( checkpoint, "state/body_ids", m_nbodies ) };
+
+  // Bodies renumbered since the full checkpoint was written are matched by id, carrying their
+  // masses, geometry, and fixed flags with them
+  {
+    std::vector<unsigned> body_of_id( m_nbodies, m_nbodies );
+    for( unsigned bdy_idx = 0; bdy_idx < m_nbodies; ++bdy_idx )
+    {
+      assert( m_body_ids[bdy_idx] < m_nbodies );
+      body_of_id[m_body_ids[bdy_idx]] = bdy_idx;
+    }
+    std::vector<unsigned> order( m_nbodies );
+    for( unsigned bdy_idx = 0; bdy_idx < m_nbodies; ++bdy_idx )
+    {
+      if( body_ids[bdy_idx] >= m_nbodies || body_of_id[body_ids[bdy_idx]] == m_nbodies )
+      {
+        throw std::string{ "Checkpoint delta contains a body that is not in its full checkpoint" };
+      }
+      order[bdy_idx] = body_of_id[body_ids[bdy_idx]];
+      // Each body of the full checkpoint is used once
+      body_of_id[body_ids[bdy_idx]] = m_nbodies;
+    }
+    permuteBodies( order );
+  }
+  assert( m_body_ids == body_ids );
+
+  m_q = checkpoint.array<scalar>( "state/q" );
+  m_v = checkpoint.array<scalar>( "state/v" );
+  if( m_q.size() != Eigen::Index( 12 * m_nbodies ) || m_v.size() != Eigen::Index( 6 * m_nbodies ) )
+  {
+    throw std::string{ "Checkpoint delta configuration and velocity do not match its full checkpoint" };
+  }
+  updateMandMinv();
+
+  readCheckpointOtherState( checkpoint );
 }
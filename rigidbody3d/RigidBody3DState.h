@@ -8,8 +8,11 @@
 #include "StaticGeometry/StaticCylinder.h"
 #include "Forces/Force.h"
 #include "Geometry/RigidBodyGeometry.h"
+#include "SleepingBodies.h"
 
 class StaticPlane;
+class CheckpointWriter;
+class CheckpointReader;
 
 enum class SimBoundaryBehavior
 {
@@ -33,6 +36,10 @@ public:
   RigidBody3DState& operator=( RigidBody3DState&& ) = default;
 
   void setState( const std::vector<Vector3s>& X, const std::vector<Vector3s>& V, const std::vector<scalar>& M, const std::vector<VectorXs>& R, const std::vector<Vector3s>& omega, const std::vector<Vector3s>& I0, const std::vector<bool>& fixed, const std::vector<unsigned>& geom_indices, const std::vector<std::unique_ptr<RigidBodyGeometry>>& geometry );
+  // Takes ownership of packed state without per body copies: q holds all center of mass positions
+  // followed by all row major orientations, v all center of mass velocities followed by all angular
+  // velocities, M the total masses, and the columns of I0 the principal moments of inertia
+  void setState( VectorXs q, VectorXs v, const VectorXs& M, const Matrix3Xsc& I0, std::vector<bool> fixed, std::vector<unsigned> geom_indices, const std::vector<std::unique_ptr<RigidBodyGeometry>>& geometry );
 
   unsigned nbodies() const;
   unsigned ngeo() const;
@@ -59,6 +66,10 @@ public:
 
   bool isKinematicallyScripted( const unsigned bdy_idx ) const;
 
+  // Bodies at rest that are temporarily treated as kinematic, and the thresholds used to detect them
+  SleepingBodies& sleepingBodies();
+  const SleepingBodies& sleepingBodies() const;
+
   const std::vector<std::unique_ptr<RigidBodyGeometry>>& geometry() const;
 
   const std::vector<unsigned>& indices() const;
@@ -71,7 +82,11 @@ public:
   const scalar& getTotalMass( const unsigned body ) const;
 
   const Eigen::Map<const Matrix33sr> getInertia( const unsigned body ) const;
+  const Eigen::Map<const Matrix33sr> getInverseInertia( const unsigned body ) const;
 
+  // Updates the world space inertia blocks of M and Minv to the current orientations. Only bodies
+  // whose orientation changed since the last update are visited, and bodies with isotropic inertia
+  // are updated without forming rotated tensors.
   void updateMandMinv();
 
   std::vector<std::unique_ptr<Force>>& forces();
@@ -107,11 +122,34 @@ public:
   const Vector3s& boundaryMin() const;
   const Vector3s& boundaryMax() const;
 
+  // Id of each body, its index when the state was set. Ids are preserved when bodies are renumbered.
+  const std::vector<unsigned>& bodyIds() const;
+
+  // Renumbers the bodies so that body order[i] becomes body i. All per-body state moves with its body.
+  void permuteBodies( const std::vector<unsigned>& order );
+
+  // Number of steps between renumberings of the bodies along a space filling curve, 0 to disable
+  void setRenumberingFrequency( const unsigned steps );
+  unsigned renumberingFrequency() const;
+
   void serialize( std::ostream& output_stream ) const;
   void deserialize( std::istream& input_stream );
 
+  // Checkpoint sections: the configuration, velocity and body space masses are stored as arrays, the
+  // world space and inverse mass matrices are rebuilt on load, and identical geometry is stored once
+  void writeCheckpoint( CheckpointWriter& checkpoint ) const;
+  void readCheckpoint( const CheckpointReader& checkpoint );
+
+  // Delta checkpoints hold only what changes over a simulation: the configuration, velocity, body
+  // ids, and the small remaining state. A delta is applied to the state read from its full checkpoint.
+  void writeCheckpointDelta( CheckpointWriter& checkpoint ) const;
+  void readCheckpointDelta( const CheckpointReader& checkpoint );
+
 private:
 
+  void writeCheckpointOtherState( CheckpointWriter& checkpoint ) const;
+  void readCheckpointOtherState( const CheckpointReader& checkpoint );
+
   unsigned m_nbodies;
   VectorXs m_q;
   VectorXs m_v;
@@ -119,7 +157,11 @@ private:
   SparseMatrixsc m_Minv0;
   SparseMatrixsc m_M;
   SparseMatrixsc m_Minv;
+  // Orientations the inertia blocks of m_M and m_Minv were last updated for; empty if the blocks
+  // must all be recomputed
+  VectorXs m_inertia_orientations;
   std::vector<bool> m_fixed;
+  SleepingBodies m_sleeping_bodies;
   std::vector<std::unique_ptr<RigidBodyGeometry>> m_geometry;
   std::vector<unsigned> m_geometry_indices;
   std::vector<std::unique_ptr<Force>> m_forces;
@@ -131,6 +173,9 @@ private:
   Vector3s m_boundary_min;
   Vector3s m_boundary_max;
 
+  std::vector<unsigned> m_body_ids;
+  unsigned m_renumbering_frequency;
+
 };
 
 #endif
@@ -0,0 +1,293 @@
+#include "SleepingBodies.h"
+
+#include <algorithm>
+
+#include "scisim/Utilities.h"
+
+constexpr unsigned SleepingBodies::AWAKE;
+
+SleepingBodies::SleepingBodies()
+: m_linear_velocity( 0.0 )
+, m_angular_velocity( 0.0 )
+, m_impulse( 0.0 )
+, m_steps( 0 )
+, m_rest_steps()
+, m_islands()
+, m_asleep_bodies()
+, m_held()
+{}
+
+void SleepingBodies::setParameters( const scalar& linear_velocity, const scalar& angular_velocity, const scalar& impulse, const unsigned steps )
+{
+  assert( linear_velocity >= 0.0 ); assert( angular_velocity >= 0.0 ); assert( impulse >= 0.0 );
+  m_linear_velocity = linear_velocity;
+  m_angular_velocity = angular_velocity;
+  m_impulse = impulse;
+  m_steps = steps;
+  // Bodies asleep under the old parameters rejoin the simulation
+  if( m_steps == 0 )
+  {
+    wakeAll();
+  }
+}
+
+bool SleepingBodies::enabled() const
+{
+  return m_steps != 0;
+}
+
+const scalar& SleepingBodies::linearVelocityThreshold() const
+{
+  return m_linear_velocity;
+}
+
+const scalar& SleepingBodies::angularVelocityThreshold() const
+{
+  return m_angular_velocity;
+}
+
+const scalar& SleepingBodies::impulseThreshold() const
+{
+  return m_impulse;
+}
+
+unsigned SleepingBodies::steps() const
+{
+  return m_steps;
+}
+
+void SleepingBodies::reset( const std::vector<bool>& fixed )
+{
+  m_rest_steps.assign( fixed.size(), 0 );
+  m_islands.assign( fixed.size(), AWAKE );
+  m_asleep_bodies.clear();
+  m_held = fixed;
+}
+
+void SleepingBodies::setFixedBodies( const std::vector<bool>& fixed )
+{
+  assert( fixed.size() == m_islands.size() );
+  m_held = fixed;
+  for( const unsigned body : m_asleep_bodies )
+  {
+    m_held[body] = true;
+  }
+}
+
+void SleepingBodies::wakeAll()
+{
+  // Sleeping bodies are never fixed
+  for( const unsigned body : m_asleep_bodies )
+  {
+    m_islands[body] = AWAKE;
+    m_held[body] = false;
+  }
+  m_asleep_bodies.clear();
+  std::fill( m_rest_steps.begin(), m_rest_steps.end(), 0 );
+}
+
+unsigned SleepingBodies::numBodies() const
+{
+  return unsigned( m_islands.size() );
+}
+
+bool SleepingBodies::isAsleep( const unsigned body ) const
+{
+  assert( body < m_islands.size() );
+  return m_islands[body] != AWAKE;
+}
+
+unsigned SleepingBodies::numAsleep() const
+{
+  return unsigned( m_asleep_bodies.size() );
+}
+
+const std::vector<unsigned>& SleepingBodies::asleepBodies() const
+{
+  return m_asleep_bodies;
+}
+
+const std::vector<bool>& SleepingBodies::heldBodies() const
+{
+  return m_held;
+}
+
+bool SleepingBodies::isAtRest( const scalar& speed, const scalar& angular_speed, const scalar& linear_impulse, const scalar& angular_impulse ) const
+{
+  return speed <= m_linear_velocity && angular_speed <= m_angular_velocity && linear_impulse <= m_impulse && angular_impulse <= m_impulse;
+}
+
+unsigned SleepingBodies::wakeIslands( const std::vector<unsigned>& bodies )
+{
+  std::vector<unsigned> labels;
+  for( const unsigned body : bodies )
+  {
+    assert( body < m_islands.size() );
+    if( m_islands[body] != AWAKE )
+    {
+      labels.emplace_back( m_islands[body] );
+    }
+  }
+  if( labels.empty() )
+  {
+    return 0;
+  }
+  std::sort( labels.begin(), labels.end() );
+  labels.erase( std::unique( labels.begin(), labels.end() ), labels.end() );
+
+  // Sleeping bodies are never fixed, so woken bodies are no longer held
+  std::vector<unsigned>::size_type num_still_asleep{ 0 };
+  for( std::vector<unsigned>::size_type asleep_idx = 0; asleep_idx < m_asleep_bodies.size(); ++asleep_idx )
+  {
+    const unsigned body{ m_asleep_bodies[asleep_idx] };
+    if( std::binary_search( labels.cbegin(), labels.cend(), m_islands[body] ) )
+    {
+      m_islands[body] = AWAKE;
+      m_rest_steps[body] = 0;
+      m_held[body] = false;
+    }
+    else
+    {
+      m_asleep_bodies[num_still_asleep++] = body;
+    }
+  }
+  const unsigned num_woken{ unsigned( m_asleep_bodies.size() - num_still_asleep ) };
+  m_asleep_bodies.resize( num_still_asleep );
+  return num_woken;
+}
+
+static unsigned findRoot( std::vector<unsigned>& parents, unsigned body )
+{
+  while( parents[body] != body )
+  {
+    parents[body] = parents[parents[body]];
+    body = parents[body];
+  }
+  return body;
+}
+
+void SleepingBodies::update( const std::vector<bool>& at_rest, const std::vector<std::pair<unsigned,unsigned>>& contacts, const std::vector<unsigned>& body_ids, std::vector<unsigned>& fell_asleep )
+{
+  assert( at_rest.size() == m_islands.size() ); assert( body_ids.size() == m_islands.size() );
+  fell_asleep.clear();
+  if( !enabled() )
+  {
+    return;
+  }
+  const unsigned nbodies{ unsigned( m_islands.size() ) };
+
+  for( unsigned body = 0; body < nbodies; ++body )
+  {
+    if( m_islands[body] == AWAKE )
+    {
+      m_rest_steps[body] = at_rest[body] ? std::min( m_rest_steps[body] + 1, m_steps ) : 0;
+    }
+  }
+
+  // Join the bodies of each island
+  std::vector<unsigned> parents( nbodies );
+  for( unsigned body = 0; body < nbodies; ++body )
+  {
+    parents[body] = body;
+  }
+  for( const std::pair<unsigned,unsigned>& contact : contacts )
+  {
+    assert( contact.first < nbodies ); assert( contact.second < nbodies );
+    assert( m_islands[contact.first] == AWAKE ); assert( m_islands[contact.second] == AWAKE );
+    const unsigned root0{ findRoot( parents, contact.first ) };
+    const unsigned root1{ findRoot( parents, contact.second ) };
+    if( root0 != root1 )
+    {
+      parents[std::max( root0, root1 )] = std::min( root0, root1 );
+    }
+  }
+
+  // An island sleeps if its most recently disturbed body rested long enough
+  std::vector<unsigned> island_rest_steps( nbodies, m_steps );
+  std::vector<unsigned> island_labels( nbodies, AWAKE );
+  for( unsigned body = 0; body < nbodies; ++body )
+  {
+    if( m_islands[body] != AWAKE )
+    {
+      continue;
+    }
+    const unsigned root{ findRoot( parents, body ) };
+    island_rest_steps[root] = std::min( island_rest_steps[root], m_rest_steps[body] );
+    island_labels[root] = std::min( island_labels[root], body_ids[body] );
+  }
+  for( unsigned body = 0; body < nbodies; ++body )
+  {
+    if( m_islands[body] != AWAKE )
+    {
+      continue;
+    }
+    const unsigned root{ findRoot( parents, body ) };
+    if( island_rest_steps[root] >= m_steps )
+    {
+      assert( at_rest[body] ); assert( !m_held[body] );
+      m_islands[body] = island_labels[root];
+      m_held[body] = true;
+      fell_asleep.emplace_back( body );
+    }
+  }
+  if( !fell_asleep.empty() )
+  {
+    const std::vector<unsigned>::size_type num_already_asleep{ m_asleep_bodies.size() };
+    m_asleep_bodies.insert( m_asleep_bodies.end(), fell_asleep.cbegin(), fell_asleep.cend() );
+    std::inplace_merge( m_asleep_bodies.begin(), m_asleep_bodies.begin() + num_already_asleep, m_asleep_bodies.end() );
+  }
+}
+
+void SleepingBodies::permuteBodies( const std::vector<unsigned>& order )
+{
+  assert( order.size() == m_islands.size() );
+  const std::vector<unsigned> rest_steps_old{ m_rest_steps };
+  const std::vector<unsigned> islands_old{ m_islands };
+  const std::vector<bool> held_old{ m_held };
+  m_asleep_bodies.clear();
+  for( std::vector<unsigned>::size_type new_idx = 0; new_idx < order.size(); ++new_idx )
+  {
+    assert( order[new_idx] < m_islands.size() );
+    m_rest_steps[new_idx] = rest_steps_old[order[new_idx]];
+    m_islands[new_idx] = islands_old[order[new_idx]];
+    m_held[new_idx] = held_old[order[new_idx]];
+    if( m_islands[new_idx] != AWAKE )
+    {
+      m_asleep_bodies.emplace_back( unsigned( new_idx ) );
+    }
+  }
+}
+
+void SleepingBodies::serialize( std::ostream& output_stream ) const
+{
+  assert( output_stream.good() );
+  Utilities::serialize( m_linear_velocity, output_stream );
+  Utilities::serialize( m_angular_velocity, output_stream );
+  Utilities::serialize( m_impulse, output_stream );
+  Utilities::serialize( m_steps, output_stream );
+  Utilities::serialize( m_rest_steps, output_stream );
+  Utilities::serialize( m_islands, output_stream );
+}
+
+void SleepingBodies::deserialize( std::istream& input_stream )
+{
+  assert( input_stream.good() );
+  m_linear_velocity = Utilities::deserialize<scalar>( input_stream );
+  m_angular_velocity = Utilities::deserialize<scalar>( input_stream );
+  m_impulse = Utilities::deserialize<scalar>( input_stream );
+  m_steps = Utilities::deserialize<unsigned>( input_stream );
+  m_rest_steps = Utilities::deserialize<std::vector<unsigned>>( input_stream );
+  m_islands = Utilities::deserialize<std::vector<unsigned>>( input_stream );
+  assert( m_rest_steps.size() == m_islands.size() );
+  // The fixed bodies are not known here, so only the sleeping bodies are held until setFixedBodies
+  m_asleep_bodies.clear();
+  m_held.assign( m_islands.size(), false );
+  for( std::vector<unsigned>::size_type body = 0; body < m_islands.size(); ++body )
+  {
+    if( m_islands[body] != AWAKE )
+    {
+      m_asleep_bodies.emplace_back( unsigned( body ) );
+      m_held[body] = true;
+    }
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef SLEEPING_BODIES_H
+#define SLEEPING_BODIES_H
+
+#include "scisim/Math/MathDefines.h"
+
+#include <iosfwd>
+#include <limits>
+#include <vector>
+
+// Tracks which simulated bodies have come to rest. Bodies connected by contacts form an island,
+// and an island falls asleep once each of its bodies has been at rest for a number of consecutive
+// steps. Sleeping bodies are treated as kinematic until their island is woken, and an island is
+// always woken as a whole.
+class SleepingBodies final
+{
+
+public:
+
+  SleepingBodies();
+
+  // A body is at rest while its linear and angular speeds, and the linear and angular impulses it
+  // receives over a step, are at most the given thresholds. A steps of 0 disables sleeping.
+  void setParameters( const scalar& linear_velocity, const scalar& angular_velocity, const scalar& impulse, const unsigned steps );
+
+  bool enabled() const;
+  const scalar& linearVelocityThreshold() const;
+  const scalar& angularVelocityThreshold() const;
+  const scalar& impulseThreshold() const;
+  unsigned steps() const;
+
+  // Wakes all bodies and resets their rest counters, keeping the parameters
+  void reset( const std::vector<bool>& fixed );
+
+  // Records the fixed bodies, which are held in place along with the sleeping bodies
+  void setFixedBodies( const std::vector<bool>& fixed );
+
+  unsigned numBodies() const;
+  bool isAsleep( const unsigned body ) const;
+  unsigned numAsleep() const;
+  // Indices of the sleeping bodies, in increasing order
+  const std::vector<unsigned>& asleepBodies() const;
+  // Flags the bodies that are fixed or asleep, which are integrated as kinematic
+  const std::vector<bool>& heldBodies() const;
+
+  bool isAtRest( const scalar& speed, const scalar& angular_speed, const scalar& linear_impulse, const scalar& angular_impulse ) const;
+
+  // Wakes every body of the islands the given bodies sleep in; returns the number of bodies woken
+  unsigned wakeIslands( const std::vector<unsigned>& bodies );
+
+  // Advances the rest counters of the awake bodies, then puts to sleep the islands formed by the
+  // given contacts between awake bodies whose bodies all rested for the required number of steps.
+  // Kinematically scripted bodies must not be at rest. Islands are labeled by the smallest id of
+  // their bodies, so labels do not depend on the numbering of the bodies. Returns the bodies that
+  // fell asleep in fell_asleep.
+  void update( const std::vector<bool>& at_rest, const std::vector<std::pair<unsigned,unsigned>>& contacts, const std::vector<unsigned>& body_ids, std::vector<unsigned>& fell_asleep );
+
+  // Renumbers the bodies so that body order[i] becomes body i
+  void permuteBodies( const std::vector<unsigned>& order );
+
+  void serialize( std::ostream& output_stream ) const;
+  void deserialize( std::istream& input_stream );
+
+private:
+
+  static constexpr unsigned AWAKE{ std::numeric_limits<unsigned>::max() };
+
+  void wakeAll();
+
+  scalar m_linear_velocity;
+  scalar m_angular_velocity;
+  scalar m_impulse;
+  unsigned m_steps;
+
+  // Number of consecutive steps each awake body has been at rest
+  std::vector<unsigned> m_rest_steps;
+  // Label of the island each sleeping body fell asleep in, AWAKE for awake bodies
+  std::vector<unsigned> m_islands;
+  // Updated only when bodies fall asleep or wake
+  std::vector<unsigned> m_asleep_bodies;
+  std::vector<bool> m_held;
+
+};
+
+#endif
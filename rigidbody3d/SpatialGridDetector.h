@@ -8,7 +8,6 @@
 
 #include "scisim/Math/MathDefines.h"
 
-#include <set>
 #include <vector>
 
 class AABB final
@@ -34,8 +33,8 @@ private:
 
 namespace SpatialGridDetector
 {
-  void getPotentialOverlaps( const std::vector<AABB>& aabbs, std::set<std::pair<unsigned,unsigned>>& overlaps );
-  void getPotentialOverlapsAllPairs( const std::vector<AABB>& aabbs, std::set<std::pair<unsigned,unsigned>>& overlaps );
+  void getPotentialOverlaps( const std::vector<AABB>& aabbs, std::vector<std::pair<unsigned,unsigned>>& overlaps );
+  void getPotentialOverlapsAllPairs( const std::vector<AABB>& aabbs, std::vector<std::pair<unsigned,unsigned>>& overlaps );
 }
 
 #endif
@@ -5,6 +5,7 @@
 
 #include "DMVMap.h"
 
+#include "scisim/Math/RigidBodyMass3D.h"
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 
 #include <iostream>
@@ -44,6 +45,9 @@ static void solveDMV( const Vector3s& am, const scalar& h, const Vector3s& I0, E
   }
   if( err > eps )
   {
+    #ifdef _OPENMP
+    #pragma omp critical
+    #endif
     std::cerr << "Warning, DMV failed to terminate." << std::endl;
   }
 
@@ -124,76 +128,67 @@ void DMVMap::flow( const VectorXs& q0, const VectorXs& v0, FlowableSystem& fsys,
   }
   #endif
 
-  const unsigned nbodies{ static_cast<unsigned>( q0.size() / 12 ) };
-
-  q1 = q0;
-  v1 = fsys.M() * v0; // A bit of a misnomer as this actually stores momentum for most of this function
+  const int nbodies{ static_cast<int>( q0.size() / 12 ) };
 
   // Compute start force
   VectorXs F{ v0.size() };
   fsys.computeForce( q0, v0, next_time, F ); // Hamiltonian so there shouldn't be velocity dependent forces
 
-  // First momentum update
-  // p1 += 0.5 * h * F_q0;
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  // Per body blocks of the world frame mass/inertia and its inverse
+  const SparseMatrixsc& M{ fsys.M() };
+  const SparseMatrixsc& Minv{ fsys.Minv() };
+  // Grab vector of reference frame mass/inertia
+  const Eigen::Map<const VectorXs,Eigen::Aligned> M0_vals{ fsys.M0().valuePtr(), fsys.M0().nonZeros() };
+
+  q1.resize( q0.size() );
+  v1.resize( v0.size() ); // A bit of a misnomer as this actually stores momentum for most of this function
+
+  // First momentum update, linear position update, and orientation update per body
+  #ifdef _OPENMP
+  #pragma omp parallel for
+  #endif
+  for( int bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
+    // p1 = M * v0
+    v1.segment<3>( 3 * bdy_idx ) = RigidBodyMass3D::translationalBlock( M, bdy_idx ).cwiseProduct( v0.segment<3>( 3 * bdy_idx ) );
+    v1.segment<3>( 3 * nbodies + 3 * bdy_idx ) = RigidBodyMass3D::rotationalBlock( M, bdy_idx ) * v0.segment<3>( 3 * nbodies + 3 * bdy_idx );
+
     if( fsys.isKinematicallyScripted( bdy_idx ) )
     {
+      q1.segment<3>( 3 * bdy_idx ) = q0.segment<3>( 3 * bdy_idx );
+      q1.segment<9>( 3 * nbodies + 9 * bdy_idx ) = q0.segment<9>( 3 * nbodies + 9 * bdy_idx );
       continue;
     }
+
+    // p1 += 0.5 * h * F_q0;
     v1.segment<3>( 3 * bdy_idx ) += 0.5 * dt * F.segment<3>( 3 * bdy_idx );
     v1.segment<3>( 3 * nbodies + 3 * bdy_idx ) += 0.5 * dt * F.segment<3>( 3 * nbodies + 3 * bdy_idx );
-  }
 
-  // Linear position update
-  const VectorXs q_update{ dt * v0 + 0.5 * dt * dt * fsys.Minv() * F };
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-  {
-    if( fsys.isKinematicallyScripted( bdy_idx ) )
-    {
-      continue;
-    }
-    q1.segment<3>( 3 * bdy_idx ) += q_update.segment<3>( 3 * bdy_idx );
-  }
-
-  // Grab vector of reference frame mass/inertia
-  const SparseMatrixsc& M0{ fsys.M0() };
-  const Eigen::Map<const VectorXs,Eigen::Aligned> M0_vals{ M0.valuePtr(), M0.nonZeros() };
+    // q1 = q0 + h * v0 + 0.5 * h * h * Minv * F_q0
+    q1.segment<3>( 3 * bdy_idx ) = q0.segment<3>( 3 * bdy_idx ) + dt * v0.segment<3>( 3 * bdy_idx ) + 0.5 * dt * dt * RigidBodyMass3D::translationalBlock( Minv, bdy_idx ).cwiseProduct( F.segment<3>( 3 * bdy_idx ) );
 
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-  {
-    if( fsys.isKinematicallyScripted( bdy_idx ) )
-    {
-      continue;
-    }
     DMV( q0, v1, dt, M0_vals, bdy_idx, q1 );
   }
 
   // Compute end force
   fsys.computeForce( q1, v0, next_time, F ); // Hamiltonian so there shouldn't be velocity dependent forces
 
-  // Second momentum update
-  // p1 += 0.5 * h * F_q1;
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
-  {
-    if( fsys.isKinematicallyScripted( bdy_idx ) )
-    {
-      continue;
-    }
-    v1.segment<3>( 3 * bdy_idx ) += 0.5 * dt * F.segment<3>( 3 * bdy_idx );
-    v1.segment<3>( 3 * nbodies + 3 * bdy_idx ) += 0.5 * dt * F.segment<3>( 3 * nbodies + 3 * bdy_idx );
-  }
-
   // Grab vector of inverse reference frame mass/inertia
   const Eigen::Map<const VectorXs,Eigen::Aligned> Minv0_vals{ fsys.Minv0().valuePtr(), fsys.Minv0().nonZeros() };
 
-  // Convert momentum to velocity
-  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  // Second momentum update and conversion of momentum to velocity
+  #ifdef _OPENMP
+  #pragma omp parallel for
+  #endif
+  for( int bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
   {
     if( fsys.isKinematicallyScripted( bdy_idx ) )
     {
       continue;
     }
+    // p1 += 0.5 * h * F_q1;
+    v1.segment<3>( 3 * bdy_idx ) += 0.5 * dt * F.segment<3>( 3 * bdy_idx );
+    v1.segment<3>( 3 * nbodies + 3 * bdy_idx ) += 0.5 * dt * F.segment<3>( 3 * nbodies + 3 * bdy_idx );
     // Linear component
     v1.segment<3>( 3 * bdy_idx ).array() /= M0_vals.segment<3>( 3 * bdy_idx ).array();
     // Rotational component
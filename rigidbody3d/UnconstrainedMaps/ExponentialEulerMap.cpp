@@ -5,30 +5,20 @@
 
 #include "ExponentialEulerMap.h"
 
+#include "scisim/Math/RigidBodyMass3D.h"
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 
 ExponentialEulerMap::~ExponentialEulerMap()
 {}
 
-static void projectOrientation( const unsigned i, VectorXs& q )
+static void projectOrientation( Eigen::Map<Matrix33sr>& R )
 {
-  assert( q.size() % 12 == 0 );
-
-  const unsigned nb{ static_cast<unsigned>( q.size() / 12 ) };
-
   Eigen::JacobiSVD<Matrix33sr> svd;
-
-  Matrix33sr R{ Eigen::Map<Matrix33sr>{ q.segment<9>( 3 * nb + 9 * i ).data() } };
   svd.compute( R, Eigen::ComputeFullU | Eigen::ComputeFullV );
-  Eigen::Map<Matrix33sr>{ q.segment<9>( 3 * nb + 9 * i ).data() } = svd.matrixU() * svd.matrixV().transpose();
+  R = svd.matrixU() * svd.matrixV().transpose();
 
-  #ifndef NDEBUG
-  {
-    R = Eigen::Map<Matrix33sr>{ q.segment<9>( 3 * nb + 9 * i ).data() };
-    assert( ( R * R.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() < 1.0e-6 );
-    assert( fabs( R.determinant() - 1.0 ) < 1.0e-6 );
-  }
-  #endif
+  assert( ( R * R.transpose() - Matrix33sr::Identity() ).lpNorm<Eigen::Infinity>() < 1.0e-6 );
+  assert( fabs( R.determinant() - 1.0 ) < 1.0e-6 );
 }
 
 void ExponentialEulerMap::flow( const VectorXs& q0, const VectorXs& v0, FlowableSystem& fsys, const unsigned iteration, const scalar& dt, VectorXs& q1, VectorXs& v1 )
@@ -36,25 +26,37 @@ void ExponentialEulerMap::flow( const VectorXs& q0, const VectorXs& v0, Flowable
   assert( iteration > 0 );
   const scalar next_time{ iteration * dt };
 
-  // Until kinematic sripting support is added, make sure code not called
-  #ifndef NDEBUG
-  {
-    const unsigned nbodies{ static_cast<unsigned>(q0.size() / 12) };
-    for( unsigned i = 0; i < nbodies; ++i )
-    {
-      assert( !fsys.isKinematicallyScripted( i ) );
-    }
-  }
-  #endif
-
   assert( q0.size() % 12 == 0 );
   assert( q0.size() == 2 * v0.size() );
 
-  const unsigned nbodies{ static_cast<unsigned>( q0.size() / 12 ) };
+  const int nbodies{ static_cast<int>( q0.size() / 12 ) };
+
+  // Compute the force at ( q0, v0 )
+  VectorXs F{ v0.size() };
+  fsys.computeForce( q0, v0, next_time, F );
+
+  // Per body blocks of the inverse world frame mass/inertia
+  const SparseMatrixsc& Minv{ fsys.Minv() };
+
+  q1.resize( q0.size() );
+  v1.resize( v0.size() );
 
   // For each body
-  for( unsigned i = 0; i < nbodies; ++i )
+  #ifdef _OPENMP
+  #pragma omp parallel for
+  #endif
+  for( int i = 0; i < nbodies; ++i )
   {
+    // Kinematic bodies, including sleeping bodies, hold their configuration and velocity
+    if( fsys.isKinematicallyScripted( i ) )
+    {
+      q1.segment<3>( 3 * i ) = q0.segment<3>( 3 * i );
+      q1.segment<9>( 3 * nbodies + 9 * i ) = q0.segment<9>( 3 * nbodies + 9 * i );
+      v1.segment<3>( 3 * i ) = v0.segment<3>( 3 * i );
+      v1.segment<3>( 3 * ( nbodies + i ) ) = v0.segment<3>( 3 * ( nbodies + i ) );
+      continue;
+    }
+
     // Update the center of mass position
     q1.segment<3>( 3 * i ) = q0.segment<3>( 3 * i ) + dt * v0.segment<3>( 3 * i );
 
@@ -68,28 +70,15 @@ void ExponentialEulerMap::flow( const VectorXs& q0, const VectorXs& v0, Flowable
     {
       R1.col( j ) = R0.col( j ) + dt * omega.cross( R0.col( j ) );
     }
-  }
 
-  // Compute the acceleartion at ( q0, v0 )
-  VectorXs A{ v0.size() };
-  fsys.computeForce( q0, v0, next_time, A );
-  A = fsys.Minv() * A;
+    // Project the orientation back to a rotation
+    projectOrientation( R1 );
 
-  // For each body
-  for( unsigned i = 0; i < nbodies; ++i )
-  {
     // Update the linear velocity
-    v1.segment<3>( 3 * i ) = v0.segment<3>( 3 * i ) + dt * A.segment<3>( 3 * i );
+    v1.segment<3>( 3 * i ) = v0.segment<3>( 3 * i ) + dt * RigidBodyMass3D::translationalBlock( Minv, i ).cwiseProduct( F.segment<3>( 3 * i ) );
 
     // Update the angular velocity
-    v1.segment<3>( 3 * ( nbodies + i ) ) = v0.segment<3>( 3 * ( nbodies + i ) ) + dt * A.segment<3>( 3 * ( nbodies + i ) );
-  }
-
-  // For each body
-  for( unsigned i = 0; i < nbodies; ++i )
-  {
-    // Project the orientation back to a rotation
-    projectOrientation( i, q1 );
+    v1.segment<3>( 3 * ( nbodies + i ) ) = v0.segment<3>( 3 * ( nbodies + i ) ) + dt * RigidBodyMass3D::rotationalBlock( Minv, i ) * F.segment<3>( 3 * ( nbodies + i ) );
   }
 }
 
@@ -42,28 +42,20 @@ void IntegrationTools::exponentialEuler( const VectorXs& q0, const VectorXs& v0,
 
   const int nbodies{ static_cast<int>( fixed.size() ) };
 
-  // Center of mass update
+  // Center of mass and orientation update
+  #ifdef _OPENMP
+  #pragma omp parallel for
+  #endif
   for( int bdy_num = 0; bdy_num < nbodies; bdy_num++ )
   {
     if( !fixed[bdy_num] )
     {
       q1.segment<3>( 3 * bdy_num ) = q0.segment<3>( 3 * bdy_num ) + dt * v0.segment<3>( 3 * bdy_num );
-    }
-    else
-    {
-      q1.segment<3>( 3 * bdy_num ) = q0.segment<3>( 3 * bdy_num );
-    }
-  }
-
-  // Orientation update
-  for( int bdy_num = 0; bdy_num < nbodies; bdy_num++ )
-  {
-    if( !fixed[bdy_num] )
-    {
       updateOrientation( nbodies, bdy_num, q0, v0, dt, q1 );
     }
     else
     {
+      q1.segment<3>( 3 * bdy_num ) = q0.segment<3>( 3 * bdy_num );
       q1.segment<9>( 3 * nbodies + 9 * bdy_num ) = q0.segment<9>( 3 * nbodies + 9 * bdy_num );
     }
   }
@@ -11,21 +11,29 @@
 #include <iomanip>
 #include <cstdlib>
 #include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <set>
 #include <getopt.h>
 
 #include "scisim/StringUtilities.h"
 #include "scisim/Math/MathDefines.h"
 #include "scisim/Math/MathUtilities.h"
 #include "scisim/Math/Rational.h"
+#include "scisim/Timer/Profiler.h"
 #include "scisim/Timer/TimeUtils.h"
 #include "scisim/UnconstrainedMaps/UnconstrainedMap.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperator.h"
 #include "scisim/ConstrainedMaps/FrictionSolver.h"
 #include "scisim/ConstrainedMaps/ConstrainedMapUtilities.h"
 #include "scisim/ConstrainedMaps/ImpactFrictionMap.h"
+#include "scisim/Checkpoint.h"
+#include "scisim/SnapshotSchedule.h"
 #include "scisim/CompileDefinitions.h"
 #include "scisim/Utilities.h"
 #include "scisim/PythonTools.h"
+#include "scisim/AsyncWriter.h"
 
 #include "rigidbody3d/RigidBody3DSim.h"
 #include "rigidbody3d/PythonScripting.h"
@@ -37,6 +45,8 @@
 #ifdef USE_HDF5
 #include "scisim/HDF5File.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactSolution.h"
+#include "rigidbody3d/Geometry/RigidBodyTriangleMesh.h"
+#include "rigidbody3d/Geometry/TriangleMeshCache.h"
 #endif
 
 // TODO: 'Front-pad' the time so all output is same width
@@ -57,7 +67,17 @@ static PythonScripting g_scripting;
 #ifdef USE_HDF5
 static std::string g_output_dir_name;
 static bool g_output_forces{ false };
+// If set, all frames are saved to a single trajectory file rather than a file per frame
+static bool g_write_trajectory{ false };
+static unsigned g_trajectory_compression{ 0 };
+static bool g_write_mesh_sdfs{ false };
+// Only accessed from jobs run by the output writer
+static HDF5File g_trajectory_file;
 #endif
+// Saves are handed off to a background writer so that the simulation continues while data is written
+static std::unique_ptr<AsyncWriter> g_output_writer{ nullptr };
+// Number of saves that can be pending before the simulation waits for the writer, 0 to save synchronously
+static unsigned g_max_pending_saves{ 4 };
 // Number of timesteps between saves
 static unsigned g_steps_per_save{ 0 };
 // Number of saves that been conducted so far
@@ -67,9 +87,14 @@ static unsigned g_save_number_width{ 0 };
 
 static bool g_serialize_snapshots{ false };
 static bool g_overwrite_snapshots{ true };
+// CSV or JSON file receiving step timings, empty if profiling is disabled
+static std::string g_profile_file_name;
+// Number of delta snapshots written after each full snapshot, 0 to only write full snapshots
+static unsigned g_deltas_per_snapshot{ 0 };
+// Files that snapshots are written to, and the full snapshot that delta snapshots are relative to
+static SnapshotSchedule g_snapshot_schedule;
 
-// Magic number to print in front of binary output to aid in debugging
-static constexpr unsigned MAGIC_BINARY_NUMBER{ 90210 };
+static constexpr std::uint32_t CHECKPOINT_VERSION{ 1 };
 
 static std::string generateOutputConfigurationDataFileName( const std::string& prefix, const std::string& extension )
 {
@@ -168,6 +193,24 @@ static std::string generateSimulationTimeString()
   return time_stream.str();
 }
 
+// Queues an output job. The writer rethrows here any exception a previous job threw.
+static int queueOutput( std::function<bool()> job )
+{
+  try
+  {
+    return g_output_writer->push( std::move( job ) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  catch( const std::exception& error )
+  {
+    std::cerr << "Failed to write output: " << error.what() << std::endl;
+  }
+  catch( ... )
+  {
+    std::cerr << "Failed to write output: unknown error" << std::endl;
+  }
+  return EXIT_FAILURE;
+}
+
 #ifdef USE_HDF5
 static int saveState()
 {
@@ -178,156 +221,315 @@ static int saveState()
   std::cout << "Saving state at time " << generateSimulationTimeString() << " to " << output_file_name;
   std::cout << "        " << TimeUtils::currentTime() << std::endl;
 
-  // Save the simulation state
-  try
+  // Save a copy of the simulation state in the background
+  return queueOutput( [output_file_name, iteration = g_iteration, dt = scalar( g_dt ), state = g_sim.state()]()
+  {
+    try
+    {
+      HDF5File output_file{ output_file_name, HDF5AccessType::READ_WRITE };
+      // Save the iteration and time step and time
+      output_file.write( "timestep", dt );
+      output_file.write( "iteration", iteration );
+      output_file.write( "time", dt * iteration );
+      // Save out the git hash
+      output_file.write( "git_hash", CompileDefinitions::GitSHA1 );
+      // Save the real time
+      //output_file.writeString( "/run_stats", "real_time", TimeUtils::currentTime() );
+      // Write out the simulation data
+      RigidBody3DSim::writeBinaryState( state, output_file );
+    }
+    catch( const std::string& error )
+    {
+      std::cerr << error << std::endl;
+      return false;
+    }
+    return true;
+  } );
+}
+
+// Runs on the output writer. initial_state is required when starting a new trajectory.
+static void openTrajectoryFile( const unsigned output_frame, const RigidBody3DState* initial_state )
+{
+  const std::string trajectory_file_name{ g_output_dir_name + "/trajectory.h5" };
+  // Start a new trajectory
+  if( output_frame == 0 )
   {
-    HDF5File output_file{ output_file_name, HDF5AccessType::READ_WRITE };
-    // Save the iteration and time step and time
-    output_file.write( "timestep", scalar( g_dt ) );
-    output_file.write( "iteration", g_iteration );
-    output_file.write( "time", scalar( g_dt ) * g_iteration );
-    // Save out the git hash
-    output_file.write( "git_hash", CompileDefinitions::GitSHA1 );
-    // Save the real time
-    //output_file.writeString( "/run_stats", "real_time", TimeUtils::currentTime() );
-    // Write out the simulation data
-    g_sim.writeBinaryState( output_file );
+    assert( initial_state != nullptr );
+    g_trajectory_file.open( trajectory_file_name, HDF5AccessType::READ_WRITE );
+    g_trajectory_file.write( "timestep", scalar( g_dt ) );
+    g_trajectory_file.write( "git_hash", CompileDefinitions::GitSHA1 );
+    RigidBody3DSim::writeBinaryTrajectoryHeader( *initial_state, g_trajectory_file, g_trajectory_compression );
+    g_trajectory_file.createExtendibleMatrix<unsigned>( "trajectory/iteration", 1, 1024, g_trajectory_compression );
+    g_trajectory_file.createExtendibleMatrix<scalar>( "trajectory/time", 1, 1024, g_trajectory_compression );
   }
-  catch( const std::string& error )
+  // Continue a resumed trajectory, discarding any frames saved after the resumed snapshot
+  else
   {
-    std::cerr << error << std::endl;
-    return EXIT_FAILURE;
+    g_trajectory_file.open( trajectory_file_name, HDF5AccessType::APPEND );
+    for( const std::string& dataset_name : std::vector<std::string>{ "trajectory/q", "trajectory/v", "trajectory/iteration", "trajectory/time" } )
+    {
+      g_trajectory_file.truncateRows( dataset_name, output_frame );
+    }
   }
-  return EXIT_SUCCESS;
 }
-#endif
 
-static int serializeSystem()
+static int saveTrajectoryFrame()
 {
-  // Generate a base filename
-  const std::string serialized_file_name{ g_overwrite_snapshots ? "serial.bin" : generateOutputConfigurationDataFileName( "serial", "bin" ) };
-
-  // Print a message to the user that the state is being written
-  std::cout << "Serializing: " << generateSimulationTimeString() << " to " << serialized_file_name;
+  // Print a status message with the simulation time and output number
+  std::cout << "Saving trajectory frame " << g_output_frame << " at time " << generateSimulationTimeString();
   std::cout << "        " << TimeUtils::currentTime() << std::endl;
 
-  // Attempt to open the output file
-  std::ofstream serial_stream{ serialized_file_name, std::ios::binary };
-  if( !serial_stream.is_open() )
+  // The header of a new trajectory is written from the state of the first frame
+  std::shared_ptr<const RigidBody3DState> initial_state{ nullptr };
+  if( g_output_frame == 0 )
   {
-    std::cerr << "Failed to open serialization file: " << serialized_file_name << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    return EXIT_FAILURE;
+    initial_state = std::make_shared<const RigidBody3DState>( g_sim.state() );
   }
+  VectorXs q_by_id;
+  VectorXs v_by_id;
+  g_sim.computeStateInIdOrder( q_by_id, v_by_id );
+
+  return queueOutput( [output_frame = g_output_frame, iteration = g_iteration, dt = scalar( g_dt ), initial_state, q_by_id = std::move( q_by_id ), v_by_id = std::move( v_by_id )]()
+  {
+    try
+    {
+      if( !g_trajectory_file.is_open() )
+      {
+        openTrajectoryFile( output_frame, initial_state.get() );
+      }
+      assert( g_trajectory_file.numRows( "trajectory/q" ) == output_frame );
+      g_trajectory_file.appendRow( "trajectory/iteration", VectorXu::Constant( 1, iteration ) );
+      g_trajectory_file.appendRow( "trajectory/time", VectorXs::Constant( 1, dt * iteration ) );
+      RigidBody3DSim::appendBinaryTrajectoryFrame( q_by_id, v_by_id, g_trajectory_file );
+    }
+    catch( const std::string& error )
+    {
+      std::cerr << error << std::endl;
+      return false;
+    }
+    return true;
+  } );
+}
+#endif
 
-  // Write the magic number
-  Utilities::serialize( MAGIC_BINARY_NUMBER, serial_stream );
+// Settings and progress of the run, everything serialized besides the simulation itself
+static void serializeRunSettings( std::ostream& output_stream )
+{
+  Utilities::serialize( g_iteration, output_stream );
+  RigidBody3DUtilities::serialize( g_unconstrained_map, output_stream );
+  Utilities::serialize( g_dt, output_stream );
+  Utilities::serialize( g_end_time, output_stream );
+  ConstrainedMapUtilities::serialize( g_impact_operator, output_stream );
+  Utilities::serialize( g_CoR, output_stream );
+  ConstrainedMapUtilities::serialize( g_friction_solver, output_stream );
+  Utilities::serialize( g_mu, output_stream );
+  ConstrainedMapUtilities::serialize( g_impact_friction_map, output_stream );
+  g_scripting.serialize( output_stream );
+  #ifdef USE_HDF5
+  StringUtilities::serialize( g_output_dir_name, output_stream );
+  Utilities::serialize( g_output_forces, output_stream );
+  Utilities::serialize( g_write_trajectory, output_stream );
+  Utilities::serialize( g_trajectory_compression, output_stream );
+  #endif
+  Utilities::serialize( g_steps_per_save, output_stream );
+  Utilities::serialize( g_output_frame, output_stream );
+  Utilities::serialize( g_dt_string_precision, output_stream );
+  Utilities::serialize( g_save_number_width, output_stream );
+  Utilities::serialize( g_serialize_snapshots, output_stream );
+  Utilities::serialize( g_overwrite_snapshots, output_stream );
+}
 
-  // Write the git revision
+static void deserializeRunSettings( std::istream& input_stream )
+{
+  g_iteration = Utilities::deserialize<unsigned>( input_stream );
+  g_unconstrained_map = RigidBody3DUtilities::deserializeUnconstrainedMap( input_stream );
+  g_dt = Utilities::deserialize<Rational<std::intmax_t>>( input_stream );
+  assert( g_dt.positive() );
+  g_end_time = Utilities::deserialize<scalar>( input_stream );
+  assert( g_end_time > 0.0 );
+  g_impact_operator = ConstrainedMapUtilities::deserializeImpactOperator( input_stream );
+  g_CoR = Utilities::deserialize<scalar>( input_stream );
+  assert( std::isnan(g_CoR) || g_CoR >= 0.0 ); assert( std::isnan(g_CoR) || g_CoR <= 1.0 );
+  g_friction_solver = ConstrainedMapUtilities::deserializeFrictionSolver( input_stream );
+  g_mu = Utilities::deserialize<scalar>( input_stream );
+  assert( std::isnan(g_mu) || g_mu >= 0.0 );
+  g_impact_friction_map = ConstrainedMapUtilities::deserializeImpactFrictionMap( input_stream );
   {
-    const std::string git_revision{ CompileDefinitions::GitSHA1 };
-    StringUtilities::serialize( git_revision, serial_stream );
+    PythonScripting new_scripting{ input_stream };
+    swap( g_scripting, new_scripting );
   }
-
-  // Write the actual state
-  g_sim.serialize( serial_stream );
-  Utilities::serialize( g_iteration, serial_stream );
-  RigidBody3DUtilities::serialize( g_unconstrained_map, serial_stream );
-  Utilities::serialize( g_dt, serial_stream );
-  Utilities::serialize( g_end_time, serial_stream );
-  ConstrainedMapUtilities::serialize( g_impact_operator, serial_stream );
-  Utilities::serialize( g_CoR, serial_stream );
-  ConstrainedMapUtilities::serialize( g_friction_solver, serial_stream );
-  Utilities::serialize( g_mu, serial_stream );
-  ConstrainedMapUtilities::serialize( g_impact_friction_map, serial_stream );
-  g_scripting.serialize( serial_stream );
   #ifdef USE_HDF5
-  StringUtilities::serialize( g_output_dir_name, serial_stream );
-  Utilities::serialize( g_output_forces, serial_stream );
+  g_output_dir_name = StringUtilities::deserialize( input_stream );
+  g_output_forces = Utilities::deserialize<bool>( input_stream );
+  g_write_trajectory = Utilities::deserialize<bool>( input_stream );
+  g_trajectory_compression = Utilities::deserialize<unsigned>( input_stream );
   #endif
-  Utilities::serialize( g_steps_per_save, serial_stream );
-  Utilities::serialize( g_output_frame, serial_stream );
-  Utilities::serialize( g_dt_string_precision, serial_stream );
-  Utilities::serialize( g_save_number_width, serial_stream );
-  Utilities::serialize( g_serialize_snapshots, serial_stream );
-  Utilities::serialize( g_overwrite_snapshots, serial_stream );
+  g_steps_per_save = Utilities::deserialize<unsigned>( input_stream );
+  g_output_frame = Utilities::deserialize<unsigned>( input_stream );
+  g_dt_string_precision = Utilities::deserialize<unsigned>( input_stream );
+  g_save_number_width = Utilities::deserialize<unsigned>( input_stream );
+  g_serialize_snapshots = Utilities::deserialize<bool>( input_stream );
+  g_overwrite_snapshots = Utilities::deserialize<bool>( input_stream );
+}
 
-  return EXIT_SUCCESS;
+static void checkGitRevision( const std::string& git_revision )
+{
+  if( CompileDefinitions::GitSHA1 != git_revision )
+  {
+    std::cerr << "Warning, resuming from data file for a different git revision." << std::endl;
+    std::cerr << "   Serialized Git Revision: " << git_revision << std::endl;
+    std::cerr << "      Current Git Revision: " << CompileDefinitions::GitSHA1 << std::endl;
+  }
+  std::cout << "Git Revision: " << git_revision << std::endl;
 }
 
-static int deserializeSystem( const std::string& file_name )
+static CheckpointWriter generateCheckpoint( const bool delta )
 {
-  std::cout << "Loading serialized simulation state file: " << file_name << std::endl;
+  CheckpointWriter checkpoint{ CHECKPOINT_VERSION };
+  checkpoint.addSection( "git_revision", CompileDefinitions::GitSHA1 );
+  checkpoint.addArray( "snapshot_iteration", &g_iteration, 1 );
+  if( delta )
+  {
+    g_snapshot_schedule.addDeltaBase( checkpoint );
+    g_sim.writeCheckpointDelta( checkpoint );
+  }
+  else
+  {
+    g_sim.writeCheckpoint( checkpoint );
+  }
+  {
+    std::ostringstream settings_stream{ std::ios::binary };
+    serializeRunSettings( settings_stream );
+    checkpoint.addSection( "run_settings", settings_stream.str() );
+  }
+  checkpoint.addArray( "delta_snapshots", &g_deltas_per_snapshot, 1 );
+  return checkpoint;
+}
 
-  // Attempt to open the input file
-  std::ifstream serial_stream{ file_name, std::ios::binary };
-  if( !serial_stream.is_open() )
+static int serializeSystem()
+{
+  // In overwrite mode a new full snapshot is followed by a delta in serial.bin that refers to it
+  const std::vector<SnapshotSchedule::File> files{ g_snapshot_schedule.nextSnapshot( g_iteration, g_deltas_per_snapshot, g_overwrite_snapshots, generateOutputConfigurationDataFileName( "serial", "bin" ) ) };
+  assert( !files.empty() );
+
+  // Assemble the checkpoints in memory, the writer saves them to disk in the background
+  std::vector<std::pair<std::string,CheckpointWriter>> checkpoints;
+  for( const SnapshotSchedule::File& file : files )
   {
-    std::cerr << "Failed to open serialization file: " << file_name << std::endl;
-    std::cerr << "Exiting." << std::endl;
-    return EXIT_FAILURE;
+    // Print a message to the user that the state is being written
+    std::cout << ( file.delta ? "Serializing delta: " : "Serializing: " ) << generateSimulationTimeString() << " to " << file.name;
+    std::cout << "        " << TimeUtils::currentTime() << std::endl;
+    checkpoints.emplace_back( file.name, generateCheckpoint( file.delta ) );
   }
 
-  // Verify the magic number
-  if( Utilities::deserialize<unsigned>( serial_stream ) != MAGIC_BINARY_NUMBER )
+  // Files are written in order and each is on disk before the next, so a delta never refers to a
+  // full snapshot that failed to write
+  return queueOutput( [checkpoints = std::move( checkpoints )]()
+  {
+    try
+    {
+      for( const std::pair<std::string,CheckpointWriter>& checkpoint : checkpoints )
+      {
+        checkpoint.second.write( checkpoint.first );
+      }
+    }
+    catch( const std::string& error )
+    {
+      std::cerr << error << std::endl;
+      return false;
+    }
+    return true;
+  } );
+}
+
+// Writes the current state as a full snapshot, used to compact a full snapshot and delta into one file
+static int writeCompactedSnapshot( const std::string& file_name )
+{
+  std::cout << "Writing full snapshot: " << generateSimulationTimeString() << " to " << file_name << std::endl;
+  try
   {
-    std::cerr << "File " << file_name << " does not appear to be a serialized 3D SCISim simulation. Exiting." << std::endl;
+    generateCheckpoint( false ).write( file_name );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
     return EXIT_FAILURE;
   }
-  
-  // Read the git revision
+  return EXIT_SUCCESS;
+}
+
+static void readCheckpointVersion( const CheckpointReader& checkpoint, const std::string& file_name )
+{
+  if( checkpoint.version() != CHECKPOINT_VERSION )
+  {
+    throw std::string{ "Checkpoint " } + file_name + " has version " + StringUtilities::convertToString( checkpoint.version() ) + ", expected version " + StringUtilities::convertToString( CHECKPOINT_VERSION );
+  }
+}
+
+static int deserializeCheckpoint( const std::string& file_name )
+{
+  try
   {
-    const std::string git_revision{ StringUtilities::deserialize( serial_stream ) };
-    if( CompileDefinitions::GitSHA1 != git_revision )
+    const CheckpointReader checkpoint{ file_name };
+    readCheckpointVersion( checkpoint, file_name );
+    checkGitRevision( std::string{ checkpoint.sectionData( "git_revision" ), checkpoint.sectionSize( "git_revision" ) } );
+    // The full snapshot the run resumes from, directly or through a delta
+    std::string base_file_name{ file_name };
+    if( checkpoint.hasSection( "delta_base" ) )
+    {
+      // Deltas are applied to the full snapshot in the same directory that they were written relative to
+      const std::unique_ptr<CheckpointReader> base_checkpoint{ SnapshotSchedule::openDeltaBase( checkpoint, file_name, base_file_name ) };
+      std::cout << "Loaded full snapshot for delta: " << base_file_name << std::endl;
+      readCheckpointVersion( *base_checkpoint, base_file_name );
+      g_sim.readCheckpoint( *base_checkpoint );
+      g_sim.readCheckpointDelta( checkpoint );
+    }
+    else
+    {
+      g_sim.readCheckpoint( checkpoint );
+    }
+    // The first snapshot after resuming is a full snapshot
+    g_snapshot_schedule.resume( base_file_name );
+    deserializeRunSettings( *checkpoint.stream( "run_settings" ) );
+    if( checkpoint.hasSection( "delta_snapshots" ) )
     {
-      std::cerr << "Warning, resuming from data file for a different git revision." << std::endl;
-      std::cerr << "   Serialized Git Revision: " << git_revision << std::endl;
-      std::cerr << "      Current Git Revision: " << CompileDefinitions::GitSHA1 << std::endl;
+      g_deltas_per_snapshot = checkpoint.array<unsigned>( "delta_snapshots" )( 0 );
     }
-    std::cout << "Git Revision: " << git_revision << std::endl;
   }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    std::cerr << "Exiting." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
 
-  g_sim.deserialize( serial_stream );
-  g_iteration = Utilities::deserialize<unsigned>( serial_stream );
-  g_unconstrained_map = RigidBody3DUtilities::deserializeUnconstrainedMap( serial_stream );
-  g_dt = Utilities::deserialize<Rational<std::intmax_t>>( serial_stream );
-  assert( g_dt.positive() );
-  g_end_time = Utilities::deserialize<scalar>( serial_stream );
-  assert( g_end_time > 0.0 );
-  g_impact_operator = ConstrainedMapUtilities::deserializeImpactOperator( serial_stream );
-  g_CoR = Utilities::deserialize<scalar>( serial_stream );
-  assert( std::isnan(g_CoR) || g_CoR >= 0.0 ); assert( std::isnan(g_CoR) || g_CoR <= 1.0 );
-  g_friction_solver = ConstrainedMapUtilities::deserializeFrictionSolver( serial_stream );
-  g_mu = Utilities::deserialize<scalar>( serial_stream );
-  assert( std::isnan(g_mu) || g_mu >= 0.0 );
-  g_impact_friction_map = ConstrainedMapUtilities::deserializeImpactFrictionMap( serial_stream );
+static int deserializeSystem( const std::string& file_name )
+{
+  std::cout << "Loading serialized simulation state file: " << file_name << std::endl;
+
+  if( CheckpointReader::isCheckpoint( file_name ) )
   {
-    PythonScripting new_scripting{ serial_stream };
-    swap( g_scripting, new_scripting );
+    return deserializeCheckpoint( file_name );
   }
-  #ifdef USE_HDF5
-  g_output_dir_name = StringUtilities::deserialize( serial_stream );
-  g_output_forces = Utilities::deserialize<bool>( serial_stream );
-  #endif
-  g_steps_per_save = Utilities::deserialize<unsigned>( serial_stream );
-  g_output_frame = Utilities::deserialize<unsigned>( serial_stream );
-  g_dt_string_precision = Utilities::deserialize<unsigned>( serial_stream );
-  g_save_number_width = Utilities::deserialize<unsigned>( serial_stream );
-  g_serialize_snapshots = Utilities::deserialize<bool>( serial_stream );
-  g_overwrite_snapshots = Utilities::deserialize<bool>( serial_stream );
 
-  return EXIT_SUCCESS;
+  // Files written before checkpoints were introduced interleave the state and run settings in a
+  // layout that no longer matches either, so they are refused rather than misread
+  std::cerr << "File " << file_name << " is not a 3D SCISim checkpoint. Serialized states written before checkpoints were introduced are no longer supported. Exiting." << std::endl;
+  return EXIT_FAILURE;
 }
 
 static int exportConfigurationData()
 {
+  const ProfilerScope profiler_scope{ ProfilerTimer::OUTPUT };
   assert( g_steps_per_save != 0 );
   if( g_iteration % g_steps_per_save == 0 )
   {
     #ifdef USE_HDF5
     if( !g_output_dir_name.empty() )
     {
-      if( saveState() == EXIT_FAILURE )
+      if( ( g_write_trajectory ? saveTrajectoryFrame() : saveState() ) == EXIT_FAILURE )
       {
         return EXIT_FAILURE;
       }
@@ -346,6 +548,32 @@ static int exportConfigurationData()
 }
 
 #ifdef USE_HDF5
+// Writes the signed distance field side file of each triangle mesh in the scene, so that later runs
+// map the fields rather than read them from the mesh files
+static int writeMeshSignedDistanceFields()
+{
+  std::set<std::string> side_file_names;
+  for( const std::unique_ptr<RigidBodyGeometry>& geometry : g_sim.state().geometry() )
+  {
+    if( geometry->getType() != RigidBodyGeometryType::TRIANGLE_MESH )
+    {
+      continue;
+    }
+    const RigidBodyTriangleMesh& mesh{ static_cast<const RigidBodyTriangleMesh&>( *geometry ) };
+    const std::string side_file_name{ TriangleMeshCache::signedDistanceFieldFileName( mesh.inputFileName() ) };
+    if( !side_file_names.insert( side_file_name ).second )
+    {
+      continue;
+    }
+    std::cout << "Writing signed distance field of " << mesh.inputFileName() << " to " << side_file_name << std::endl;
+    if( !TriangleMeshCache::writeSignedDistanceField( mesh.data(), side_file_name ) )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
 static std::string generateOutputConstraintForceDataFileName()
 {
   std::stringstream ss;
@@ -353,38 +581,53 @@ static std::string generateOutputConstraintForceDataFileName()
   ss << g_output_dir_name << "/forces_" << std::setfill('0') << std::setw( g_save_number_width ) << g_output_frame - 1 << ".h5";
   return ss.str();
 }
-#endif
 
-static int stepSystem()
+static int saveForces( ImpactSolution& impact_solution )
 {
-  const unsigned next_iter = g_iteration + 1;
+  const ProfilerScope profiler_scope{ ProfilerTimer::OUTPUT };
+  const std::string constraint_force_file_name{ generateOutputConstraintForceDataFileName() };
+  std::cout << "Saving forces at time " << generateSimulationTimeString() << " to " << constraint_force_file_name << std::endl;
 
-  #ifdef USE_HDF5
-  HDF5File force_file;
-  assert( g_steps_per_save != 0 );
-  if( g_output_forces && g_iteration % g_steps_per_save == 0 )
+  // Bodies may have been renumbered, so the collision indices are accompanied by the id of each body
+  const std::vector<unsigned>& ids{ g_sim.state().bodyIds() };
+  VectorXu body_ids{ Eigen::Map<const VectorXu>{ ids.data(), Eigen::Index( ids.size() ) } };
+
+  return queueOutput( [constraint_force_file_name, iteration = g_iteration, dt = scalar( g_dt ), impact_solution = std::move( impact_solution ), body_ids = std::move( body_ids )]()
   {
-    assert( !g_output_dir_name.empty() );
-    const std::string constraint_force_file_name{ generateOutputConstraintForceDataFileName() };
-    std::cout << "Saving forces at time " << generateSimulationTimeString() << " to " << constraint_force_file_name << std::endl;
     try
     {
-      force_file.open( constraint_force_file_name, HDF5AccessType::READ_WRITE );
+      HDF5File force_file{ constraint_force_file_name, HDF5AccessType::READ_WRITE };
       // Save the iteration and time step and time
-      force_file.write( "timestep", scalar( g_dt ) );
-      force_file.write( "iteration", g_iteration );
-      force_file.write( "time", scalar( g_dt ) * g_iteration );
+      force_file.write( "timestep", dt );
+      force_file.write( "iteration", iteration );
+      force_file.write( "time", dt * iteration );
       // Save out the git hash
       force_file.write( "git_hash", CompileDefinitions::GitSHA1 );
       // Save the real time
       //force_file.writeString( "/run_stats", "real_time", TimeUtils::currentTime() );
+      impact_solution.writeSolution( force_file );
+      force_file.write( "state/body_ids", body_ids );
     }
     catch( const std::string& error )
     {
       std::cerr << error << std::endl;
-      return EXIT_FAILURE;
+      return false;
     }
-  }
+    return true;
+  } );
+}
+#endif
+
+static int stepSystem()
+{
+  const ProfilerScope profiler_scope{ ProfilerTimer::STEP };
+  const unsigned next_iter = g_iteration + 1;
+
+  #ifdef USE_HDF5
+  assert( g_steps_per_save != 0 );
+  const bool save_forces{ g_output_forces && g_iteration % g_steps_per_save == 0 };
+  assert( !save_forces || !g_output_dir_name.empty() );
+  ImpactSolution impact_solution;
   #endif
 
   if( g_unconstrained_map == nullptr && g_impact_operator == nullptr && g_friction_solver == nullptr && g_impact_friction_map == nullptr )
@@ -398,34 +641,19 @@ static int stepSystem()
   else if( g_unconstrained_map != nullptr && g_impact_operator != nullptr && g_friction_solver == nullptr && g_impact_friction_map == nullptr )
   {
     #ifdef USE_HDF5
-    ImpactSolution impact_solution;
-    if( force_file.is_open() )
+    if( save_forces )
     {
       g_sim.impactMap().exportForcesNextStep( impact_solution );
     }
     #endif
     g_sim.flow( g_scripting, next_iter, g_dt, *g_unconstrained_map, *g_impact_operator, g_CoR );
-    #ifdef USE_HDF5
-    if( force_file.is_open() )
-    {
-      try
-      {
-        impact_solution.writeSolution( force_file );
-      }
-      catch( const std::string& error )
-      {
-        std::cerr << error << std::endl;
-        return EXIT_FAILURE;
-      }
-    }
-    #endif
   }
   else if( g_unconstrained_map != nullptr && g_impact_operator == nullptr && g_friction_solver != nullptr && g_impact_friction_map != nullptr )
   {
     #ifdef USE_HDF5
-    if( force_file.is_open() )
+    if( save_forces )
     {
-      g_impact_friction_map->exportForcesNextStep( force_file );
+      g_impact_friction_map->exportForcesNextStep( impact_solution );
     }
     #endif
     g_sim.flow( g_scripting, next_iter, g_dt, *g_unconstrained_map, g_CoR, g_mu, *g_friction_solver, *g_impact_friction_map );
@@ -436,15 +664,46 @@ static int stepSystem()
     return EXIT_FAILURE;
   }
 
+  #ifdef USE_HDF5
+  if( save_forces && saveForces( impact_solution ) == EXIT_FAILURE )
+  {
+    return EXIT_FAILURE;
+  }
+  #endif
+
   ++g_iteration;
 
   return exportConfigurationData();
 }
 
+// Waits for all pending saves to be written
+static int finishOutput()
+{
+  bool succeeded{ false };
+  try
+  {
+    succeeded = g_output_writer->flush();
+  }
+  catch( const std::exception& error )
+  {
+    std::cerr << "Failed to write output: " << error.what() << std::endl;
+  }
+  catch( ... )
+  {
+    std::cerr << "Failed to write output: unknown error" << std::endl;
+  }
+  #ifdef USE_HDF5
+  // The writer is idle, so the trajectory can be closed from this thread
+  g_trajectory_file = HDF5File{};
+  #endif
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 static int executeSimLoop()
 {
   if( exportConfigurationData() == EXIT_FAILURE )
   {
+    finishOutput();
     return EXIT_FAILURE;
   }
 
@@ -459,22 +718,36 @@ static int executeSimLoop()
       {
         if( stepSystem() == EXIT_FAILURE )
         {
+          finishOutput();
           return EXIT_FAILURE;
         }
+        Profiler::endStep( g_iteration );
       }
       #endif
+      // Ensure all output is on disk before the end of simulation callback
+      if( finishOutput() == EXIT_FAILURE )
+      {
+        return EXIT_FAILURE;
+      }
       // User-provided end of simulation python callback
       g_scripting.setState( g_sim.getState() );
       g_scripting.endOfSimCallback();
       g_scripting.forgetState();
+      if( !Profiler::close() )
+      {
+        std::cerr << "Failed to write profile to " << g_profile_file_name << std::endl;
+        return EXIT_FAILURE;
+      }
       std::cout << "Simulation complete at time " << g_iteration * scalar( g_dt ) << ". Exiting." << std::endl;
       return EXIT_SUCCESS;
     }
 
     if( stepSystem() == EXIT_FAILURE )
     {
+      finishOutput();
       return EXIT_FAILURE;
     }
+    Profiler::endStep( g_iteration );
   }
 }
 
@@ -488,12 +761,18 @@ static void printUsage( const std::string& executable_name )
   #ifdef USE_HDF5
   std::cout << "   -i/--impulses            : saves impulses in addition to configuration if an output directory is set" << std::endl;
   std::cout << "   -o/--output_dir dir      : saves simulation state to the given directory" << std::endl;
+  std::cout << "   -t/--trajectory integer  : saves all frames to a single trajectory.h5 in the output directory, compressed at the given level from 0 (none) to 9" << std::endl;
+  std::cout << "   -m/--mesh_sdf            : writes a signed distance field file next to each triangle mesh in the scene, mapped by later runs in place of reading the field, and exits" << std::endl;
   #endif
   std::cout << "   -f/--frequency integer   : rate at which to save simulation data, in Hz; ignored if no output directory specified" << std::endl;
+  std::cout << "   -q/--queue integer       : number of saves that can be pending in the background before the simulation waits; 0 saves synchronously (default 4)" << std::endl;
   std::cout << "   -s/--serialize_snapshots bool : save a bit identical, resumable snapshot; if 0 overwrites the snapshot each timestep, if 1 saves a new snapshot for each timestep" << std::endl;
+  std::cout << "   -p/--profile file        : records the time spent in each phase of the step; a .csv file receives one row per step, a .json file receives totals, means, and maxima" << std::endl;
+  std::cout << "   -d/--deltas integer      : number of delta snapshots, holding only the state that changes, to save after each full snapshot (default 0)" << std::endl;
+  std::cout << "   -c/--compact file        : with -r, saves the resumed state as a full snapshot to the given file and exits" << std::endl;
 }
 
-static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_enabled, scalar& end_time_override, unsigned& output_frequency, std::string& serialized_file_name )
+static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_enabled, scalar& end_time_override, unsigned& output_frequency, std::string& serialized_file_name, std::string& compacted_file_name )
 {
   const struct option long_options[] =
   {
@@ -504,8 +783,14 @@ static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_en
     #ifdef USE_HDF5
     { "impulses", no_argument, nullptr, 'i' },
     { "output_dir", required_argument, nullptr, 'o' },
+    { "trajectory", required_argument, nullptr, 't' },
+    { "mesh_sdf", no_argument, nullptr, 'm' },
     #endif
     { "frequency", required_argument, nullptr, 'f' },
+    { "profile", required_argument, nullptr, 'p' },
+    { "queue", required_argument, nullptr, 'q' },
+    { "deltas", required_argument, nullptr, 'd' },
+    { "compact", required_argument, nullptr, 'c' },
     { nullptr, 0, nullptr, 0 }
   };
 
@@ -513,9 +798,9 @@ static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_en
   {
     int option_index = 0;
     #ifdef USE_HDF5
-    constexpr char command_line_options[]{ "his:r:e:o:f:" };
+    constexpr char command_line_options[]{ "hims:r:e:o:t:f:q:d:c:p:" };
     #else
-    constexpr char command_line_options[]{ "hs:r:e:f:" };
+    constexpr char command_line_options[]{ "hs:r:e:f:q:d:c:p:" };
     #endif
     const int c{ getopt_long( *argc, *argv, command_line_options, long_options, &option_index ) };
     if( c == -1 )
@@ -570,6 +855,21 @@ static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_en
         g_output_dir_name = optarg;
         break;
       }
+      case 'm':
+      {
+        g_write_mesh_sdfs = true;
+        break;
+      }
+      case 't':
+      {
+        g_write_trajectory = true;
+        if( !StringUtilities::extractFromString( optarg, g_trajectory_compression ) || g_trajectory_compression > 9 )
+        {
+          std::cerr << "Failed to read value for argument for -t/--trajectory. Value must be an integer between 0 and 9." << std::endl;
+          return false;
+        }
+        break;
+      }
       #endif
       case 'f':
       {
@@ -580,6 +880,34 @@ static bool parseCommandLineOptions( int* argc, char*** argv, bool& help_mode_en
         }
         break;
       }
+      case 'q':
+      {
+        if( !StringUtilities::extractFromString( optarg, g_max_pending_saves ) )
+        {
+          std::cerr << "Failed to read value for argument for -q/--queue. Value must be an unsigned integer." << std::endl;
+          return false;
+        }
+        break;
+      }
+      case 'd':
+      {
+        if( !StringUtilities::extractFromString( optarg, g_deltas_per_snapshot ) )
+        {
+          std::cerr << "Failed to read value for argument for -d/--deltas. Value must be an unsigned integer." << std::endl;
+          return false;
+        }
+        break;
+      }
+      case 'c':
+      {
+        compacted_file_name = optarg;
+        break;
+      }
+      case 'p':
+      {
+        g_profile_file_name = optarg;
+        break;
+      }
       case '?':
       {
         return false;
@@ -609,9 +937,10 @@ int main( int argc, char** argv )
   scalar end_time_override{ -1.0 };
   unsigned output_frequency{ 0 };
   std::string serialized_file_name;
+  std::string compacted_file_name;
 
   // Attempt to load command line options
-  if( !parseCommandLineOptions( &argc, &argv, help_mode_enabled, end_time_override, output_frequency, serialized_file_name ) )
+  if( !parseCommandLineOptions( &argc, &argv, help_mode_enabled, end_time_override, output_frequency, serialized_file_name, compacted_file_name ) )
   {
     return EXIT_FAILURE;
   }
@@ -630,8 +959,37 @@ int main( int argc, char** argv )
     std::cerr << "Impulse output requires an output directory." << std::endl;
     return EXIT_FAILURE;
   }
+  if( g_write_trajectory && g_output_dir_name.empty() )
+  {
+    std::cerr << "Trajectory output requires an output directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( g_write_mesh_sdfs && !serialized_file_name.empty() )
+  {
+    std::cerr << "Writing signed distance fields requires an xml scene file, not a snapshot to resume from." << std::endl;
+    return EXIT_FAILURE;
+  }
   #endif
 
+  if( g_deltas_per_snapshot != 0 && !g_serialize_snapshots )
+  {
+    std::cerr << "Delta snapshots require snapshots to be enabled with -s/--serialize_snapshots." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( !compacted_file_name.empty() && serialized_file_name.empty() )
+  {
+    std::cerr << "Compacting a snapshot requires a snapshot to resume from with -r/--resume." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !g_profile_file_name.empty() && !Profiler::open( g_profile_file_name ) )
+  {
+    std::cerr << "Failed to open profile file " << g_profile_file_name << ". The file name must end in .csv or .json." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  g_output_writer.reset( new AsyncWriter{ g_max_pending_saves } );
+
   #ifdef USE_PYTHON
   // Initialize the Python interpreter
   Py_SetProgramName( argv[0] );
@@ -657,6 +1015,10 @@ int main( int argc, char** argv )
     {
       return EXIT_FAILURE;
     }
+    if( !compacted_file_name.empty() )
+    {
+      return writeCompactedSnapshot( compacted_file_name );
+    }
     return executeSimLoop();
   }
 
@@ -673,6 +1035,13 @@ int main( int argc, char** argv )
     return EXIT_FAILURE;
   }
 
+  #ifdef USE_HDF5
+  if( g_write_mesh_sdfs )
+  {
+    return writeMeshSignedDistanceFields();
+  }
+  #endif
+
   // Override the default end time with the requested one, if provided
   if( end_time_override > 0.0 )
   {
@@ -0,0 +1,190 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include "scisim/Checkpoint.h"
+#include "rigidbody3d/RigidBody3DSim.h"
+#include "rigidbody3d/Geometry/RigidBodyBox.h"
+#include "rigidbody3d/Geometry/RigidBodySphere.h"
+#include "rigidbody3d/StaticGeometry/StaticPlane.h"
+
+// Simulation of nbodies spheres and boxes with random configurations, velocities, and masses
+static void initializeSimulation( const unsigned nbodies, std::mt19937_64& mt, RigidBody3DSim& sim )
+{
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  std::vector<Vector3s> X, V, omega, I0;
+  std::vector<scalar> M;
+  std::vector<VectorXs> R;
+  std::vector<bool> fixed;
+  std::vector<unsigned> geometry_indices;
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  {
+    X.emplace_back( 10.0 * Vector3s{ gen( mt ), gen( mt ), gen( mt ) } );
+    V.emplace_back( gen( mt ), gen( mt ), gen( mt ) );
+    omega.emplace_back( gen( mt ), gen( mt ), gen( mt ) );
+    M.emplace_back( 2.0 + gen( mt ) );
+    I0.emplace_back( Vector3s{ 2.0 + gen( mt ), 2.0 + gen( mt ), 2.0 + gen( mt ) } );
+    R.emplace_back( 9 );
+    Eigen::Map<Matrix33sr>{ R.back().data() } = Quaternions{ gen( mt ), gen( mt ), gen( mt ), gen( mt ) }.normalized().toRotationMatrix();
+    fixed.emplace_back( bdy_idx % 7 == 0 );
+    geometry_indices.emplace_back( bdy_idx % 3 );
+  }
+  // The first and last geometry are identical and share storage in a checkpoint
+  std::vector<std::unique_ptr<RigidBodyGeometry>> geometry;
+  geometry.emplace_back( new RigidBodySphere{ 1.0 } );
+  geometry.emplace_back( new RigidBodyBox{ Vector3s{ 1.0, 2.0, 3.0 } } );
+  geometry.emplace_back( new RigidBodySphere{ 1.0 } );
+  sim.state().setState( X, V, M, R, omega, I0, fixed, geometry_indices, geometry );
+}
+
+static std::string readFile( const std::string& file_name )
+{
+  std::ifstream input_stream{ file_name, std::ios::binary };
+  return std::string{ std::istreambuf_iterator<char>{ input_stream }, std::istreambuf_iterator<char>{} };
+}
+
+static bool writeCheckpoint( const RigidBody3DSim& sim, const std::string& file_name, const bool delta )
+{
+  CheckpointWriter checkpoint{ 1 };
+  if( delta )
+  {
+    sim.writeCheckpointDelta( checkpoint );
+  }
+  else
+  {
+    sim.writeCheckpoint( checkpoint );
+  }
+  try
+  {
+    checkpoint.write( file_name );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// A state read from a checkpoint is written back to an identical checkpoint
+static int testRoundTrip()
+{
+  std::mt19937_64 mt{ 1337 };
+  RigidBody3DSim sim;
+  initializeSimulation( 50, mt, sim );
+  sim.state().addStaticPlane( StaticPlane{ Vector3s::Zero(), Vector3s{ 0.0, 1.0, 0.0 } } );
+  sim.renumberBodies();
+  if( !writeCheckpoint( sim, "rb3d_checkpoint_round_trip_00.bin", false ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  RigidBody3DSim loaded_sim;
+  try
+  {
+    const CheckpointReader checkpoint{ "rb3d_checkpoint_round_trip_00.bin" };
+    if( !checkpoint.hasSection( "state/geometry_blob_1" ) || checkpoint.hasSection( "state/geometry_blob_2" ) )
+    {
+      std::cerr << "Identical geometry was not stored once" << std::endl;
+      return EXIT_FAILURE;
+    }
+    loaded_sim.readCheckpoint( checkpoint );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( loaded_sim.state().ngeo() != 3 || loaded_sim.state().numStaticPlanes() != 1 )
+  {
+    std::cerr << "Loaded geometry does not match" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( !writeCheckpoint( loaded_sim, "rb3d_checkpoint_round_trip_01.bin", false ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( readFile( "rb3d_checkpoint_round_trip_00.bin" ) != readFile( "rb3d_checkpoint_round_trip_01.bin" ) )
+  {
+    std::cerr << "Checkpoint of the loaded state differs from the original checkpoint" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// A delta applied to its full checkpoint compacts to the full checkpoint of the same state, even
+// after the bodies are renumbered
+static int testDeltaCompaction()
+{
+  std::mt19937_64 mt{ 4242 };
+  RigidBody3DSim sim;
+  initializeSimulation( 200, mt, sim );
+  if( !writeCheckpoint( sim, "rb3d_checkpoint_delta_base.bin", false ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Advance the state
+  sim.renumberBodies();
+  sim.state().q().head( 3 * sim.state().nbodies() ) += VectorXs::Ones( 3 * sim.state().nbodies() );
+  sim.state().v() *= 0.5;
+  sim.state().updateMandMinv();
+  sim.state().addStaticPlane( StaticPlane{ Vector3s::Zero(), Vector3s{ 0.0, 1.0, 0.0 } } );
+  if( !writeCheckpoint( sim, "rb3d_checkpoint_delta.bin", true ) || !writeCheckpoint( sim, "rb3d_checkpoint_delta_full.bin", false ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  RigidBody3DSim loaded_sim;
+  try
+  {
+    const CheckpointReader base_checkpoint{ "rb3d_checkpoint_delta_base.bin" };
+    loaded_sim.readCheckpoint( base_checkpoint );
+    const CheckpointReader delta_checkpoint{ "rb3d_checkpoint_delta.bin" };
+    if( delta_checkpoint.hasSection( "state/M0" ) || delta_checkpoint.hasSection( "state/geometry_blob_0" ) )
+    {
+      std::cerr << "Delta contains state that does not change" << std::endl;
+      return EXIT_FAILURE;
+    }
+    loaded_sim.readCheckpointDelta( delta_checkpoint );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( !writeCheckpoint( loaded_sim, "rb3d_checkpoint_delta_compacted.bin", false ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( readFile( "rb3d_checkpoint_delta_full.bin" ) != readFile( "rb3d_checkpoint_delta_compacted.bin" ) )
+  {
+    std::cerr << "Compacted delta differs from the full checkpoint" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( std::string{ argv[1] } == "round_trip" )
+  {
+    return testRoundTrip();
+  }
+  else if( std::string{ argv[1] } == "delta_compaction" )
+  {
+    return testDeltaCompaction();
+  }
+
+  std::cerr << "Invalid test specified: " << argv[1] << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,268 @@
+#include <iostream>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "rigidbody3d/SpatialGridDetector.h"
+#include "scisim/CollisionDetection/SortedCellGrid.h"
+
+// Generates randomly placed cubes with half widths in [min_half_width, max_half_width] inside [-domain_half_width, domain_half_width]^3
+static void generateAABBs( const unsigned num_aabbs, const scalar& domain_half_width, const scalar& min_half_width, const scalar& max_half_width, std::mt19937_64& mt, std::vector<AABB>& aabbs )
+{
+  std::uniform_real_distribution<scalar> center_gen{ -domain_half_width, domain_half_width };
+  std::uniform_real_distribution<scalar> width_gen{ min_half_width, max_half_width };
+  aabbs.resize( num_aabbs );
+  for( AABB& aabb : aabbs )
+  {
+    const Array3s center{ center_gen( mt ), center_gen( mt ), center_gen( mt ) };
+    const scalar r{ width_gen( mt ) };
+    aabb.min() = center - r;
+    aabb.max() = center + r;
+  }
+}
+
+// Randomly translates each AABB by at most max_displacement along each axis
+static void perturbAABBs( const scalar& max_displacement, std::mt19937_64& mt, std::vector<AABB>& aabbs )
+{
+  std::uniform_real_distribution<scalar> displacement_gen{ -max_displacement, max_displacement };
+  for( AABB& aabb : aabbs )
+  {
+    const Array3s displacement{ displacement_gen( mt ), displacement_gen( mt ), displacement_gen( mt ) };
+    aabb.min() += displacement;
+    aabb.max() += displacement;
+  }
+}
+
+// Checks the persistent grid against the spatial grid and all pairs detectors
+static bool overlapsAgree( SortedCellGrid<3>& broad_phase, const std::vector<AABB>& aabbs )
+{
+  const std::vector<std::pair<unsigned,unsigned>>& persistent_overlaps{ broad_phase.computePotentialOverlaps( aabbs ) };
+
+  std::vector<std::pair<unsigned,unsigned>> spatial_grid_overlaps;
+  SpatialGridDetector::getPotentialOverlaps( aabbs, spatial_grid_overlaps );
+
+  std::vector<std::pair<unsigned,unsigned>> all_pairs_overlaps;
+  SpatialGridDetector::getPotentialOverlapsAllPairs( aabbs, all_pairs_overlaps );
+
+  const bool active_sets_agree{ spatial_grid_overlaps == all_pairs_overlaps && persistent_overlaps == spatial_grid_overlaps };
+
+  if( !active_sets_agree )
+  {
+    std::cout << "Num AABBs:               " << aabbs.size() << std::endl;
+    std::cout << "Collisions persistent:   " << persistent_overlaps.size() << std::endl;
+    std::cout << "Collisions spatial grid: " << spatial_grid_overlaps.size() << std::endl;
+    std::cout << "Collisions all pairs:    " << all_pairs_overlaps.size() << std::endl;
+  }
+
+  return active_sets_agree;
+}
+
+// Similarly sized boxes that jitter in place
+static int testSpatialGridJitter()
+{
+  std::mt19937_64 mt{ 1337 };
+  std::vector<AABB> aabbs;
+  generateAABBs( 2000, 20.0, 0.4, 0.6, mt, aabbs );
+
+  SortedCellGrid<3> broad_phase;
+  for( unsigned step = 0; step < 50; ++step )
+  {
+    if( !overlapsAgree( broad_phase, aabbs ) )
+    {
+      std::cout << "Active sets disagree at step " << step << std::endl;
+      return EXIT_FAILURE;
+    }
+    perturbAABBs( 0.1, mt, aabbs );
+  }
+  return EXIT_SUCCESS;
+}
+
+// Boxes of widely varying size that cross many cells between queries
+static int testSpatialGridLargeMotion()
+{
+  std::mt19937_64 mt{ 42 };
+  std::vector<AABB> aabbs;
+  generateAABBs( 1000, 10.0, 0.05, 2.0, mt, aabbs );
+
+  SortedCellGrid<3> broad_phase;
+  for( unsigned step = 0; step < 30; ++step )
+  {
+    if( !overlapsAgree( broad_phase, aabbs ) )
+    {
+      std::cout << "Active sets disagree at step " << step << std::endl;
+      return EXIT_FAILURE;
+    }
+    perturbAABBs( 3.0, mt, aabbs );
+  }
+  return EXIT_SUCCESS;
+}
+
+// AABBs that appear and disappear between queries (as with portals), and a change in the mean
+// AABB size that forces a rebuild of the grid
+static int testSpatialGridChangingSet()
+{
+  std::mt19937_64 mt{ 5 };
+  std::vector<AABB> aabbs;
+  generateAABBs( 800, 15.0, 0.3, 0.7, mt, aabbs );
+
+  SortedCellGrid<3> broad_phase;
+  std::uniform_int_distribution<unsigned> count_gen{ 600, 1000 };
+  for( unsigned step = 0; step < 40; ++step )
+  {
+    if( !overlapsAgree( broad_phase, aabbs ) )
+    {
+      std::cout << "Active sets disagree at step " << step << std::endl;
+      return EXIT_FAILURE;
+    }
+    perturbAABBs( 0.2, mt, aabbs );
+    std::vector<AABB> extra_aabbs;
+    if( step == 20 )
+    {
+      generateAABBs( count_gen( mt ), 15.0, 2.0, 3.0, mt, extra_aabbs );
+      aabbs.swap( extra_aabbs );
+    }
+    else
+    {
+      generateAABBs( count_gen( mt ) - 600, 15.0, 0.3, 0.7, mt, extra_aabbs );
+      aabbs.resize( 600 );
+      aabbs.insert( aabbs.end(), extra_aabbs.begin(), extra_aabbs.end() );
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+// A crowded pile in which a few boxes cross cells on every query, so cells fill up and empty out
+// in place over many queries
+static int testSpatialGridCrowdedPile()
+{
+  std::mt19937_64 mt{ 8128 };
+  std::vector<AABB> aabbs;
+  generateAABBs( 3000, 6.0, 0.3, 0.5, mt, aabbs );
+
+  SortedCellGrid<3> broad_phase;
+  std::uniform_int_distribution<std::vector<AABB>::size_type> aabb_gen{ 0, aabbs.size() - 1 };
+  std::uniform_real_distribution<scalar> displacement_gen{ -0.8, 0.8 };
+  for( unsigned step = 0; step < 200; ++step )
+  {
+    if( !overlapsAgree( broad_phase, aabbs ) )
+    {
+      std::cout << "Active sets disagree at step " << step << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( unsigned move = 0; move < 100; ++move )
+    {
+      AABB& aabb{ aabbs[aabb_gen( mt )] };
+      const Array3s displacement{ displacement_gen( mt ), displacement_gen( mt ), displacement_gen( mt ) };
+      // Keep the pile inside of the grid
+      if( ( aabb.min() + displacement > -6.5 ).all() && ( aabb.max() + displacement < 6.5 ).all() )
+      {
+        aabb.min() += displacement;
+        aabb.max() += displacement;
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+// Two distant clusters, so the grid spans far more than 2^32 cells
+static int testSpatialGridSparseDomain()
+{
+  std::mt19937_64 mt{ 2718 };
+  std::vector<AABB> aabbs;
+  generateAABBs( 500, 5.0, 0.4, 0.6, mt, aabbs );
+  std::vector<AABB> far_aabbs;
+  generateAABBs( 500, 5.0, 0.4, 0.6, mt, far_aabbs );
+  for( AABB& aabb : far_aabbs )
+  {
+    aabb.min() += 1.0e4;
+    aabb.max() += 1.0e4;
+  }
+  aabbs.insert( aabbs.end(), far_aabbs.begin(), far_aabbs.end() );
+
+  SortedCellGrid<3> broad_phase;
+  if( !overlapsAgree( broad_phase, aabbs ) )
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// The grid keeps its cells between queries and only counts AABBs that changed cells as moved
+static int testSpatialGridMovedAABBs()
+{
+  std::mt19937_64 mt{ 99 };
+  std::vector<AABB> aabbs;
+  generateAABBs( 500, 10.0, 0.4, 0.6, mt, aabbs );
+
+  SortedCellGrid<3> broad_phase;
+  if( !overlapsAgree( broad_phase, aabbs ) || broad_phase.numMovedAABBs() != aabbs.size() )
+  {
+    std::cout << "Building the grid should move every AABB" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const scalar h{ broad_phase.cellWidth() };
+
+  // Translations far below the FPA padding of the cells leave every AABB in place
+  perturbAABBs( 1.0e-9, mt, aabbs );
+  if( !overlapsAgree( broad_phase, aabbs ) || broad_phase.numMovedAABBs() != 0 || broad_phase.cellWidth() != h )
+  {
+    std::cout << "Unmoved AABBs were reinserted" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Moving one AABB across a cell moves only that AABB
+  aabbs[7].min().x() += h;
+  aabbs[7].max().x() += h;
+  if( !overlapsAgree( broad_phase, aabbs ) || broad_phase.numMovedAABBs() != 1 || broad_phase.cellWidth() != h )
+  {
+    std::cout << "Expected exactly one moved AABB, got " << broad_phase.numMovedAABBs() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Dropping AABBs counts each as moved
+  aabbs.resize( aabbs.size() - 3 );
+  if( !overlapsAgree( broad_phase, aabbs ) || broad_phase.numMovedAABBs() != 3 )
+  {
+    std::cout << "Expected three removed AABBs, got " << broad_phase.numMovedAABBs() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( std::string{ argv[1] } == "spatial_grid_00" )
+  {
+    return testSpatialGridJitter();
+  }
+  else if( std::string{ argv[1] } == "spatial_grid_01" )
+  {
+    return testSpatialGridLargeMotion();
+  }
+  else if( std::string{ argv[1] } == "spatial_grid_02" )
+  {
+    return testSpatialGridChangingSet();
+  }
+  else if( std::string{ argv[1] } == "spatial_grid_03" )
+  {
+    return testSpatialGridSparseDomain();
+  }
+  else if( std::string{ argv[1] } == "spatial_grid_04" )
+  {
+    return testSpatialGridMovedAABBs();
+  }
+  else if( std::string{ argv[1] } == "spatial_grid_05" )
+  {
+    return testSpatialGridCrowdedPile();
+  }
+
+  std::cerr << "Invalid test specified: " << argv[1] << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,238 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "scisim/Math/SpaceFillingCurve.h"
+#include "rigidbody3d/ConstraintCache.h"
+#include "rigidbody3d/Constraints/BodyBodyConstraint.h"
+#include "rigidbody3d/Constraints/StaticPlaneBoxConstraint.h"
+
+// Configuration of nbodies bodies at random positions with random orientations
+static VectorXs randomConfiguration( const unsigned nbodies, std::mt19937_64& mt )
+{
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  VectorXs q{ 12 * nbodies };
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  {
+    q.segment<3>( 3 * bdy_idx ) = Vector3s{ gen( mt ), gen( mt ), gen( mt ) };
+    const Matrix33sr R{ Quaternions{ gen( mt ), gen( mt ), gen( mt ), gen( mt ) }.normalized().toRotationMatrix() };
+    Eigen::Map<Matrix33sr>{ q.segment<9>( 3 * nbodies + 9 * bdy_idx ).data() } = R;
+  }
+  return q;
+}
+
+static VectorXs impulseForCorner( const short corner )
+{
+  VectorXs r{ 6 };
+  r << 0.0, 1.0, 0.0, 0.5 * corner, 1.0 + corner, - 0.25 * corner;
+  return r;
+}
+
+static bool checkCachedImpulse( const ConstraintCache& cache, const Constraint& constraint, const VectorXs& q, const VectorXs& expected )
+{
+  VectorXs r{ 6 };
+  cache.getCachedConstraint( constraint, q, r );
+  if( ( r - expected ).lpNorm<Eigen::Infinity>() != 0.0 )
+  {
+    std::cerr << "Cached impulse " << r.transpose() << " does not match " << expected.transpose() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// The corners of a box resting on a plane are identified after the box moves and the
+// contacts are generated in a different order
+static int testBoxPlaneCorners()
+{
+  std::mt19937_64 mt{ 1337 };
+  const Vector3s n{ 0.0, 1.0, 0.0 };
+  const Vector3s half_width{ 1.0, 0.5, 2.0 };
+  const std::vector<short> corners{ 0, 2, 4, 6 };
+
+  ConstraintCache cache;
+  {
+    const VectorXs q0{ randomConfiguration( 2, mt ) };
+    for( const short corner : corners )
+    {
+      cache.cacheConstraint( StaticPlaneBoxConstraint{ 1, corner, n, half_width, q0, 3 }, q0, impulseForCorner( corner ) );
+    }
+  }
+
+  const VectorXs q1{ randomConfiguration( 2, mt ) };
+  for( std::vector<short>::const_reverse_iterator corner = corners.crbegin(); corner != corners.crend(); ++corner )
+  {
+    if( !checkCachedImpulse( cache, StaticPlaneBoxConstraint{ 1, *corner, n, half_width, q1, 3 }, q1, impulseForCorner( *corner ) ) )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // A corner that was not in contact is not confused with its neighbors
+  if( !checkCachedImpulse( cache, StaticPlaneBoxConstraint{ 1, 7, n, half_width, q1, 3 }, q1, VectorXs::Zero( 6 ) ) )
+  {
+    return EXIT_FAILURE;
+  }
+  // Nor are the same corners against a different plane or on a different box
+  if( !checkCachedImpulse( cache, StaticPlaneBoxConstraint{ 1, 0, n, half_width, q1, 2 }, q1, VectorXs::Zero( 6 ) ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( !checkCachedImpulse( cache, StaticPlaneBoxConstraint{ 0, 0, n, half_width, q1, 3 }, q1, VectorXs::Zero( 6 ) ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Body-body contacts survive serialization and rigid motion of the first body
+static int testBodyBodySerialization()
+{
+  std::mt19937_64 mt{ 4242 };
+  const VectorXs q0{ randomConfiguration( 3, mt ) };
+  const Vector3s n{ 1.0, 0.0, 0.0 };
+  const Vector3s p0{ q0.segment<3>( 0 ) + Vector3s{ 0.5, 0.5, 0.0 } };
+  const Vector3s p1{ q0.segment<3>( 0 ) + Vector3s{ 0.5, -0.5, 0.0 } };
+
+  std::stringstream stream;
+  {
+    ConstraintCache cache;
+    cache.cacheConstraint( BodyBodyConstraint{ 0, 2, p0, n, q0 }, q0, impulseForCorner( 0 ) );
+    cache.cacheConstraint( BodyBodyConstraint{ 0, 2, p1, n, q0 }, q0, impulseForCorner( 1 ) );
+    cache.serialize( stream );
+  }
+  ConstraintCache cache;
+  cache.deserialize( stream );
+  if( cache.empty() )
+  {
+    std::cerr << "Deserialized cache is empty" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Rigidly move the first body
+  VectorXs q1{ q0 };
+  const Matrix33sr R{ Quaternions{ 0.9, 0.1, -0.3, 0.2 }.normalized().toRotationMatrix() };
+  const Vector3s dx{ 0.1, -0.2, 0.3 };
+  q1.segment<3>( 0 ) += dx;
+  Eigen::Map<Matrix33sr>{ q1.segment<9>( 9 ).data() } = R * Eigen::Map<const Matrix33sr>{ q0.segment<9>( 9 ).data() };
+  const Vector3s p1_moved{ q1.segment<3>( 0 ) + R * ( p1 - q0.segment<3>( 0 ) ) };
+  const Vector3s p0_moved{ q1.segment<3>( 0 ) + R * ( p0 - q0.segment<3>( 0 ) ) };
+
+  if( !checkCachedImpulse( cache, BodyBodyConstraint{ 0, 2, p1_moved, n, q1 }, q1, impulseForCorner( 1 ) ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( !checkCachedImpulse( cache, BodyBodyConstraint{ 0, 2, p0_moved, n, q1 }, q1, impulseForCorner( 0 ) ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( !checkCachedImpulse( cache, BodyBodyConstraint{ 0, 1, p0_moved, n, q1 }, q1, VectorXs::Zero( 6 ) ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  cache.clear();
+  if( !cache.empty() )
+  {
+    std::cerr << "Cleared cache is not empty" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Configuration with body order[i] moved to index i
+static VectorXs permuteConfiguration( const VectorXs& q, const std::vector<unsigned>& order )
+{
+  const unsigned nbodies{ unsigned( order.size() ) };
+  VectorXs permuted_q{ q.size() };
+  for( unsigned new_idx = 0; new_idx < nbodies; ++new_idx )
+  {
+    permuted_q.segment<3>( 3 * new_idx ) = q.segment<3>( 3 * order[new_idx] );
+    permuted_q.segment<9>( 3 * nbodies + 9 * new_idx ) = q.segment<9>( 3 * nbodies + 9 * order[new_idx] );
+  }
+  return permuted_q;
+}
+
+// Cached contacts follow their bodies when the bodies are renumbered
+static int testRenumberBodies()
+{
+  std::mt19937_64 mt{ 8675309 };
+  const VectorXs q0{ randomConfiguration( 3, mt ) };
+  const Vector3s n{ 0.0, 1.0, 0.0 };
+  const Vector3s half_width{ 1.0, 0.5, 2.0 };
+  const Vector3s p{ q0.segment<3>( 0 ) + Vector3s{ 0.5, 0.5, 0.0 } };
+
+  ConstraintCache cache;
+  cache.cacheConstraint( BodyBodyConstraint{ 0, 2, p, n, q0 }, q0, impulseForCorner( 0 ) );
+  cache.cacheConstraint( StaticPlaneBoxConstraint{ 1, 4, n, half_width, q0, 3 }, q0, impulseForCorner( 4 ) );
+
+  // Bodies 1 and 2 swap places, so the body-body contact keeps the order of its bodies
+  {
+    const std::vector<unsigned> order{ 0, 2, 1 };
+    std::vector<unsigned> new_index;
+    SpaceFillingCurve::invertOrder( order, new_index );
+    ConstraintCache renumbered_cache{ cache };
+    renumbered_cache.renumberBodies( new_index );
+    const VectorXs q1{ permuteConfiguration( q0, order ) };
+    if( !checkCachedImpulse( renumbered_cache, BodyBodyConstraint{ 0, 1, p, n, q1 }, q1, impulseForCorner( 0 ) ) )
+    {
+      return EXIT_FAILURE;
+    }
+    if( !checkCachedImpulse( renumbered_cache, StaticPlaneBoxConstraint{ 2, 4, n, half_width, q1, 3 }, q1, impulseForCorner( 4 ) ) )
+    {
+      return EXIT_FAILURE;
+    }
+    if( !checkCachedImpulse( renumbered_cache, StaticPlaneBoxConstraint{ 1, 4, n, half_width, q1, 3 }, q1, VectorXs::Zero( 6 ) ) )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Bodies 0 and 2 swap places, so the body-body contact is discarded
+  {
+    const std::vector<unsigned> order{ 2, 1, 0 };
+    std::vector<unsigned> new_index;
+    SpaceFillingCurve::invertOrder( order, new_index );
+    ConstraintCache renumbered_cache{ cache };
+    renumbered_cache.renumberBodies( new_index );
+    const VectorXs q1{ permuteConfiguration( q0, order ) };
+    if( !checkCachedImpulse( renumbered_cache, BodyBodyConstraint{ 0, 2, p, n, q1 }, q1, VectorXs::Zero( 6 ) ) )
+    {
+      return EXIT_FAILURE;
+    }
+    if( !checkCachedImpulse( renumbered_cache, StaticPlaneBoxConstraint{ 1, 4, n, half_width, q1, 3 }, q1, impulseForCorner( 4 ) ) )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( std::string{ argv[1] } == "box_plane_corners" )
+  {
+    return testBoxPlaneCorners();
+  }
+  else if( std::string{ argv[1] } == "body_body_serialization" )
+  {
+    return testBodyBodySerialization();
+  }
+  else if( std::string{ argv[1] } == "renumber_bodies" )
+  {
+    return testRenumberBodies();
+  }
+
+  std::cerr << "Invalid test specified: " << argv[1] << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "scisim/Math/Rational.h"
+#include "scisim/Constraints/ContactBatch.h"
+#include "rigidbody3d/RigidBody3DSim.h"
+#include "rigidbody3d/Geometry/RigidBodySphere.h"
+#include "rigidbody3d/StaticGeometry/StaticPlane.h"
+#include "rigidbody3d/Constraints/BodyBodyConstraint.h"
+#include "rigidbody3d/Constraints/SphereSphereConstraint.h"
+#include "rigidbody3d/Constraints/StaticPlaneBodyConstraint.h"
+#include "rigidbody3d/Constraints/StaticPlaneSphereConstraint.h"
+#include "rigidbody3d/Constraints/TeleportedSphereSphereConstraint.h"
+
+static Vector3s randomUnitVector( std::mt19937_64& mt )
+{
+  std::normal_distribution<scalar> gen{ 0.0, 1.0 };
+  return Vector3s{ gen( mt ), gen( mt ), gen( mt ) }.normalized();
+}
+
+// Generates contacts of every batched type between randomly placed bodies with random velocities
+static void generateContacts( const StaticPlane& plane, std::mt19937_64& mt, VectorXs& q, VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set )
+{
+  constexpr unsigned nbodies{ 8 };
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  q.resize( 12 * nbodies );
+  v.resize( 6 * nbodies );
+  for( unsigned idx = 0; idx < 12 * nbodies; ++idx )
+  {
+    q( idx ) = gen( mt );
+  }
+  for( unsigned idx = 0; idx < 6 * nbodies; ++idx )
+  {
+    v( idx ) = gen( mt );
+  }
+
+  active_set.clear();
+  active_set.emplace_back( new BodyBodyConstraint{ 0, 1, Vector3s{ gen( mt ), gen( mt ), gen( mt ) }, randomUnitVector( mt ), q } );
+  active_set.emplace_back( new StaticPlaneBodyConstraint{ 2, Vector3s{ gen( mt ), gen( mt ), gen( mt ) }, randomUnitVector( mt ), q, 0 } );
+  {
+    // Sphere centers lie along the normal through the contact point
+    const Vector3s n{ randomUnitVector( mt ) };
+    q.segment<3>( 3 * 4 ) = q.segment<3>( 3 * 3 ) - 2.0 * n;
+    active_set.emplace_back( new SphereSphereConstraint{ 3, 4, n, Vector3s{ q.segment<3>( 3 * 3 ) - n }, 1.0, 1.0 } );
+  }
+  active_set.emplace_back( new StaticPlaneSphereConstraint{ 5, 0.5, plane, 0 } );
+  active_set.emplace_back( new BodyBodyConstraint{ 1, 7, Vector3s{ gen( mt ), gen( mt ), gen( mt ) }, randomUnitVector( mt ), q } );
+  // Zero relative velocity, so the basis falls back to an arbitrary tangent
+  v.segment<3>( 3 * 6 ).setZero();
+  v.segment<3>( 3 * ( nbodies + 6 ) ).setZero();
+  active_set.emplace_back( new StaticPlaneBodyConstraint{ 6, Vector3s{ gen( mt ), gen( mt ), gen( mt ) }, randomUnitVector( mt ), q, 0 } );
+}
+
+// Checks the batched bases, forcing terms, H, and impact operator against the virtual Constraint interface
+static int testBatchMatchesConstraints()
+{
+  std::mt19937_64 mt{ 31415 };
+  StaticPlane plane{ Vector3s{ 0.0, -2.0, 0.0 }, Vector3s{ 0.0, 1.0, 0.0 } };
+  plane.v() = Vector3s{ 0.5, 0.0, -0.25 };
+  plane.omega() = Vector3s{ 0.0, 1.5, 0.0 };
+
+  for( unsigned trial = 0; trial < 20; ++trial )
+  {
+    VectorXs q;
+    VectorXs v;
+    std::vector<std::unique_ptr<Constraint>> active_set;
+    generateContacts( plane, mt, q, v, active_set );
+    const unsigned ncons{ unsigned( active_set.size() ) };
+
+    ContactBatch batch;
+    if( !batch.build( q, active_set ) || batch.size() != ncons )
+    {
+      std::cerr << "Failed to batch contacts" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // Contact bases
+    MatrixXXsc bases;
+    batch.computeBases( v, bases );
+    MatrixXXsc basis;
+    for( unsigned con = 0; con < ncons; ++con )
+    {
+      active_set[con]->computeBasis( q, v, basis );
+      if( ( bases.block<3,3>( 0, 3 * con ) - basis ).lpNorm<Eigen::Infinity>() != 0.0 )
+      {
+        std::cerr << "Batched basis disagrees for contact " << con << " at trial " << trial << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    // Forcing terms and H
+    const VectorXs CoR{ VectorXs::Constant( ncons, 0.5 ) };
+    const VectorXs nrel{ VectorXs::Random( ncons ) };
+    const VectorXs drel{ VectorXs::Random( 2 * ncons ) };
+    VectorXs forcing_terms;
+    batch.computeForcingTerms( v, bases, CoR, nrel, drel, forcing_terms );
+    MatrixXXsr H0_batch;
+    MatrixXXsr H1_batch;
+    batch.computeH( bases, H0_batch, H1_batch );
+    VectorXi body0;
+    VectorXi body1;
+    batch.getBodyIndices( body0, body1 );
+    const unsigned nbodies{ unsigned( v.size() / 6 ) };
+    MatrixXXsc N_expected{ MatrixXXsc::Zero( v.size(), ncons ) };
+    for( unsigned con = 0; con < ncons; ++con )
+    {
+      const MatrixXXsc contact_basis{ bases.block<3,3>( 0, 3 * con ) };
+
+      VectorXs forcing_term;
+      active_set[con]->computeForcingTerm( q, v, contact_basis, CoR( con ), nrel( con ), drel.segment<2>( 2 * con ), forcing_term );
+      if( ( forcing_terms.segment<3>( 3 * con ) - forcing_term ).lpNorm<Eigen::Infinity>() > 1.0e-12 )
+      {
+        std::cerr << "Batched forcing term disagrees for contact " << con << " at trial " << trial << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      std::pair<int,int> bodies;
+      active_set[con]->getSimulatedBodyIndices( bodies );
+      MatrixXXsc H0{ MatrixXXsc::Zero( 3, 6 ) };
+      MatrixXXsc H1{ MatrixXXsc::Zero( 3, 6 ) };
+      active_set[con]->evalH( q, contact_basis, H0, H1 );
+      if( ( H0_batch.block<3,6>( 3 * con, 0 ) - H0 ).lpNorm<Eigen::Infinity>() != 0.0 || ( H1_batch.block<3,6>( 3 * con, 0 ) - H1 ).lpNorm<Eigen::Infinity>() != 0.0 )
+      {
+        std::cerr << "Batched H disagrees for contact " << con << " at trial " << trial << std::endl;
+        return EXIT_FAILURE;
+      }
+      if( body0( con ) != bodies.first || body1( con ) != bodies.second )
+      {
+        std::cerr << "Batched body indices disagree for contact " << con << " at trial " << trial << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      // The column of N holds the normal rows of H0 and -H1
+      N_expected.block<3,1>( 3 * bodies.first, con ) = H0.block<1,3>( 0, 0 ).transpose();
+      N_expected.block<3,1>( 3 * ( nbodies + bodies.first ), con ) = H0.block<1,3>( 0, 3 ).transpose();
+      if( bodies.second >= 0 )
+      {
+        N_expected.block<3,1>( 3 * bodies.second, con ) = - H1.block<1,3>( 0, 0 ).transpose();
+        N_expected.block<3,1>( 3 * ( nbodies + bodies.second ), con ) = - H1.block<1,3>( 0, 3 ).transpose();
+      }
+    }
+
+    // Impact operator
+    SparseMatrixsc N{ static_cast<SparseMatrixsc::Index>( v.size() ), static_cast<SparseMatrixsc::Index>( ncons ) };
+    batch.computeN( N );
+    if( ( MatrixXXsc{ N } - N_expected ).lpNorm<Eigen::Infinity>() != 0.0 )
+    {
+      std::cerr << "Batched N disagrees at trial " << trial << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// An active set with a constraint that can not be batched falls back to the virtual interface
+static int testUnbatchableConstraint()
+{
+  std::mt19937_64 mt{ 2718 };
+  const StaticPlane plane{ Vector3s{ 0.0, -2.0, 0.0 }, Vector3s{ 0.0, 1.0, 0.0 } };
+  VectorXs q;
+  VectorXs v;
+  std::vector<std::unique_ptr<Constraint>> active_set;
+  generateContacts( plane, mt, q, v, active_set );
+  active_set.emplace_back( new TeleportedSphereSphereConstraint{ 0, 7, Vector3s::Zero(), Vector3s{ 1.0, 0.0, 0.0 }, 1.0, 1.0 } );
+
+  ContactBatch batch;
+  if( batch.build( q, active_set ) || batch.size() != 0 )
+  {
+    std::cerr << "Batched a constraint that does not support batching" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// A batch matches only the active set and configuration it was built from, and subsets and
+// ordered views carry over each contact
+static int testSubset()
+{
+  std::mt19937_64 mt{ 1618 };
+  const StaticPlane plane{ Vector3s{ 0.0, -2.0, 0.0 }, Vector3s{ 0.0, 1.0, 0.0 } };
+  VectorXs q;
+  VectorXs v;
+  std::vector<std::unique_ptr<Constraint>> active_set;
+  generateContacts( plane, mt, q, v, active_set );
+
+  ContactBatch batch;
+  if( !batch.build( q, active_set ) || !batch.matches( q, active_set ) )
+  {
+    std::cerr << "Batch does not match the active set it was built from" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::swap( active_set[0], active_set[1] );
+  if( batch.matches( q, active_set ) )
+  {
+    std::cerr << "Batch matches a reordered active set" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::swap( active_set[0], active_set[1] );
+  {
+    VectorXs q_moved{ q };
+    q_moved( 0 ) += 1.0;
+    if( batch.matches( q_moved, active_set ) )
+    {
+      std::cerr << "Batch matches a different configuration" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  MatrixXXsc bases;
+  batch.computeBases( v, bases );
+  MatrixXXsr H0;
+  MatrixXXsr H1;
+  batch.computeH( bases, H0, H1 );
+  VectorXi body0;
+  VectorXi body1;
+  batch.getBodyIndices( body0, body1 );
+
+  // Take every other contact in reverse order and reverse the body numbering
+  const std::vector<unsigned> contacts{ 5, 3, 1 };
+  ContactBatch subset;
+  batch.extract( contacts, subset );
+  const int nbodies{ int( v.size() / 6 ) };
+  VectorXi new_indices{ nbodies };
+  for( int body = 0; body < nbodies; ++body )
+  {
+    new_indices( body ) = nbodies - 1 - body;
+  }
+  subset.renumberBodies( new_indices );
+  if( subset.size() != contacts.size() )
+  {
+    std::cerr << "Subset has the wrong number of contacts" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  MatrixXXsc subset_bases{ 3, 3 * int( contacts.size() ) };
+  for( unsigned subset_idx = 0; subset_idx < contacts.size(); ++subset_idx )
+  {
+    subset_bases.middleCols<3>( 3 * subset_idx ) = bases.middleCols<3>( 3 * contacts[subset_idx] );
+  }
+  MatrixXXsr subset_H0;
+  MatrixXXsr subset_H1;
+  subset.computeH( subset_bases, subset_H0, subset_H1 );
+  VectorXi subset_body0;
+  VectorXi subset_body1;
+  subset.getBodyIndices( subset_body0, subset_body1 );
+  for( unsigned subset_idx = 0; subset_idx < contacts.size(); ++subset_idx )
+  {
+    const unsigned con{ contacts[subset_idx] };
+    if( subset_H0.block<3,6>( 3 * subset_idx, 0 ) != H0.block<3,6>( 3 * con, 0 ) || subset_H1.block<3,6>( 3 * subset_idx, 0 ) != H1.block<3,6>( 3 * con, 0 ) )
+    {
+      std::cerr << "Subset H disagrees for contact " << con << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( subset_body0( subset_idx ) != new_indices( body0( con ) ) || subset_body1( subset_idx ) != ( body1( con ) >= 0 ? new_indices( body1( con ) ) : -1 ) )
+    {
+      std::cerr << "Subset body indices disagree for contact " << con << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if( subset.matches( q, active_set ) )
+  {
+    std::cerr << "Subset matches the full active set" << std::endl;
+    return EXIT_FAILURE;
+  }
+  {
+    // Identical constraints, likely at the addresses of the freed batched ones
+    active_set.clear();
+    std::mt19937_64 mt_copy{ 1618 };
+    VectorXs q_copy;
+    VectorXs v_copy;
+    std::vector<std::unique_ptr<Constraint>> new_set;
+    generateContacts( plane, mt_copy, q_copy, v_copy, new_set );
+    if( batch.matches( q, new_set ) )
+    {
+      std::cerr << "Batch matches constraints it was not built from" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // An ordered view of the batch gives the same result as the renumbered subset
+  {
+    VectorXs v_renumbered{ v.size() };
+    for( int body = 0; body < nbodies; ++body )
+    {
+      v_renumbered.segment<3>( 3 * new_indices( body ) ) = v.segment<3>( 3 * body );
+      v_renumbered.segment<3>( 3 * ( nbodies + new_indices( body ) ) ) = v.segment<3>( 3 * ( nbodies + body ) );
+    }
+    const VectorXs CoR{ VectorXs::Constant( int( contacts.size() ), 0.5 ) };
+    const VectorXs nrel{ VectorXs::Constant( int( contacts.size() ), 0.1 ) };
+    const VectorXs drel{ VectorXs::Constant( 2 * int( contacts.size() ), 0.2 ) };
+    VectorXs subset_forcing_terms;
+    subset.computeForcingTerms( v_renumbered, subset_bases, CoR, nrel, drel, subset_forcing_terms );
+    VectorXs view_forcing_terms;
+    batch.computeForcingTerms( contacts, new_indices, v_renumbered, subset_bases, CoR, nrel, drel, view_forcing_terms );
+    MatrixXXsr view_H0;
+    MatrixXXsr view_H1;
+    batch.computeH( contacts, subset_bases, view_H0, view_H1 );
+    VectorXi view_body0;
+    VectorXi view_body1;
+    batch.getBodyIndices( contacts, new_indices, view_body0, view_body1 );
+    if( view_forcing_terms != subset_forcing_terms || view_H0 != subset_H0 || view_H1 != subset_H1 || view_body0 != subset_body0 || view_body1 != subset_body1 )
+    {
+      std::cerr << "Ordered view of the batch disagrees with the subset" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// The simulation batches each active set it computes once, for every operator to share
+static int testSimulationBatch()
+{
+  RigidBody3DSim sim;
+  {
+    const std::vector<Vector3s> X{ { 0.0, 0.4, 0.0 }, { 0.9, 0.4, 0.0 } };
+    const std::vector<Vector3s> zero( X.size(), Vector3s::Zero() );
+    const std::vector<scalar> M( X.size(), 1.0 );
+    const std::vector<Vector3s> I0( X.size(), Vector3s::Constant( 0.1 ) );
+    const std::vector<VectorXs> R( X.size(), Eigen::Map<const VectorXs>{ Matrix33sr::Identity().eval().data(), 9 } );
+    const std::vector<bool> fixed( X.size(), false );
+    const std::vector<unsigned> geometry_indices( X.size(), 0 );
+    std::vector<std::unique_ptr<RigidBodyGeometry>> geometry;
+    geometry.emplace_back( new RigidBodySphere{ 0.5 } );
+    sim.state().setState( X, zero, M, R, zero, I0, fixed, geometry_indices, geometry );
+    sim.state().addStaticPlane( StaticPlane{ Vector3s::Zero(), Vector3s{ 0.0, 1.0, 0.0 } } );
+  }
+
+  const VectorXs q{ sim.state().q() };
+  std::vector<std::unique_ptr<Constraint>> active_set;
+  sim.computeActiveSet( q, q, sim.state().v(), active_set );
+  if( active_set.size() != 3 )
+  {
+    std::cerr << "Expected three contacts, found " << active_set.size() << std::endl;
+    return EXIT_FAILURE;
+  }
+  const ContactBatch* const contact_batch{ sim.contactBatch( q, active_set ) };
+  if( contact_batch == nullptr || contact_batch->size() != active_set.size() )
+  {
+    std::cerr << "Simulation did not batch its active set" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The batch only holds at the configuration it was built at
+  {
+    VectorXs q_moved{ q };
+    q_moved( 0 ) += 0.01;
+    if( sim.contactBatch( q_moved, active_set ) != nullptr )
+    {
+      std::cerr << "Simulation batch used at a different configuration" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Computing a new active set replaces the batch
+  std::vector<std::unique_ptr<Constraint>> next_set;
+  sim.computeActiveSet( q, q, sim.state().v(), next_set );
+  if( sim.contactBatch( q, active_set ) != nullptr || sim.contactBatch( q, next_set ) == nullptr )
+  {
+    std::cerr << "Simulation batch does not follow the latest active set" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( std::string{ argv[1] } == "matches_constraints" )
+  {
+    return testBatchMatchesConstraints();
+  }
+  else if( std::string{ argv[1] } == "unbatchable_constraint" )
+  {
+    return testUnbatchableConstraint();
+  }
+  else if( std::string{ argv[1] } == "subset" )
+  {
+    return testSubset();
+  }
+  else if( std::string{ argv[1] } == "simulation_batch" )
+  {
+    return testSimulationBatch();
+  }
+
+  std::cerr << "Invalid test specified: " << argv[1] << std::endl;
+  return EXIT_FAILURE;
+}
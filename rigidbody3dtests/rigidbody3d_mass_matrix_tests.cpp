@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+
+#include "rigidbody3d/RigidBody3DState.h"
+#include "rigidbody3d/Geometry/RigidBodyBox.h"
+#include "rigidbody3d/Geometry/RigidBodySphere.h"
+#include "scisim/Math/RigidBodyMass3D.h"
+#include "scisim/Math/SpaceFillingCurve.h"
+
+static Matrix33sr randomRotation( std::mt19937_64& mt )
+{
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  return Quaternions{ gen( mt ), gen( mt ), gen( mt ), gen( mt ) }.normalized().toRotationMatrix();
+}
+
+// State of nbodies bodies with random orientations; every third body has isotropic inertia, and every
+// fixed_stride-th body is fixed if fixed_stride is not 0
+static void initializeState( const unsigned nbodies, const unsigned fixed_stride, std::mt19937_64& mt, RigidBody3DState& state )
+{
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  std::vector<Vector3s> X, V, omega, I0;
+  std::vector<scalar> M;
+  std::vector<VectorXs> R;
+  std::vector<bool> fixed;
+  std::vector<unsigned> geometry_indices;
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  {
+    X.emplace_back( 10.0 * Vector3s{ gen( mt ), gen( mt ), gen( mt ) } );
+    V.emplace_back( gen( mt ), gen( mt ), gen( mt ) );
+    omega.emplace_back( gen( mt ), gen( mt ), gen( mt ) );
+    M.emplace_back( 2.0 + gen( mt ) );
+    if( bdy_idx % 3 == 0 )
+    {
+      I0.emplace_back( Vector3s::Constant( 2.0 + gen( mt ) ) );
+    }
+    else
+    {
+      I0.emplace_back( Vector3s{ 2.0 + gen( mt ), 2.0 + gen( mt ), 2.0 + gen( mt ) } );
+    }
+    R.emplace_back( 9 );
+    Eigen::Map<Matrix33sr>{ R.back().data() } = randomRotation( mt );
+    fixed.emplace_back( fixed_stride != 0 && bdy_idx % fixed_stride == 0 );
+    geometry_indices.emplace_back( bdy_idx % 3 == 0 ? 0 : 1 );
+  }
+  std::vector<std::unique_ptr<RigidBodyGeometry>> geometry;
+  geometry.emplace_back( new RigidBodySphere{ 1.0 } );
+  geometry.emplace_back( new RigidBodyBox{ Vector3s{ 1.0, 2.0, 3.0 } } );
+  state.setState( X, V, M, R, omega, I0, fixed, geometry_indices, geometry );
+}
+
+// Compares each inertia block against the inertia rotated to the body's current orientation
+static bool blocksMatchOrientations( const RigidBody3DState& state )
+{
+  for( unsigned bdy_idx = 0; bdy_idx < state.nbodies(); ++bdy_idx )
+  {
+    const Eigen::Map<const Matrix33sr> R{ state.q().data() + 3 * state.nbodies() + 9 * bdy_idx };
+    const Matrix33sr I{ R * RigidBodyMass3D::principalMoments( state.M0(), bdy_idx ).asDiagonal() * R.transpose() };
+    const Matrix33sr Iinv{ R * RigidBodyMass3D::principalMoments( state.Minv0(), bdy_idx ).asDiagonal() * R.transpose() };
+    if( ( state.getInertia( bdy_idx ) - I ).lpNorm<Eigen::Infinity>() > 1.0e-12 || ( state.getInverseInertia( bdy_idx ) - Iinv ).lpNorm<Eigen::Infinity>() > 1.0e-12 )
+    {
+      std::cerr << "Inertia of body " << bdy_idx << " does not match its orientation" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Bodies that do not rotate keep their inertia blocks, and rotated bodies, including bodies that
+// were renumbered, receive the inertia of their new orientation
+static int testIncrementalUpdate()
+{
+  std::mt19937_64 mt{ 1337 };
+  RigidBody3DState state;
+  initializeState( 300, 0, mt, state );
+  state.updateMandMinv();
+  if( !blocksMatchOrientations( state ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  const unsigned nbodies{ state.nbodies() };
+  for( unsigned pass = 0; pass < 3; ++pass )
+  {
+    // Renumber the bodies
+    std::vector<unsigned> order( nbodies );
+    std::iota( order.begin(), order.end(), 0 );
+    std::shuffle( order.begin(), order.end(), mt );
+    state.permuteBodies( order );
+
+    // Rotate every other body
+    const SparseMatrixsc M_old{ state.M() };
+    for( unsigned bdy_idx = pass % 2; bdy_idx < nbodies; bdy_idx += 2 )
+    {
+      Eigen::Map<Matrix33sr>{ state.q().data() + 3 * nbodies + 9 * bdy_idx } = randomRotation( mt );
+    }
+    state.updateMandMinv();
+
+    if( !blocksMatchOrientations( state ) )
+    {
+      return EXIT_FAILURE;
+    }
+    for( unsigned bdy_idx = 1 - pass % 2; bdy_idx < nbodies; bdy_idx += 2 )
+    {
+      if( RigidBodyMass3D::rotationalBlock( state.M(), bdy_idx ) != RigidBodyMass3D::rotationalBlock( M_old, bdy_idx ) )
+      {
+        std::cerr << "Inertia of unrotated body " << bdy_idx << " changed" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // A copy of the state updates identically
+  RigidBody3DState copy{ state };
+  Eigen::Map<Matrix33sr>{ state.q().data() + 3 * nbodies } = randomRotation( mt );
+  copy.q() = state.q();
+  state.updateMandMinv();
+  copy.updateMandMinv();
+  if( state.M().toDense() != copy.M().toDense() || state.Minv().toDense() != copy.Minv().toDense() )
+  {
+    std::cerr << "Copied state updated differently" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// The corners of a cube come out in Z-order, x varying fastest, and invertOrder undoes the ordering
+static int testMortonOrder()
+{
+  const std::vector<unsigned> z_order{ 5, 2, 7, 0, 6, 3, 1, 4 };
+  VectorXs x{ 3 * z_order.size() };
+  for( unsigned curve_idx = 0; curve_idx < z_order.size(); ++curve_idx )
+  {
+    x.segment<3>( 3 * z_order[curve_idx] ) << scalar( curve_idx & 1 ), scalar( ( curve_idx >> 1 ) & 1 ), scalar( ( curve_idx >> 2 ) & 1 );
+  }
+
+  std::vector<unsigned> order;
+  SpaceFillingCurve::computeMortonOrder3D( x, order );
+  if( order != z_order )
+  {
+    std::cerr << "Corners of the cube are not in Z-order" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<unsigned> inverse;
+  SpaceFillingCurve::invertOrder( order, inverse );
+  for( unsigned new_idx = 0; new_idx < order.size(); ++new_idx )
+  {
+    if( inverse[order[new_idx]] != new_idx || order[inverse[new_idx]] != new_idx )
+    {
+      std::cerr << "Inverse ordering does not undo the ordering" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Renumbering the bodies along a Morton curve moves each body's state with it, and renumbering by
+// the inverse ordering restores the state exactly
+static int testPermuteRoundTrip()
+{
+  std::mt19937_64 mt{ 4242 };
+  RigidBody3DState state;
+  initializeState( 200, 7, mt, state );
+  state.updateMandMinv();
+  const RigidBody3DState original{ state };
+  const unsigned nbodies{ state.nbodies() };
+
+  std::vector<unsigned> order;
+  SpaceFillingCurve::computeMortonOrder3D( state.q().segment( 0, 3 * nbodies ), order );
+  std::vector<unsigned> sorted_order{ order };
+  std::sort( sorted_order.begin(), sorted_order.end() );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  {
+    if( sorted_order[bdy_idx] != bdy_idx )
+    {
+      std::cerr << "Morton ordering is not a permutation of the bodies" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  state.permuteBodies( order );
+  for( unsigned new_idx = 0; new_idx < nbodies; ++new_idx )
+  {
+    const unsigned old_idx{ order[new_idx] };
+    if( state.q().segment<3>( 3 * new_idx ) != original.q().segment<3>( 3 * old_idx ) ||
+        state.q().segment<9>( 3 * nbodies + 9 * new_idx ) != original.q().segment<9>( 3 * nbodies + 9 * old_idx ) ||
+        state.v().segment<3>( 3 * new_idx ) != original.v().segment<3>( 3 * old_idx ) ||
+        state.v().segment<3>( 3 * nbodies + 3 * new_idx ) != original.v().segment<3>( 3 * nbodies + 3 * old_idx ) ||
+        state.fixed()[new_idx] != original.fixed()[old_idx] || state.bodyIds()[new_idx] != old_idx ||
+        RigidBodyMass3D::rotationalBlock( state.M(), new_idx ) != RigidBodyMass3D::rotationalBlock( original.M(), old_idx ) )
+    {
+      std::cerr << "State of body " << old_idx << " did not move to index " << new_idx << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<unsigned> inverse;
+  SpaceFillingCurve::invertOrder( order, inverse );
+  state.permuteBodies( inverse );
+  if( state.q() != original.q() || state.v() != original.v() || state.fixed() != original.fixed() || state.bodyIds() != original.bodyIds() )
+  {
+    std::cerr << "Configuration, velocity, or fixed flags not restored by the inverse ordering" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( state.M().toDense() != original.M().toDense() || state.Minv().toDense() != original.Minv().toDense() ||
+      state.M0().toDense() != original.M0().toDense() || state.Minv0().toDense() != original.Minv0().toDense() )
+  {
+    std::cerr << "Mass matrices not restored by the inverse ordering" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "incremental_update" )
+  {
+    return testIncrementalUpdate();
+  }
+  else if( test_name == "morton_order" )
+  {
+    return testMortonOrder();
+  }
+  else if( test_name == "permute_round_trip" )
+  {
+    return testPermuteRoundTrip();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "scisim/Math/Rational.h"
+#include "rigidbody3d/RigidBody3DSim.h"
+#include "rigidbody3d/PythonScripting.h"
+#include "rigidbody3d/Forces/NearEarthGravityForce.h"
+#include "rigidbody3d/Geometry/RigidBodySphere.h"
+#include "rigidbody3d/Geometry/RigidBodyStaple.h"
+#include "rigidbody3d/StaticGeometry/StaticPlane.h"
+#include "rigidbody3d/UnconstrainedMaps/SplitHamMap.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/GaussSeidelOperator.h"
+
+// None of the bodies are fixed, so exactly the sleeping bodies are held
+static bool checkAsleep( const SleepingBodies& sleeping_bodies, const std::vector<bool>& expected )
+{
+  std::vector<unsigned> expected_asleep_bodies;
+  for( unsigned body = 0; body < expected.size(); ++body )
+  {
+    if( sleeping_bodies.isAsleep( body ) != expected[body] )
+    {
+      std::cerr << "Body " << body << ( expected[body] ? " should" : " should not" ) << " be asleep" << std::endl;
+      return false;
+    }
+    if( sleeping_bodies.heldBodies()[body] != expected[body] )
+    {
+      std::cerr << "Body " << body << ( expected[body] ? " should" : " should not" ) << " be held" << std::endl;
+      return false;
+    }
+    if( expected[body] )
+    {
+      expected_asleep_bodies.emplace_back( body );
+    }
+  }
+  if( sleeping_bodies.asleepBodies() != expected_asleep_bodies )
+  {
+    std::cerr << "List of sleeping bodies does not match the sleeping bodies" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Islands sleep only once all of their bodies rested, wake as a whole, and survive renumbering
+// and serialization
+static int testIslands()
+{
+  SleepingBodies sleeping_bodies;
+  sleeping_bodies.setParameters( 0.1, 0.1, 0.1, 3 );
+  sleeping_bodies.reset( std::vector<bool>( 5, false ) );
+  const std::vector<std::pair<unsigned,unsigned>> contacts{ { 0, 1 }, { 1, 2 }, { 3, 4 } };
+  const std::vector<unsigned> body_ids{ 0, 1, 2, 3, 4 };
+  std::vector<unsigned> fell_asleep;
+
+  // Body 2 keeps moving for the first two steps
+  for( unsigned step = 0; step < 3; ++step )
+  {
+    sleeping_bodies.update( { true, true, step >= 2, true, true }, contacts, body_ids, fell_asleep );
+  }
+  if( !checkAsleep( sleeping_bodies, { false, false, false, true, true } ) || fell_asleep.size() != 2 )
+  {
+    return EXIT_FAILURE;
+  }
+  // Contacts are only reported between awake bodies
+  const std::vector<std::pair<unsigned,unsigned>> awake_contacts{ { 0, 1 }, { 1, 2 } };
+  sleeping_bodies.update( { true, true, true, false, false }, awake_contacts, body_ids, fell_asleep );
+  if( !checkAsleep( sleeping_bodies, { false, false, false, true, true } ) )
+  {
+    return EXIT_FAILURE;
+  }
+  sleeping_bodies.update( { true, true, true, false, false }, awake_contacts, body_ids, fell_asleep );
+  if( !checkAsleep( sleeping_bodies, { true, true, true, true, true } ) || fell_asleep.size() != 3 )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Renumber the bodies and round trip them through serialization
+  sleeping_bodies.permuteBodies( { 4, 3, 2, 1, 0 } );
+  std::stringstream stream;
+  sleeping_bodies.serialize( stream );
+  SleepingBodies deserialized;
+  deserialized.deserialize( stream );
+  if( deserialized.numAsleep() != 5 || deserialized.steps() != 3 )
+  {
+    std::cerr << "Deserialized sleeping bodies differ" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Touching one body wakes its whole island, and only that island
+  if( deserialized.wakeIslands( { 1 } ) != 2 || !checkAsleep( deserialized, { false, false, true, true, true } ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( deserialized.wakeIslands( { 2 } ) != 3 || deserialized.numAsleep() != 0 )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Disabling sleeping wakes every body
+  sleeping_bodies.setParameters( 0.1, 0.1, 0.1, 0 );
+  if( sleeping_bodies.numAsleep() != 0 || !checkAsleep( sleeping_bodies, { false, false, false, false, false } ) )
+  {
+    std::cerr << "Disabling sleeping left bodies asleep" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// A row of touching spheres and a lone sphere resting on a plane, and a sphere dropped onto the row
+static void initializeSimulation( RigidBody3DSim& sim )
+{
+  const std::vector<Vector3s> X{ { 0.0, 0.5, 0.0 }, { 0.999, 0.5, 0.0 }, { 1.998, 0.5, 0.0 }, { 10.0, 0.5, 0.0 }, { 0.0, 3.0, 0.0 } };
+  const std::vector<Vector3s> V( X.size(), Vector3s::Zero() );
+  const std::vector<Vector3s> omega( X.size(), Vector3s::Zero() );
+  const std::vector<scalar> M( X.size(), 1.0 );
+  const std::vector<Vector3s> I0( X.size(), Vector3s::Constant( 0.1 ) );
+  const std::vector<VectorXs> R( X.size(), Eigen::Map<const VectorXs>{ Matrix33sr::Identity().eval().data(), 9 } );
+  const std::vector<bool> fixed( X.size(), false );
+  const std::vector<unsigned> geometry_indices( X.size(), 0 );
+  std::vector<std::unique_ptr<RigidBodyGeometry>> geometry;
+  geometry.emplace_back( new RigidBodySphere{ 0.5 } );
+  sim.state().setState( X, V, M, R, omega, I0, fixed, geometry_indices, geometry );
+  sim.state().addForce( NearEarthGravityForce{ Vector3s{ 0.0, -10.0, 0.0 } } );
+  sim.state().addStaticPlane( StaticPlane{ Vector3s::Zero(), Vector3s{ 0.0, 1.0, 0.0 } } );
+  sim.state().sleepingBodies().setParameters( 0.2, 0.2, 0.2, 10 );
+}
+
+static void step( RigidBody3DSim& sim, const unsigned iteration )
+{
+  PythonScripting scripting;
+  SplitHamMap umap;
+  GaussSeidelOperator imap{ 1.0e-9 };
+  sim.flow( scripting, iteration, Rational<std::intmax_t>( 1, 100 ), umap, imap, 0.0 );
+}
+
+// Resting islands fall asleep and hold still, and the dropped sphere wakes only the island it hits
+static int testSleepAndWake()
+{
+  RigidBody3DSim sim;
+  initializeSimulation( sim );
+  const SleepingBodies& sleeping_bodies{ sim.state().sleepingBodies() };
+
+  unsigned iteration{ 1 };
+  for( ; iteration <= 30; ++iteration )
+  {
+    step( sim, iteration );
+  }
+  if( !checkAsleep( sleeping_bodies, { true, true, true, true, false } ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  const VectorXs q_asleep{ sim.state().q() };
+  for( ; iteration <= 200 && sleeping_bodies.isAsleep( 0 ); ++iteration )
+  {
+    step( sim, iteration );
+    if( sleeping_bodies.isAsleep( 0 ) && sim.state().q().segment<3>( 0 ) != q_asleep.segment<3>( 0 ) )
+    {
+      std::cerr << "Sleeping body moved" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if( !checkAsleep( sleeping_bodies, { false, false, false, true, false } ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( ( sim.state().q().segment<3>( 12 ) - sim.state().q().segment<3>( 0 ) ).norm() > 1.1 )
+  {
+    std::cerr << "Island woke before the dropped sphere reached it" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( sim.state().q().segment<3>( 9 ) != q_asleep.segment<3>( 9 ) )
+  {
+    std::cerr << "Lone sleeping sphere moved" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// A simulation restored mid run, with some islands asleep, continues identically
+static int testSerialization()
+{
+  RigidBody3DSim sim;
+  initializeSimulation( sim );
+  unsigned iteration{ 1 };
+  for( ; iteration <= 20; ++iteration )
+  {
+    step( sim, iteration );
+  }
+  if( sim.state().sleepingBodies().numAsleep() == 0 )
+  {
+    std::cerr << "No bodies fell asleep" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::stringstream stream;
+  sim.serialize( stream );
+  RigidBody3DSim restored;
+  restored.deserialize( stream );
+
+  for( ; iteration <= 150; ++iteration )
+  {
+    step( sim, iteration );
+    step( restored, iteration );
+  }
+  if( sim.state().q() != restored.state().q() || sim.state().v() != restored.state().v() )
+  {
+    std::cerr << "Restored simulation diverged" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for( unsigned body = 0; body < sim.state().nbodies(); ++body )
+  {
+    if( sim.state().sleepingBodies().isAsleep( body ) != restored.state().sleepingBodies().isAsleep( body ) )
+    {
+      std::cerr << "Restored sleeping bodies diverged" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// A loose pile of staples, each rotated by 45 degrees about the vertical axis and held just
+// above the one below, and a staple falling towards the top of the pile. The staples' bounding
+// boxes overlap, but the staples never touch, as staple-staple contact is not supported. There
+// is no gravity, as staple-plane contact is not supported either.
+static void initializeStaplePile( RigidBody3DSim& sim )
+{
+  const scalar D{ 0.1 };
+  std::vector<Vector3s> X;
+  std::vector<VectorXs> R;
+  for( unsigned staple = 0; staple < 5; ++staple )
+  {
+    // The falling staple starts above the pile, turned to miss the legs of the resting staples
+    const bool falling{ staple == 4 };
+    X.emplace_back( Vector3s{ 0.0, falling ? 3.0 * 1.5 * D + 0.5 : staple * 1.5 * D, 0.0 } );
+    // No staple lies in an axis aligned plane, which would give it a flat bounding box
+    const scalar theta{ falling ? 0.1875 * PI<scalar> : 0.0625 * PI<scalar> + 0.25 * PI<scalar> * staple };
+    const Matrix33sr rotation{ Eigen::AngleAxis<scalar>{ theta, Vector3s::UnitY() }.toRotationMatrix() };
+    R.emplace_back( Eigen::Map<const VectorXs>{ rotation.data(), 9 } );
+  }
+  std::vector<Vector3s> V( X.size(), Vector3s::Zero() );
+  V.back() = Vector3s{ 0.0, -0.5, 0.0 };
+  const std::vector<Vector3s> omega( X.size(), Vector3s::Zero() );
+  const std::vector<scalar> M( X.size(), 1.0 );
+  const std::vector<Vector3s> I0( X.size(), Vector3s::Constant( 0.1 ) );
+  const std::vector<bool> fixed( X.size(), false );
+  const std::vector<unsigned> geometry_indices( X.size(), 0 );
+  std::vector<std::unique_ptr<RigidBodyGeometry>> geometry;
+  geometry.emplace_back( new RigidBodyStaple{ 1.0, 1.0, D } );
+  sim.state().setState( X, V, M, R, omega, I0, fixed, geometry_indices, geometry );
+  sim.state().sleepingBodies().setParameters( 0.2, 0.2, 0.2, 10 );
+}
+
+// The pile falls asleep while the falling staple's bounding box overlaps it, and stays asleep
+// and in place as the falling staple passes through the overlapping boxes
+static int testStaplePile()
+{
+  RigidBody3DSim sim;
+  initializeStaplePile( sim );
+  const SleepingBodies& sleeping_bodies{ sim.state().sleepingBodies() };
+
+  unsigned iteration{ 1 };
+  for( ; iteration <= 20; ++iteration )
+  {
+    step( sim, iteration );
+  }
+  if( !checkAsleep( sleeping_bodies, { true, true, true, true, false } ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  const VectorXs q_asleep{ sim.state().q() };
+  for( ; iteration <= 40; ++iteration )
+  {
+    step( sim, iteration );
+  }
+  if( !checkAsleep( sleeping_bodies, { true, true, true, true, false } ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( sim.state().q().segment<12>( 0 ) != q_asleep.segment<12>( 0 ) )
+  {
+    std::cerr << "Sleeping staple moved" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( fabs( q_asleep( 13 ) - sim.state().q()( 13 ) - 0.1 ) > 1.0e-9 )
+  {
+    std::cerr << "Falling staple did not pass freely through the pile's bounding boxes" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "islands" )
+  {
+    return testIslands();
+  }
+  else if( test_name == "sleep_and_wake" )
+  {
+    return testSleepAndWake();
+  }
+  else if( test_name == "serialization" )
+  {
+    return testSerialization();
+  }
+  else if( test_name == "staple_pile" )
+  {
+    return testStaplePile();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scisim/HDF5File.h"
+#include "scisim/Utilities.h"
+#include "rigidbody3d/Geometry/MomentTools.h"
+#include "rigidbody3d/Geometry/RigidBodyTriangleMesh.h"
+#include "rigidbody3d/Geometry/SampleHierarchy.h"
+#include "rigidbody3d/Geometry/TriangleMeshCache.h"
+#include "rigidbody3d/Geometry/TriangleMeshData.h"
+
+// Writes a mesh file for a cube of the given half width centered at the origin, with the signed
+// distance field, shifted by signed_distance_offset, sampled on a grid that extends past the cube
+static void writeCubeMesh( const std::string& file_name, const scalar half_width, const scalar signed_distance_offset )
+{
+  Matrix3Xsc vertices{ 3, 8 };
+  for( int vrt_idx = 0; vrt_idx < 8; ++vrt_idx )
+  {
+    vertices.col( vrt_idx ) << ( vrt_idx & 1 ? half_width : -half_width ), ( vrt_idx & 2 ? half_width : -half_width ), ( vrt_idx & 4 ? half_width : -half_width );
+  }
+  Matrix3Xuc faces{ 3, 12 };
+  faces << 0, 0, 4, 4, 0, 0, 2, 2, 0, 0, 1, 1,
+           2, 3, 5, 7, 1, 5, 6, 7, 4, 6, 3, 7,
+           3, 1, 7, 6, 5, 4, 7, 3, 6, 2, 7, 5;
+
+  scalar volume;
+  Vector3s I_on_rho;
+  Vector3s center;
+  Matrix3s R;
+  MomentTools::computeMoments( vertices, faces, volume, I_on_rho, center, R );
+
+  const Vector3u grid_dimensions{ 9, 9, 9 };
+  const Vector3s grid_origin{ Vector3s::Constant( -2.0 * half_width ) };
+  const Vector3s cell_delta{ Vector3s::Constant( 0.5 * half_width ) };
+  VectorXs signed_distance{ grid_dimensions.prod() };
+  for( unsigned k = 0; k < grid_dimensions.z(); ++k )
+  {
+    for( unsigned j = 0; j < grid_dimensions.y(); ++j )
+    {
+      for( unsigned i = 0; i < grid_dimensions.x(); ++i )
+      {
+        const Vector3s x{ grid_origin + cell_delta.cwiseProduct( Vector3s{ scalar( i ), scalar( j ), scalar( k ) } ) };
+        const Vector3s d{ x.cwiseAbs() - Vector3s::Constant( half_width ) };
+        signed_distance( ( k * grid_dimensions.y() + j ) * grid_dimensions.x() + i ) = d.cwiseMax( 0.0 ).norm() + std::min( d.maxCoeff(), 0.0 ) + signed_distance_offset;
+      }
+    }
+  }
+
+  HDF5File mesh_file{ file_name, HDF5AccessType::READ_WRITE };
+  mesh_file.write( "mesh/vertices", vertices );
+  mesh_file.write( "mesh/faces", faces );
+  mesh_file.write( "moments/volume", volume );
+  mesh_file.write( "moments/I_on_rho", I_on_rho );
+  mesh_file.write( "moments/x", center );
+  mesh_file.write( "moments/R", R );
+  mesh_file.write( "surface_samples/samples", vertices );
+  mesh_file.write( "convex_hull/vertices", vertices );
+  mesh_file.write( "sdf/cell_delta", cell_delta );
+  mesh_file.write( "sdf/grid_dimensions", grid_dimensions );
+  mesh_file.write( "sdf/grid_origin", grid_origin );
+  mesh_file.write( "sdf/signed_distance", signed_distance );
+}
+
+static std::string serializedMesh( const RigidBodyGeometry& mesh )
+{
+  std::ostringstream output_stream{ std::ios::binary };
+  mesh.serialize( output_stream );
+  return output_stream.str();
+}
+
+// Meshes loaded from one file and their clones share data, which is released with the last mesh
+static int testSharedData()
+{
+  const std::string file_name{ "rb3d_triangle_mesh_shared.h5" };
+  try
+  {
+    writeCubeMesh( file_name, 1.0, 0.0 );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::weak_ptr<const TriangleMeshData> expired_data;
+  {
+    const RigidBodyTriangleMesh mesh0{ file_name };
+    const RigidBodyTriangleMesh mesh1{ file_name };
+    const std::unique_ptr<RigidBodyGeometry> clone{ mesh0.clone() };
+    const RigidBodyTriangleMesh& cloned_mesh{ static_cast<const RigidBodyTriangleMesh&>( *clone ) };
+    if( &mesh0.data() != &mesh1.data() || &mesh0.data() != &cloned_mesh.data() )
+    {
+      std::cerr << "Meshes loaded from the same file do not share data" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( mesh0.data().signedDistanceIsMapped() )
+    {
+      std::cerr << "Signed distance field mapped without a side file" << std::endl;
+      return EXIT_FAILURE;
+    }
+    expired_data = TriangleMeshCache::load( file_name );
+  }
+  if( !expired_data.expired() )
+  {
+    std::cerr << "Mesh data was not released with the last mesh" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // A deserialized mesh matches the loaded mesh
+  const RigidBodyTriangleMesh mesh{ file_name };
+  std::istringstream input_stream{ serializedMesh( mesh ), std::ios::binary };
+  Utilities::deserialize<RigidBodyGeometryType>( input_stream );
+  const RigidBodyTriangleMesh deserialized_mesh{ input_stream };
+  if( serializedMesh( deserialized_mesh ) != serializedMesh( mesh ) )
+  {
+    std::cerr << "Deserialized mesh does not match the loaded mesh" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( &deserialized_mesh.data() != &mesh.data() )
+  {
+    std::cerr << "Deserialized mesh does not share data with the loaded mesh" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// A signed distance field mapped from a side file gives the same collisions as one read from the mesh
+static int testMappedSignedDistance()
+{
+  const std::string file_name{ "rb3d_triangle_mesh_mapped.h5" };
+  const std::string side_file_name{ TriangleMeshCache::signedDistanceFieldFileName( file_name ) };
+  std::remove( side_file_name.c_str() );
+  try
+  {
+    writeCubeMesh( file_name, 0.5, 0.0 );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937_64 mt{ 1729 };
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  std::vector<Vector3s> points;
+  for( unsigned point_idx = 0; point_idx < 100; ++point_idx )
+  {
+    points.emplace_back( gen( mt ), gen( mt ), gen( mt ) );
+  }
+
+  // The side file is used once the mesh read without it is released
+  std::string read_mesh_bytes;
+  std::vector<bool> read_collisions;
+  std::vector<Vector3s> read_normals;
+  {
+    const RigidBodyTriangleMesh read_mesh{ file_name };
+    if( !TriangleMeshCache::writeSignedDistanceField( read_mesh.data(), side_file_name ) )
+    {
+      return EXIT_FAILURE;
+    }
+    read_mesh_bytes = serializedMesh( read_mesh );
+    for( const Vector3s& point : points )
+    {
+      Vector3s n{ Vector3s::Zero() };
+      read_collisions.emplace_back( read_mesh.detectCollision( point, n ) );
+      read_normals.emplace_back( n );
+    }
+  }
+
+  const RigidBodyTriangleMesh mapped_mesh{ file_name };
+  if( !mapped_mesh.data().signedDistanceIsMapped() )
+  {
+    std::cerr << "Signed distance field was not mapped from the side file" << std::endl;
+    return EXIT_FAILURE;
+  }
+  // The side file starts with a header describing the grid of the mesh
+  {
+    std::ifstream side_file{ side_file_name, std::ios::binary };
+    TriangleMeshCache::SignedDistanceFieldHeader header;
+    side_file.read( reinterpret_cast<char*>( &header ), sizeof( header ) );
+    if( !side_file.good() || !TriangleMeshCache::signedDistanceFieldHeaderMatches( header, mapped_mesh.data() ) )
+    {
+      std::cerr << "Side file header does not describe the grid of the mesh" << std::endl;
+      return EXIT_FAILURE;
+    }
+    ++header.grid_dimensions[1];
+    if( TriangleMeshCache::signedDistanceFieldHeaderMatches( header, mapped_mesh.data() ) )
+    {
+      std::cerr << "Side file header matches a different grid" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if( serializedMesh( mapped_mesh ) != read_mesh_bytes )
+  {
+    std::cerr << "Mapped mesh does not serialize to the read mesh" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( std::count( read_collisions.cbegin(), read_collisions.cend(), true ) == 0 )
+  {
+    std::cerr << "No sample points collide with the mesh" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for( std::vector<Vector3s>::size_type point_idx = 0; point_idx < points.size(); ++point_idx )
+  {
+    Vector3s n{ Vector3s::Zero() };
+    if( mapped_mesh.detectCollision( points[point_idx], n ) != read_collisions[point_idx] || n != read_normals[point_idx] )
+    {
+      std::cerr << "Mapped signed distance field gives a different collision at " << points[point_idx].transpose() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// A side file written for a different mesh file on the same grid, or one that is truncated, is
+// ignored and the signed distance field is read from the mesh file
+static int testStaleSignedDistance()
+{
+  const std::string file_name{ "rb3d_triangle_mesh_stale.h5" };
+  const std::string side_file_name{ TriangleMeshCache::signedDistanceFieldFileName( file_name ) };
+  std::remove( side_file_name.c_str() );
+  try
+  {
+    writeCubeMesh( file_name, 0.5, 0.0 );
+    {
+      const RigidBodyTriangleMesh mesh{ file_name };
+      if( !TriangleMeshCache::writeSignedDistanceField( mesh.data(), side_file_name ) )
+      {
+        return EXIT_FAILURE;
+      }
+    }
+    // Re-process the mesh with a different field on the same grid
+    writeCubeMesh( file_name, 0.5, 0.25 );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const VectorXs expected_signed_distance{ HDF5File{ file_name, HDF5AccessType::READ_ONLY }.read<VectorXs>( "sdf/signed_distance" ) };
+  {
+    const RigidBodyTriangleMesh mesh{ file_name };
+    if( mesh.data().signedDistanceIsMapped() )
+    {
+      std::cerr << "Signed distance field was mapped from a stale side file" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( mesh.data().signedDistance() != expected_signed_distance )
+    {
+      std::cerr << "Signed distance field does not match the mesh file" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Truncate the side file
+  {
+    std::ofstream side_file{ side_file_name, std::ios::binary | std::ios::trunc };
+    side_file << "SCISDF";
+  }
+  const RigidBodyTriangleMesh mesh{ file_name };
+  if( mesh.data().signedDistanceIsMapped() || mesh.data().signedDistance() != expected_signed_distance )
+  {
+    std::cerr << "Signed distance field was not read from the mesh file with a truncated side file" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Batched collision queries match one at a time queries of the transformed samples
+static int testBatchedQueries()
+{
+  const std::string file_name{ "rb3d_triangle_mesh_batched.h5" };
+  std::remove( TriangleMeshCache::signedDistanceFieldFileName( file_name ).c_str() );
+  try
+  {
+    writeCubeMesh( file_name, 0.5, 0.0 );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  const RigidBodyTriangleMesh mesh{ file_name };
+
+  std::mt19937_64 mt{ 314 };
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  // More samples than fit in one block, with a partial final block
+  Matrix3Xsc samples{ 3, 203 };
+  for( int smp_num = 0; smp_num < samples.cols(); ++smp_num )
+  {
+    samples.col( smp_num ) << gen( mt ), gen( mt ), gen( mt );
+  }
+  const Matrix3s R{ Eigen::AngleAxis<scalar>{ 0.7, Vector3s{ 1.0, 2.0, -0.5 }.normalized() }.toRotationMatrix() };
+  const Vector3s t{ 0.2, -0.1, 0.3 };
+
+  std::vector<Vector3s> expected_x;
+  std::vector<Vector3s> expected_n;
+  for( int smp_num = 0; smp_num < samples.cols(); ++smp_num )
+  {
+    const Vector3s x{ R * samples.col( smp_num ) + t };
+    Vector3s n;
+    if( mesh.detectCollision( x, n ) )
+    {
+      expected_x.emplace_back( x );
+      expected_n.emplace_back( n );
+    }
+  }
+  if( expected_x.empty() || expected_x.size() == std::vector<Vector3s>::size_type( samples.cols() ) )
+  {
+    std::cerr << "Samples do not exercise both colliding and separated points" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Results are appended after existing entries
+  std::vector<Vector3s> x{ Vector3s::Zero() };
+  std::vector<Vector3s> n{ Vector3s::Zero() };
+  mesh.detectCollisions( R, t, samples, x, n );
+  if( x.size() != expected_x.size() + 1 || n.size() != expected_n.size() + 1 )
+  {
+    std::cerr << "Batched query found " << x.size() - 1 << " collisions, expected " << expected_x.size() << std::endl;
+    return EXIT_FAILURE;
+  }
+  for( std::vector<Vector3s>::size_type col_num = 0; col_num < expected_x.size(); ++col_num )
+  {
+    if( ( x[col_num + 1] - expected_x[col_num] ).lpNorm<Eigen::Infinity>() > 1.0e-12 || ( n[col_num + 1] - expected_n[col_num] ).lpNorm<Eigen::Infinity>() > 1.0e-9 )
+    {
+      std::cerr << "Batched query differs from single query for collision " << col_num << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Samples entirely outside the grid produce no collisions
+  mesh.detectCollisions( R, Vector3s{ 10.0, 0.0, 0.0 }, samples, x, n );
+  if( x.size() != expected_x.size() + 1 )
+  {
+    std::cerr << "Batched query found collisions outside of the grid" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Queries through a sample hierarchy match queries of every sample, while culling most leaves of a glancing contact
+static int testSampleHierarchy()
+{
+  const std::string file_name{ "rb3d_triangle_mesh_hierarchy.h5" };
+  std::remove( TriangleMeshCache::signedDistanceFieldFileName( file_name ).c_str() );
+  try
+  {
+    writeCubeMesh( file_name, 0.5, 0.0 );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  const RigidBodyTriangleMesh mesh{ file_name };
+
+  std::mt19937_64 mt{ 2718 };
+  std::uniform_real_distribution<scalar> gen{ -3.0, 3.0 };
+  Matrix3Xsc samples{ 3, 2000 };
+  for( int smp_num = 0; smp_num < samples.cols(); ++smp_num )
+  {
+    samples.col( smp_num ) << gen( mt ), gen( mt ), gen( mt );
+  }
+  const SampleHierarchy hierarchy{ samples };
+
+  // The hierarchy holds a permutation of the samples
+  {
+    std::vector<bool> seen( std::size_t( samples.cols() ), false );
+    for( int smp_num = 0; smp_num < samples.cols(); ++smp_num )
+    {
+      const int original{ hierarchy.originalIndex( smp_num ) };
+      if( seen[original] || hierarchy.samples().col( smp_num ) != samples.col( original ) )
+      {
+        std::cerr << "Sample hierarchy does not hold a permutation of the samples" << std::endl;
+        return EXIT_FAILURE;
+      }
+      seen[original] = true;
+    }
+  }
+
+  const Matrix3s R{ Eigen::AngleAxis<scalar>{ -1.1, Vector3s{ 0.3, 1.0, 0.2 }.normalized() }.toRotationMatrix() };
+  for( const Vector3s& t : { Vector3s{ 0.0, 0.0, 0.0 }, Vector3s{ 3.5, 0.0, 0.0 }, Vector3s{ 2.5, 2.5, -2.5 } } )
+  {
+    std::vector<Vector3s> expected_x;
+    std::vector<Vector3s> expected_n;
+    mesh.detectCollisions( R, t, samples, expected_x, expected_n );
+    std::vector<Vector3s> x;
+    std::vector<Vector3s> n;
+    mesh.detectCollisions( R, t, hierarchy, x, n );
+    if( x.size() != expected_x.size() || n.size() != expected_n.size() )
+    {
+      std::cerr << "Hierarchy query found " << x.size() << " collisions, expected " << expected_x.size() << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( std::vector<Vector3s>::size_type col_num = 0; col_num < x.size(); ++col_num )
+    {
+      if( ( x[col_num] - expected_x[col_num] ).lpNorm<Eigen::Infinity>() > 1.0e-12 || ( n[col_num] - expected_n[col_num] ).lpNorm<Eigen::Infinity>() > 1.0e-9 )
+      {
+        std::cerr << "Hierarchy query differs from the full query for collision " << col_num << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  // When the samples only graze the grid, most of them are never visited
+  int visited_samples{ 0 };
+  hierarchy.visitOverlappingLeaves( R, Vector3s{ 2.5, 2.5, -2.5 }, mesh.data().gridOrigin().array(), mesh.data().gridEnd().array(),
+                                    [&visited_samples]( const int, const int num_samples ) { visited_samples += num_samples; } );
+  if( visited_samples == 0 || visited_samples > samples.cols() / 4 )
+  {
+    std::cerr << "Sample hierarchy visited " << visited_samples << " of " << samples.cols() << " samples for a grazing query" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( std::string{ argv[1] } == "shared_data" )
+  {
+    return testSharedData();
+  }
+  else if( std::string{ argv[1] } == "mapped_signed_distance" )
+  {
+    return testMappedSignedDistance();
+  }
+  else if( std::string{ argv[1] } == "stale_signed_distance" )
+  {
+    return testStaleSignedDistance();
+  }
+  else if( std::string{ argv[1] } == "batched_queries" )
+  {
+    return testBatchedQueries();
+  }
+  else if( std::string{ argv[1] } == "sample_hierarchy" )
+  {
+    return testSampleHierarchy();
+  }
+
+  std::cerr << "Invalid test specified: " << argv[1] << std::endl;
+  return EXIT_FAILURE;
+}
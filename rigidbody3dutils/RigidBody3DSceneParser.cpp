@@ -5,6 +5,7 @@
 
 #include "RigidBody3DSceneParser.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
@@ -13,14 +14,18 @@
 #include "scisim/Math/Rational.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ColoredGaussSeidelOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/JacobiOperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GROperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GRROperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/IslandImpactOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorMatrixFreeAPGD.h"
 #include "scisim/ConstrainedMaps/GeometricImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/StabilizedImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/SymplecticEulerImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/StaggeredProjections.h"
 #include "scisim/ConstrainedMaps/Sobogus.h"
+#include "scisim/ConstrainedMaps/IslandFrictionSolver.h"
 #include "scisim/ConstrainedMaps/GRRFriction.h"
 #include "scisim/ConstrainedMaps/FrictionSolver.h"
 #include "scisim/ConstrainedMaps/FrictionMaps/FrictionOperator.h"
@@ -49,6 +54,10 @@
 #include "rigidbody3d/StaticGeometry/StaticCylinder.h"
 #include "rigidbody3d/Portals/PlanarPortal.h"
 
+#ifdef USE_HDF5
+#include "scisim/HDF5File.h"
+#endif
+
 #include "RenderingState.h"
 #include "rapidxml.hpp"
 
@@ -57,19 +66,25 @@ static bool loadTextFileIntoVector( const std::string& filename, std::vector<cha
   assert( xmlchars.empty() );
 
   // Attempt to open the text file for reading
-  std::ifstream textfile( filename );
+  std::ifstream textfile{ filename, std::ios::binary | std::ios::ate };
   if( !textfile.is_open() )
   {
     return false;
   }
 
-  // Read the entire file into a single string
-  std::string line;
-  while( getline( textfile, line ) )
+  // Read the entire file with a single allocation, as scene files with many bodies can be large
+  const std::streamoff file_size{ textfile.tellg() };
+  if( file_size < 0 )
   {
-    std::copy( line.cbegin(), line.cend(), back_inserter( xmlchars ) );
+    return false;
   }
-  xmlchars.emplace_back( '\0' );
+  xmlchars.resize( std::vector<char>::size_type( file_size ) + 1 );
+  textfile.seekg( 0 );
+  if( !textfile.read( xmlchars.data(), file_size ) )
+  {
+    return false;
+  }
+  xmlchars.back() = '\0';
 
   return true;
 }
@@ -123,6 +138,132 @@ static bool loadScriptingSetup( const rapidxml::xml_node<>& node, std::string& s
   return true;
 }
 
+// Reads exactly three whitespace separated scalars. Scene files can hold a very large number of
+// bodies, so this avoids constructing a stream per attribute.
+static bool readVector3( const char* text, Vector3s& vector )
+{
+  for( int component = 0; component < 3; ++component )
+  {
+    char* end;
+    vector( component ) = std::strtod( text, &end );
+    if( end == text )
+    {
+      return false;
+    }
+    text = end;
+  }
+  char* end;
+  std::strtod( text, &end );
+  return end == text;
+}
+
+namespace
+{
+
+  // Bodies stored column by column in an HDF5 file, for scenes too large to list body by body in XML
+  struct RigidBodyList final
+  {
+    Matrix3Xsc x;
+    Matrix3Xsc v;
+    Matrix3Xsc omega;
+    Eigen::Matrix<scalar,1,Eigen::Dynamic> rho;
+    Eigen::Matrix<int,1,Eigen::Dynamic> geo_idx;
+    // Optional, bodies are not fixed if empty
+    Eigen::Matrix<int,1,Eigen::Dynamic> fixed;
+    // Optional rotation vectors, bodies take the orientation of their geometry if empty
+    Matrix3Xsc R;
+  };
+
+}
+
+static bool loadRigidBodyList( const std::string& file_name, RigidBodyList& body_list )
+{
+  #ifdef USE_HDF5
+  try
+  {
+    const HDF5File list_file{ file_name, HDF5AccessType::READ_ONLY };
+    body_list.x = list_file.read<Matrix3Xsc>( "bodies/x" );
+    body_list.v = list_file.read<Matrix3Xsc>( "bodies/v" );
+    body_list.omega = list_file.read<Matrix3Xsc>( "bodies/omega" );
+    body_list.rho = list_file.read<Eigen::Matrix<scalar,1,Eigen::Dynamic>>( "bodies/rho" );
+    body_list.geo_idx = list_file.read<Eigen::Matrix<int,1,Eigen::Dynamic>>( "bodies/geo_idx" );
+    if( list_file.exists( "bodies/fixed" ) )
+    {
+      body_list.fixed = list_file.read<Eigen::Matrix<int,1,Eigen::Dynamic>>( "bodies/fixed" );
+    }
+    if( list_file.exists( "bodies/R" ) )
+    {
+      body_list.R = list_file.read<Matrix3Xsc>( "bodies/R" );
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << "Failed to load rigid_body_list " << file_name << ": " << error << std::endl;
+    return false;
+  }
+  const int nbodies{ int( body_list.rho.size() ) };
+  if( body_list.x.cols() != nbodies || body_list.v.cols() != nbodies || body_list.omega.cols() != nbodies || body_list.geo_idx.size() != nbodies || ( body_list.fixed.size() != 0 && body_list.fixed.size() != nbodies ) || ( body_list.R.cols() != 0 && body_list.R.cols() != nbodies ) )
+  {
+    std::cerr << "Failed to load rigid_body_list " << file_name << ", every data set must have one column per body" << std::endl;
+    return false;
+  }
+  return true;
+  #else
+  std::cerr << "Error, loading rigid_body_list " << file_name << " requires HDF5 support. Please recompile with USE_HDF5=ON." << std::endl;
+  return false;
+  #endif
+}
+
+// Computes the mass properties of a body from its geometry and writes the body into packed state
+static bool insertBody( const std::vector<std::unique_ptr<RigidBodyGeometry>>& geometry, const Vector3s& x, const Vector3s& body_v, const Vector3s& omega, const scalar& rho, const bool body_fixed, int geometry_index, const Vector3s& rotation_vector, const unsigned bdy_idx, VectorXs& q, VectorXs& v, VectorXs& M, Matrix3Xsc& I0, std::vector<bool>& fixed, std::vector<unsigned>& geo_indices )
+{
+  if( geometry_index < 0 )
+  {
+    using std::abs;
+    if( static_cast<unsigned long>(abs(geometry_index)) > geometry.size() )
+    {
+      std::cerr << "Invalid geometry index specified: " << geometry_index << std::endl;
+      std::cerr << "Valid indices: [" << -int(geometry.size()) << ", " << geometry.size() - 1 << "]" << std::endl;
+      return false;
+    }
+    geometry_index = int(geometry.size()) + geometry_index;
+  }
+  else if( static_cast<unsigned long>(geometry_index) >= geometry.size() )
+  {
+    std::cerr << "Invalid geometry index specified: " << geometry_index << std::endl;
+    std::cerr << "Valid indices: [" << -int(geometry.size()) << ", " << geometry.size() - 1 << "]" << std::endl;
+    return false;
+  }
+  assert( geometry_index >= 0 );
+  assert( static_cast<unsigned long>(geometry_index) < geometry.size() );
+
+  Matrix33sr R0;
+  if( rotation_vector.norm() != 0.0 )
+  {
+    R0 = Eigen::AngleAxis<scalar>( rotation_vector.norm(), rotation_vector.normalized() ).matrix();
+  }
+  else
+  {
+    R0.setIdentity();
+  }
+
+  const unsigned nbodies{ unsigned( M.size() ) };
+  assert( bdy_idx < nbodies );
+  Vector3s CM;
+  Vector3s I;
+  Matrix33sr R;
+  geometry[geometry_index]->computeMassAndInertia( rho, M( bdy_idx ), CM, I, R );
+  q.segment<3>( 3 * bdy_idx ) = x + CM;
+  Eigen::Map<Matrix33sr>{ q.data() + 3 * nbodies + 9 * bdy_idx } = R0 * R;
+  v.segment<3>( 3 * bdy_idx ) = body_v;
+  v.segment<3>( 3 * nbodies + 3 * bdy_idx ) = omega;
+  I0.col( bdy_idx ) = I;
+  fixed[bdy_idx] = body_fixed;
+  geo_indices[bdy_idx] = unsigned( geometry_index );
+
+  return true;
+}
+
 static bool loadSimState( const rapidxml::xml_node<>& node, RigidBody3DState& sim_state )
 {
   std::vector<std::unique_ptr<RigidBodyGeometry>> geometry;
@@ -272,97 +413,74 @@ static bool loadSimState( const rapidxml::xml_node<>& node, RigidBody3DState& si
     }
   }
 
-  std::vector<Vector3s> xs;
-  std::vector<Vector3s> vs;
-  std::vector<scalar> Ms;
-  std::vector<VectorXs> Rs;
-  std::vector<Vector3s> omegas;
-  std::vector<Vector3s> I0s;
-  std::vector<bool> fixeds;
-  std::vector<unsigned> geo_indices;
-
+  // Bodies listed in the scene file are loaded first, followed by the bodies of any companion body
+  // lists in document order. All bodies are counted up front so that state is allocated only once.
+  unsigned num_xml_bodies{ 0 };
   for( rapidxml::xml_node<>* nd = node.first_node( "rigid_body_with_density" ); nd; nd = nd->next_sibling( "rigid_body_with_density" ) )
+  {
+    ++num_xml_bodies;
+  }
+  std::vector<RigidBodyList> body_lists;
+  for( rapidxml::xml_node<>* nd = node.first_node( "rigid_body_list" ); nd; nd = nd->next_sibling( "rigid_body_list" ) )
+  {
+    const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "filename" ) };
+    if( !attrib )
+    {
+      std::cerr << "Failed to locate filename attribute for rigid_body_list" << std::endl;
+      return false;
+    }
+    body_lists.emplace_back();
+    if( !loadRigidBodyList( attrib->value(), body_lists.back() ) )
+    {
+      return false;
+    }
+  }
+  unsigned nbodies{ num_xml_bodies };
+  for( const RigidBodyList& body_list : body_lists )
+  {
+    nbodies += unsigned( body_list.rho.size() );
+  }
+
+  VectorXs q{ 12 * nbodies };
+  VectorXs v{ 6 * nbodies };
+  VectorXs M{ nbodies };
+  Matrix3Xsc I0{ 3, nbodies };
+  std::vector<bool> fixed( nbodies );
+  std::vector<unsigned> geo_indices( nbodies );
+
+  unsigned bdy_idx{ 0 };
+  for( rapidxml::xml_node<>* nd = node.first_node( "rigid_body_with_density" ); nd; nd = nd->next_sibling( "rigid_body_with_density" ), ++bdy_idx )
   {
     // Load the center of mass' position
     Vector3s x;
     {
       const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "x" ) };
-      if( !attrib )
+      if( !attrib || !readVector3( attrib->value(), x ) )
       {
         std::cerr << "Failed to load x" << std::endl;
         return false;
       }
-
-      std::stringstream ss;
-      ss << attrib->value();
-      std::vector<scalar> vals;
-      scalar input_scalar;
-      while( ss >> input_scalar )
-      {
-        vals.emplace_back( input_scalar );
-      }
-      if( vals.size() != 3 )
-      {
-        std::cerr << "Failed to load x" << std::endl;
-        return false;
-      }
-
-      x << vals[0], vals[1], vals[2];
     }
     // Load the center of mass' velocity
-    Vector3s v;
+    Vector3s body_v;
     {
       const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "v" ) };
-      if( !attrib )
-      {
-        std::cerr << "Failed to load v" << std::endl;
-        return false;
-      }
-
-      std::stringstream ss;
-      ss << attrib->value();
-      std::vector<scalar> vals;
-      scalar input_scalar;
-      while( ss >> input_scalar )
-      {
-        vals.emplace_back( input_scalar );
-      }
-      if( vals.size() != 3 )
+      if( !attrib || !readVector3( attrib->value(), body_v ) )
       {
         std::cerr << "Failed to load v" << std::endl;
         return false;
       }
-
-      v << vals[0], vals[1], vals[2];
     }
-    vs.emplace_back( v );
     // Load the angular velocity about the center of mass
     Vector3s omega;
     {
       const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "omega" ) };
-      if( !attrib )
+      if( !attrib || !readVector3( attrib->value(), omega ) )
       {
         std::cerr << "Failed to load omega" << std::endl;
         return false;
       }
-
-      std::stringstream ss;
-      ss << attrib->value();
-      std::vector<scalar> vals;
-      scalar input_scalar;
-      while( ss >> input_scalar )
-      {
-        vals.emplace_back( input_scalar );
-      }
-      if( vals.size() != 3 )
-      {
-        std::cerr << "Failed to load omega" << std::endl;
-        return false;
-      }
-
-      omega << vals[0], vals[1], vals[2];
     }
-    omegas.emplace_back( omega );
     // Load the density of the body
     scalar rho;
     {
@@ -380,7 +498,7 @@ static bool loadSimState( const rapidxml::xml_node<>& node, RigidBody3DState& si
       }
     }
     // Load whether or not the body is fixed
-    bool fixed;
+    bool body_fixed;
     {
       const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "fixed" ) };
       if( !attrib )
@@ -388,14 +506,13 @@ static bool loadSimState( const rapidxml::xml_node<>& node, RigidBody3DState& si
         std::cerr << "Failed to load fixed" << std::endl;
         return false;
       }
-      const bool parsed{ StringUtilities::extractFromString( attrib->value(), fixed ) };
+      const bool parsed{ StringUtilities::extractFromString( attrib->value(), body_fixed ) };
       if( !parsed )
       {
         std::cerr << "Failed to load fixed" << std::endl;
         return false;
       }
     }
-    fixeds.push_back( fixed );
     // Load the index of this body's geometry
     int geometry_index;
     {
@@ -412,71 +529,38 @@ static bool loadSimState( const rapidxml::xml_node<>& node, RigidBody3DState& si
         return false;
       }
     }
-    if( geometry_index < 0 )
+    // Load an optional orientation
+    Vector3s rotation_vector{ Vector3s::Zero() };
     {
-      using std::abs;
-      if( static_cast<unsigned long>(abs(geometry_index)) > geometry.size() )
+      const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "R" ) };
+      if( attrib && !StringUtilities::readScalarList( attrib->value(), 3, ' ', rotation_vector ) )
       {
-        std::cerr << "Invalid geometry index specified: " << geometry_index << std::endl;
-        std::cerr << "Valid indices: [" << -int(geometry.size()) << ", " << geometry.size() - 1 << "]" << std::endl;
+        std::cerr << "Failed to load R attribute for rigid_body_with_density, must provide 3 positive scalars" << std::endl;
         return false;
       }
-      geometry_index = int(geometry.size()) + geometry_index;
     }
-    else if( static_cast<unsigned long>(geometry_index) >= geometry.size() )
+
+    if( !insertBody( geometry, x, body_v, omega, rho, body_fixed, geometry_index, rotation_vector, bdy_idx, q, v, M, I0, fixed, geo_indices ) )
     {
-      std::cerr << "Invalid geometry index specified: " << geometry_index << std::endl;
-      std::cerr << "Valid indices: [" << -int(geometry.size()) << ", " << geometry.size() - 1 << "]" << std::endl;
       return false;
     }
-    assert( geometry_index >= 0 );
-    assert( static_cast<unsigned long>(geometry_index) < geometry.size() );
-    geo_indices.emplace_back( geometry_index );
+  }
 
-    // Load an optional orientation
-    Matrix33sr R0;
+  for( const RigidBodyList& body_list : body_lists )
+  {
+    for( int list_idx = 0; list_idx < body_list.rho.size(); ++list_idx, ++bdy_idx )
     {
-      const rapidxml::xml_attribute<>* const attrib{ nd->first_attribute( "R" ) };
-      if( !attrib )
+      const bool body_fixed{ body_list.fixed.size() != 0 && body_list.fixed( list_idx ) != 0 };
+      const Vector3s rotation_vector{ body_list.R.cols() != 0 ? Vector3s{ body_list.R.col( list_idx ) } : Vector3s::Zero() };
+      if( !insertBody( geometry, body_list.x.col( list_idx ), body_list.v.col( list_idx ), body_list.omega.col( list_idx ), body_list.rho( list_idx ), body_fixed, body_list.geo_idx( list_idx ), rotation_vector, bdy_idx, q, v, M, I0, fixed, geo_indices ) )
       {
-        R0.setIdentity();
-      }
-      else
-      {
-        VectorXs rotation_vector;
-        if( !StringUtilities::readScalarList( attrib->value(), 3, ' ', rotation_vector ) )
-        {
-          std::cerr << "Failed to load R attribute for rigid_body_with_density, must provide 3 positive scalars" << std::endl;
-          return false;
-        }
-        assert( rotation_vector.size() == 3 );
-        if( rotation_vector.norm() != 0.0 )
-        {
-          R0 = Eigen::AngleAxis<scalar>( rotation_vector.norm(), rotation_vector.normalized() ).matrix();
-        }
-        else
-        {
-          R0.setIdentity();
-        }
+        return false;
       }
     }
-
-    scalar M;
-    Vector3s CM;
-    Vector3s I;
-    Matrix33sr R;
-    geometry[geo_indices.back()]->computeMassAndInertia( rho, M, CM, I, R );
-    Ms.emplace_back( M );
-    xs.emplace_back( x + CM );
-    I0s.emplace_back( I );
-    R = R0 * R;
-    VectorXs Rvec{ 9 };
-    Rvec = Eigen::Map<VectorXs>{ R.data(), 9, 1 };
-    Rs.emplace_back( Rvec );
   }
+  assert( bdy_idx == nbodies );
 
-  // TODO: Replace with a swap?
-  sim_state.setState( xs, vs, Ms, Rs, omegas, I0s, fixeds, geo_indices, geometry );
+  sim_state.setState( std::move( q ), std::move( v ), M, I0, std::move( fixed ), std::move( geo_indices ), geometry );
 
   return true;
 }
@@ -1219,8 +1303,42 @@ static bool loadLCPSolver( const rapidxml::xml_node<>& node, std::unique_ptr<Imp
 
   const std::string solver_name{ nd->value() };
 
+  if( solver_name == "apgd_matrix_free" )
+  {
+    // Attempt to parse the solver tolerance
+    scalar tol;
+    {
+      const rapidxml::xml_attribute<>* const tol_nd{ node.first_attribute( "tol" ) };
+      if( tol_nd == nullptr )
+      {
+        std::cerr << "Could not locate tol for apgd_matrix_free solver" << std::endl;
+        return false;
+      }
+      if( !StringUtilities::extractFromString( std::string{ tol_nd->value() }, tol ) || tol <= 0.0 )
+      {
+        std::cerr << "Could not load tol for apgd_matrix_free solver, value must be a positive scalar" << std::endl;
+        return false;
+      }
+    }
+    // Attempt to parse the max number of iterations
+    unsigned max_iters;
+    {
+      const rapidxml::xml_attribute<>* const itr_nd{ node.first_attribute( "max_iters" ) };
+      if( itr_nd == nullptr )
+      {
+        std::cerr << "Could not locate max_iters for apgd_matrix_free solver" << std::endl;
+        return false;
+      }
+      if( !StringUtilities::extractFromString( std::string{ itr_nd->value() }, max_iters ) )
+      {
+        std::cerr << "Could not load max_iters for apgd_matrix_free solver, value must be an unsigned integer" << std::endl;
+        return false;
+      }
+    }
+    impact_operator.reset( new LCPOperatorMatrixFreeAPGD{ tol, max_iters } );
+  }
   #ifdef QL_FOUND
-  if( solver_name == "ql_vp" )
+  else if( solver_name == "ql_vp" )
   {
     // Attempt to parse the solver tolerance
     const rapidxml::xml_attribute<>* const tol_nd{ node.first_attribute( "tol" ) };
@@ -1254,10 +1372,9 @@ static bool loadLCPSolver( const rapidxml::xml_node<>& node, std::unique_ptr<Imp
     }
     impact_operator.reset( new LCPOperatorQL{ tol } );
   }
-  else
   #endif
   #ifdef IPOPT_FOUND
-  if( solver_name == "ipopt" )
+  else if( solver_name == "ipopt" )
   {
     // Attempt to read the desired linear solvers
     std::vector<std::string> linear_solvers;
@@ -1307,19 +1424,14 @@ static bool loadLCPSolver( const rapidxml::xml_node<>& node, std::unique_ptr<Imp
     }
     impact_operator.reset( new LCPOperatorIpopt{ linear_solvers, con_tol } );
   }
-  else
   #endif
-  #if defined(QL_FOUND) || defined(IPOPT_FOUND)
+  else
   {
     std::cerr << "Invalid lcp solver name: " << solver_name << std::endl;
     return false;
   }
 
   return true;
-  #else
-  std::cerr << "Invalid lcp solver name: " << solver_name << std::endl;
-  return false;
-  #endif
 }
 
 // TODO: Clean this function up, pull into SCISim
@@ -1338,7 +1450,7 @@ static bool loadImpactOperatorNoCoR( const rapidxml::xml_node<>& node, std::uniq
   }
 
   scalar v_tol{ std::numeric_limits<scalar>::signaling_NaN() };
-  if( type == "gauss_seidel" || type == "jacobi" || type == "gr" )
+  if( type == "gauss_seidel" || type == "colored_gauss_seidel" || type == "jacobi" || type == "gr" )
   {
     // Attempt to load the termination tolerance
     const rapidxml::xml_attribute<>* const v_tol_nd{ node.first_attribute( "v_tol" ) };
@@ -1358,6 +1470,10 @@ static bool loadImpactOperatorNoCoR( const rapidxml::xml_node<>& node, std::uniq
   {
     impact_operator.reset( new GaussSeidelOperator{ v_tol } );
   }
+  else if( type == "colored_gauss_seidel" )
+  {
+    impact_operator.reset( new ColoredGaussSeidelOperator{ v_tol } );
+  }
   else if( type == "jacobi" )
   {
     impact_operator.reset( new JacobiOperator{ v_tol } );
@@ -1876,7 +1992,34 @@ static bool loadSobogusFrictionSolver( const rapidxml::xml_node<>& node, std::un
 
   if( staggering_type == "geometric" )
   {
-    if_map.reset( new GeometricImpactFrictionMap{ tol, static_cast<unsigned>( max_iters ), ImpulsesToCache::NONE } );
+    // Attempt to load the optional cache_impulses option
+    ImpulsesToCache cache_impulses{ ImpulsesToCache::NONE };
+    {
+      const rapidxml::xml_attribute<>* const attrib_nd{ node.first_attribute( "cache_impulses" ) };
+      if( attrib_nd != nullptr )
+      {
+        const std::string impulses_to_cache{ attrib_nd->value() };
+        if( "none" == impulses_to_cache )
+        {
+          cache_impulses = ImpulsesToCache::NONE;
+        }
+        else if( "normal" == impulses_to_cache )
+        {
+          cache_impulses = ImpulsesToCache::NORMAL;
+        }
+        else if( "normal_and_friction" == impulses_to_cache )
+        {
+          cache_impulses = ImpulsesToCache::NORMAL_AND_FRICTION;
+        }
+        else
+        {
+          std::cerr << "Invalid option specified for cache_impulses. Valid options are: none, normal, normal_and_friction" << std::endl;
+          return false;
+        }
+      }
+    }
+
+    if_map.reset( new GeometricImpactFrictionMap{ tol, static_cast<unsigned>( max_iters ), cache_impulses } );
   }
   else if( staggering_type == "symplectic_euler" )
   {
@@ -1962,7 +2105,13 @@ static bool loadSobogusFrictionSolver( const rapidxml::xml_node<>& node, std::un
     return false;
   }
 
-  friction_solver.reset( new Sobogus{ SobogusSolverType::RigidBodies3D, static_cast<unsigned>( eval_every ) } );
+  SobogusSettings settings;
+  if( !loadSobogusSettings( node, settings ) )
+  {
+    return false;
+  }
+
+  friction_solver.reset( new Sobogus{ SobogusSolverType::RigidBodies3D, static_cast<unsigned>( eval_every ), settings } );
   
   return true;
 }
@@ -2099,6 +2248,43 @@ static bool loadGRRFrictionSolver( const rapidxml::xml_node<>& node, scalar& mu,
   return true;
 }
 
+// Splits the impact or friction solve into independent groups of contacts. Example:
+//  <contact_islands min_contacts="64"/>
+static bool loadContactIslands( const rapidxml::xml_node<>& node, std::unique_ptr<ImpactOperator>& impact_operator, std::unique_ptr<FrictionSolver>& friction_solver )
+{
+  // Attempt to load the smallest number of contacts in a group
+  int min_contacts;
+  {
+    const rapidxml::xml_attribute<>* const attrib_nd{ node.first_attribute( "min_contacts" ) };
+    if( attrib_nd == nullptr )
+    {
+      std::cerr << "Could not locate min_contacts for contact_islands" << std::endl;
+      return false;
+    }
+    if( !StringUtilities::extractFromString( attrib_nd->value(), min_contacts ) || min_contacts < 0 )
+    {
+      std::cerr << "Could not load min_contacts value for contact_islands, value of min_contacts must be a nonnegative integer" << std::endl;
+      return false;
+    }
+  }
+
+  if( impact_operator != nullptr )
+  {
+    impact_operator.reset( new IslandImpactOperator{ unsigned( min_contacts ), *impact_operator } );
+  }
+  else if( friction_solver != nullptr )
+  {
+    friction_solver.reset( new IslandFrictionSolver{ unsigned( min_contacts ), *friction_solver } );
+  }
+  else
+  {
+    std::cerr << "Error loading contact_islands, no impact_operator or friction solver specified" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
 static bool loadEndTime( const rapidxml::xml_node<>& node, scalar& end_time )
 {
   // Attempt to parse the time setting
@@ -2123,6 +2309,78 @@ static bool loadEndTime( const rapidxml::xml_node<>& node, scalar& end_time )
   return true;
 }
 
+static bool loadBodyRenumbering( const rapidxml::xml_node<>& node, RigidBody3DState& sim )
+{
+  // Attempt to parse the number of steps between renumberings
+  const rapidxml::xml_attribute<>* steps_attrib{ node.first_attribute( "steps" ) };
+  if( !steps_attrib )
+  {
+    std::cerr << "Failed to locate steps attribute for body_renumbering node." << std::endl;
+    return false;
+  }
+  unsigned steps;
+  if( !StringUtilities::extractFromString( steps_attrib->value(), steps ) || steps == 0 )
+  {
+    std::cerr << "Failed to parse steps attribute for body_renumbering. Value must be a positive integer." << std::endl;
+    return false;
+  }
+  sim.setRenumberingFrequency( steps );
+  return true;
+}
+
+static bool loadSleepingThreshold( const rapidxml::xml_node<>& node, const std::string& attribute_name, scalar& threshold )
+{
+  const rapidxml::xml_attribute<>* threshold_attrib{ node.first_attribute( attribute_name.c_str() ) };
+  if( !threshold_attrib )
+  {
+    std::cerr << "Failed to locate " << attribute_name << " attribute for sleeping node." << std::endl;
+    return false;
+  }
+  if( !StringUtilities::extractFromString( threshold_attrib->value(), threshold ) || threshold < 0.0 )
+  {
+    std::cerr << "Failed to parse " << attribute_name << " attribute for sleeping. Value must be a non-negative scalar." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool loadSleeping( const rapidxml::xml_node<>& node, RigidBody3DState& sim )
+{
+  // Attempt to parse the speeds and impulses below which a body is at rest
+  scalar linear_velocity;
+  if( !loadSleepingThreshold( node, "linear_velocity", linear_velocity ) )
+  {
+    return false;
+  }
+  scalar angular_velocity;
+  if( !loadSleepingThreshold( node, "angular_velocity", angular_velocity ) )
+  {
+    return false;
+  }
+  scalar impulse;
+  if( !loadSleepingThreshold( node, "impulse", impulse ) )
+  {
+    return false;
+  }
+
+  // Attempt to parse the number of steps an island must rest before it falls asleep
+  const rapidxml::xml_attribute<>* steps_attrib{ node.first_attribute( "steps" ) };
+  if( !steps_attrib )
+  {
+    std::cerr << "Failed to locate steps attribute for sleeping node." << std::endl;
+    return false;
+  }
+  unsigned steps;
+  if( !StringUtilities::extractFromString( steps_attrib->value(), steps ) || steps == 0 )
+  {
+    std::cerr << "Failed to parse steps attribute for sleeping. Value must be a positive integer." << std::endl;
+    return false;
+  }
+
+  sim.sleepingBodies().setParameters( linear_velocity, angular_velocity, impulse, steps );
+  return true;
+}
+
 static bool loadSimulationBoundary( const rapidxml::xml_node<>& node, RigidBody3DState& sim )
 {
   // Attempt to read the type of boundary treatment
@@ -2348,6 +2606,16 @@ bool RigidBody3DSceneParser::parseXMLSceneFile( const std::string& file_name, st
     }
   }
 
+  // Split the solve into contact islands, if requested
+  if( root_node.first_node( "contact_islands" ) != nullptr )
+  {
+    if( !loadContactIslands( *root_node.first_node( "contact_islands" ), impact_operator, friction_solver ) )
+    {
+      std::cerr << "Failed to load contact_islands in xml scene file: " << file_name << std::endl;
+      return false;
+    }
+  }
+
   // Load simulation bounds, if present
   if( root_node.first_node( "simulation_boundary" ) != nullptr )
   {
@@ -2400,5 +2668,25 @@ bool RigidBody3DSceneParser::parseXMLSceneFile( const std::string& file_name, st
     return false;
   }
 
+  // Load the frequency of body renumbering, if present
+  if( root_node.first_node( "body_renumbering" ) != nullptr )
+  {
+    if( !loadBodyRenumbering( *root_node.first_node( "body_renumbering" ), sim_state ) )
+    {
+      std::cerr << "Failed to load body_renumbering in xml scene file: " << file_name << std::endl;
+      return false;
+    }
+  }
+
+  // Load the thresholds for putting bodies to sleep, if present
+  if( root_node.first_node( "sleeping" ) != nullptr )
+  {
+    if( !loadSleeping( *root_node.first_node( "sleeping" ), sim_state ) )
+    {
+      std::cerr << "Failed to load sleeping in xml scene file: " << file_name << std::endl;
+      return false;
+    }
+  }
+
   return true;
 }
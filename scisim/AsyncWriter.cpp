@@ -0,0 +1,146 @@
+#include "AsyncWriter.h"
+
+#include <cassert>
+#include <utility>
+
+AsyncWriter::AsyncWriter( const unsigned max_pending_jobs )
+: m_max_pending_jobs( max_pending_jobs )
+, m_mutex()
+, m_job_queued()
+, m_job_completed()
+, m_jobs()
+, m_job_running( false )
+, m_failed( false )
+, m_job_exception()
+, m_stop( false )
+, m_thread()
+{
+  if( m_max_pending_jobs != 0 )
+  {
+    m_thread = std::thread{ &AsyncWriter::run, this };
+  }
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  if( m_thread.joinable() )
+  {
+    // The writer thread drains any queued jobs before exiting
+    {
+      std::lock_guard<std::mutex> lock{ m_mutex };
+      m_stop = true;
+    }
+    m_job_queued.notify_one();
+    m_thread.join();
+  }
+  assert( m_jobs.empty() );
+}
+
+bool AsyncWriter::push( std::function<bool()> job )
+{
+  assert( job );
+  if( m_max_pending_jobs == 0 )
+  {
+    bool succeeded;
+    try
+    {
+      succeeded = job();
+    }
+    catch( ... )
+    {
+      m_failed = true;
+      throw;
+    }
+    if( !succeeded )
+    {
+      m_failed = true;
+    }
+    return !m_failed;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    m_job_completed.wait( lock, [this]{ return m_jobs.size() < m_max_pending_jobs; } );
+    if( m_failed )
+    {
+      rethrowJobException();
+      return false;
+    }
+    m_jobs.emplace_back( std::move( job ) );
+  }
+  m_job_queued.notify_one();
+  return true;
+}
+
+bool AsyncWriter::flush()
+{
+  if( m_max_pending_jobs == 0 )
+  {
+    return !m_failed;
+  }
+  std::unique_lock<std::mutex> lock{ m_mutex };
+  m_job_completed.wait( lock, [this]{ return m_jobs.empty() && !m_job_running; } );
+  rethrowJobException();
+  return !m_failed;
+}
+
+unsigned AsyncWriter::maxPendingJobs() const
+{
+  return m_max_pending_jobs;
+}
+
+void AsyncWriter::run()
+{
+  std::unique_lock<std::mutex> lock{ m_mutex };
+  while( true )
+  {
+    m_job_queued.wait( lock, [this]{ return m_stop || !m_jobs.empty(); } );
+    if( m_jobs.empty() )
+    {
+      assert( m_stop );
+      return;
+    }
+    bool succeeded;
+    std::exception_ptr job_exception;
+    {
+      const std::function<bool()> job{ std::move( m_jobs.front() ) };
+      m_jobs.pop_front();
+      m_job_running = true;
+
+      // Run the job without holding the lock so that more jobs can be queued meanwhile
+      lock.unlock();
+      try
+      {
+        succeeded = job();
+      }
+      catch( ... )
+      {
+        succeeded = false;
+        job_exception = std::current_exception();
+      }
+    }
+    lock.lock();
+
+    m_job_running = false;
+    if( !succeeded )
+    {
+      // Later jobs may also throw, only the first exception is kept for the caller
+      if( !m_failed && job_exception )
+      {
+        m_job_exception = job_exception;
+      }
+      m_failed = true;
+    }
+    m_job_completed.notify_all();
+  }
+}
+
+void AsyncWriter::rethrowJobException()
+{
+  if( m_job_exception )
+  {
+    std::exception_ptr job_exception{ nullptr };
+    std::swap( job_exception, m_job_exception );
+    std::rethrow_exception( job_exception );
+  }
+}
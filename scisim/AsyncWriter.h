@@ -0,0 +1,62 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs output jobs in order on a background thread so that simulation and disk I/O overlap. Jobs
+// must own a copy of the data they write. Once max_pending_jobs are queued, push blocks until the
+// writer catches up. With max_pending_jobs of 0, jobs run synchronously within push. An exception
+// thrown by a job fails the writer and is rethrown on the calling thread by the next push or flush.
+class AsyncWriter final
+{
+
+public:
+
+  explicit AsyncWriter( const unsigned max_pending_jobs );
+  ~AsyncWriter();
+
+  AsyncWriter( const AsyncWriter& ) = delete;
+  AsyncWriter( AsyncWriter&& ) = delete;
+  AsyncWriter& operator=( const AsyncWriter& ) = delete;
+  AsyncWriter& operator=( AsyncWriter&& ) = delete;
+
+  // Queues a job that returns false on failure. Returns false if any job has failed so far, or
+  // rethrows the exception of a job that threw and has not been reported yet.
+  bool push( std::function<bool()> job );
+
+  // Blocks until all queued jobs have run. Returns false if any job has failed, or rethrows the
+  // exception of a job that threw and has not been reported yet.
+  bool flush();
+
+  unsigned maxPendingJobs() const;
+
+private:
+
+  void run();
+  // Rethrows, once, the exception of the first job that threw. Called with the lock held.
+  void rethrowJobException();
+
+  const unsigned m_max_pending_jobs;
+
+  std::mutex m_mutex;
+  // Signaled when a job is queued or the writer is stopped
+  std::condition_variable m_job_queued;
+  // Signaled when a job completes
+  std::condition_variable m_job_completed;
+  std::deque<std::function<bool()>> m_jobs;
+  // True while the writer thread runs a job it has removed from the queue
+  bool m_job_running;
+  bool m_failed;
+  std::exception_ptr m_job_exception;
+  bool m_stop;
+
+  std::thread m_thread;
+
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr char MAGIC_NUMBER[8]{ 'S', 'C', 'I', 'S', 'I', 'M', 'C', 'K' };
+static constexpr std::uint32_t BYTE_ORDER_MARK{ 0x01020304 };
+static constexpr std::size_t NAME_LENGTH{ 48 };
+static constexpr std::size_t SECTION_ALIGNMENT{ 64 };
+static constexpr std::size_t HEADER_SIZE{ sizeof(MAGIC_NUMBER) + 2 * sizeof(std::uint32_t) + sizeof(std::uint64_t) };
+static constexpr std::size_t TABLE_ENTRY_SIZE{ NAME_LENGTH + 2 * sizeof(std::uint64_t) };
+
+static std::uint64_t alignOffset( const std::uint64_t offset )
+{
+  return ( ( offset + SECTION_ALIGNMENT - 1 ) / SECTION_ALIGNMENT ) * SECTION_ALIGNMENT;
+}
+
+template<typename T>
+static void writeValue( const T& value, std::ostream& output_stream )
+{
+  output_stream.write( reinterpret_cast<const char*>( &value ), sizeof(T) );
+}
+
+template<typename T>
+static T readValue( const char* data )
+{
+  T value;
+  std::memcpy( &value, data, sizeof(T) );
+  return value;
+}
+
+CheckpointWriter::CheckpointWriter( const std::uint32_t version )
+: m_version( version )
+, m_sections()
+{}
+
+void CheckpointWriter::addSection( const std::string& name, std::string data )
+{
+  assert( !name.empty() );
+  assert( name.size() < NAME_LENGTH );
+  assert( std::none_of( m_sections.cbegin(), m_sections.cend(), [&name]( const std::pair<std::string,std::string>& section ){ return section.first == name; } ) );
+  m_sections.emplace_back( name, std::move( data ) );
+}
+
+// Flushes a file, or a directory's entries, to disk
+static bool syncToDisk( const std::string& file_name )
+{
+  const int file_descriptor{ open( file_name.c_str(), O_RDONLY ) };
+  if( file_descriptor < 0 )
+  {
+    return false;
+  }
+  const bool synced{ fsync( file_descriptor ) == 0 };
+  close( file_descriptor );
+  return synced;
+}
+
+void CheckpointWriter::write( const std::string& file_name ) const
+{
+  // The checkpoint is completed on disk beside its destination and then renamed over it, so an
+  // interrupted write leaves any previous checkpoint of the same name intact
+  const std::string temporary_file_name{ file_name + ".tmp" };
+  {
+    std::ofstream output_stream{ temporary_file_name, std::ios::binary };
+    if( !output_stream.is_open() )
+    {
+      throw std::string{ "Failed to open checkpoint file: " } + temporary_file_name;
+    }
+
+    // Header
+    output_stream.write( MAGIC_NUMBER, sizeof(MAGIC_NUMBER) );
+    writeValue( m_version, output_stream );
+    writeValue( BYTE_ORDER_MARK, output_stream );
+    writeValue( std::uint64_t( m_sections.size() ), output_stream );
+
+    // Section table
+    std::vector<std::uint64_t> offsets( m_sections.size() );
+    {
+      std::uint64_t offset{ HEADER_SIZE + TABLE_ENTRY_SIZE * m_sections.size() };
+      for( std::vector<std::uint64_t>::size_type section_idx = 0; section_idx < m_sections.size(); ++section_idx )
+      {
+        offset = alignOffset( offset );
+        offsets[section_idx] = offset;
+        offset += m_sections[section_idx].second.size();
+      }
+    }
+    for( std::vector<std::uint64_t>::size_type section_idx = 0; section_idx < m_sections.size(); ++section_idx )
+    {
+      char name[NAME_LENGTH]{};
+      m_sections[section_idx].first.copy( name, NAME_LENGTH - 1 );
+      output_stream.write( name, NAME_LENGTH );
+      writeValue( offsets[section_idx], output_stream );
+      writeValue( std::uint64_t( m_sections[section_idx].second.size() ), output_stream );
+    }
+
+    // Section data, padded to the alignment
+    std::uint64_t position{ HEADER_SIZE + TABLE_ENTRY_SIZE * m_sections.size() };
+    for( std::vector<std::uint64_t>::size_type section_idx = 0; section_idx < m_sections.size(); ++section_idx )
+    {
+      const std::string padding( offsets[section_idx] - position, '\0' );
+      output_stream.write( padding.data(), std::streamsize( padding.size() ) );
+      const std::string& data{ m_sections[section_idx].second };
+      output_stream.write( data.data(), std::streamsize( data.size() ) );
+      position = offsets[section_idx] + data.size();
+    }
+
+    output_stream.close();
+    if( !output_stream.good() )
+    {
+      std::remove( temporary_file_name.c_str() );
+      throw std::string{ "Failed to write checkpoint file: " } + temporary_file_name;
+    }
+  }
+
+  if( !syncToDisk( temporary_file_name ) || std::rename( temporary_file_name.c_str(), file_name.c_str() ) != 0 )
+  {
+    std::remove( temporary_file_name.c_str() );
+    throw std::string{ "Failed to write checkpoint file: " } + file_name;
+  }
+  // Make the rename itself durable before any file that refers to this checkpoint is written
+  const std::string::size_type separator{ file_name.find_last_of( '/' ) };
+  if( !syncToDisk( separator == std::string::npos ? std::string{ "." } : file_name.substr( 0, separator + 1 ) ) )
+  {
+    throw std::string{ "Failed to write checkpoint file: " } + file_name;
+  }
+}
+
+namespace
+{
+
+  // Read only stream buffer over a section of the mapped file
+  class SectionStreamBuffer final : public std::streambuf
+  {
+
+  public:
+
+    SectionStreamBuffer( const char* data, const std::size_t size )
+    {
+      // The buffer is never written through
+      char* begin{ const_cast<char*>( data ) };
+      setg( begin, begin, begin + size );
+    }
+
+  };
+
+  class SectionStream final : public std::istream
+  {
+
+  public:
+
+    SectionStream( const char* data, const std::size_t size )
+    : std::istream( nullptr )
+    , m_buffer( data, size )
+    {
+      rdbuf( &m_buffer );
+    }
+
+  private:
+
+    SectionStreamBuffer m_buffer;
+
+  };
+
+}
+
+CheckpointReader::CheckpointReader( const std::string& file_name )
+: m_data( nullptr )
+, m_size( 0 )
+, m_version( 0 )
+, m_sections()
+{
+  const int file_descriptor{ open( file_name.c_str(), O_RDONLY ) };
+  if( file_descriptor < 0 )
+  {
+    throw std::string{ "Failed to open checkpoint file: " } + file_name;
+  }
+  struct stat file_status;
+  if( fstat( file_descriptor, &file_status ) != 0 || std::size_t( file_status.st_size ) < HEADER_SIZE )
+  {
+    close( file_descriptor );
+    throw std::string{ "Checkpoint file is too small: " } + file_name;
+  }
+  m_size = std::size_t( file_status.st_size );
+  void* const mapped_data{ mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0 ) };
+  // The mapping remains valid after the file is closed
+  close( file_descriptor );
+  if( mapped_data == MAP_FAILED )
+  {
+    throw std::string{ "Failed to map checkpoint file: " } + file_name;
+  }
+  // Sections are read front to back
+  madvise( mapped_data, m_size, MADV_SEQUENTIAL );
+  m_data = static_cast<const char*>( mapped_data );
+
+  // From here on the destructor will not run, so unmap on failure
+  const auto fail = [this]( const std::string& error )
+  {
+    munmap( const_cast<char*>( m_data ), m_size );
+    throw error;
+  };
+
+  if( std::memcmp( m_data, MAGIC_NUMBER, sizeof(MAGIC_NUMBER) ) != 0 )
+  {
+    fail( std::string{ "File is not a checkpoint: " } + file_name );
+  }
+  m_version = readValue<std::uint32_t>( m_data + sizeof(MAGIC_NUMBER) );
+  if( readValue<std::uint32_t>( m_data + sizeof(MAGIC_NUMBER) + sizeof(std::uint32_t) ) != BYTE_ORDER_MARK )
+  {
+    fail( std::string{ "Checkpoint was written with a different byte order: " } + file_name );
+  }
+  const std::uint64_t num_sections{ readValue<std::uint64_t>( m_data + sizeof(MAGIC_NUMBER) + 2 * sizeof(std::uint32_t) ) };
+  if( num_sections > ( m_size - HEADER_SIZE ) / TABLE_ENTRY_SIZE )
+  {
+    fail( std::string{ "Checkpoint section table is truncated: " } + file_name );
+  }
+  for( std::uint64_t section_idx = 0; section_idx < num_sections; ++section_idx )
+  {
+    const char* const entry{ m_data + HEADER_SIZE + TABLE_ENTRY_SIZE * section_idx };
+    const std::string name{ entry, strnlen( entry, NAME_LENGTH ) };
+    const Section section{ readValue<std::uint64_t>( entry + NAME_LENGTH ), readValue<std::uint64_t>( entry + NAME_LENGTH + sizeof(std::uint64_t) ) };
+    if( section.offset > m_size || section.size > m_size - section.offset )
+    {
+      fail( std::string{ "Checkpoint section " } + name + " is truncated: " + file_name );
+    }
+    m_sections.emplace( name, section );
+  }
+}
+
+CheckpointReader::~CheckpointReader()
+{
+  munmap( const_cast<char*>( m_data ), m_size );
+}
+
+bool CheckpointReader::isCheckpoint( const std::string& file_name )
+{
+  std::ifstream input_stream{ file_name, std::ios::binary };
+  char magic_number[sizeof(MAGIC_NUMBER)];
+  input_stream.read( magic_number, sizeof(magic_number) );
+  return input_stream.good() && std::memcmp( magic_number, MAGIC_NUMBER, sizeof(MAGIC_NUMBER) ) == 0;
+}
+
+std::uint32_t CheckpointReader::version() const
+{
+  return m_version;
+}
+
+bool CheckpointReader::hasSection( const std::string& name ) const
+{
+  return m_sections.find( name ) != m_sections.cend();
+}
+
+const CheckpointReader::Section& CheckpointReader::section( const std::string& name ) const
+{
+  const std::map<std::string,Section>::const_iterator section{ m_sections.find( name ) };
+  if( section == m_sections.cend() )
+  {
+    throw std::string{ "Checkpoint is missing section " } + name;
+  }
+  return section->second;
+}
+
+const char* CheckpointReader::sectionData( const std::string& name ) const
+{
+  return m_data + section( name ).offset;
+}
+
+std::size_t CheckpointReader::sectionSize( const std::string& name ) const
+{
+  return std::size_t( section( name ).size );
+}
+
+std::unique_ptr<std::istream> CheckpointReader::stream( const std::string& name ) const
+{
+  return std::unique_ptr<std::istream>{ new SectionStream{ sectionData( name ), sectionSize( name ) } };
+}
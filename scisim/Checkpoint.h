@@ -0,0 +1,118 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+
+// Binary checkpoint made of named sections. The file begins with a header and a table of the
+// sections, followed by the sections themselves. Each section is aligned so that arrays can be
+// used in place when the file is memory mapped, making restarts bounded by disk bandwidth.
+//
+// Layout, in native byte order:
+//   char[8]       magic number "SCISIMCK"
+//   std::uint32_t version of the contents, chosen by the writer
+//   std::uint32_t byte order mark 0x01020304
+//   std::uint64_t number of sections
+//   per section: char[48] NUL padded name, std::uint64_t offset, std::uint64_t size in bytes
+//   section data, each section starting at a multiple of 64 bytes
+
+class CheckpointWriter final
+{
+
+public:
+
+  explicit CheckpointWriter( const std::uint32_t version );
+
+  // Adds a section holding the given bytes. Names must be unique and shorter than 48 characters.
+  void addSection( const std::string& name, std::string data );
+
+  // Adds a section holding a contiguous array of trivially copyable values
+  template<typename T>
+  void addArray( const std::string& name, const T* data, const std::size_t count )
+  {
+    static_assert( std::is_trivially_copyable<T>::value, "Error in checkpoint, array type is not trivially copyable." );
+    addSection( name, std::string( reinterpret_cast<const char*>( data ), count * sizeof(T) ) );
+  }
+
+  template<typename Derived>
+  void addArray( const std::string& name, const Eigen::PlainObjectBase<Derived>& array )
+  {
+    addArray( name, array.data(), std::size_t( array.size() ) );
+  }
+
+  // Writes the checkpoint through a temporary file that replaces file_name once it is on disk, so
+  // an existing checkpoint is never left partially overwritten. Throws a std::string on failure.
+  void write( const std::string& file_name ) const;
+
+private:
+
+  std::uint32_t m_version;
+  std::vector<std::pair<std::string,std::string>> m_sections;
+
+};
+
+class CheckpointReader final
+{
+
+public:
+
+  // Memory maps the checkpoint, throws a std::string on failure
+  explicit CheckpointReader( const std::string& file_name );
+  ~CheckpointReader();
+
+  CheckpointReader( const CheckpointReader& ) = delete;
+  CheckpointReader( CheckpointReader&& ) = delete;
+  CheckpointReader& operator=( const CheckpointReader& ) = delete;
+  CheckpointReader& operator=( CheckpointReader&& ) = delete;
+
+  // True if the file begins with the checkpoint magic number
+  static bool isCheckpoint( const std::string& file_name );
+
+  std::uint32_t version() const;
+
+  bool hasSection( const std::string& name ) const;
+
+  // Contents of a section, throws a std::string if the section does not exist
+  const char* sectionData( const std::string& name ) const;
+  std::size_t sectionSize( const std::string& name ) const;
+
+  // Array stored in a section, valid while the reader exists
+  template<typename T>
+  Eigen::Map<const Eigen::Matrix<T,Eigen::Dynamic,1>> array( const std::string& name ) const
+  {
+    static_assert( std::is_trivially_copyable<T>::value, "Error in checkpoint, array type is not trivially copyable." );
+    const std::size_t size{ sectionSize( name ) };
+    if( size % sizeof(T) != 0 )
+    {
+      throw std::string{ "Checkpoint section " } + name + " is not an array of the requested type";
+    }
+    return Eigen::Map<const Eigen::Matrix<T,Eigen::Dynamic,1>>{ reinterpret_cast<const T*>( sectionData( name ) ), Eigen::Index( size / sizeof(T) ) };
+  }
+
+  // Stream over a section, for data written with the serialize methods
+  std::unique_ptr<std::istream> stream( const std::string& name ) const;
+
+private:
+
+  struct Section final
+  {
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+
+  const Section& section( const std::string& name ) const;
+
+  const char* m_data;
+  std::size_t m_size;
+  std::uint32_t m_version;
+  std::map<std::string,Section> m_sections;
+
+};
+
+#endif
@@ -0,0 +1,529 @@
+#ifndef SORTED_CELL_GRID_H
+#define SORTED_CELL_GRID_H
+
+#include "scisim/Math/MathDefines.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Uniform grid broad phase shared by the 2D and 3D simulations. Each AABB is rasterized into the
+// cells it touches, and the resulting (cell, AABB) entries are counting sorted by a hash of their
+// 64 bit cell key into one contiguous array. A pair of AABBs is only tested in the first cell the
+// two share, and candidate pairs are gathered in a flat vector and sorted. All storage is reused
+// between queries, so a query does not allocate per cell or per pair.
+//
+// The grid persists across queries. It keeps its cells while every AABB stays inside of them and
+// the typical AABB size stays near the cell width. Each bucket is given some slack when the entries
+// are sorted, so an AABB that changes the range of cells it covers is removed from the cells it
+// left and inserted into the cells it entered in place. A bucket that runs out of slack is moved
+// to the end of the sorted arrays with twice the room. The entries are only rasterized and sorted
+// again when the cells change or when too much of the sorted arrays is left behind by moved buckets.
+//
+// AABBType must provide min() and max() returning Eigen::Array<scalar,N,1>, and overlaps().
+template<int N>
+class SortedCellGrid final
+{
+
+public:
+
+  using ArrayNs = Eigen::Array<scalar,N,1>;
+  using ArrayNu = Eigen::Array<unsigned,N,1>;
+
+  SortedCellGrid();
+
+  // Returns the sorted and unique pairs of indices of overlapping AABBs. The returned
+  // reference is invalidated by the next query.
+  template<typename AABBType>
+  const std::vector<std::pair<unsigned,unsigned>>& computePotentialOverlaps( const std::vector<AABBType>& aabbs );
+
+  // Pairs reported by the last query
+  const std::vector<std::pair<unsigned,unsigned>>& potentialOverlaps() const;
+
+  // Discards the grid, the next query will rebuild it from scratch
+  void clear();
+
+  // Width of a grid cell; zero if the grid has not been built
+  const scalar& cellWidth() const;
+
+  // Number of AABBs that were added, removed, or changed cells during the last query
+  unsigned numMovedAABBs() const;
+
+private:
+
+  // Returns true if the cells of the grid changed
+  template<typename AABBType>
+  bool initialize( const std::vector<AABBType>& aabbs );
+  template<typename AABBType>
+  void rebuildEntries( const std::vector<AABBType>& aabbs );
+  template<typename AABBType>
+  void updateEntries( const std::vector<AABBType>& aabbs );
+  void computeCellRange( const ArrayNs& min, const ArrayNs& max, ArrayNu& index_lower, ArrayNu& index_upper ) const;
+  void rasterize();
+  void sortEntries();
+
+  // Removes the entries of an AABB from the cells in [lower, upper] outside of [keep_lower, keep_upper]
+  void removeEntries( const unsigned aabb_idx, const ArrayNu& lower, const ArrayNu& upper, const ArrayNu& keep_lower, const ArrayNu& keep_upper );
+  // Inserts entries of an AABB into the cells in [lower, upper] outside of [skip_lower, skip_upper]
+  void insertEntries( const unsigned aabb_idx, const ArrayNu& lower, const ArrayNu& upper, const ArrayNu& skip_lower, const ArrayNu& skip_upper );
+  void growBucket( const unsigned bucket_idx );
+
+  // Advances index to the next cell in [lower, upper], first axis fastest; returns false past the last cell
+  static bool nextCell( const ArrayNu& lower, const ArrayNu& upper, ArrayNu& index );
+  static bool inRange( const ArrayNu& index, const ArrayNu& lower, const ArrayNu& upper );
+
+  void computeCellIndex( const ArrayNs& coord, ArrayNu& index ) const;
+  std::uint64_t keyForIndex( const ArrayNu& index ) const;
+  unsigned bucketForKey( const std::uint64_t key ) const;
+
+  // Lower corner, cell width, and number of cells along each axis
+  ArrayNs m_min_coord;
+  scalar m_h;
+  ArrayNu m_dimensions;
+  // Stride of each axis in the linear cell key
+  Eigen::Array<std::uint64_t,N,1> m_strides;
+  // Number of hash buckets is 2^(64 - m_bucket_shift)
+  unsigned m_bucket_shift;
+
+  // Range of cells covered by each AABB
+  std::vector<ArrayNu> m_lower;
+  std::vector<ArrayNu> m_upper;
+  unsigned m_num_moved;
+
+  // Cell key and AABB index of each (cell, AABB) entry, in rasterization order
+  std::vector<std::uint64_t> m_entry_keys;
+  std::vector<unsigned> m_entry_aabbs;
+  // Offset and number of slots of each bucket in the sorted arrays, and the number of slots in use
+  // at the front of each bucket
+  std::vector<unsigned> m_bucket_starts;
+  std::vector<unsigned> m_bucket_capacities;
+  std::vector<unsigned> m_bucket_sizes;
+  // Number of slots in the sorted arrays left behind by buckets that grew
+  unsigned m_num_abandoned_slots;
+  // Entries grouped by bucket; within a bucket, AABB indices are nondecreasing
+  std::vector<std::uint64_t> m_sorted_keys;
+  std::vector<unsigned> m_sorted_aabbs;
+
+  // Storage for reported overlaps
+  std::vector<std::pair<unsigned,unsigned>> m_overlaps;
+
+};
+
+template<int N>
+SortedCellGrid<N>::SortedCellGrid()
+: m_min_coord( ArrayNs::Zero() )
+, m_h( 0.0 )
+, m_dimensions( ArrayNu::Zero() )
+, m_strides( Eigen::Array<std::uint64_t,N,1>::Zero() )
+, m_bucket_shift( 63 )
+, m_lower()
+, m_upper()
+, m_num_moved( 0 )
+, m_entry_keys()
+, m_entry_aabbs()
+, m_bucket_starts()
+, m_bucket_capacities()
+, m_bucket_sizes()
+, m_num_abandoned_slots( 0 )
+, m_sorted_keys()
+, m_sorted_aabbs()
+, m_overlaps()
+{}
+
+template<int N>
+template<typename AABBType>
+const std::vector<std::pair<unsigned,unsigned>>& SortedCellGrid<N>::computePotentialOverlaps( const std::vector<AABBType>& aabbs )
+{
+  m_overlaps.clear();
+  if( aabbs.size() < 2 )
+  {
+    clear();
+    return m_overlaps;
+  }
+
+  if( initialize( aabbs ) )
+  {
+    rebuildEntries( aabbs );
+  }
+  else
+  {
+    updateEntries( aabbs );
+  }
+
+  // For each bucket
+  for( std::vector<unsigned>::size_type bucket_idx = 0; bucket_idx < m_bucket_sizes.size(); ++bucket_idx )
+  {
+    const unsigned bucket_end{ m_bucket_starts[bucket_idx] + m_bucket_sizes[bucket_idx] };
+    // Visit each pair of entries in this bucket
+    for( unsigned idx0 = m_bucket_starts[bucket_idx]; idx0 + 1 < bucket_end; ++idx0 )
+    {
+      for( unsigned idx1 = idx0 + 1; idx1 < bucket_end; ++idx1 )
+      {
+        // Distinct cells can hash to the same bucket
+        if( m_sorted_keys[idx0] != m_sorted_keys[idx1] )
+        {
+          continue;
+        }
+        const unsigned aabb0{ m_sorted_aabbs[idx0] };
+        const unsigned aabb1{ m_sorted_aabbs[idx1] };
+        assert( aabb0 < aabb1 );
+        // AABBs that share several cells are only tested in the first cell they share
+        if( m_sorted_keys[idx0] != keyForIndex( m_lower[aabb0].max( m_lower[aabb1] ) ) )
+        {
+          continue;
+        }
+        if( aabbs[aabb0].overlaps( aabbs[aabb1] ) )
+        {
+          m_overlaps.emplace_back( aabb0, aabb1 );
+        }
+      }
+    }
+  }
+
+  std::sort( m_overlaps.begin(), m_overlaps.end() );
+  assert( std::adjacent_find( m_overlaps.begin(), m_overlaps.end() ) == m_overlaps.end() );
+
+  return m_overlaps;
+}
+
+template<int N>
+void SortedCellGrid<N>::clear()
+{
+  m_h = 0.0;
+  m_lower.clear();
+  m_upper.clear();
+  m_num_moved = 0;
+}
+
+template<int N>
+const scalar& SortedCellGrid<N>::cellWidth() const
+{
+  return m_h;
+}
+
+template<int N>
+unsigned SortedCellGrid<N>::numMovedAABBs() const
+{
+  return m_num_moved;
+}
+
+template<int N>
+const std::vector<std::pair<unsigned,unsigned>>& SortedCellGrid<N>::potentialOverlaps() const
+{
+  return m_overlaps;
+}
+
+template<int N>
+template<typename AABBType>
+bool SortedCellGrid<N>::initialize( const std::vector<AABBType>& aabbs )
+{
+  assert( !aabbs.empty() );
+
+  // Compute a bounding box for all AABBs
+  ArrayNs min_coord{ ArrayNs::Constant( SCALAR_INFINITY ) };
+  ArrayNs max_coord{ ArrayNs::Constant( -SCALAR_INFINITY ) };
+  // Compute the grid cell width
+  ArrayNs delta{ ArrayNs::Zero() };
+  for( const AABBType& aabb : aabbs )
+  {
+    assert( ( aabb.min() < aabb.max() ).all() );
+    min_coord = min_coord.min( aabb.min() );
+    max_coord = max_coord.max( aabb.max() );
+    delta += aabb.max() - aabb.min();
+  }
+  const scalar h{ delta.maxCoeff() / scalar( aabbs.size() ) };
+  assert( h > 0.0 );
+
+  // Keep the current cells if the typical AABB size is close to the cell width and every AABB,
+  // enlarged as when rasterized, lies inside of the grid
+  if( m_h != 0.0 && h <= 2.0 * m_h && h >= 0.5 * m_h && ( min_coord - 1.0e-6 > m_min_coord ).all() && ( ( max_coord + 1.0e-6 - m_min_coord ) / m_h < m_dimensions.template cast<scalar>() ).all() )
+  {
+    return false;
+  }
+
+  // Pad the grid by a cell so that AABBs can move a little before the grid is rebuilt, and
+  // inflate it to account for FPA quantization errors
+  m_h = h;
+  m_min_coord = min_coord - m_h - 2.0e-6;
+  max_coord += m_h + 2.0e-6;
+
+  // Compute the number of cells in the grid
+  const ArrayNs scaled_extent{ ( ( max_coord - m_min_coord ) / m_h ).ceil() };
+  assert( ( scaled_extent < scalar( std::numeric_limits<unsigned>::max() ) ).all() );
+  // The linear cell key must fit in 64 bits
+  assert( scaled_extent.prod() < scalar( std::numeric_limits<std::uint64_t>::max() ) );
+  m_dimensions = scaled_extent.template cast<unsigned>();
+
+  m_strides( 0 ) = 1;
+  for( int axis = 1; axis < N; ++axis )
+  {
+    m_strides( axis ) = m_strides( axis - 1 ) * std::uint64_t( m_dimensions( axis - 1 ) );
+  }
+
+  return true;
+}
+
+template<int N>
+template<typename AABBType>
+void SortedCellGrid<N>::rebuildEntries( const std::vector<AABBType>& aabbs )
+{
+  m_num_moved = unsigned( std::max( m_lower.size(), aabbs.size() ) );
+  m_lower.resize( aabbs.size() );
+  m_upper.resize( aabbs.size() );
+  for( typename std::vector<AABBType>::size_type aabb_idx = 0; aabb_idx < aabbs.size(); ++aabb_idx )
+  {
+    computeCellRange( aabbs[aabb_idx].min(), aabbs[aabb_idx].max(), m_lower[aabb_idx], m_upper[aabb_idx] );
+  }
+  rasterize();
+  sortEntries();
+}
+
+template<int N>
+template<typename AABBType>
+void SortedCellGrid<N>::updateEntries( const std::vector<AABBType>& aabbs )
+{
+  m_num_moved = 0;
+  // An empty range, as the lower corner exceeds the upper corner
+  const ArrayNu no_lower{ ArrayNu::Ones() };
+  const ArrayNu no_upper{ ArrayNu::Zero() };
+
+  // Remove the AABBs that no longer exist
+  for( std::size_t aabb_idx = aabbs.size(); aabb_idx < m_lower.size(); ++aabb_idx )
+  {
+    removeEntries( unsigned( aabb_idx ), m_lower[aabb_idx], m_upper[aabb_idx], no_lower, no_upper );
+    ++m_num_moved;
+  }
+  const std::size_t num_kept{ std::min( m_lower.size(), aabbs.size() ) };
+  m_lower.resize( aabbs.size() );
+  m_upper.resize( aabbs.size() );
+
+  ArrayNu index_lower;
+  ArrayNu index_upper;
+  for( typename std::vector<AABBType>::size_type aabb_idx = 0; aabb_idx < aabbs.size(); ++aabb_idx )
+  {
+    computeCellRange( aabbs[aabb_idx].min(), aabbs[aabb_idx].max(), index_lower, index_upper );
+    if( aabb_idx < num_kept )
+    {
+      if( ( index_lower == m_lower[aabb_idx] ).all() && ( index_upper == m_upper[aabb_idx] ).all() )
+      {
+        continue;
+      }
+      // Move the AABB out of the cells it left and into the cells it entered
+      removeEntries( unsigned( aabb_idx ), m_lower[aabb_idx], m_upper[aabb_idx], index_lower, index_upper );
+      insertEntries( unsigned( aabb_idx ), index_lower, index_upper, m_lower[aabb_idx], m_upper[aabb_idx] );
+    }
+    else
+    {
+      insertEntries( unsigned( aabb_idx ), index_lower, index_upper, no_lower, no_upper );
+    }
+    ++m_num_moved;
+    m_lower[aabb_idx] = index_lower;
+    m_upper[aabb_idx] = index_upper;
+  }
+
+  // Compact the sorted arrays once most of them were left behind by grown buckets
+  if( 2 * std::size_t( m_num_abandoned_slots ) > m_sorted_keys.size() )
+  {
+    rasterize();
+    sortEntries();
+  }
+}
+
+template<int N>
+void SortedCellGrid<N>::computeCellRange( const ArrayNs& min, const ArrayNs& max, ArrayNu& index_lower, ArrayNu& index_upper ) const
+{
+  // Slightly enlarge the boxes to account for FPA errors
+  computeCellIndex( min - 1.0e-6, index_lower );
+  computeCellIndex( max + 1.0e-6, index_upper );
+  assert( ( index_lower <= index_upper ).all() );
+}
+
+template<int N>
+void SortedCellGrid<N>::rasterize()
+{
+  m_entry_keys.clear();
+  m_entry_aabbs.clear();
+
+  // For each bounding box
+  for( std::size_t aabb_idx = 0; aabb_idx < m_lower.size(); ++aabb_idx )
+  {
+    const ArrayNu& index_lower{ m_lower[aabb_idx] };
+    const ArrayNu& index_upper{ m_upper[aabb_idx] };
+
+    ArrayNu index{ index_lower };
+    do
+    {
+      m_entry_keys.emplace_back( keyForIndex( index ) );
+      m_entry_aabbs.emplace_back( unsigned( aabb_idx ) );
+    }
+    while( nextCell( index_lower, index_upper, index ) );
+  }
+  assert( m_entry_keys.size() == m_entry_aabbs.size() );
+  assert( m_entry_keys.size() < std::numeric_limits<unsigned>::max() );
+}
+
+template<int N>
+void SortedCellGrid<N>::sortEntries()
+{
+  const unsigned num_entries{ unsigned( m_entry_keys.size() ) };
+
+  // Use the smallest power of two number of buckets, with at least two buckets, that holds every entry
+  m_bucket_shift = 63;
+  while( m_bucket_shift > 33 && ( std::uint64_t( 1 ) << ( 64 - m_bucket_shift ) ) < num_entries )
+  {
+    --m_bucket_shift;
+  }
+  const unsigned num_buckets{ unsigned( std::uint64_t( 1 ) << ( 64 - m_bucket_shift ) ) };
+
+  // Count the entries in each bucket
+  m_bucket_sizes.assign( num_buckets, 0 );
+  for( const std::uint64_t key : m_entry_keys )
+  {
+    ++m_bucket_sizes[bucketForKey( key )];
+  }
+  // Leave room in each bucket for AABBs that move into its cells
+  m_bucket_starts.resize( num_buckets );
+  m_bucket_capacities.resize( num_buckets );
+  unsigned num_slots{ 0 };
+  for( unsigned bucket_idx = 0; bucket_idx < num_buckets; ++bucket_idx )
+  {
+    m_bucket_starts[bucket_idx] = num_slots;
+    m_bucket_capacities[bucket_idx] = m_bucket_sizes[bucket_idx] + m_bucket_sizes[bucket_idx] / 2 + 2;
+    num_slots += m_bucket_capacities[bucket_idx];
+  }
+  m_num_abandoned_slots = 0;
+
+  // Scatter the entries into their buckets; entries are visited in order of increasing AABB index,
+  // so each bucket holds nondecreasing AABB indices
+  std::fill( m_bucket_sizes.begin(), m_bucket_sizes.end(), 0 );
+  m_sorted_keys.resize( num_slots );
+  m_sorted_aabbs.resize( num_slots );
+  for( unsigned entry_idx = 0; entry_idx < num_entries; ++entry_idx )
+  {
+    const unsigned bucket_idx{ bucketForKey( m_entry_keys[entry_idx] ) };
+    const unsigned destination{ m_bucket_starts[bucket_idx] + m_bucket_sizes[bucket_idx]++ };
+    m_sorted_keys[destination] = m_entry_keys[entry_idx];
+    m_sorted_aabbs[destination] = m_entry_aabbs[entry_idx];
+  }
+}
+
+template<int N>
+void SortedCellGrid<N>::removeEntries( const unsigned aabb_idx, const ArrayNu& lower, const ArrayNu& upper, const ArrayNu& keep_lower, const ArrayNu& keep_upper )
+{
+  ArrayNu index{ lower };
+  do
+  {
+    if( inRange( index, keep_lower, keep_upper ) )
+    {
+      continue;
+    }
+    const std::uint64_t key{ keyForIndex( index ) };
+    const unsigned bucket_idx{ bucketForKey( key ) };
+    const unsigned bucket_begin{ m_bucket_starts[bucket_idx] };
+    const unsigned bucket_end{ bucket_begin + m_bucket_sizes[bucket_idx] };
+    unsigned entry_idx{ bucket_begin };
+    while( m_sorted_aabbs[entry_idx] != aabb_idx || m_sorted_keys[entry_idx] != key )
+    {
+      ++entry_idx;
+      assert( entry_idx < bucket_end );
+    }
+    // Close the gap, preserving the order of the AABB indices
+    std::copy( m_sorted_keys.begin() + entry_idx + 1, m_sorted_keys.begin() + bucket_end, m_sorted_keys.begin() + entry_idx );
+    std::copy( m_sorted_aabbs.begin() + entry_idx + 1, m_sorted_aabbs.begin() + bucket_end, m_sorted_aabbs.begin() + entry_idx );
+    --m_bucket_sizes[bucket_idx];
+  }
+  while( nextCell( lower, upper, index ) );
+}
+
+template<int N>
+void SortedCellGrid<N>::insertEntries( const unsigned aabb_idx, const ArrayNu& lower, const ArrayNu& upper, const ArrayNu& skip_lower, const ArrayNu& skip_upper )
+{
+  ArrayNu index{ lower };
+  do
+  {
+    if( inRange( index, skip_lower, skip_upper ) )
+    {
+      continue;
+    }
+    const std::uint64_t key{ keyForIndex( index ) };
+    const unsigned bucket_idx{ bucketForKey( key ) };
+    if( m_bucket_sizes[bucket_idx] == m_bucket_capacities[bucket_idx] )
+    {
+      growBucket( bucket_idx );
+    }
+    const unsigned bucket_begin{ m_bucket_starts[bucket_idx] };
+    const unsigned bucket_end{ bucket_begin + m_bucket_sizes[bucket_idx] };
+    // Open a slot after the entries of smaller or equal AABB indices
+    const unsigned entry_idx{ unsigned( std::upper_bound( m_sorted_aabbs.begin() + bucket_begin, m_sorted_aabbs.begin() + bucket_end, aabb_idx ) - m_sorted_aabbs.begin() ) };
+    std::copy_backward( m_sorted_keys.begin() + entry_idx, m_sorted_keys.begin() + bucket_end, m_sorted_keys.begin() + bucket_end + 1 );
+    std::copy_backward( m_sorted_aabbs.begin() + entry_idx, m_sorted_aabbs.begin() + bucket_end, m_sorted_aabbs.begin() + bucket_end + 1 );
+    m_sorted_keys[entry_idx] = key;
+    m_sorted_aabbs[entry_idx] = aabb_idx;
+    ++m_bucket_sizes[bucket_idx];
+  }
+  while( nextCell( lower, upper, index ) );
+}
+
+template<int N>
+void SortedCellGrid<N>::growBucket( const unsigned bucket_idx )
+{
+  const unsigned old_start{ m_bucket_starts[bucket_idx] };
+  const unsigned new_start{ unsigned( m_sorted_keys.size() ) };
+  m_num_abandoned_slots += m_bucket_capacities[bucket_idx];
+  m_bucket_capacities[bucket_idx] *= 2;
+  m_sorted_keys.resize( m_sorted_keys.size() + m_bucket_capacities[bucket_idx] );
+  m_sorted_aabbs.resize( m_sorted_aabbs.size() + m_bucket_capacities[bucket_idx] );
+  std::copy( m_sorted_keys.begin() + old_start, m_sorted_keys.begin() + old_start + m_bucket_sizes[bucket_idx], m_sorted_keys.begin() + new_start );
+  std::copy( m_sorted_aabbs.begin() + old_start, m_sorted_aabbs.begin() + old_start + m_bucket_sizes[bucket_idx], m_sorted_aabbs.begin() + new_start );
+  m_bucket_starts[bucket_idx] = new_start;
+}
+
+template<int N>
+bool SortedCellGrid<N>::nextCell( const ArrayNu& lower, const ArrayNu& upper, ArrayNu& index )
+{
+  int axis{ 0 };
+  while( axis < N && index( axis ) == upper( axis ) )
+  {
+    index( axis ) = lower( axis );
+    ++axis;
+  }
+  if( axis == N )
+  {
+    return false;
+  }
+  ++index( axis );
+  return true;
+}
+
+template<int N>
+bool SortedCellGrid<N>::inRange( const ArrayNu& index, const ArrayNu& lower, const ArrayNu& upper )
+{
+  return ( index >= lower ).all() && ( index <= upper ).all();
+}
+
+template<int N>
+void SortedCellGrid<N>::computeCellIndex( const ArrayNs& coord, ArrayNu& index ) const
+{
+  assert( ( coord > m_min_coord ).all() ); assert( m_h > 0.0 );
+  // Unsigned cast same as floor if input is positive
+  index = ( ( coord - m_min_coord ) / m_h ).template cast<unsigned>();
+}
+
+template<int N>
+std::uint64_t SortedCellGrid<N>::keyForIndex( const ArrayNu& index ) const
+{
+  assert( ( index < m_dimensions ).all() );
+  return ( index.template cast<std::uint64_t>() * m_strides ).sum();
+}
+
+template<int N>
+unsigned SortedCellGrid<N>::bucketForKey( const std::uint64_t key ) const
+{
+  // Fibonacci hashing spreads consecutive keys across the buckets
+  return unsigned( ( key * std::uint64_t( 0x9E3779B97F4A7C15 ) ) >> m_bucket_shift );
+}
+
+#endif
@@ -11,6 +11,8 @@
 #include "scisim/ConstrainedMaps/ImpactMaps/GROperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GRROperator.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/GaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ColoredGaussSeidelOperator.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/IslandImpactOperator.h"
 #include "scisim/ConstrainedMaps/GeometricImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/StabilizedImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/SymplecticEulerImpactFrictionMap.h"
@@ -18,7 +20,9 @@
 #include "scisim/ConstrainedMaps/ImpactFrictionMap.h"
 #include "scisim/ConstrainedMaps/StaggeredProjections.h"
 #include "scisim/ConstrainedMaps/Sobogus.h"
+#include "scisim/ConstrainedMaps/IslandFrictionSolver.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorAPGD.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorMatrixFreeAPGD.h"
 
 #ifdef IPOPT_FOUND
 #include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorIpopt.h"
@@ -136,6 +140,14 @@ std::unique_ptr<ImpactOperator> ConstrainedMapUtilities::deserializeImpactOperat
   {
     impact_operator.reset( new GaussSeidelOperator{ input_stream } );
   }
+  else if( "colored_gauss_seidel" == impact_operator_name )
+  {
+    impact_operator.reset( new ColoredGaussSeidelOperator{ input_stream } );
+  }
+  else if( "islands" == impact_operator_name )
+  {
+    impact_operator.reset( new IslandImpactOperator{ input_stream } );
+  }
   #ifdef QL_FOUND
   else if( "lcp_ql" == impact_operator_name )
   {
@@ -152,6 +164,10 @@ std::unique_ptr<ImpactOperator> ConstrainedMapUtilities::deserializeImpactOperat
   {
     impact_operator.reset( new LCPOperatorAPGD{ input_stream } );
   }
+  else if( "lcp_apgd_matrix_free" == impact_operator_name )
+  {
+    impact_operator.reset( new LCPOperatorMatrixFreeAPGD{ input_stream } );
+  }
   else if( "NULL" == impact_operator_name )
   {
     impact_operator.reset( nullptr );
@@ -218,6 +234,10 @@ std::unique_ptr<FrictionSolver> ConstrainedMapUtilities::deserializeFrictionSolv
   {
     friction_solver.reset( new Sobogus{ input_stream } );
   }
+  else if( "islands" == friction_solver_name )
+  {
+    friction_solver.reset( new IslandFrictionSolver{ input_stream } );
+  }
   else if( "NULL" == friction_solver_name )
   {
     friction_solver.reset( nullptr );
@@ -0,0 +1,125 @@
+#include "ContactIslands.h"
+
+#include "scisim/Constraints/Constraint.h"
+
+#include <algorithm>
+
+static unsigned findRoot( std::vector<unsigned>& parents, unsigned body )
+{
+  while( parents[body] != body )
+  {
+    // Halve the path on the way up
+    parents[body] = parents[parents[body]];
+    body = parents[body];
+  }
+  return body;
+}
+
+void ContactIslands::partition( const std::vector<std::unique_ptr<Constraint>>& cons, const unsigned min_contacts, std::vector<std::vector<unsigned>>& islands )
+{
+  islands.clear();
+  if( cons.empty() )
+  {
+    return;
+  }
+
+  // Simulated bodies of each constraint, the second is negative for static and kinematic geometry
+  std::vector<std::pair<int,int>> con_bodies( cons.size() );
+  int max_body{ -1 };
+  for( std::vector<std::unique_ptr<Constraint>>::size_type con_idx = 0; con_idx < cons.size(); ++con_idx )
+  {
+    cons[con_idx]->getSimulatedBodyIndices( con_bodies[con_idx] );
+    assert( con_bodies[con_idx].first >= 0 );
+    max_body = std::max( max_body, std::max( con_bodies[con_idx].first, con_bodies[con_idx].second ) );
+  }
+
+  // Join the bodies of each constraint
+  std::vector<unsigned> parents( max_body + 1 );
+  for( std::vector<unsigned>::size_type bdy_idx = 0; bdy_idx < parents.size(); ++bdy_idx )
+  {
+    parents[bdy_idx] = unsigned( bdy_idx );
+  }
+  for( const std::pair<int,int>& bodies : con_bodies )
+  {
+    if( bodies.second >= 0 )
+    {
+      const unsigned root0{ findRoot( parents, unsigned( bodies.first ) ) };
+      const unsigned root1{ findRoot( parents, unsigned( bodies.second ) ) };
+      if( root0 != root1 )
+      {
+        parents[std::max( root0, root1 )] = std::min( root0, root1 );
+      }
+    }
+  }
+
+  // Number the components in order of their first constraint, so that the partition is deterministic
+  std::vector<int> component_of_root( parents.size(), -1 );
+  std::vector<std::vector<unsigned>> components;
+  for( std::vector<std::pair<int,int>>::size_type con_idx = 0; con_idx < con_bodies.size(); ++con_idx )
+  {
+    const unsigned root{ findRoot( parents, unsigned( con_bodies[con_idx].first ) ) };
+    if( component_of_root[root] == -1 )
+    {
+      component_of_root[root] = int( components.size() );
+      components.emplace_back();
+    }
+    components[component_of_root[root]].emplace_back( unsigned( con_idx ) );
+  }
+
+  // Merge small components into groups of at least min_contacts constraints
+  for( std::vector<unsigned>& component : components )
+  {
+    if( islands.empty() || islands.back().size() >= min_contacts )
+    {
+      islands.emplace_back( std::move( component ) );
+    }
+    else
+    {
+      islands.back().insert( islands.back().end(), component.begin(), component.end() );
+    }
+  }
+  // A small trailing group is folded into the previous one
+  if( islands.size() > 1 && islands.back().size() < min_contacts )
+  {
+    std::vector<unsigned> last{ std::move( islands.back() ) };
+    islands.pop_back();
+    islands.back().insert( islands.back().end(), last.begin(), last.end() );
+  }
+  for( std::vector<unsigned>& island : islands )
+  {
+    std::sort( island.begin(), island.end() );
+  }
+}
+
+void ContactIslands::gather( const VectorXs& x, const std::vector<unsigned>& island, const int block_size, VectorXs& x_island )
+{
+  assert( block_size >= 0 );
+  x_island.resize( block_size * int( island.size() ) );
+  for( std::vector<unsigned>::size_type local_idx = 0; local_idx < island.size(); ++local_idx )
+  {
+    assert( block_size * int( island[local_idx] + 1 ) <= x.size() );
+    x_island.segment( block_size * int( local_idx ), block_size ) = x.segment( block_size * int( island[local_idx] ), block_size );
+  }
+}
+
+void ContactIslands::scatter( const VectorXs& x_island, const std::vector<unsigned>& island, const int block_size, VectorXs& x )
+{
+  assert( block_size >= 0 );
+  assert( x_island.size() == block_size * int( island.size() ) );
+  for( std::vector<unsigned>::size_type local_idx = 0; local_idx < island.size(); ++local_idx )
+  {
+    assert( block_size * int( island[local_idx] + 1 ) <= x.size() );
+    x.segment( block_size * int( island[local_idx] ), block_size ) = x_island.segment( block_size * int( local_idx ), block_size );
+  }
+}
+
+void ContactIslands::gatherBases( const MatrixXXsc& contact_bases, const std::vector<unsigned>& island, MatrixXXsc& contact_bases_island )
+{
+  const int basis_size{ int( contact_bases.rows() ) };
+  contact_bases_island.resize( basis_size, basis_size * int( island.size() ) );
+  for( std::vector<unsigned>::size_type local_idx = 0; local_idx < island.size(); ++local_idx )
+  {
+    assert( basis_size * int( island[local_idx] + 1 ) <= contact_bases.cols() );
+    contact_bases_island.middleCols( basis_size * int( local_idx ), basis_size ) = contact_bases.middleCols( basis_size * int( island[local_idx] ), basis_size );
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef CONTACT_ISLANDS_H
+#define CONTACT_ISLANDS_H
+
+#include "scisim/Math/MathDefines.h"
+
+#include <memory>
+
+class Constraint;
+
+namespace ContactIslands
+{
+
+  // Partitions constraints by the connected components of the graph with a node per simulated body
+  // and an edge per constraint, so that no two groups act on a common body. Components with fewer
+  // than min_contacts constraints are merged with the components that follow them, bounding the
+  // number of sub-problems when a scene breaks into many small islands. Constraint indices within
+  // a group are sorted.
+  void partition( const std::vector<std::unique_ptr<Constraint>>& cons, const unsigned min_contacts, std::vector<std::vector<unsigned>>& islands );
+
+  // Copies the blocks of x belonging to the constraints of an island, block_size entries per constraint
+  void gather( const VectorXs& x, const std::vector<unsigned>& island, const int block_size, VectorXs& x_island );
+
+  // Writes the blocks of an island back into their positions in x
+  void scatter( const VectorXs& x_island, const std::vector<unsigned>& island, const int block_size, VectorXs& x );
+
+  // Copies the columns of the contact bases belonging to the constraints of an island
+  void gatherBases( const MatrixXXsc& contact_bases, const std::vector<unsigned>& island, MatrixXXsc& contact_bases_island );
+
+}
+
+#endif
@@ -11,6 +11,7 @@
 #include "scisim/Math/MathDefines.h"
 
 class Constraint;
+class ContactBatch;
 class FlowableSystem;
 
 class FrictionSolver
@@ -25,7 +26,7 @@ public:
 
   virtual ~FrictionSolver() = 0;
 
-  virtual void solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& v2, bool& solve_succeeded, scalar& error ) = 0;
+  virtual void solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& v2, bool& solve_succeeded, scalar& error ) = 0;
 
   virtual unsigned numFrictionImpulsesPerNormal( const unsigned ambient_space_dimensions ) const = 0;
 
@@ -33,6 +34,8 @@ public:
 
   virtual std::string name() const = 0;
 
+  virtual std::unique_ptr<FrictionSolver> clone() const = 0;
+
 protected:
 
   FrictionSolver() = default;
@@ -26,7 +26,7 @@ GRRFriction::GRRFriction( std::istream& input_stream )
 GRRFriction::~GRRFriction()
 {}
 
-void GRRFriction::solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error )
+void GRRFriction::solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error )
 {
   if( nrel_extra.size() != 0 )
   {
@@ -41,7 +41,7 @@ void GRRFriction::solve( const unsigned iteration, const scalar& dt, const Flowa
 
   // Impact basis
   SparseMatrixsc N{ static_cast<SparseMatrixsc::Index>( v0.size() ), static_cast<SparseMatrixsc::Index>( alpha.size() ) };
-  ImpactOperatorUtilities::computeN( fsys, active_set, q0, N );
+  ImpactOperatorUtilities::computeN( fsys, active_set, contact_batch, q0, N );
 
   // Friction basis
   SparseMatrixsc D;
@@ -65,8 +65,12 @@ void GRRFriction::solve( const unsigned iteration, const scalar& dt, const Flowa
   // Impact solve
   {
     // Quadratic term in LCP QP
-    const SparseMatrixsc QN{ N.transpose() * Minv * N };
-    assert( ( Eigen::Map<const ArrayXs>{QN.valuePtr(), QN.nonZeros()} != 0.0 ).any() );
+    SparseMatrixsc QN;
+    if( m_impact_operator->usesDelassusOperator() )
+    {
+      ImpactOperatorUtilities::computeDelassusOperator( N, Minv, QN );
+      assert( ( Eigen::Map<const ArrayXs>{QN.valuePtr(), QN.nonZeros()} != 0.0 ).any() );
+    }
 
     alpha.setZero();
     m_impact_operator->flow( active_set, M, Minv, q0, v0, v0, N, QN, nrel, CoR, alpha );
@@ -105,3 +109,8 @@ std::string GRRFriction::name() const
 {
   return "grr_friction";
 }
+
+std::unique_ptr<FrictionSolver> GRRFriction::clone() const
+{
+  return std::unique_ptr<FrictionSolver>{ new GRRFriction{ *m_impact_operator, *m_friction_operator } };
+}
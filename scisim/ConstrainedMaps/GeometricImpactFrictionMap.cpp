@@ -14,9 +14,14 @@
 #include "scisim/Constraints/ConstrainedSystem.h"
 #include "scisim/UnconstrainedMaps/UnconstrainedMap.h"
 #include "scisim/ScriptingCallback.h"
+#include "scisim/Timer/Profiler.h"
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/Utilities.h"
 
+#ifdef USE_HDF5
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactSolution.h"
+#endif
+
 GeometricImpactFrictionMap::GeometricImpactFrictionMap( const scalar& abs_tol, const unsigned max_iters, const ImpulsesToCache impulses_to_cache )
 : m_f( VectorXs::Zero( 0 ) )
 , m_abs_tol( abs_tol )
@@ -24,7 +29,7 @@ GeometricImpactFrictionMap::GeometricImpactFrictionMap( const scalar& abs_tol, c
 , m_impulses_to_cache( impulses_to_cache )
 #ifdef USE_HDF5
 , m_write_constraint_forces( false )
-, m_constraint_force_stream( nullptr )
+, m_impact_solution( nullptr )
 #endif
 {
   assert( m_abs_tol >= 0.0 );
@@ -37,7 +42,7 @@ GeometricImpactFrictionMap::GeometricImpactFrictionMap( std::istream& input_stre
 , m_impulses_to_cache( Utilities::deserialize<ImpulsesToCache>( input_stream ) )
 #ifdef USE_HDF5
 , m_write_constraint_forces( false )
-, m_constraint_force_stream( nullptr )
+, m_impact_solution( nullptr )
 #endif
 {
   assert( m_abs_tol >= 0.0 );
@@ -171,7 +176,7 @@ GeometricImpactFrictionMap::GeometricImpactFrictionMap( std::istream& input_stre
 //  }
 //}
 
-static void initializeImpulses( const ImpulsesToCache cache_mode, const unsigned ambient_dims, const std::vector<std::unique_ptr<Constraint>>& active_set, ConstrainedSystem& csys, VectorXs& alpha, VectorXs& beta )
+static void initializeImpulses( const ImpulsesToCache cache_mode, const unsigned ambient_dims, const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, ConstrainedSystem& csys, VectorXs& alpha, VectorXs& beta )
 {
   switch( cache_mode )
   {
@@ -210,8 +215,41 @@ static void initializeImpulses( const ImpulsesToCache cache_mode, const unsigned
       }
       else
       {
-        std::cerr << "Decaching in " << ambient_dims << " space not yet supported." << std::endl;
-        std::exit( EXIT_FAILURE );
+        assert( ambient_dims == 3 );
+        if( beta.size() != 2 * alpha.size() )
+        {
+          std::cerr << "Decaching in 3 space requires two friction impulses per contact." << std::endl;
+          std::exit( EXIT_FAILURE );
+        }
+        unsigned col_num{ 0 };
+        for( const std::unique_ptr<Constraint>& constraint : active_set )
+        {
+          // The cache stores the previous contact normal and the full impulse in world space
+          VectorXs cached_impulse{ 6 };
+          csys.getCachedConstraintImpulse( *constraint, cached_impulse );
+
+          if( ( cached_impulse.array() == 0.0 ).all() )
+          {
+            alpha( col_num ) = 0.0;
+            beta.segment<2>( 2 * col_num ).setZero();
+          }
+          else
+          {
+            const Matrix33sc basis{ contact_bases.block<3,3>( 0, 3 * col_num ) };
+
+            // Rotate the previous impulse by the rotation of the normal
+            const Quaternions R{ Quaternions::FromTwoVectors( cached_impulse.segment<3>( 0 ), basis.col( 0 ) ) };
+            const Vector3s f{ R * cached_impulse.segment<3>( 3 ) };
+
+            // Project the impulse onto the current basis
+            alpha( col_num ) = f.dot( basis.col( 0 ) );
+            beta( 2 * col_num + 0 ) = f.dot( basis.col( 1 ) );
+            beta( 2 * col_num + 1 ) = f.dot( basis.col( 2 ) );
+          }
+
+          col_num++;
+        }
+        assert( col_num == active_set.size() );
       }
       csys.clearConstraintCache();
       break;
@@ -219,7 +257,7 @@ static void initializeImpulses( const ImpulsesToCache cache_mode, const unsigned
   }
 }
 
-static void cacheImpulses( const ImpulsesToCache cache_mode, const unsigned ambient_dims, const std::vector<std::unique_ptr<Constraint>>& active_set, ConstrainedSystem& csys, const VectorXs& alpha, const VectorXs& beta )
+static void cacheImpulses( const ImpulsesToCache cache_mode, const unsigned ambient_dims, const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, ConstrainedSystem& csys, const VectorXs& alpha, const VectorXs& beta )
 {
   switch( cache_mode )
   {
@@ -256,8 +294,23 @@ static void cacheImpulses( const ImpulsesToCache cache_mode, const unsigned ambi
       }
       else
       {
-        std::cerr << "Caching in " << ambient_dims << " space not yet supported." << std::endl;
-        std::exit( EXIT_FAILURE );
+        assert( ambient_dims == 3 );
+        assert( 2 * alpha.size() == beta.size() );
+        unsigned col_num = 0;
+        for( const std::unique_ptr<Constraint>& constraint : active_set )
+        {
+          const Matrix33sc basis{ contact_bases.block<3,3>( 0, 3 * col_num ) };
+
+          VectorXs cached_impulse{ 6 };
+          // Cache the contact normal
+          cached_impulse.segment<3>( 0 ) = basis.col( 0 );
+          // Compute the impulse in 3D cartesian space
+          cached_impulse.segment<3>( 3 ) = alpha( col_num ) * basis.col( 0 ) + beta( 2 * col_num + 0 ) * basis.col( 1 ) + beta( 2 * col_num + 1 ) * basis.col( 2 );
+          csys.cacheConstraint( *constraint, cached_impulse );
+
+          col_num++;
+        }
+        assert( col_num == active_set.size() );
       }
       break;
   }
@@ -276,11 +329,18 @@ void GeometricImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSys
   }
 
   // Compute an unconstrained predictor step
-  umap.flow( q0, v0, fsys, iteration, dt, q1, v1 );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::UNCONSTRAINED_MAP };
+    umap.flow( q0, v0, fsys, iteration, dt, q1, v1 );
+  }
 
   // Using the configuration at the predictor step, compute the set of active constraints
   std::vector<std::unique_ptr<Constraint>> active_set;
-  csys.computeActiveSet( q0, q1, v0, active_set );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ACTIVE_SET };
+    csys.computeActiveSet( q0, q1, v0, active_set );
+  }
+  Profiler::addCount( ProfilerCounter::CONTACTS, active_set.size() );
 
   // If there are no active constraints, there is no need to perform collision response
   if( active_set.empty() )
@@ -289,10 +349,10 @@ void GeometricImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSys
     #ifdef USE_HDF5
     if( m_write_constraint_forces )
     {
-      exportConstraintForcesToBinary( q0, active_set, MatrixXXsc{ fsys.ambientSpaceDimensions(), 0 }, VectorXs::Zero(0), VectorXs::Zero(0), dt );
+      m_impact_solution->setSolution( q0, active_set, MatrixXXsc{ fsys.ambientSpaceDimensions(), 0 }, VectorXs::Zero(0), VectorXs::Zero(0), dt );
     }
     m_write_constraint_forces = false;
-    m_constraint_force_stream = nullptr;
+    m_impact_solution = nullptr;
     #endif
     return;
   }
@@ -301,7 +361,10 @@ void GeometricImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSys
 
   // Pre-compute the full contact basis
   MatrixXXsc contact_bases;
-  csys.computeContactBases( q0, v0, active_set, contact_bases );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ASSEMBLY };
+    csys.computeContactBases( q0, v0, active_set, contact_bases );
+  }
   assert( contact_bases.rows() == fsys.ambientSpaceDimensions() );
   assert( contact_bases.cols() == fsys.ambientSpaceDimensions() * ncollisions );
 
@@ -322,7 +385,10 @@ void GeometricImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSys
   // Friction impulses magnitudes
   VectorXs beta{ friction_solver.numFrictionImpulsesPerNormal( fsys.ambientSpaceDimensions() ) * ncollisions };
 
-  initializeImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, csys, alpha, beta );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::WARM_START };
+    initializeImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, contact_bases, csys, alpha, beta );
+  }
 
   // Compute the initial momentum and angular momentum
   #ifndef NDEBUG
@@ -341,7 +407,10 @@ void GeometricImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSys
     bool solve_succeeded;
     VectorXs nrel_extra;
     VectorXs drel_extra;
-    friction_solver.solve( iteration, dt, fsys, fsys.M(), fsys.Minv(), CoR, mu, q0, v0, active_set, contact_bases, nrel_extra, drel_extra, m_max_iters, m_abs_tol, m_f, alpha, beta, v2, solve_succeeded, error );
+    {
+      const ProfilerScope profiler_scope{ ProfilerTimer::FRICTION_SOLVE };
+      friction_solver.solve( iteration, dt, fsys, fsys.M(), fsys.Minv(), CoR, mu, q0, v0, active_set, contact_bases, csys.contactBatch( q0, active_set ), nrel_extra, drel_extra, m_max_iters, m_abs_tol, m_f, alpha, beta, v2, solve_succeeded, error );
+    }
     assert( error >= 0.0 );
     if( !solve_succeeded )
     {
@@ -425,20 +494,26 @@ void GeometricImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSys
   //assert( ImpactFrictionMap::noImpulsesToKinematicGeometry( fsys, N, alpha, D, beta, v0 ) );
 
   // Cache the constraints for warm starting
-  cacheImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, csys, alpha, beta );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::WARM_START };
+    cacheImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, contact_bases, csys, alpha, beta );
+  }
 
   #ifdef USE_HDF5
   // Export constraint forces, if requested
   if( m_write_constraint_forces )
   {
-    exportConstraintForcesToBinary( q0, active_set, contact_bases, alpha, beta, dt );
+    m_impact_solution->setSolution( q0, active_set, contact_bases, alpha, beta, dt );
   }
   m_write_constraint_forces = false;
-  m_constraint_force_stream = nullptr;
+  m_impact_solution = nullptr;
   #endif
 
   // Using the initial configuration and the new velocity, compute the final state
-  umap.flow( q0, v2, fsys, iteration, dt, q1, v1 );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::UNCONSTRAINED_MAP };
+    umap.flow( q0, v2, fsys, iteration, dt, q1, v1 );
+  }
 }
 
 void GeometricImpactFrictionMap::resetCachedData()
@@ -446,15 +521,6 @@ void GeometricImpactFrictionMap::resetCachedData()
   m_f = VectorXs::Zero( 0 );
 }
 
-#ifdef USE_HDF5
-void GeometricImpactFrictionMap::exportConstraintForcesToBinary( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& contact_bases, const VectorXs& alpha, const VectorXs& beta, const scalar& dt )
-{
-  assert( m_write_constraint_forces );
-  assert( m_constraint_force_stream != nullptr );
-  ImpactFrictionMap::exportConstraintForcesToBinaryFile( q, constraints, contact_bases, alpha, beta, dt, *m_constraint_force_stream );
-}
-#endif
-
 void GeometricImpactFrictionMap::serialize( std::ostream& output_stream ) const
 {
   assert( output_stream.good() );
@@ -464,7 +530,7 @@ void GeometricImpactFrictionMap::serialize( std::ostream& output_stream ) const
   Utilities::serialize( m_impulses_to_cache, output_stream );
   #ifdef USE_HDF5
   assert( m_write_constraint_forces == false );
-  assert( m_constraint_force_stream == nullptr );
+  assert( m_impact_solution == nullptr );
   #endif
 }
 
@@ -474,9 +540,9 @@ std::string GeometricImpactFrictionMap::name() const
 }
 
 #ifdef USE_HDF5
-void GeometricImpactFrictionMap::exportForcesNextStep( HDF5File& output_file )
+void GeometricImpactFrictionMap::exportForcesNextStep( ImpactSolution& impact_solution )
 {
   m_write_constraint_forces = true;
-  m_constraint_force_stream = &output_file;
+  m_impact_solution = &impact_solution;
 }
 #endif
@@ -0,0 +1,141 @@
+#include "ColoredGaussSeidelOperator.h"
+
+#include "scisim/Utilities.h"
+#include "scisim/Constraints/Constraint.h"
+#include "scisim/Timer/Profiler.h"
+
+#include <algorithm>
+
+ColoredGaussSeidelOperator::ColoredGaussSeidelOperator( const scalar& v_tol )
+: m_v_tol( v_tol )
+{
+  assert( m_v_tol >= 0.0 );
+}
+
+ColoredGaussSeidelOperator::ColoredGaussSeidelOperator( std::istream& input_stream )
+: m_v_tol( Utilities::deserialize<scalar>( input_stream ) )
+{
+  assert( m_v_tol >= 0.0 );
+}
+
+static bool colorIsFree( const std::vector<unsigned>& body_colors, const unsigned color )
+{
+  return std::find( body_colors.begin(), body_colors.end(), color ) == body_colors.end();
+}
+
+void ColoredGaussSeidelOperator::colorConstraints( const std::vector<std::unique_ptr<Constraint>>& cons, std::vector<std::vector<unsigned>>& colors )
+{
+  colors.clear();
+
+  // Colors used by the constraints on each simulated body; contacts per body are few in practice
+  std::vector<std::vector<unsigned>> body_colors;
+  std::pair<int,int> bodies;
+  for( unsigned con_idx = 0; con_idx < cons.size(); ++con_idx )
+  {
+    cons[con_idx]->getSimulatedBodyIndices( bodies );
+    assert( bodies.first >= 0 );
+    // A body touching its own periodic image through a portal only touches one body
+    if( bodies.second == bodies.first )
+    {
+      bodies.second = -1;
+    }
+    const unsigned max_body{ unsigned( std::max( bodies.first, bodies.second ) ) };
+    if( max_body >= body_colors.size() )
+    {
+      body_colors.resize( max_body + 1 );
+    }
+    std::vector<unsigned>& colors0{ body_colors[bodies.first] };
+    unsigned color{ 0 };
+    if( bodies.second >= 0 )
+    {
+      const std::vector<unsigned>& colors1{ body_colors[bodies.second] };
+      while( !colorIsFree( colors0, color ) || !colorIsFree( colors1, color ) )
+      {
+        ++color;
+      }
+      body_colors[bodies.second].emplace_back( color );
+    }
+    else
+    {
+      while( !colorIsFree( colors0, color ) )
+      {
+        ++color;
+      }
+    }
+    colors0.emplace_back( color );
+
+    if( color >= colors.size() )
+    {
+      colors.resize( color + 1 );
+    }
+    colors[color].emplace_back( con_idx );
+  }
+}
+
+void ColoredGaussSeidelOperator::flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha )
+{
+  assert( ( alpha.array() == 0.0 ).all() );
+  assert( ( v0.array() == v0F.array() ).all() );
+  assert( alpha.size() == int( cons.size() ) ); assert( CoR.size() == alpha.size() );
+
+  std::vector<std::vector<unsigned>> colors;
+  colorConstraints( cons, colors );
+
+  VectorXs v1 = v0;
+
+  // Iterate until all constraint violations fall below the threshold
+  bool collision_happened = true;
+  while( collision_happened )
+  {
+    collision_happened = false;
+    Profiler::addCount( ProfilerCounter::IMPACT_SOLVER_ITERATIONS, 1 );
+
+    for( const std::vector<unsigned>& color : colors )
+    {
+      // Constraints of a color touch disjoint entries of v1 and alpha
+      const int ncolor{ int( color.size() ) };
+      bool color_collision_happened = false;
+      #ifdef _OPENMP
+      #pragma omp parallel for reduction( || : color_collision_happened )
+      #endif
+      for( int color_idx = 0; color_idx < ncolor; ++color_idx )
+      {
+        const unsigned current_idx{ color[color_idx] };
+        // If the relative velocity along the constraint is below the threshold
+        const scalar ndotv = cons[current_idx]->evalNdotV( q0, v1 );
+        if( ndotv < - m_v_tol )
+        {
+          // Reflect about this constraint
+          scalar local_alpha;
+          cons[current_idx]->resolveImpact( CoR( current_idx ), M, ndotv, v1, local_alpha );
+          assert( local_alpha >= 0.0 ); assert( cons[current_idx]->evalNdotV( q0, v1 ) >= 0.0 );
+          alpha( current_idx ) += local_alpha;
+          // And remember that a collision happend
+          color_collision_happened = true;
+        }
+      }
+      collision_happened = collision_happened || color_collision_happened;
+    }
+  }
+  assert( ( v0 + Minv * N * alpha - v1 ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
+}
+
+bool ColoredGaussSeidelOperator::usesDelassusOperator() const
+{
+  return false;
+}
+
+std::string ColoredGaussSeidelOperator::name() const
+{
+  return "colored_gauss_seidel";
+}
+
+std::unique_ptr<ImpactOperator> ColoredGaussSeidelOperator::clone() const
+{
+  return std::unique_ptr<ImpactOperator>{ new ColoredGaussSeidelOperator{ m_v_tol } };
+}
+
+void ColoredGaussSeidelOperator::serialize( std::ostream& output_stream ) const
+{
+  Utilities::serialize( m_v_tol, output_stream );
+}
@@ -0,0 +1,41 @@
+#ifndef COLORED_GAUSS_SEIDEL_OPERATOR_H
+#define COLORED_GAUSS_SEIDEL_OPERATOR_H
+
+#include "ImpactOperator.h"
+
+// Pairwise Gauss-Seidel impact resolution, as in GaussSeidelOperator, with the constraints grouped
+// into colors such that no two constraints of a color share a simulated body. The constraints of
+// each color are resolved in parallel. Constraints are visited color by color rather than in
+// active set order, so impulses can differ from GaussSeidelOperator, but do not depend on the
+// number of threads.
+class ColoredGaussSeidelOperator final : public ImpactOperator
+{
+
+public:
+
+  explicit ColoredGaussSeidelOperator( const scalar& v_tol );
+  explicit ColoredGaussSeidelOperator( std::istream& input_stream );
+
+  virtual ~ColoredGaussSeidelOperator() override = default;
+
+  virtual void flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha ) override;
+
+  virtual bool usesDelassusOperator() const override;
+
+  virtual std::string name() const override;
+
+  virtual std::unique_ptr<ImpactOperator> clone() const override;
+
+  virtual void serialize( std::ostream& output_stream ) const override;
+
+  // Greedily assigns each constraint the lowest color not already used by a constraint on either
+  // of its simulated bodies. Returns the constraint indices of each color in increasing order.
+  static void colorConstraints( const std::vector<std::unique_ptr<Constraint>>& cons, std::vector<std::vector<unsigned>>& colors );
+
+private:
+
+  const scalar m_v_tol;
+
+};
+
+#endif
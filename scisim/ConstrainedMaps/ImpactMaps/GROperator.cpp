@@ -9,6 +9,7 @@
 
 #include "scisim/Math/MathUtilities.h"
 #include "scisim/ConstrainedMaps/ConstrainedMapUtilities.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
 #include "scisim/Utilities.h"
 
 GROperator::GROperator( const scalar& v_tol, const ImpactOperator& impact_operator )
@@ -103,7 +104,11 @@ void GROperator::flow( const std::vector<std::unique_ptr<Constraint>>& cons, con
     VectorXs alpha_local{ VectorXs::Zero( num_contacts_with_negative_vel ) };
     SparseMatrixsc N_local;
     MathUtilities::extractColumns( N, violated_indices, N_local );
-    const SparseMatrixsc Q_local = N_local.transpose() * Minv * N_local;
+    SparseMatrixsc Q_local;
+    if( m_impact_operator->usesDelassusOperator() )
+    {
+      ImpactOperatorUtilities::computeDelassusOperator( N_local, Minv, Q_local );
+    }
     // Solve the 'local' problem
     m_impact_operator->flow( cons, M, Minv, q0, v1, v1, N_local, Q_local, nrel_local, CoR_local, alpha_local );
 
@@ -130,6 +135,12 @@ void GROperator::flow( const std::vector<std::unique_ptr<Constraint>>& cons, con
   assert( ( ( N.transpose() * v1 + nrel ).array() >= -m_v_tol ).all() );
 }
 
+bool GROperator::usesDelassusOperator() const
+{
+  // The local problems form their own operators
+  return false;
+}
+
 std::string GROperator::name() const
 {
   return "gr";
@@ -22,6 +22,8 @@ public:
   // TODO: Q isn't useful here, revise interface
   virtual void flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha ) override;
 
+  virtual bool usesDelassusOperator() const override;
+
   virtual std::string name() const override;
 
   virtual std::unique_ptr<ImpactOperator> clone() const override;
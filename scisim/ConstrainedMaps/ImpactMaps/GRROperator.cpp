@@ -68,6 +68,11 @@ void GRROperator::flow( const std::vector<std::unique_ptr<Constraint>>& cons, co
   alpha += CoR(0) * alpha_out;
 }
 
+bool GRROperator::usesDelassusOperator() const
+{
+  return m_elastic_operator->usesDelassusOperator() || m_inelastic_operator->usesDelassusOperator();
+}
+
 std::string GRROperator::name() const
 {
   return "grr";
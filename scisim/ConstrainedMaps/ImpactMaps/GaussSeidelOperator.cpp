@@ -6,6 +6,7 @@
 #include "GaussSeidelOperator.h"
 #include "scisim/Utilities.h"
 #include "scisim/Constraints/Constraint.h"
+#include "scisim/Timer/Profiler.h"
 
 GaussSeidelOperator::GaussSeidelOperator( const scalar& v_tol )
 : m_v_tol( v_tol )
@@ -34,6 +35,7 @@ void GaussSeidelOperator::flow( const std::vector<std::unique_ptr<Constraint>>&
   while( collision_happened )
   {
     collision_happened = false;
+    Profiler::addCount( ProfilerCounter::IMPACT_SOLVER_ITERATIONS, 1 );
 
     // For each constraint
     for( unsigned current_idx = 0; current_idx < ncons; ++current_idx )
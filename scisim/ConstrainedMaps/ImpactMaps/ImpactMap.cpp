@@ -13,6 +13,7 @@
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/UnconstrainedMaps/UnconstrainedMap.h"
 #include "scisim/ScriptingCallback.h"
+#include "scisim/Timer/Profiler.h"
 #include "scisim/Utilities.h"
 #include "ImpactOperator.h"
 
@@ -51,11 +52,18 @@ static bool constraintSetShouldConserveAngularMomentum( const std::vector<std::u
 void ImpactMap::flow( ScriptingCallback& call_back, FlowableSystem& fsys, ConstrainedSystem& csys, UnconstrainedMap& umap, ImpactOperator& imap, const unsigned iteration, const scalar& dt, const scalar& CoR_default, const VectorXs& q0, const VectorXs& v0, VectorXs& q1, VectorXs& v1 )
 {
   // Compute an unconstrained predictor step, save result into q1 and v1
-  umap.flow( q0, v0, fsys, iteration, dt, q1, v1 );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::UNCONSTRAINED_MAP };
+    umap.flow( q0, v0, fsys, iteration, dt, q1, v1 );
+  }
 
   // Using the configuration at the predictor step, compute the set of active constraints.
   std::vector<std::unique_ptr<Constraint>> active_set;
-  csys.computeActiveSet( q0, q1, v0, active_set );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ACTIVE_SET };
+    csys.computeActiveSet( q0, q1, v0, active_set );
+  }
+  Profiler::addCount( ProfilerCounter::CONTACTS, active_set.size() );
 
   // If there are no active constraints, there is no need to perform collision response
   if( active_set.empty() )
@@ -81,6 +89,7 @@ void ImpactMap::flow( ScriptingCallback& call_back, FlowableSystem& fsys, Constr
   // If desired, read in previous values for warm starting
   if( m_warm_start )
   {
+    const ProfilerScope profiler_scope{ ProfilerTimer::WARM_START };
     unsigned col_num{ 0 };
     for( const std::unique_ptr<Constraint>& constraint : active_set )
     {
@@ -104,10 +113,16 @@ void ImpactMap::flow( ScriptingCallback& call_back, FlowableSystem& fsys, Constr
 
   // Generalized normal basis
   SparseMatrixsc N{ fsys.Minv().cols(), SparseMatrixsc::Index( ncollisions ) };
-  ImpactOperatorUtilities::computeN( fsys, active_set, q0, N );
-
   // Quadratic term in LCP QP
-  const SparseMatrixsc Q{ N.transpose() * fsys.Minv() * N };
+  SparseMatrixsc Q;
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ASSEMBLY };
+    ImpactOperatorUtilities::computeN( fsys, active_set, csys.contactBatch( q0, active_set ), q0, N );
+    if( imap.usesDelassusOperator() )
+    {
+      ImpactOperatorUtilities::computeDelassusOperator( N, fsys.Minv(), Q );
+    }
+  }
 
   // Evaluate the kinematic scripted object's velocity projected onto the constraint set
   VectorXs gdotN;
@@ -130,7 +145,10 @@ void ImpactMap::flow( ScriptingCallback& call_back, FlowableSystem& fsys, Constr
   #endif
 
   // Note: No friction, so initial velocity passed in twice
-  imap.flow( active_set, fsys.M(), fsys.Minv(), q0, v0, v0, N, Q, gdotN, CoR, alpha );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::IMPACT_SOLVE };
+    imap.flow( active_set, fsys.M(), fsys.Minv(), q0, v0, v0, N, Q, gdotN, CoR, alpha );
+  }
   v2 = v0 + fsys.Minv() * N * alpha;
 
   // Verify that momentum and angular momentum are conserved
@@ -159,6 +177,7 @@ void ImpactMap::flow( ScriptingCallback& call_back, FlowableSystem& fsys, Constr
   assert( csys.constraintCacheEmpty() );
   if( m_warm_start )
   {
+    const ProfilerScope profiler_scope{ ProfilerTimer::WARM_START };
     unsigned col_num = 0;
     for( const std::unique_ptr<Constraint>& constraint : active_set )
     {
@@ -184,7 +203,10 @@ void ImpactMap::flow( ScriptingCallback& call_back, FlowableSystem& fsys, Constr
   active_set.clear();
 
   // Using the initial configuration and the new velocity, compute the final state
-  umap.flow( q0, v2, fsys, iteration, dt, q1, v1 );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::UNCONSTRAINED_MAP };
+    umap.flow( q0, v2, fsys, iteration, dt, q1, v1 );
+  }
 }
 
 void ImpactMap::serialize( std::ostream& output_stream ) const
@@ -7,3 +7,8 @@
 
 ImpactOperator::~ImpactOperator()
 {}
+
+bool ImpactOperator::usesDelassusOperator() const
+{
+  return true;
+}
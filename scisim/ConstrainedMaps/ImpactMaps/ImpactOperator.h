@@ -26,6 +26,9 @@ public:
 
   virtual void flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha ) = 0;
 
+  // If false, callers may skip forming Q = N^T M^-1 N and pass an empty matrix to flow
+  virtual bool usesDelassusOperator() const;
+
   virtual std::string name() const = 0;
 
   virtual std::unique_ptr<ImpactOperator> clone() const = 0;
@@ -6,8 +6,11 @@
 #include "ImpactOperatorUtilities.h"
 
 #include "scisim/Constraints/Constraint.h"
+#include "scisim/Constraints/ContactBatch.h"
 
-void ImpactOperatorUtilities::computeN( const FlowableSystem& fsys, const std::vector<std::unique_ptr<Constraint>>& V, const VectorXs& q, SparseMatrixsc& N )
+#include <algorithm>
+
+void ImpactOperatorUtilities::computeN( const FlowableSystem& fsys, const std::vector<std::unique_ptr<Constraint>>& V, const ContactBatch* contact_batch, const VectorXs& q, SparseMatrixsc& N )
 {
   assert( N.cols() == int( V.size() ) );
 
@@ -17,34 +20,168 @@ void ImpactOperatorUtilities::computeN( const FlowableSystem& fsys, const std::v
     return;
   }
 
-  VectorXi column_nonzeros( N.cols() );
+  // Contacts between 3D rigid bodies are assembled from a structure of arrays batch
+  if( contact_batch != nullptr )
+  {
+    assert( contact_batch->size() == V.size() );
+    contact_batch->computeN( N );
+  }
+  else
+  {
+    VectorXi column_nonzeros( N.cols() );
+    {
+      auto con_itr = V.cbegin();
+      for( int col = 0; col < N.cols(); ++col )
+      {
+        assert( *con_itr != nullptr );
+        column_nonzeros[col] = (*con_itr)->impactStencilSize();
+        ++con_itr;
+      }
+      assert( con_itr == V.cend() );
+    }
+
+    N.reserve( column_nonzeros );
+    {
+      auto con_itr = V.cbegin();
+      for( int col = 0; col < N.cols(); ++col )
+      {
+        assert( *con_itr != nullptr );
+        (*con_itr)->evalgradg( q, col, N, fsys );
+        ++con_itr;
+      }
+      assert( con_itr == V.cend() );
+    }
+
+    assert( column_nonzeros.sum() == N.nonZeros() );
+  }
+
+  N.prune( []( const Eigen::Index& row, const Eigen::Index& col, const scalar& value ) { return value != 0.0; } );
+  assert( N.innerNonZeroPtr() == nullptr );
+}
+
+void ImpactOperatorUtilities::computeDelassusOperator( const SparseMatrixsc& N, const SparseMatrixsc& Minv, SparseMatrixsc& Q )
+{
+  assert( Minv.rows() == Minv.cols() ); assert( Minv.cols() == N.rows() );
+
+  const int ncons{ int( N.cols() ) };
+
+  // Row major copy of N gives the contacts that act on each degree of freedom
+  const SparseMatrixsr N_rows{ N };
+
+  // Column of M^-1 N: dense storage, the column that last touched each degree of freedom, and the
+  // touched degrees of freedom
+  VectorXs minv_n{ N.rows() };
+  VectorXi minv_n_last_column{ VectorXi::Constant( N.rows(), -1 ) };
+  std::vector<int> minv_n_rows;
+  // Column of Q: dense storage, the column that last touched each contact, and the touched contacts
+  VectorXs accumulator{ ncons };
+  VectorXi last_column{ VectorXi::Constant( ncons, -1 ) };
+  std::vector<int> column_rows;
+
+  // Degrees of freedom of the blocks of M^-1 of the bodies in a contact
+  const auto gatherDOFs = [&N, &Minv, &minv_n_last_column, &minv_n_rows]( const int col )
+  {
+    minv_n_rows.clear();
+    for( SparseMatrixsc::InnerIterator n_it{ N, col }; n_it; ++n_it )
+    {
+      for( SparseMatrixsc::InnerIterator minv_it{ Minv, n_it.row() }; minv_it; ++minv_it )
+      {
+        const int dof{ int( minv_it.row() ) };
+        if( minv_n_last_column( dof ) != col )
+        {
+          minv_n_last_column( dof ) = col;
+          minv_n_rows.emplace_back( dof );
+        }
+      }
+    }
+  };
+
+  // Size the pattern of Q from the contacts that share a block of M^-1 with each contact
+  Q.resize( ncons, ncons );
+  int* const outer_index{ Q.outerIndexPtr() };
+  outer_index[0] = 0;
+  for( int col = 0; col < ncons; ++col )
   {
-    auto con_itr = V.cbegin();
-    for( int col = 0; col < N.cols(); ++col )
+    gatherDOFs( col );
+    int column_nonzeros{ 0 };
+    for( const int dof : minv_n_rows )
     {
-      assert( *con_itr != nullptr );
-      column_nonzeros[col] = (*con_itr)->impactStencilSize();
-      ++con_itr;
+      for( SparseMatrixsr::InnerIterator row_it{ N_rows, dof }; row_it; ++row_it )
+      {
+        const int row{ int( row_it.col() ) };
+        if( last_column( row ) != col )
+        {
+          last_column( row ) = col;
+          ++column_nonzeros;
+        }
+      }
     }
-    assert( con_itr == V.cend() );
+    outer_index[col + 1] = outer_index[col] + column_nonzeros;
   }
+  Q.resizeNonZeros( outer_index[ncons] );
 
-  N.reserve( column_nonzeros );
+  // Fill each column of Q in place
+  minv_n_last_column.setConstant( -1 );
+  last_column.setConstant( -1 );
+  for( int col = 0; col < ncons; ++col )
   {
-    auto con_itr = V.cbegin();
-    for( int col = 0; col < N.cols(); ++col )
+    // M^-1 N(:,col) touches only the blocks of M^-1 of the bodies in this contact
+    gatherDOFs( col );
+    for( const int dof : minv_n_rows )
+    {
+      minv_n( dof ) = 0.0;
+    }
+    for( SparseMatrixsc::InnerIterator n_it{ N, col }; n_it; ++n_it )
+    {
+      for( SparseMatrixsc::InnerIterator minv_it{ Minv, n_it.row() }; minv_it; ++minv_it )
+      {
+        minv_n( minv_it.row() ) += minv_it.value() * n_it.value();
+      }
+    }
+
+    // Q(:,col) = N^T M^-1 N(:,col), visiting each contact that acts on a touched degree of freedom
+    column_rows.clear();
+    for( const int dof : minv_n_rows )
     {
-      assert( *con_itr != nullptr );
-      (*con_itr)->evalgradg( q, col, N, fsys );
-      ++con_itr;
+      const scalar weight{ minv_n( dof ) };
+      for( SparseMatrixsr::InnerIterator row_it{ N_rows, dof }; row_it; ++row_it )
+      {
+        const int row{ int( row_it.col() ) };
+        if( last_column( row ) != col )
+        {
+          last_column( row ) = col;
+          accumulator( row ) = 0.0;
+          column_rows.emplace_back( row );
+        }
+        accumulator( row ) += row_it.value() * weight;
+      }
+    }
+    assert( int( column_rows.size() ) == outer_index[col + 1] - outer_index[col] );
+    std::sort( column_rows.begin(), column_rows.end() );
+    int nonzero_idx{ outer_index[col] };
+    for( const int row : column_rows )
+    {
+      Q.innerIndexPtr()[nonzero_idx] = row;
+      Q.valuePtr()[nonzero_idx] = accumulator( row );
+      ++nonzero_idx;
     }
-    assert( con_itr == V.cend() );
   }
 
-  assert( column_nonzeros.sum() == N.nonZeros() );
+  #ifndef NDEBUG
+  {
+    const SparseMatrixsc Q_difference{ SparseMatrixsc{ N.transpose() * Minv * N } - Q };
+    const scalar Q_max{ Q.nonZeros() == 0 ? 0.0 : Q.coeffs().abs().maxCoeff() };
+    assert( Q_difference.nonZeros() == 0 || Q_difference.coeffs().abs().maxCoeff() <= 1.0e-9 * std::max( 1.0, Q_max ) );
+  }
+  #endif
+}
 
-  N.prune( []( const Eigen::Index& row, const Eigen::Index& col, const scalar& value ) { return value != 0.0; } );
-  assert( N.innerNonZeroPtr() == nullptr );
+void ImpactOperatorUtilities::applyDelassusOperator( const SparseMatrixsc& N, const SparseMatrixsc& Minv, const VectorXs& x, VectorXs& Nx, VectorXs& MinvNx, VectorXs& y )
+{
+  assert( N.cols() == x.size() ); assert( Minv.rows() == Minv.cols() ); assert( Minv.cols() == N.rows() );
+  Nx.noalias() = N * x;
+  MinvNx.noalias() = Minv * Nx;
+  y.noalias() = N.transpose() * MinvNx;
 }
 
 void ImpactOperatorUtilities::computeLCPQPLinearTerm( const SparseMatrixsc& N, const VectorXs& nrel, const VectorXs& CoR, const VectorXs& v0, const VectorXs& v0F, VectorXs& linear_term )
@@ -12,11 +12,24 @@
 
 class FlowableSystem;
 class Constraint;
+class ContactBatch;
 
 namespace ImpactOperatorUtilities
 {
 
-  void computeN( const FlowableSystem& fsys, const std::vector<std::unique_ptr<Constraint>>& V, const VectorXs& q, SparseMatrixsc& N );
+  // If contact_batch is not null, it holds the contacts of V and N is assembled from it
+  void computeN( const FlowableSystem& fsys, const std::vector<std::unique_ptr<Constraint>>& V, const ContactBatch* contact_batch, const VectorXs& q, SparseMatrixsc& N );
+
+  // Forms the Delassus operator Q = N^T M^-1 N directly in compressed storage. The nonzeros of each
+  // column of Q are first counted from the blocks of M^-1 touched by the column of N and the other
+  // contacts acting on the same degrees of freedom, then the values are accumulated into the exactly
+  // sized pattern. With a block diagonal M^-1, a column only visits the contacts that share a body
+  // with it, and neither M^-1 N nor N^T is formed as a whole.
+  void computeDelassusOperator( const SparseMatrixsc& N, const SparseMatrixsc& Minv, SparseMatrixsc& Q );
+
+  // Computes y = N^T M^-1 N x without forming N^T M^-1 N. Nx and MinvNx hold the intermediate
+  // products, so that repeated applications reuse their storage.
+  void applyDelassusOperator( const SparseMatrixsc& N, const SparseMatrixsc& Minv, const VectorXs& x, VectorXs& Nx, VectorXs& MinvNx, VectorXs& y );
 
   void computeLCPQPLinearTerm( const SparseMatrixsc& N, const VectorXs& nrel, const VectorXs& CoR, const VectorXs& v0, const VectorXs& v0F, VectorXs& linear_term );
 
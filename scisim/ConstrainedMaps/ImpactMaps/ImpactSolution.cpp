@@ -26,15 +26,9 @@ static void getCollisionIndices( const Constraint& con, std::pair<int,int>& indi
   }
 }
 
-void ImpactSolution::setSolution( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& impact_bases, const VectorXs& alpha, const scalar& dt )
+void ImpactSolution::setIndicesAndPoints( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const unsigned ambient_space_dims )
 {
   const unsigned ncons{ static_cast<unsigned>( constraints.size() ) };
-  assert( ncons == alpha.size() );
-  assert( std::vector<std::unique_ptr<Constraint>>::size_type( ncons ) == constraints.size() );
-  assert( alpha.size() == ncons );
-
-  const unsigned ambient_space_dims{ static_cast<unsigned>( impact_bases.rows() ) };
-  assert( ambient_space_dims == 2 || ambient_space_dims == 3 );
 
   // Place all indices into a single matrix for output
   m_indices.resize( 2, ncons );
@@ -56,6 +50,19 @@ void ImpactSolution::setSolution( const VectorXs& q, const std::vector<std::uniq
     assert( contact_point.size() == ambient_space_dims );
     m_points.col( con ) = contact_point;
   }
+}
+
+void ImpactSolution::setSolution( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& impact_bases, const VectorXs& alpha, const scalar& dt )
+{
+  const unsigned ncons{ static_cast<unsigned>( constraints.size() ) };
+  assert( ncons == alpha.size() );
+  assert( std::vector<std::unique_ptr<Constraint>>::size_type( ncons ) == constraints.size() );
+  assert( alpha.size() == ncons );
+
+  const unsigned ambient_space_dims{ static_cast<unsigned>( impact_bases.rows() ) };
+  assert( ambient_space_dims == 2 || ambient_space_dims == 3 );
+
+  setIndicesAndPoints( q, constraints, ambient_space_dims );
 
   // Save the world space contact normals
   m_normals = impact_bases;
@@ -72,7 +79,50 @@ void ImpactSolution::setSolution( const VectorXs& q, const std::vector<std::uniq
   m_dt = dt;
 }
 
-void ImpactSolution::writeSolution( HDF5File& output_file )
+void ImpactSolution::setSolution( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& contact_bases, const VectorXs& alpha, const VectorXs& beta, const scalar& dt )
+{
+  const unsigned ncons{ static_cast<unsigned>( constraints.size() ) };
+  assert( ncons == alpha.size() );
+
+  const unsigned ambient_space_dims{ static_cast<unsigned>( contact_bases.rows() ) };
+  assert( ambient_space_dims == 2 || ambient_space_dims == 3 );
+  assert( contact_bases.cols() == ambient_space_dims * ncons );
+  assert( beta.size() == ncons * ( ambient_space_dims - 1 ) );
+
+  setIndicesAndPoints( q, constraints, ambient_space_dims );
+
+  // Save the world space contact normals
+  m_normals.resize( ambient_space_dims, ncons );
+  for( unsigned con = 0; con < ncons; ++con )
+  {
+    m_normals.col( con ) = contact_bases.col( ambient_space_dims * con );
+    assert( fabs( m_normals.col( con ).norm() - 1.0 ) <= 1.0e-6 );
+  }
+
+  // Compute the world space contact forces
+  m_forces.resize( ambient_space_dims, ncons );
+  for( unsigned con = 0; con < ncons; ++con )
+  {
+    // Contribution from normal
+    m_forces.col( con ) = alpha( con ) * m_normals.col( con );
+    // Contribution from friction
+    for( unsigned friction_sample = 0; friction_sample < ambient_space_dims - 1; ++friction_sample )
+    {
+      assert( ( ambient_space_dims - 1 ) * con + friction_sample < beta.size() );
+      const scalar impulse{ beta( ( ambient_space_dims - 1 ) * con + friction_sample ) };
+
+      const unsigned column_number{ ambient_space_dims * con + friction_sample + 1 };
+      assert( column_number < contact_bases.cols() );
+      assert( fabs( m_normals.col( con ).dot( contact_bases.col( column_number ) ) ) <= 1.0e-6 );
+
+      m_forces.col( con ) += impulse * contact_bases.col( column_number );
+    }
+  }
+
+  m_dt = dt;
+}
+
+void ImpactSolution::writeSolution( HDF5File& output_file ) const
 {
   const unsigned ncons{ unsigned( m_indices.cols() ) };
 
@@ -22,10 +22,15 @@ public:
 
   void setSolution( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& impact_bases, const VectorXs& alpha, const scalar& dt );
 
-  void writeSolution( HDF5File& output_file );
+  // Solution with friction, contact_bases holds the normal followed by the tangents of each contact
+  void setSolution( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& contact_bases, const VectorXs& alpha, const VectorXs& beta, const scalar& dt );
+
+  void writeSolution( HDF5File& output_file ) const;
 
 private:
 
+  void setIndicesAndPoints( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const unsigned ambient_space_dims );
+
   Matrix2Xic m_indices;
   MatrixXXsc m_points;
   MatrixXXsc m_normals;
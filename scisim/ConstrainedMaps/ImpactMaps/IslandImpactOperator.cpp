@@ -0,0 +1,145 @@
+#include "IslandImpactOperator.h"
+
+#include "scisim/Math/MathUtilities.h"
+#include "scisim/ConstrainedMaps/ConstrainedMapUtilities.h"
+#include "scisim/ConstrainedMaps/ContactIslands.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
+#include "scisim/Timer/Profiler.h"
+#include "scisim/Utilities.h"
+#include "scisim/Constraints/Constraint.h"
+
+namespace
+{
+
+  // Constraints of an island, lent by the full constraint list for the duration of the island's solve
+  class BorrowedConstraints final
+  {
+
+  public:
+
+    BorrowedConstraints( const std::vector<std::unique_ptr<Constraint>>& cons, const std::vector<unsigned>& island )
+    : m_cons( island.size() )
+    {
+      for( std::vector<unsigned>::size_type local_idx = 0; local_idx < island.size(); ++local_idx )
+      {
+        m_cons[local_idx].reset( cons[island[local_idx]].get() );
+      }
+    }
+
+    ~BorrowedConstraints()
+    {
+      // The full constraint list retains ownership
+      for( std::unique_ptr<Constraint>& con : m_cons )
+      {
+        con.release();
+      }
+    }
+
+    BorrowedConstraints( const BorrowedConstraints& ) = delete;
+    BorrowedConstraints& operator=( const BorrowedConstraints& ) = delete;
+
+    const std::vector<std::unique_ptr<Constraint>>& constraints() const
+    {
+      return m_cons;
+    }
+
+  private:
+
+    std::vector<std::unique_ptr<Constraint>> m_cons;
+
+  };
+
+}
+
+IslandImpactOperator::IslandImpactOperator( const unsigned min_contacts, const ImpactOperator& impact_operator )
+: m_min_contacts( min_contacts )
+, m_impact_operator( impact_operator.clone() )
+{
+  assert( m_impact_operator != nullptr );
+}
+
+IslandImpactOperator::IslandImpactOperator( std::istream& input_stream )
+: m_min_contacts( Utilities::deserialize<unsigned>( input_stream ) )
+, m_impact_operator( ConstrainedMapUtilities::deserializeImpactOperator( input_stream ) )
+{
+  assert( m_impact_operator != nullptr );
+}
+
+IslandImpactOperator::~IslandImpactOperator()
+{}
+
+void IslandImpactOperator::flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha )
+{
+  assert( N.cols() == SparseMatrixsc::Index( cons.size() ) );
+  assert( alpha.size() == N.cols() ); assert( nrel.size() == N.cols() ); assert( CoR.size() == N.cols() );
+
+  std::vector<std::vector<unsigned>> islands;
+  ContactIslands::partition( cons, m_min_contacts, islands );
+
+  // A single island is the original problem
+  if( islands.size() <= 1 )
+  {
+    SparseMatrixsc Q_full;
+    if( m_impact_operator->usesDelassusOperator() )
+    {
+      ImpactOperatorUtilities::computeDelassusOperator( N, Minv, Q_full );
+    }
+    m_impact_operator->flow( cons, M, Minv, q0, v0, v0F, N, Q_full, nrel, CoR, alpha );
+    return;
+  }
+
+  // The profiler may only be updated from a single thread, so islands are solved serially while profiling
+  const int nislands{ int( islands.size() ) };
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule( dynamic ) if( !Profiler::enabled() )
+  #endif
+  for( int island_idx = 0; island_idx < nislands; ++island_idx )
+  {
+    const std::vector<unsigned>& island{ islands[island_idx] };
+
+    SparseMatrixsc N_island;
+    MathUtilities::extractColumns( N, island, N_island );
+    const std::unique_ptr<ImpactOperator> island_operator{ m_impact_operator->clone() };
+    SparseMatrixsc Q_island;
+    if( island_operator->usesDelassusOperator() )
+    {
+      ImpactOperatorUtilities::computeDelassusOperator( N_island, Minv, Q_island );
+    }
+    VectorXs nrel_island;
+    ContactIslands::gather( nrel, island, 1, nrel_island );
+    VectorXs CoR_island;
+    ContactIslands::gather( CoR, island, 1, CoR_island );
+    VectorXs alpha_island;
+    ContactIslands::gather( alpha, island, 1, alpha_island );
+
+    const BorrowedConstraints island_cons{ cons, island };
+
+    island_operator->flow( island_cons.constraints(), M, Minv, q0, v0, v0F, N_island, Q_island, nrel_island, CoR_island, alpha_island );
+
+    // Islands write disjoint entries of alpha
+    ContactIslands::scatter( alpha_island, island, 1, alpha );
+  }
+}
+
+bool IslandImpactOperator::usesDelassusOperator() const
+{
+  // Each island forms its own operator
+  return false;
+}
+
+std::string IslandImpactOperator::name() const
+{
+  return "islands";
+}
+
+std::unique_ptr<ImpactOperator> IslandImpactOperator::clone() const
+{
+  return std::unique_ptr<ImpactOperator>{ new IslandImpactOperator{ m_min_contacts, *m_impact_operator } };
+}
+
+void IslandImpactOperator::serialize( std::ostream& output_stream ) const
+{
+  assert( output_stream.good() );
+  Utilities::serialize( m_min_contacts, output_stream );
+  ConstrainedMapUtilities::serialize( m_impact_operator, output_stream );
+}
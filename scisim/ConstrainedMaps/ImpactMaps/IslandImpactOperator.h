@@ -0,0 +1,37 @@
+#ifndef ISLAND_IMPACT_OPERATOR_H
+#define ISLAND_IMPACT_OPERATOR_H
+
+#include "ImpactOperator.h"
+
+#include <memory>
+
+// Splits the impact problem into groups of contacts that share no bodies (see ContactIslands) and
+// solves each group independently, in parallel when OpenMP is enabled, with a copy of an impact
+// operator. Each sub-problem receives the group's constraints with the matching columns of N.
+class IslandImpactOperator final : public ImpactOperator
+{
+
+public:
+
+  IslandImpactOperator( const unsigned min_contacts, const ImpactOperator& impact_operator );
+  explicit IslandImpactOperator( std::istream& input_stream );
+  virtual ~IslandImpactOperator() override;
+
+  virtual void flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha ) override;
+
+  virtual bool usesDelassusOperator() const override;
+
+  virtual std::string name() const override;
+
+  virtual std::unique_ptr<ImpactOperator> clone() const override;
+
+  virtual void serialize( std::ostream& output_stream ) const override;
+
+private:
+
+  const unsigned m_min_contacts;
+  const std::unique_ptr<ImpactOperator> m_impact_operator;
+
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include "scisim/Math/QPSolvers/SparseMatrixVectorOperators.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
 #include "scisim/Utilities.h"
+#include "scisim/Timer/Profiler.h"
 #include "NonNegativeProjection.h"
 #include "MinMapImpact.h"
 
@@ -36,6 +37,7 @@ void LCPOperatorAPGD::flow( const std::vector<std::unique_ptr<Constraint>>& cons
   ProjectionSolvers::APGD( NonNegativeProjection{}, MinMapImpact{}, ObjectiveEigenColumnMajor{}, GradientEigenColumnMajor{}, MultiplyEigenColumnMajor{}, m_tol, m_max_iters, Q, b, alpha, results );
   #endif
   assert( ( alpha.array() >= 0.0 ).all() );
+  Profiler::addCount( ProfilerCounter::IMPACT_SOLVER_ITERATIONS, results.num_iterations );
 
   if( results.status != ProjectionSolveStatus::Success )
   {
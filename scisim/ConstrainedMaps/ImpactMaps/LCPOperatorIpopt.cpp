@@ -145,7 +145,8 @@ void LCPOperatorIpopt::solveQP( const QPTerminationOperator& termination_operato
   Ipopt::SmartPtr<Ipopt::IpoptApplication> ipopt_app;
   createIpoptApplication( m_tol, ipopt_app );
 
-  const SparseMatrixsc Q{ N.transpose() * Minv * N };
+  SparseMatrixsc Q;
+  ImpactOperatorUtilities::computeDelassusOperator( N, Minv, Q );
 
   // Create the Ipopt-based QP solver
   assert( Q.rows() == Q.cols() );
@@ -0,0 +1,74 @@
+#include "LCPOperatorMatrixFreeAPGD.h"
+
+#include "scisim/Math/QPSolvers/ProjectionSolvers.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
+#include "scisim/Utilities.h"
+#include "scisim/Timer/Profiler.h"
+#include "NonNegativeProjection.h"
+#include "MinMapImpact.h"
+
+#include <iostream>
+
+LCPOperatorMatrixFreeAPGD::LCPOperatorMatrixFreeAPGD( const scalar& tol, const unsigned max_iters )
+: m_tol( tol )
+, m_max_iters( max_iters )
+{
+  assert( m_tol >= 0.0 );
+}
+
+LCPOperatorMatrixFreeAPGD::LCPOperatorMatrixFreeAPGD( std::istream& input_stream )
+: m_tol( Utilities::deserialize<scalar>( input_stream ) )
+, m_max_iters( Utilities::deserialize<unsigned>( input_stream ) )
+{
+  assert( m_tol >= 0.0 );
+}
+
+void LCPOperatorMatrixFreeAPGD::flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha )
+{
+  // b in b^T \alpha
+  VectorXs b;
+  ImpactOperatorUtilities::computeLCPQPLinearTerm( N, nrel, CoR, v0, v0F, b );
+
+  if( b.size() == 0 )
+  {
+    return;
+  }
+
+  ProjectionSolveResults results;
+  // Applies N^T M^-1 N, reusing the intermediate vectors across products
+  VectorXs Nx{ N.rows() };
+  VectorXs MinvNx{ N.rows() };
+  const auto delassus_product = [&N, &Minv, &Nx, &MinvNx]( const VectorXs& x, VectorXs& y )
+  {
+    ImpactOperatorUtilities::applyDelassusOperator( N, Minv, x, Nx, MinvNx, y );
+  };
+  ProjectionSolvers::APGDMatrixFree( NonNegativeProjection{}, MinMapImpact{}, delassus_product, m_tol, m_max_iters, b, alpha, results );
+  assert( ( alpha.array() >= 0.0 ).all() );
+  Profiler::addCount( ProfilerCounter::IMPACT_SOLVER_ITERATIONS, results.num_iterations );
+
+  if( results.status != ProjectionSolveStatus::Success )
+  {
+    std::cerr << "LCPOperatorMatrixFreeAPGD warning, failed to acheive desired tolerance: " << results.achieved_tolerance << std::endl;
+  }
+}
+
+bool LCPOperatorMatrixFreeAPGD::usesDelassusOperator() const
+{
+  return false;
+}
+
+std::string LCPOperatorMatrixFreeAPGD::name() const
+{
+  return "lcp_apgd_matrix_free";
+}
+
+std::unique_ptr<ImpactOperator> LCPOperatorMatrixFreeAPGD::clone() const
+{
+  return std::unique_ptr<ImpactOperator>{ new LCPOperatorMatrixFreeAPGD{ m_tol, m_max_iters } };
+}
+
+void LCPOperatorMatrixFreeAPGD::serialize( std::ostream& output_stream ) const
+{
+  Utilities::serialize( m_tol, output_stream );
+  Utilities::serialize( m_max_iters, output_stream );
+}
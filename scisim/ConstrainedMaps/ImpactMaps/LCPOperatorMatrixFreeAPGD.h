@@ -0,0 +1,35 @@
+#ifndef LCP_OPERATOR_MATRIX_FREE_APGD_H
+#define LCP_OPERATOR_MATRIX_FREE_APGD_H
+
+#include "ImpactOperator.h"
+
+// Solves the same LCP as LCPOperatorAPGD, but applies Q = N^T M^-1 N as a product with N, M^-1,
+// and N^T in turn, so Q is never formed
+class LCPOperatorMatrixFreeAPGD final : public ImpactOperator
+{
+
+public:
+
+  LCPOperatorMatrixFreeAPGD( const scalar& tol, const unsigned max_iters );
+  explicit LCPOperatorMatrixFreeAPGD( std::istream& input_stream );
+
+  virtual ~LCPOperatorMatrixFreeAPGD() override = default;
+
+  virtual void flow( const std::vector<std::unique_ptr<Constraint>>& cons, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& q0, const VectorXs& v0, const VectorXs& v0F, const SparseMatrixsc& N, const SparseMatrixsc& Q, const VectorXs& nrel, const VectorXs& CoR, VectorXs& alpha ) override;
+
+  virtual bool usesDelassusOperator() const override;
+
+  virtual std::string name() const override;
+
+  virtual std::unique_ptr<ImpactOperator> clone() const override;
+
+  virtual void serialize( std::ostream& output_stream ) const override;
+
+private:
+
+  const scalar m_tol;
+  const unsigned m_max_iters;
+
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "IslandFrictionSolver.h"
+
+#include <algorithm>
+
+#include "scisim/ConstrainedMaps/ConstrainedMapUtilities.h"
+#include "scisim/ConstrainedMaps/ContactIslands.h"
+#include "scisim/Constraints/Constraint.h"
+#include "scisim/Constraints/ContactBatch.h"
+#include "scisim/Timer/Profiler.h"
+#include "scisim/Utilities.h"
+
+IslandFrictionSolver::IslandFrictionSolver( const unsigned min_contacts, const FrictionSolver& friction_solver )
+: m_min_contacts( min_contacts )
+, m_friction_solver( friction_solver.clone() )
+{
+  assert( m_friction_solver != nullptr );
+}
+
+IslandFrictionSolver::IslandFrictionSolver( std::istream& input_stream )
+: m_min_contacts( Utilities::deserialize<unsigned>( input_stream ) )
+, m_friction_solver( ConstrainedMapUtilities::deserializeFrictionSolver( input_stream ) )
+{
+  assert( m_friction_solver != nullptr );
+}
+
+IslandFrictionSolver::~IslandFrictionSolver()
+{}
+
+void IslandFrictionSolver::solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error )
+{
+  assert( alpha.size() == int( active_set.size() ) ); assert( CoR.size() == alpha.size() ); assert( mu.size() == alpha.size() );
+  assert( f.size() == v0.size() ); assert( vout.size() == v0.size() );
+
+  std::vector<std::vector<unsigned>> islands;
+  ContactIslands::partition( active_set, m_min_contacts, islands );
+
+  // A single island is the original problem
+  if( islands.size() <= 1 )
+  {
+    m_friction_solver->solve( iteration, dt, fsys, M, Minv, CoR, mu, q0, v0, active_set, contact_bases, contact_batch, nrel_extra, drel_extra, max_iters, tol, f, alpha, beta, vout, solve_succeeded, error );
+    return;
+  }
+
+  const int ncons{ int( alpha.size() ) };
+  assert( beta.size() % ncons == 0 ); assert( nrel_extra.size() % ncons == 0 ); assert( drel_extra.size() % ncons == 0 );
+  const int beta_block{ int( beta.size() ) / ncons };
+  const int nrel_extra_block{ int( nrel_extra.size() ) / ncons };
+  const int drel_extra_block{ int( drel_extra.size() ) / ncons };
+
+  // Each island starts from the full friction impulse and contributes its own impulse and velocity change
+  const VectorXs f0{ f };
+  f.setZero();
+  vout = v0;
+  solve_succeeded = true;
+  error = 0.0;
+
+  // The profiler may only be updated from a single thread, so islands are solved serially while profiling
+  const int nislands{ int( islands.size() ) };
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule( dynamic ) if( !Profiler::enabled() )
+  #endif
+  for( int island_idx = 0; island_idx < nislands; ++island_idx )
+  {
+    const std::vector<unsigned>& island{ islands[island_idx] };
+
+    // Islands own disjoint constraints, so each can borrow its constraints from the active set
+    std::vector<std::unique_ptr<Constraint>> island_set( island.size() );
+    for( std::vector<unsigned>::size_type local_idx = 0; local_idx < island.size(); ++local_idx )
+    {
+      island_set[local_idx] = std::move( active_set[island[local_idx]] );
+    }
+    MatrixXXsc island_bases;
+    ContactIslands::gatherBases( contact_bases, island, island_bases );
+    ContactBatch island_batch;
+    if( contact_batch != nullptr )
+    {
+      contact_batch->extract( island, island_batch );
+    }
+    VectorXs CoR_island;
+    ContactIslands::gather( CoR, island, 1, CoR_island );
+    VectorXs mu_island;
+    ContactIslands::gather( mu, island, 1, mu_island );
+    VectorXs nrel_extra_island;
+    ContactIslands::gather( nrel_extra, island, nrel_extra_block, nrel_extra_island );
+    VectorXs drel_extra_island;
+    ContactIslands::gather( drel_extra, island, drel_extra_block, drel_extra_island );
+    VectorXs alpha_island;
+    ContactIslands::gather( alpha, island, 1, alpha_island );
+    VectorXs beta_island;
+    ContactIslands::gather( beta, island, beta_block, beta_island );
+
+    VectorXs f_island{ f0 };
+    VectorXs vout_island{ v0.size() };
+    bool island_succeeded;
+    scalar island_error;
+    const std::unique_ptr<FrictionSolver> island_solver{ m_friction_solver->clone() };
+    island_solver->solve( iteration, dt, fsys, M, Minv, CoR_island, mu_island, q0, v0, island_set, island_bases, contact_batch != nullptr ? &island_batch : nullptr, nrel_extra_island, drel_extra_island, max_iters, tol, f_island, alpha_island, beta_island, vout_island, island_succeeded, island_error );
+
+    for( std::vector<unsigned>::size_type local_idx = 0; local_idx < island.size(); ++local_idx )
+    {
+      active_set[island[local_idx]] = std::move( island_set[local_idx] );
+    }
+    ContactIslands::scatter( alpha_island, island, 1, alpha );
+    ContactIslands::scatter( beta_island, island, beta_block, beta );
+
+    #ifdef _OPENMP
+    #pragma omp critical
+    #endif
+    {
+      f += f_island;
+      vout += vout_island - v0;
+      solve_succeeded = solve_succeeded && island_succeeded;
+      error = std::max( error, island_error );
+    }
+  }
+}
+
+unsigned IslandFrictionSolver::numFrictionImpulsesPerNormal( const unsigned ambient_space_dimensions ) const
+{
+  return m_friction_solver->numFrictionImpulsesPerNormal( ambient_space_dimensions );
+}
+
+void IslandFrictionSolver::serialize( std::ostream& output_stream ) const
+{
+  assert( output_stream.good() );
+  Utilities::serialize( m_min_contacts, output_stream );
+  ConstrainedMapUtilities::serialize( m_friction_solver, output_stream );
+}
+
+std::string IslandFrictionSolver::name() const
+{
+  return "islands";
+}
+
+std::unique_ptr<FrictionSolver> IslandFrictionSolver::clone() const
+{
+  return std::unique_ptr<FrictionSolver>{ new IslandFrictionSolver{ m_min_contacts, *m_friction_solver } };
+}
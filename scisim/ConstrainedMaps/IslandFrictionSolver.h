@@ -0,0 +1,37 @@
+#ifndef ISLAND_FRICTION_SOLVER_H
+#define ISLAND_FRICTION_SOLVER_H
+
+#include "FrictionSolver.h"
+
+// Splits the coupled impact and friction problem into groups of contacts that share no bodies (see
+// ContactIslands) and solves each group independently, in parallel when OpenMP is enabled, with a
+// copy of another friction solver. The solve succeeds if every group succeeds, and the reported
+// error is the largest error of any group.
+class IslandFrictionSolver final : public FrictionSolver
+{
+
+public:
+
+  IslandFrictionSolver( const unsigned min_contacts, const FrictionSolver& friction_solver );
+  explicit IslandFrictionSolver( std::istream& input_stream );
+
+  virtual ~IslandFrictionSolver() override;
+
+  virtual void solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error ) override;
+
+  virtual unsigned numFrictionImpulsesPerNormal( const unsigned ambient_space_dimensions ) const override;
+
+  virtual void serialize( std::ostream& output_stream ) const override;
+
+  virtual std::string name() const override;
+
+  virtual std::unique_ptr<FrictionSolver> clone() const override;
+
+private:
+
+  const unsigned m_min_contacts;
+  const std::unique_ptr<FrictionSolver> m_friction_solver;
+
+};
+
+#endif
@@ -6,18 +6,102 @@
 #include "Sobogus.h"
 
 #include "scisim/Constraints/Constraint.h"
+#include "scisim/Constraints/ContactBatch.h"
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/Utilities.h"
+#include "scisim/StringUtilities.h"
+#include "scisim/Timer/Profiler.h"
 
 #ifndef NDEBUG
 #include "scisim/Math/MathUtilities.h"
+#include "scisim/Math/RigidBodyMass3D.h"
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <map>
+#include <numeric>
 
 #include <iostream>
 
+#include "rapidxml.hpp"
+
+SobogusSettings::SobogusSettings()
+: max_threads( 0 )
+, use_coloring( false )
+, contact_ordering( SobogusContactOrdering::None )
+, report_solves( false )
+{}
+
+SobogusSettings::SobogusSettings( std::istream& input_stream )
+: max_threads( Utilities::deserialize<unsigned>( input_stream ) )
+, use_coloring( Utilities::deserialize<bool>( input_stream ) )
+, contact_ordering( Utilities::deserialize<SobogusContactOrdering>( input_stream ) )
+, report_solves( Utilities::deserialize<bool>( input_stream ) )
+{}
+
+void SobogusSettings::serialize( std::ostream& output_stream ) const
+{
+  Utilities::serialize( max_threads, output_stream );
+  Utilities::serialize( use_coloring, output_stream );
+  Utilities::serialize( contact_ordering, output_stream );
+  Utilities::serialize( report_solves, output_stream );
+}
+
+bool loadSobogusSettings( const rapidxml::xml_node<char>& node, SobogusSettings& settings )
+{
+  settings = SobogusSettings{};
+
+  if( node.first_attribute( "threads" ) != nullptr )
+  {
+    if( !StringUtilities::extractFromString( node.first_attribute( "threads" )->value(), settings.max_threads ) )
+    {
+      std::cerr << "Could not load threads value for sobogus_friction_solver, value of threads must be a nonnegative integer" << std::endl;
+      return false;
+    }
+  }
+
+  // Parallel sweeps require a coloring, so default to coloring whenever more than one thread is requested
+  settings.use_coloring = settings.max_threads > 1;
+  if( node.first_attribute( "coloring" ) != nullptr )
+  {
+    if( !StringUtilities::extractFromString( node.first_attribute( "coloring" )->value(), settings.use_coloring ) )
+    {
+      std::cerr << "Could not load coloring value for sobogus_friction_solver, value of coloring must be a boolean" << std::endl;
+      return false;
+    }
+  }
+
+  if( node.first_attribute( "contact_ordering" ) != nullptr )
+  {
+    const std::string ordering{ node.first_attribute( "contact_ordering" )->value() };
+    if( ordering == "none" )
+    {
+      settings.contact_ordering = SobogusContactOrdering::None;
+    }
+    else if( ordering == "by_body" )
+    {
+      settings.contact_ordering = SobogusContactOrdering::ByBody;
+    }
+    else
+    {
+      std::cerr << "Invalid contact_ordering for sobogus_friction_solver, options are: none, by_body" << std::endl;
+      return false;
+    }
+  }
+
+  if( node.first_attribute( "report" ) != nullptr )
+  {
+    if( !StringUtilities::extractFromString( node.first_attribute( "report" )->value(), settings.report_solves ) )
+    {
+      std::cerr << "Could not load report value for sobogus_friction_solver, value of report must be a boolean" << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
 SobogusFrictionProblem::SobogusFrictionProblem( const SobogusSolverType& solver_type )
 : m_solver_type( solver_type )
 , m_num_bodies()
@@ -31,10 +115,10 @@ SobogusFrictionProblem::SobogusFrictionProblem( const SobogusSolverType& solver_
 , m_H_1_store()
 {}
 
-SobogusFrictionProblem::SobogusFrictionProblem( const SobogusSolverType& solver_type, const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel )
+SobogusFrictionProblem::SobogusFrictionProblem( const SobogusSolverType& solver_type, const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const std::vector<unsigned>& batch_contacts, const VectorXi& batch_body_map, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel )
 : m_solver_type( solver_type )
 {
-  initialize( active_set, contact_bases, masses, q0, v0, CoR, mu, nrel, drel );
+  initialize( active_set, contact_bases, contact_batch, batch_contacts, batch_body_map, masses, q0, v0, CoR, mu, nrel, drel );
 }
 
 void SobogusFrictionProblem::initialize2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel )
@@ -181,7 +265,7 @@ void SobogusFrictionProblem::initializeRigidBody2D( const std::vector<std::uniqu
   m_rigid_body_2d.fromPrimal( m_num_bodies, masses, m_f_in, m_num_collisions, mu, contact_bases, m_w_in, obj_A, obj_B, m_H_0_store, m_H_1_store );
 }
 
-void SobogusFrictionProblem::initialize3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel )
+void SobogusFrictionProblem::initialize3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const std::vector<unsigned>& batch_contacts, const VectorXi& batch_body_map, const VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel )
 {
   // Compute the number of bodies in the system
   assert( masses.size() % 36 == 0 );
@@ -202,48 +286,64 @@ void SobogusFrictionProblem::initialize3D( const std::vector<std::unique_ptr<Con
     m_f_in.segment<6>( 6 * bdy_idx ) = - Eigen::Map<const Matrix66sc>( &masses( 36 * bdy_idx ) ) * v ;
   }
 
-  // 'Forcing' terms (kinematic collisions, restitution)
-  m_w_in.resize( 3 * m_num_collisions );
-  // Flat storage for contact basis and contact basis crossed with arms for torque
-  m_H_0_store.resize( 3 * m_num_collisions, 6 );
-  m_H_1_store.resize( 3 * m_num_collisions, 6 );
-  for( unsigned clsn_idx = 0; clsn_idx < m_num_collisions; ++clsn_idx )
-  {
-    // Compute the contact basis
-    const MatrixXXsc contact_basis{ contact_bases.block<3,3>( 0, 3 * clsn_idx ) };
-    assert( contact_basis.rows() == contact_basis.cols() );
-    assert( ( contact_basis * contact_basis.transpose() - MatrixXXsc::Identity( contact_basis.rows(), contact_basis.cols() ) ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
-    assert( fabs( contact_basis.determinant() - 1.0 ) <= 1.0e-6 );
-
-    // Compute the 'forcing' term
-    VectorXs forcing_term;
-    active_set[clsn_idx]->computeForcingTerm( q0, v0, contact_basis, CoR( clsn_idx ), nrel( clsn_idx ), drel.segment<2>( 2 * clsn_idx ), forcing_term );
-    assert( forcing_term.size() == 3 );
-    m_w_in.segment<3>( 3 * clsn_idx ) = forcing_term;
-
-    // Format for H:
-    //   n^T  \tilde{n}^T
-    //   s^T  \tilde{s}^T
-    //   t^T  \tilde{t}^T
-    MatrixXXsc H0{ 3, 6 };
-    MatrixXXsc H1{ 3, 6 };
-    active_set[clsn_idx]->evalH( q0, contact_basis, H0, H1 );
-    m_H_0_store.block<3,6>( 3 * clsn_idx, 0  ) = H0;
-    m_H_1_store.block<3,6>( 3 * clsn_idx, 0  ) = H1;
-  }
-
   VectorXi obj_A{ m_num_collisions };
   VectorXi obj_B{ m_num_collisions };
-  for( unsigned clsn_idx = 0; clsn_idx < m_num_collisions; ++clsn_idx )
+
+  // Contacts that support it are formatted from a structure of arrays batch
+  if( contact_batch != nullptr )
   {
-    // Save the ids of the objects involved in the collision
-    std::pair<int,int> object_ids;
-    active_set[clsn_idx]->getSimulatedBodyIndices( object_ids );
-    assert( object_ids.first != object_ids.second );
-    assert( object_ids.first >= 0 );
-    assert( object_ids.second >= -1 );
-    obj_A( clsn_idx ) = object_ids.first;
-    obj_B( clsn_idx ) = object_ids.second;
+    assert( contact_batch->size() == m_num_collisions );
+    assert( batch_contacts.empty() || batch_contacts.size() == m_num_collisions );
+    // 'Forcing' terms (kinematic collisions, restitution)
+    contact_batch->computeForcingTerms( batch_contacts, batch_body_map, v0, contact_bases, CoR, nrel, drel, m_w_in );
+    // Flat storage for contact basis and contact basis crossed with arms for torque
+    contact_batch->computeH( batch_contacts, contact_bases, m_H_0_store, m_H_1_store );
+    // Save the ids of the objects involved in each collision
+    contact_batch->getBodyIndices( batch_contacts, batch_body_map, obj_A, obj_B );
+  }
+  else
+  {
+    // 'Forcing' terms (kinematic collisions, restitution)
+    m_w_in.resize( 3 * m_num_collisions );
+    // Flat storage for contact basis and contact basis crossed with arms for torque
+    m_H_0_store.resize( 3 * m_num_collisions, 6 );
+    m_H_1_store.resize( 3 * m_num_collisions, 6 );
+    for( unsigned clsn_idx = 0; clsn_idx < m_num_collisions; ++clsn_idx )
+    {
+      // Compute the contact basis
+      const MatrixXXsc contact_basis{ contact_bases.block<3,3>( 0, 3 * clsn_idx ) };
+      assert( contact_basis.rows() == contact_basis.cols() );
+      assert( ( contact_basis * contact_basis.transpose() - MatrixXXsc::Identity( contact_basis.rows(), contact_basis.cols() ) ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
+      assert( fabs( contact_basis.determinant() - 1.0 ) <= 1.0e-6 );
+
+      // Compute the 'forcing' term
+      VectorXs forcing_term;
+      active_set[clsn_idx]->computeForcingTerm( q0, v0, contact_basis, CoR( clsn_idx ), nrel( clsn_idx ), drel.segment<2>( 2 * clsn_idx ), forcing_term );
+      assert( forcing_term.size() == 3 );
+      m_w_in.segment<3>( 3 * clsn_idx ) = forcing_term;
+
+      // Format for H:
+      //   n^T  \tilde{n}^T
+      //   s^T  \tilde{s}^T
+      //   t^T  \tilde{t}^T
+      MatrixXXsc H0{ 3, 6 };
+      MatrixXXsc H1{ 3, 6 };
+      active_set[clsn_idx]->evalH( q0, contact_basis, H0, H1 );
+      m_H_0_store.block<3,6>( 3 * clsn_idx, 0  ) = H0;
+      m_H_1_store.block<3,6>( 3 * clsn_idx, 0  ) = H1;
+    }
+
+    for( unsigned clsn_idx = 0; clsn_idx < m_num_collisions; ++clsn_idx )
+    {
+      // Save the ids of the objects involved in the collision
+      std::pair<int,int> object_ids;
+      active_set[clsn_idx]->getSimulatedBodyIndices( object_ids );
+      assert( object_ids.first != object_ids.second );
+      assert( object_ids.first >= 0 );
+      assert( object_ids.second >= -1 );
+      obj_A( clsn_idx ) = object_ids.first;
+      obj_B( clsn_idx ) = object_ids.second;
+    }
   }
 
   assert( m_num_collisions == mu.size() );
@@ -251,14 +351,14 @@ void SobogusFrictionProblem::initialize3D( const std::vector<std::unique_ptr<Con
 }
 
 // TODO: Factor out code by passing in the number of dofs per body?
-void SobogusFrictionProblem::initialize( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel )
+void SobogusFrictionProblem::initialize( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const std::vector<unsigned>& batch_contacts, const VectorXi& batch_body_map, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel )
 {
   assert( active_set.size() == unsigned( contact_bases.cols() / contact_bases.rows() ) );
   assert( masses.size() % 36 == 0 || masses.size() % 9 == 0 || masses.size() % 4 == 0 );
 
   if( m_solver_type == SobogusSolverType::RigidBodies3D )
   {
-    initialize3D( active_set, contact_bases, masses, q0, v0, CoR, mu, nrel, drel );
+    initialize3D( active_set, contact_bases, contact_batch, batch_contacts, batch_body_map, masses, q0, v0, CoR, mu, nrel, drel );
   }
   else if( m_solver_type == SobogusSolverType::Balls2D )
   {
@@ -270,7 +370,7 @@ void SobogusFrictionProblem::initialize( const std::vector<std::unique_ptr<Const
   }
 }
 
-void SobogusFrictionProblem::solve2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
+void SobogusFrictionProblem::solve2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
 {
   assert( tol >= 0.0 );
 
@@ -302,7 +402,7 @@ void SobogusFrictionProblem::solve2D( const std::vector<std::unique_ptr<Constrai
   }
 
   assert( vout.size() == 2 * m_num_bodies );
-  error = m_balls_2d.solve( r, vout, num_iterations, 0, tol, max_iters, eval_every, true );
+  error = m_balls_2d.solve( r, vout, num_iterations, max_threads, use_coloring, tol, max_iters, eval_every, true );
   succeeded = error < tol;
 
   // Extract the impulses
@@ -372,7 +472,7 @@ void SobogusFrictionProblem::solve2D( const std::vector<std::unique_ptr<Constrai
   #endif
 }
 
-void SobogusFrictionProblem::solveRigidBody2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
+void SobogusFrictionProblem::solveRigidBody2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
 {
   assert( tol >= 0.0 );
 
@@ -404,7 +504,7 @@ void SobogusFrictionProblem::solveRigidBody2D( const std::vector<std::unique_ptr
     r.segment<2>( 2 * clsn_idx ) = alpha(clsn_idx) * n + beta(clsn_idx) * t;
   }
 
-  error = m_rigid_body_2d.solve( r, vout, num_iterations, 0, tol, max_iters, eval_every, true );
+  error = m_rigid_body_2d.solve( r, vout, num_iterations, max_threads, use_coloring, tol, max_iters, eval_every, true );
   succeeded = error < tol;
 
   // Extract the impulses
@@ -483,7 +583,7 @@ void SobogusFrictionProblem::solveRigidBody2D( const std::vector<std::unique_ptr
   #endif
 }
 
-void SobogusFrictionProblem::solve3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
+void SobogusFrictionProblem::solve3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
 {
   assert( tol >= 0.0 );
 
@@ -519,7 +619,7 @@ void SobogusFrictionProblem::solve3D( const std::vector<std::unique_ptr<Constrai
   }
   assert( ( r.array() == r.array() ).all() );
 
-  error = m_mfp.solve( r, vout, num_iterations, 0, tol, max_iters, eval_every, true );
+  error = m_mfp.solve( r, vout, num_iterations, max_threads, use_coloring, tol, max_iters, eval_every, true );
   succeeded = error < tol;
 
   // Extract the impulses
@@ -593,19 +693,19 @@ void SobogusFrictionProblem::solve3D( const std::vector<std::unique_ptr<Constrai
   #endif
 }
 
-void SobogusFrictionProblem::solve( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
+void SobogusFrictionProblem::solve( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations )
 {
   if( m_solver_type == SobogusSolverType::RigidBodies3D )
   {
-    solve3D( active_set, max_iters, eval_every, tol, alpha, beta, f, vout, succeeded, error, num_iterations );
+    solve3D( active_set, max_iters, eval_every, tol, max_threads, use_coloring, alpha, beta, f, vout, succeeded, error, num_iterations );
   }
   else if( m_solver_type == SobogusSolverType::Balls2D )
   {
-    solve2D( active_set, mu, max_iters, eval_every, tol, alpha, beta, f, vout, succeeded, error, num_iterations );
+    solve2D( active_set, mu, max_iters, eval_every, tol, max_threads, use_coloring, alpha, beta, f, vout, succeeded, error, num_iterations );
   }
   else if( m_solver_type == SobogusSolverType::RigidBody2D )
   {
-    solveRigidBody2D( active_set, mu, max_iters, eval_every, tol, alpha, beta, f, vout, succeeded, error, num_iterations );
+    solveRigidBody2D( active_set, mu, max_iters, eval_every, tol, max_threads, use_coloring, alpha, beta, f, vout, succeeded, error, num_iterations );
   }
 }
 
@@ -639,19 +739,63 @@ scalar SobogusFrictionProblem::computeError( const VectorXs& r )
   }
 }
 
-Sobogus::Sobogus( const SobogusSolverType& solver_type, const unsigned eval_every )
+Sobogus::Sobogus( const SobogusSolverType& solver_type, const unsigned eval_every, const SobogusSettings& settings )
 : m_solver_type( solver_type )
 , m_eval_every( eval_every )
+, m_settings( settings )
+, m_last_num_iterations( 0 )
+, m_last_error( 0.0 )
 {}
 
 Sobogus::Sobogus( std::istream& input_stream )
 : m_solver_type( Utilities::deserialize<SobogusSolverType>( input_stream ) )
 , m_eval_every( Utilities::deserialize<unsigned>( input_stream ) )
+, m_settings( input_stream )
+, m_last_num_iterations( 0 )
+, m_last_error( 0.0 )
 {}
 
 Sobogus::~Sobogus()
 {}
 
+// Builds a vector whose ith entry is the index of the contact to place ith, sorted by the lower and then the
+// higher index of the simulated bodies involved; static geometry sorts before all bodies
+static void computeContactOrderByBody( const std::vector<std::unique_ptr<Constraint>>& active_set, std::vector<unsigned>& order )
+{
+  std::vector<std::pair<int,int>> keys( active_set.size() );
+  for( std::vector<std::unique_ptr<Constraint>>::size_type con_idx = 0; con_idx < active_set.size(); ++con_idx )
+  {
+    const int body0{ active_set[con_idx]->simulatedBody0() };
+    const int body1{ active_set[con_idx]->simulatedBody1() };
+    keys[con_idx] = std::make_pair( std::min( body0, body1 ), std::max( body0, body1 ) );
+  }
+  order.resize( active_set.size() );
+  std::iota( order.begin(), order.end(), 0 );
+  std::stable_sort( order.begin(), order.end(), [&keys]( const unsigned a, const unsigned b ) { return keys[a] < keys[b]; } );
+}
+
+// Gathers the block_size entries of each contact, in the given order
+static void gatherContactBlocks( const std::vector<unsigned>& order, const int block_size, const VectorXs& x, VectorXs& x_sorted )
+{
+  assert( x.size() == block_size * int( order.size() ) );
+  x_sorted.resize( x.size() );
+  for( std::vector<unsigned>::size_type sorted_idx = 0; sorted_idx < order.size(); ++sorted_idx )
+  {
+    x_sorted.segment( block_size * int( sorted_idx ), block_size ) = x.segment( block_size * int( order[sorted_idx] ), block_size );
+  }
+}
+
+// Inverse of gatherContactBlocks
+static void scatterContactBlocks( const std::vector<unsigned>& order, const int block_size, const VectorXs& x_sorted, VectorXs& x )
+{
+  assert( x_sorted.size() == block_size * int( order.size() ) );
+  x.resize( x_sorted.size() );
+  for( std::vector<unsigned>::size_type sorted_idx = 0; sorted_idx < order.size(); ++sorted_idx )
+  {
+    x.segment( block_size * int( order[sorted_idx] ), block_size ) = x_sorted.segment( block_size * int( sorted_idx ), block_size );
+  }
+}
+
 // Builds a vector that, given local index i in [0,nlocalbodies), gives the global index ltg[i] [0,nglobalbodies)
 static void buildLocalToGlobalMap( const unsigned nglobalbodies, const std::vector<std::unique_ptr<Constraint>>& active_set, VectorXu& ltg )
 {
@@ -724,7 +868,7 @@ static void extractMass2DRigidBody( const unsigned nlocalbodies, const unsigned
 
 static void extractMass3D( const unsigned nlocalbodies, const unsigned nglobalbodies, const VectorXu& ltg, const SparseMatrixsc& M, VectorXs& masses )
 {
-  assert( M.rows() == M.cols() );
+  assert( RigidBodyMass3D::hasBlockLayout( M ) ); assert( RigidBodyMass3D::numBodies( M ) == nglobalbodies );
   masses.resize( 36 * nlocalbodies );
   for( unsigned local_body_index = 0; local_body_index < nlocalbodies; ++local_body_index )
   {
@@ -735,7 +879,7 @@ static void extractMass3D( const unsigned nlocalbodies, const unsigned nglobalbo
     Eigen::Map<Matrix66sc> mass_block{ &masses( 36 * local_body_index ) };
 
     // The total mass is in the upper left block
-    mass_block.block<3,3>( 0, 0 ) = Eigen::Map<const Vector3s>{ &M.data().value( 3 * global_body_number ) }.asDiagonal();
+    mass_block.block<3,3>( 0, 0 ) = RigidBodyMass3D::translationalBlock( M, global_body_number ).asDiagonal();
     assert( ( mass_block.block<3,3>( 0, 0 ).array() >= 0.0 ).all() );
 
     // Zero off-diagonal blocks
@@ -743,7 +887,7 @@ static void extractMass3D( const unsigned nlocalbodies, const unsigned nglobalbo
     mass_block.block<3,3>( 3, 0 ).setZero();
 
     // The inertia is in the lower right block
-    mass_block.block<3,3>( 3, 3 ) = Eigen::Map<const Matrix33sc>{ &M.data().value( 3 * nglobalbodies + 9 * global_body_number ) };
+    mass_block.block<3,3>( 3, 3 ) = RigidBodyMass3D::rotationalBlock( M, global_body_number );
     // TODO: Eigenvalues of inertia block should be positive
 
     assert( ( mass_block - mass_block.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
@@ -758,8 +902,8 @@ void SobogusFrictionProblem::flattenMass( const SparseMatrixsc& M, VectorXs& mas
   {
     case SobogusSolverType::RigidBodies3D:
     {
-      assert( M.rows() % 6 == 0 );
-      const unsigned nbodies{ static_cast<unsigned>( M.rows() ) / 6 };
+      assert( RigidBodyMass3D::hasBlockLayout( M ) );
+      const unsigned nbodies{ RigidBodyMass3D::numBodies( M ) };
       masses.resize( 36 * nbodies );
       for( unsigned body_index = 0; body_index < nbodies; ++body_index )
       {
@@ -767,7 +911,7 @@ void SobogusFrictionProblem::flattenMass( const SparseMatrixsc& M, VectorXs& mas
         Eigen::Map<Matrix66sc> mass_block{ &masses( 36 * body_index ) };
 
         // The total mass is in the upper left block
-        mass_block.block<3,3>( 0, 0 ) = Eigen::Map<const Vector3s>{ &M.data().value( 3 * body_index ) }.asDiagonal();
+        mass_block.block<3,3>( 0, 0 ) = RigidBodyMass3D::translationalBlock( M, body_index ).asDiagonal();
         assert( ( mass_block.block<3,3>( 0, 0 ).array() >= 0.0 ).all() );
 
         // Zero off-diagonal blocks
@@ -775,7 +919,7 @@ void SobogusFrictionProblem::flattenMass( const SparseMatrixsc& M, VectorXs& mas
         mass_block.block<3,3>( 3, 0 ).setZero();
 
         // The inertia is in the lower right block
-        mass_block.block<3,3>( 3, 3 ) = Eigen::Map<const Matrix33sc>{ &M.data().value( 3 * nbodies + 9 * body_index ) };
+        mass_block.block<3,3>( 3, 3 ) = RigidBodyMass3D::rotationalBlock( M, body_index );
         // TODO: Eigenvalues of inertia block should be positive
         assert( ( mass_block - mass_block.transpose() ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
       }
@@ -877,7 +1021,7 @@ static void extractv3D( const unsigned nlocalbodies, const unsigned nglobalbodie
   }
 }
 
-void Sobogus::solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error )
+void Sobogus::solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error )
 {
   const unsigned nglobalbodies{ fsys.numBodies() };
 
@@ -980,7 +1124,58 @@ void Sobogus::solve( const unsigned iteration, const scalar& dt, const FlowableS
     extractv2DRigidBody( nlocalbodies, nglobalbodies, ltg, v0, v_local );
   }
 
-  SobogusFrictionProblem sfp{ m_solver_type, active_set, contact_bases, masses, q_local, v_local, CoR, mu, nrel, drel };
+  // Optionally sort the contacts so that consecutive contacts in the sweeps touch nearby bodies
+  const bool sort_contacts{ m_settings.contact_ordering == SobogusContactOrdering::ByBody && !active_set.empty() };
+  std::vector<unsigned> contact_order;
+  MatrixXXsc contact_bases_sorted;
+  VectorXs CoR_sorted;
+  VectorXs mu_sorted;
+  if( sort_contacts )
+  {
+    computeContactOrderByBody( active_set, contact_order );
+    {
+      std::vector<std::unique_ptr<Constraint>> active_set_sorted( active_set.size() );
+      for( std::vector<unsigned>::size_type sorted_idx = 0; sorted_idx < contact_order.size(); ++sorted_idx )
+      {
+        active_set_sorted[sorted_idx] = std::move( active_set[contact_order[sorted_idx]] );
+      }
+      active_set.swap( active_set_sorted );
+    }
+    const int basis_size{ int( contact_bases.rows() ) };
+    contact_bases_sorted.resize( contact_bases.rows(), contact_bases.cols() );
+    for( std::vector<unsigned>::size_type sorted_idx = 0; sorted_idx < contact_order.size(); ++sorted_idx )
+    {
+      contact_bases_sorted.middleCols( basis_size * int( sorted_idx ), basis_size ) = contact_bases.middleCols( basis_size * int( contact_order[sorted_idx] ), basis_size );
+    }
+    gatherContactBlocks( contact_order, 1, CoR, CoR_sorted );
+    gatherContactBlocks( contact_order, 1, mu, mu_sorted );
+    VectorXs scratch;
+    gatherContactBlocks( contact_order, 1, nrel, scratch );
+    nrel.swap( scratch );
+    gatherContactBlocks( contact_order, int( drel.size() / nrel.size() ), drel, scratch );
+    drel.swap( scratch );
+    gatherContactBlocks( contact_order, 1, alpha, scratch );
+    alpha.swap( scratch );
+    gatherContactBlocks( contact_order, int( beta.size() / alpha.size() ), beta, scratch );
+    beta.swap( scratch );
+  }
+  const MatrixXXsc& contact_bases_solve{ sort_contacts ? contact_bases_sorted : contact_bases };
+  const VectorXs& CoR_solve{ sort_contacts ? CoR_sorted : CoR };
+  const VectorXs& mu_solve{ sort_contacts ? mu_sorted : mu };
+
+  // The caller's batch is read in the solve's contact order and with the local view of the bodies
+  VectorXi global_to_local;
+  if( contact_batch != nullptr )
+  {
+    assert( m_solver_type == SobogusSolverType::RigidBodies3D ); assert( contact_batch->size() == active_set.size() );
+    global_to_local.setConstant( nglobalbodies, -1 );
+    for( unsigned local_body_index = 0; local_body_index < nlocalbodies; ++local_body_index )
+    {
+      global_to_local( ltg( local_body_index ) ) = int( local_body_index );
+    }
+  }
+
+  SobogusFrictionProblem sfp{ m_solver_type, active_set, contact_bases_solve, contact_batch, contact_order, global_to_local, masses, q_local, v_local, CoR_solve, mu_solve, nrel, drel };
 
   VectorXs v_local_out;
   VectorXs f_local;
@@ -1002,7 +1197,30 @@ void Sobogus::solve( const unsigned iteration, const scalar& dt, const FlowableS
 
   {
     unsigned num_iterations;
-    sfp.solve( active_set, mu, max_iters, m_eval_every, tol, alpha, beta, f_local, v_local_out, solve_succeeded, error, num_iterations );
+    sfp.solve( active_set, mu_solve, max_iters, m_eval_every, tol, m_settings.max_threads, m_settings.use_coloring, alpha, beta, f_local, v_local_out, solve_succeeded, error, num_iterations );
+    m_last_num_iterations = num_iterations;
+    Profiler::addCount( ProfilerCounter::FRICTION_SOLVER_ITERATIONS, num_iterations );
+    m_last_error = error;
+    if( m_settings.report_solves )
+    {
+      std::cout << "Sobogus: " << active_set.size() << " contacts, " << num_iterations << " iterations, residual " << error << std::endl;
+    }
+  }
+
+  // Restore the caller's contact order
+  if( sort_contacts )
+  {
+    std::vector<std::unique_ptr<Constraint>> active_set_unsorted( active_set.size() );
+    for( std::vector<unsigned>::size_type sorted_idx = 0; sorted_idx < contact_order.size(); ++sorted_idx )
+    {
+      active_set_unsorted[contact_order[sorted_idx]] = std::move( active_set[sorted_idx] );
+    }
+    active_set.swap( active_set_unsorted );
+    VectorXs scratch;
+    scatterContactBlocks( contact_order, int( beta.size() / alpha.size() ), beta, scratch );
+    beta.swap( scratch );
+    scatterContactBlocks( contact_order, 1, alpha, scratch );
+    alpha.swap( scratch );
   }
 
   // TODO: Convert the following to functions like above
@@ -1096,9 +1314,30 @@ void Sobogus::serialize( std::ostream& output_stream ) const
 {
   Utilities::serialize( m_solver_type, output_stream );
   Utilities::serialize( m_eval_every, output_stream );
+  m_settings.serialize( output_stream );
 }
 
 std::string Sobogus::name() const
 {
   return "sobogus";
 }
+
+std::unique_ptr<FrictionSolver> Sobogus::clone() const
+{
+  return std::unique_ptr<FrictionSolver>{ new Sobogus{ m_solver_type, m_eval_every, m_settings } };
+}
+
+const SobogusSettings& Sobogus::settings() const
+{
+  return m_settings;
+}
+
+unsigned Sobogus::lastNumIterations() const
+{
+  return m_last_num_iterations;
+}
+
+const scalar& Sobogus::lastError() const
+{
+  return m_last_error;
+}
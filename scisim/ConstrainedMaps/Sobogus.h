@@ -17,10 +17,37 @@
 #include "FrictionSolver.h"
 
 class Constraint;
+class ContactBatch;
 class FlowableSystem;
+namespace rapidxml { template<class Ch> class xml_node; }
 
 enum class SobogusSolverType{ Balls2D, RigidBody2D, RigidBodies3D };
 
+enum class SobogusContactOrdering{ None, ByBody };
+
+// Tuning of the So-bogus Gauss-Seidel solve. The defaults match the solver's behavior before
+// these options existed.
+struct SobogusSettings final
+{
+  SobogusSettings();
+  explicit SobogusSettings( std::istream& input_stream );
+
+  void serialize( std::ostream& output_stream ) const;
+
+  // Maximum number of threads for the Gauss-Seidel sweeps; 1 runs serially, 0 uses So-bogus' default
+  unsigned max_threads;
+  // Color the contacts so that parallel sweeps never update a body concurrently
+  bool use_coloring;
+  // Order of the contacts in the sweeps; ByBody sorts contacts by the bodies involved for locality
+  SobogusContactOrdering contact_ordering;
+  // Print the number of iterations and the residual of each solve
+  bool report_solves;
+};
+
+// Loads the optional threads, coloring, contact_ordering, and report attributes of a
+// sobogus_friction_solver scene node; all other settings keep their defaults
+bool loadSobogusSettings( const rapidxml::xml_node<char>& node, SobogusSettings& settings );
+
 // TODO: Have a 2D and 3D version of this
 // TODO: Rename m_f_in to m_p0
 // TODO: Rename m_H0 to generalized contact basis
@@ -30,12 +57,14 @@ class SobogusFrictionProblem final
 public:
 
   explicit SobogusFrictionProblem( const SobogusSolverType& solver_type );
-  SobogusFrictionProblem( const SobogusSolverType& solver_type, const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
+  // If contact_batch is not null, the contacts are read from it in the order batch_contacts, with
+  // body i of the batch renumbered to batch_body_map(i), as ContactBatch::computeH and friends
+  SobogusFrictionProblem( const SobogusSolverType& solver_type, const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const std::vector<unsigned>& batch_contacts, const VectorXi& batch_body_map, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
 
-  void initialize( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
+  void initialize( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const std::vector<unsigned>& batch_contacts, const VectorXi& batch_body_map, VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
 
   // TODO: Get working with warm starts (setting r correctly) for 2D rigid bodies and 3D rigid bodies
-  void solve( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
+  void solve( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
 
   scalar computeError( const VectorXs& r );
 
@@ -44,13 +73,13 @@ public:
 private:
 
   void initialize2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
-  void solve2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
+  void solve2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
 
   void initializeRigidBody2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
-  void solveRigidBody2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
+  void solveRigidBody2D( const std::vector<std::unique_ptr<Constraint>>& active_set, const VectorXs& mu, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
 
-  void initialize3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
-  void solve3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const unsigned max_iters, const unsigned eval_every, const scalar& tol, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
+  void initialize3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const std::vector<unsigned>& batch_contacts, const VectorXi& batch_body_map, const VectorXs& masses, const VectorXs& q0, const VectorXs& v0, const VectorXs& CoR, const VectorXs& mu, const VectorXs& nrel, const VectorXs& drel );
+  void solve3D( const std::vector<std::unique_ptr<Constraint>>& active_set, const unsigned max_iters, const unsigned eval_every, const scalar& tol, const unsigned max_threads, const bool use_coloring, VectorXs& alpha, VectorXs& beta, VectorXs& f, VectorXs& vout, bool& succeeded, scalar& error, unsigned& num_iterations );
 
   const SobogusSolverType m_solver_type;
 
@@ -78,11 +107,11 @@ class Sobogus final : public FrictionSolver
 
 public:
 
-  Sobogus( const SobogusSolverType& solver_type, const unsigned eval_every );
+  Sobogus( const SobogusSolverType& solver_type, const unsigned eval_every, const SobogusSettings& settings );
   explicit Sobogus( std::istream& input_stream );
   virtual ~Sobogus() override;
 
-  virtual void solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error ) override;
+  virtual void solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error ) override;
 
   virtual unsigned numFrictionImpulsesPerNormal( const unsigned ambient_space_dimensions ) const override;
 
@@ -90,12 +119,24 @@ public:
 
   virtual std::string name() const override;
 
+  virtual std::unique_ptr<FrictionSolver> clone() const override;
+
+  const SobogusSettings& settings() const;
+
+  // Number of iterations and residual of the most recent solve
+  unsigned lastNumIterations() const;
+  const scalar& lastError() const;
+
 private:
 
   void flattenMass( const SparseMatrixsc& M, VectorXs& masses );
 
   const SobogusSolverType m_solver_type;
   const unsigned m_eval_every;
+  const SobogusSettings m_settings;
+
+  unsigned m_last_num_iterations;
+  scalar m_last_error;
 
 };
 
@@ -14,9 +14,14 @@
 #include "scisim/Constraints/ConstrainedSystem.h"
 #include "scisim/UnconstrainedMaps/UnconstrainedMap.h"
 #include "scisim/ScriptingCallback.h"
+#include "scisim/Timer/Profiler.h"
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/Utilities.h"
 
+#ifdef USE_HDF5
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactSolution.h"
+#endif
+
 StabilizedImpactFrictionMap::StabilizedImpactFrictionMap( const scalar& abs_tol, const unsigned max_iters, const bool external_warm_start_alpha, const bool external_warm_start_beta )
 : m_f( VectorXs::Zero( 0 ) )
 , m_abs_tol( abs_tol )
@@ -25,7 +30,7 @@ StabilizedImpactFrictionMap::StabilizedImpactFrictionMap( const scalar& abs_tol,
 , m_external_warm_start_beta( external_warm_start_beta )
 #ifdef USE_HDF5
 , m_write_constraint_forces( false )
-, m_constraint_force_stream( nullptr )
+, m_impact_solution( nullptr )
 #endif
 {
   assert( m_abs_tol >= 0.0 );
@@ -39,7 +44,7 @@ StabilizedImpactFrictionMap::StabilizedImpactFrictionMap( std::istream& input_st
 , m_external_warm_start_beta( Utilities::deserialize<bool>( input_stream ) )
 #ifdef USE_HDF5
 , m_write_constraint_forces( false )
-, m_constraint_force_stream( nullptr )
+, m_impact_solution( nullptr )
 #endif
 {
   assert( m_abs_tol >= 0.0 );
@@ -57,11 +62,18 @@ void StabilizedImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSy
   }
 
   // Compute an unconstrained predictor step
-  umap.flow( q0, v0, fsys, iteration, dt, q1, v1 );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::UNCONSTRAINED_MAP };
+    umap.flow( q0, v0, fsys, iteration, dt, q1, v1 );
+  }
 
   // Using the configuration at the predictor step, compute the set of active constraints
   std::vector<std::unique_ptr<Constraint>> active_set;
-  csys.computeActiveSet( q0, q1, v1, active_set );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ACTIVE_SET };
+    csys.computeActiveSet( q0, q1, v1, active_set );
+  }
+  Profiler::addCount( ProfilerCounter::CONTACTS, active_set.size() );
 
   // If there are no active constraints, there is no need to perform collision response
   if( active_set.empty() )
@@ -69,10 +81,10 @@ void StabilizedImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSy
     #ifdef USE_HDF5
     if( m_write_constraint_forces )
     {
-      exportConstraintForcesToBinary( q0, active_set, MatrixXXsc{ fsys.ambientSpaceDimensions(), 0 }, VectorXs::Zero(0), VectorXs::Zero(0), dt );
+      m_impact_solution->setSolution( q0, active_set, MatrixXXsc{ fsys.ambientSpaceDimensions(), 0 }, VectorXs::Zero(0), VectorXs::Zero(0), dt );
     }
     m_write_constraint_forces = false;
-    m_constraint_force_stream = nullptr;
+    m_impact_solution = nullptr;
     #endif
     return;
   }
@@ -82,7 +94,10 @@ void StabilizedImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSy
   // Pre-compute the full contact basis
   MatrixXXsc contact_bases;
   // NB: v1, not v0, so linear samples are aligned with the incoming velocity
-  csys.computeContactBases( q0, v1, active_set, contact_bases );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ASSEMBLY };
+    csys.computeContactBases( q0, v1, active_set, contact_bases );
+  }
   assert( contact_bases.rows() == fsys.ambientSpaceDimensions() );
   assert( contact_bases.cols() == fsys.ambientSpaceDimensions() * ncollisions );
 
@@ -124,7 +139,10 @@ void StabilizedImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSy
     VectorXs v2{ v1.size() };
     VectorXs nrel_extra;
     VectorXs drel_extra;
-    friction_solver.solve( iteration, dt, fsys, fsys.M(), fsys.Minv(), CoR, mu, q0, v1, active_set, contact_bases, nrel_extra, drel_extra, m_max_iters, m_abs_tol, m_f, alpha, beta, v2, solve_succeeded, error );
+    {
+      const ProfilerScope profiler_scope{ ProfilerTimer::FRICTION_SOLVE };
+      friction_solver.solve( iteration, dt, fsys, fsys.M(), fsys.Minv(), CoR, mu, q0, v1, active_set, contact_bases, csys.contactBatch( q0, active_set ), nrel_extra, drel_extra, m_max_iters, m_abs_tol, m_f, alpha, beta, v2, solve_succeeded, error );
+    }
     //std::cout << "alpha: " << alpha.transpose() << std::endl;
     //std::cout << "beta: " << beta.transpose() << std::endl;
     assert( error >= 0.0 );
@@ -171,10 +189,10 @@ void StabilizedImpactFrictionMap::flow( ScriptingCallback& call_back, FlowableSy
   // Export constraint forces, if requested
   if( m_write_constraint_forces )
   {
-    exportConstraintForcesToBinary( q0, active_set, contact_bases, alpha, beta, dt );
+    m_impact_solution->setSolution( q0, active_set, contact_bases, alpha, beta, dt );
   }
   m_write_constraint_forces = false;
-  m_constraint_force_stream = nullptr;
+  m_impact_solution = nullptr;
   #endif
 
   active_set.clear();
@@ -187,15 +205,6 @@ void StabilizedImpactFrictionMap::resetCachedData()
   m_f = VectorXs::Zero( 0 );
 }
 
-#ifdef USE_HDF5
-void StabilizedImpactFrictionMap::exportConstraintForcesToBinary( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& contact_bases, const VectorXs& alpha, const VectorXs& beta, const scalar& dt )
-{
-  assert( m_write_constraint_forces );
-  assert( m_constraint_force_stream != nullptr );
-  ImpactFrictionMap::exportConstraintForcesToBinaryFile( q, constraints, contact_bases, alpha, beta, dt, *m_constraint_force_stream );
-}
-#endif
-
 void StabilizedImpactFrictionMap::serialize( std::ostream& output_stream ) const
 {
   assert( output_stream.good() );
@@ -206,7 +215,7 @@ void StabilizedImpactFrictionMap::serialize( std::ostream& output_stream ) const
   Utilities::serialize( m_external_warm_start_beta, output_stream );
   #ifdef USE_HDF5
   assert( m_write_constraint_forces == false );
-  assert( m_constraint_force_stream == nullptr );
+  assert( m_impact_solution == nullptr );
   #endif
 }
 
@@ -216,9 +225,9 @@ std::string StabilizedImpactFrictionMap::name() const
 }
 
 #ifdef USE_HDF5
-void StabilizedImpactFrictionMap::exportForcesNextStep( HDF5File& output_file )
+void StabilizedImpactFrictionMap::exportForcesNextStep( ImpactSolution& impact_solution )
 {
   m_write_constraint_forces = true;
-  m_constraint_force_stream = &output_file;
+  m_impact_solution = &impact_solution;
 }
 #endif
@@ -12,6 +12,7 @@
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/Utilities.h"
+#include "scisim/Timer/Profiler.h"
 
 #include <iostream>
 
@@ -145,7 +146,7 @@ static scalar computeSobogusError( const VectorXs& alpha, const VectorXs& beta,
 // TODO: Unify interfces for formGeneralizedSmoothFrictionBasis and computeN
 // TODO: Use the improved matrix-vector routines
 // NOTE: Can't precompute linear terms as they change during the solve
-void StaggeredProjections::solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error )
+void StaggeredProjections::solve( const unsigned iteration, const scalar& dt, const FlowableSystem& fsys, const SparseMatrixsc& M, const SparseMatrixsc& Minv, const VectorXs& CoR, const VectorXs& mu, const VectorXs& q0, const VectorXs& v0, std::vector<std::unique_ptr<Constraint>>& active_set, const MatrixXXsc& contact_bases, const ContactBatch* contact_batch, const VectorXs& nrel_extra, const VectorXs& drel_extra, const unsigned max_iters, const scalar& tol, VectorXs& f, VectorXs& alpha, VectorXs& beta, VectorXs& vout, bool& solve_succeeded, scalar& error )
 {
   assert( MathUtilities::isSquare( M ) );
   assert( MathUtilities::isSquare( Minv ) );
@@ -176,7 +177,7 @@ void StaggeredProjections::solve( const unsigned iteration, const scalar& dt, co
 
   // Impact basis
   SparseMatrixsc N{ static_cast<SparseMatrixsc::Index>( v0.size() ), static_cast<SparseMatrixsc::Index>( alpha.size() ) };
-  ImpactOperatorUtilities::computeN( fsys, active_set, q0, N );
+  ImpactOperatorUtilities::computeN( fsys, active_set, contact_batch, q0, N );
 
   VectorXs nrel{ alpha.size() };
   VectorXs drel{ beta.size() };
@@ -189,12 +190,16 @@ void StaggeredProjections::solve( const unsigned iteration, const scalar& dt, co
   {
     VectorXs flat_masses;
     sbfp.flattenMass( M, flat_masses );
-    sbfp.initialize( active_set, contact_bases, flat_masses, q0, v0, CoR, mu, nrel, drel );
+    sbfp.initialize( active_set, contact_bases, contact_batch, std::vector<unsigned>{}, VectorXi{}, flat_masses, q0, v0, CoR, mu, nrel, drel );
   }
 
   // Quadratic term in LCP QP
-  const SparseMatrixsc QN{ N.transpose() * Minv * N };
-  assert( ( Eigen::Map<const ArrayXs>{QN.valuePtr(), QN.nonZeros()} != 0.0 ).any() );
+  SparseMatrixsc QN;
+  if( m_impact_operator->usesDelassusOperator() )
+  {
+    ImpactOperatorUtilities::computeDelassusOperator( N, Minv, QN );
+    assert( ( Eigen::Map<const ArrayXs>{QN.valuePtr(), QN.nonZeros()} != 0.0 ).any() );
+  }
 
   // Quadratic term in MDP QP
   const SparseMatrixsc QD{ D.transpose() * Minv * D };
@@ -213,6 +218,8 @@ void StaggeredProjections::solve( const unsigned iteration, const scalar& dt, co
   // Staggered projections loop to compute coupled impact/friction
   for( unsigned itr = 0; itr < max_iters; ++itr )
   {
+    Profiler::addCount( ProfilerCounter::FRICTION_SOLVER_ITERATIONS, 1 );
+
     // Impact solve
     {
       // Incoming velocity with the friction impulses applied
@@ -334,3 +341,8 @@ std::string StaggeredProjections::name() const
 {
   return "staggered_projections";
 }
+
+std::unique_ptr<FrictionSolver> StaggeredProjections::clone() const
+{
+  return std::unique_ptr<FrictionSolver>{ new StaggeredProjections{ m_warm_start_alpha, m_warm_start_beta, *m_impact_operator, *m_friction_operator } };
+}
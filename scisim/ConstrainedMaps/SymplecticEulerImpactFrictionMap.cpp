@@ -8,11 +8,16 @@
 #include "scisim/Constraints/ConstrainedSystem.h"
 #include "scisim/UnconstrainedMaps/UnconstrainedMap.h"
 #include "scisim/ScriptingCallback.h"
+#include "scisim/Timer/Profiler.h"
 #include "scisim/UnconstrainedMaps/FlowableSystem.h"
 #include "scisim/Utilities.h"
 #include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
 #include "scisim/ConstrainedMaps/FrictionMaps/FrictionOperator.h"
 
+#ifdef USE_HDF5
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactSolution.h"
+#endif
+
 SymplecticEulerImpactFrictionMap::SymplecticEulerImpactFrictionMap( const scalar& abs_tol, const unsigned max_iters, const ImpulsesToCache impulses_to_cache, const bool stabilize, const scalar& penetration_threshold )
 : m_f( VectorXs::Zero( 0 ) )
 , m_abs_tol( abs_tol )
@@ -22,7 +27,7 @@ SymplecticEulerImpactFrictionMap::SymplecticEulerImpactFrictionMap( const scalar
 , m_impulses_to_cache( impulses_to_cache )
 #ifdef USE_HDF5
 , m_write_constraint_forces( false )
-, m_constraint_force_stream( nullptr )
+, m_impact_solution( nullptr )
 #endif
 {
   assert( m_abs_tol >= 0.0 );
@@ -38,7 +43,7 @@ SymplecticEulerImpactFrictionMap::SymplecticEulerImpactFrictionMap( std::istream
 , m_impulses_to_cache( Utilities::deserialize<ImpulsesToCache>( input_stream ) )
 #ifdef USE_HDF5
 , m_write_constraint_forces( false )
-, m_constraint_force_stream( nullptr )
+, m_impact_solution( nullptr )
 #endif
 {
   assert( m_abs_tol >= 0.0 );
@@ -220,6 +225,7 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
   // Compute the force at the start of step and the corresponding change in velocity
   VectorXs vdelta( q0.size() );
   {
+    const ProfilerScope profiler_scope{ ProfilerTimer::UNCONSTRAINED_MAP };
     VectorXs F( fsys.Minv().cols() );
     fsys.computeForce( q0, v0, dt, F );
     fsys.zeroOutForcesOnFixedBodies( F );
@@ -231,7 +237,11 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
 
   // Compute the set of active collisions
   std::vector<std::unique_ptr<Constraint>> active_set;
-  csys.computeActiveSet( q0, q1, v0, active_set );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ACTIVE_SET };
+    csys.computeActiveSet( q0, q1, v0, active_set );
+  }
+  Profiler::addCount( ProfilerCounter::CONTACTS, active_set.size() );
   // If there are no active constraints, there is no need to perform collision response
   if( active_set.empty() )
   {
@@ -241,10 +251,10 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
     #ifdef USE_HDF5
     if( m_write_constraint_forces )
     {
-      exportConstraintForcesToBinary( q0, active_set, MatrixXXsc{ fsys.ambientSpaceDimensions(), 0 }, VectorXs::Zero(0), VectorXs::Zero(0), dt );
+      m_impact_solution->setSolution( q0, active_set, MatrixXXsc{ fsys.ambientSpaceDimensions(), 0 }, VectorXs::Zero(0), VectorXs::Zero(0), dt );
     }
     m_write_constraint_forces = false;
-    m_constraint_force_stream = nullptr;
+    m_impact_solution = nullptr;
     #endif
     return;
   }
@@ -268,13 +278,22 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
   // Friction impulses magnitudes
   VectorXs beta{ friction_solver.numFrictionImpulsesPerNormal( fsys.ambientSpaceDimensions() ) * ncollisions };
 
-  initializeImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, csys, alpha, beta, q0, v0 );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::WARM_START };
+    initializeImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, csys, alpha, beta, q0, v0 );
+  }
   // std::cout << "alpha0: " << alpha.transpose() << std::endl;
   // std::cout << "beta0:  " << beta.transpose() << std::endl;
 
+  // Structure of arrays form of the active set, shared by the operators below
+  const ContactBatch* const contact_batch{ csys.contactBatch( q0, active_set ) };
+
   // Pre-compute the full contact basis
   MatrixXXsc contact_bases;
-  csys.computeContactBases( q0, v0, active_set, contact_bases );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::ASSEMBLY };
+    csys.computeContactBases( q0, v0, active_set, contact_bases );
+  }
   assert( contact_bases.rows() == fsys.ambientSpaceDimensions() );
   assert( contact_bases.cols() == fsys.ambientSpaceDimensions() * ncollisions );
 
@@ -296,12 +315,14 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
     // TODO: Pull nrel and drel computation into functions
     VectorXs nrel;
     {
+      const ProfilerScope profiler_scope{ ProfilerTimer::ASSEMBLY };
       SparseMatrixsc N{ static_cast<SparseMatrixsc::Index>( v0.size() ), static_cast<SparseMatrixsc::Index>( alpha.size() ) };
-      ImpactOperatorUtilities::computeN( fsys, active_set, q0, N );
+      ImpactOperatorUtilities::computeN( fsys, active_set, contact_batch, q0, N );
       nrel = N.transpose() * vdelta;
     }
     VectorXs drel;
     {
+      const ProfilerScope profiler_scope{ ProfilerTimer::ASSEMBLY };
       SparseMatrixsc D;
       FrictionOperator::formGeneralizedSmoothFrictionBasis( unsigned( v0.size() ), unsigned( alpha.size() ), q0, active_set, contact_bases, D );
       drel = D.transpose() * vdelta;
@@ -326,7 +347,10 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
       nrel += g0 / dt;
     }
 
-    friction_solver.solve( iteration, dt, fsys, fsys.M(), fsys.Minv(), CoR, mu, q0, v0, active_set, contact_bases, nrel, drel, m_max_iters, m_abs_tol, m_f, alpha, beta, v1, solve_succeeded, error );
+    {
+      const ProfilerScope profiler_scope{ ProfilerTimer::FRICTION_SOLVE };
+      friction_solver.solve( iteration, dt, fsys, fsys.M(), fsys.Minv(), CoR, mu, q0, v0, active_set, contact_bases, contact_batch, nrel, drel, m_max_iters, m_abs_tol, m_f, alpha, beta, v1, solve_succeeded, error );
+    }
     assert( error >= 0.0 );
     if( !solve_succeeded )
     {
@@ -373,7 +397,7 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
   if( ( mu.array() == 0.0 ).all() )
   {
     SparseMatrixsc N{ static_cast<SparseMatrixsc::Index>( v0.size() ), static_cast<SparseMatrixsc::Index>( alpha.size() ) };
-    ImpactOperatorUtilities::computeN( fsys, active_set, q0, N );
+    ImpactOperatorUtilities::computeN( fsys, active_set, contact_batch, q0, N );
     assert( ( v0 + vdelta + fsys.Minv() * N * alpha - v1 ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
     const VectorXs CoR_part = CoR(0) * N.transpose() * v0;
     const VectorXs rhs0 = N.transpose() * ( v0 + vdelta + fsys.Minv() * N * alpha ) + CoR_part;
@@ -391,16 +415,19 @@ void SymplecticEulerImpactFrictionMap::flow( ScriptingCallback& call_back, Flowa
   #endif
 
   // Cache the constraints for warm starting
-  cacheImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, csys, alpha, beta, q0, v0 );
+  {
+    const ProfilerScope profiler_scope{ ProfilerTimer::WARM_START };
+    cacheImpulses( m_impulses_to_cache, fsys.ambientSpaceDimensions(), active_set, csys, alpha, beta, q0, v0 );
+  }
 
   #ifdef USE_HDF5
   // Export constraint forces, if requested
   if( m_write_constraint_forces )
   {
-    exportConstraintForcesToBinary( q0, active_set, contact_bases, alpha, beta, dt );
+    m_impact_solution->setSolution( q0, active_set, contact_bases, alpha, beta, dt );
   }
   m_write_constraint_forces = false;
-  m_constraint_force_stream = nullptr;
+  m_impact_solution = nullptr;
   #endif
 
   fsys.linearInertialConfigurationUpdate( q0, v1, dt, q1 );
@@ -411,15 +438,6 @@ void SymplecticEulerImpactFrictionMap::resetCachedData()
   m_f = VectorXs::Zero( 0 );
 }
 
-#ifdef USE_HDF5
-void SymplecticEulerImpactFrictionMap::exportConstraintForcesToBinary( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& contact_bases, const VectorXs& alpha, const VectorXs& beta, const scalar& dt )
-{
-  assert( m_write_constraint_forces );
-  assert( m_constraint_force_stream != nullptr );
-  ImpactFrictionMap::exportConstraintForcesToBinaryFile( q, constraints, contact_bases, alpha, beta, dt, *m_constraint_force_stream );
-}
-#endif
-
 void SymplecticEulerImpactFrictionMap::serialize( std::ostream& output_stream ) const
 {
   assert( output_stream.good() );
@@ -431,7 +449,7 @@ void SymplecticEulerImpactFrictionMap::serialize( std::ostream& output_stream )
   Utilities::serialize( m_impulses_to_cache, output_stream );
   #ifdef USE_HDF5
   assert( m_write_constraint_forces == false );
-  assert( m_constraint_force_stream == nullptr );
+  assert( m_impact_solution == nullptr );
   #endif
 }
 
@@ -441,9 +459,9 @@ std::string SymplecticEulerImpactFrictionMap::name() const
 }
 
 #ifdef USE_HDF5
-void SymplecticEulerImpactFrictionMap::exportForcesNextStep( HDF5File& output_file )
+void SymplecticEulerImpactFrictionMap::exportForcesNextStep( ImpactSolution& impact_solution )
 {
   m_write_constraint_forces = true;
-  m_constraint_force_stream = &output_file;
+  m_impact_solution = &impact_solution;
 }
 #endif
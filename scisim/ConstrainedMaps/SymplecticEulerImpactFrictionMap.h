@@ -9,7 +9,7 @@ class Constraint;
 class FrictionSolver;
 
 #ifdef USE_HDF5
-class HDF5File;
+class ImpactSolution;
 #endif
 
 class SymplecticEulerImpactFrictionMap final : public ImpactFrictionMap
@@ -36,16 +36,11 @@ public:
   virtual std::string name() const override;
 
   #ifdef USE_HDF5
-  virtual void exportForcesNextStep( HDF5File& output_file ) override;
+  virtual void exportForcesNextStep( ImpactSolution& impact_solution ) override;
   #endif
 
 private:
 
-  #ifdef USE_HDF5
-  // For saving out constraint forces
-  void exportConstraintForcesToBinary( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& constraints, const MatrixXXsc& contact_bases, const VectorXs& alpha, const VectorXs& beta, const scalar& dt );
-  #endif
-
   // Cached impulses from last solve
   VectorXs m_f;
 
@@ -61,7 +56,7 @@ private:
   #ifdef USE_HDF5
   // Temporary state for writing constraint forces
   bool m_write_constraint_forces;
-  HDF5File* m_constraint_force_stream;
+  ImpactSolution* m_impact_solution;
   #endif
 
 };
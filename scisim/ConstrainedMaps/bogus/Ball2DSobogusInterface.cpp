@@ -99,7 +99,7 @@ void Balls2DSobogusInterface::computeDual()
   m_dual->computeFrom( *m_primal );
 }
 
-double Balls2DSobogusInterface::solve( Eigen::VectorXd& r, Eigen::VectorXd& v, unsigned& num_iterations, const unsigned max_threads, const double& tol, const unsigned max_iters, const unsigned eval_every, const bool use_infinity_norm )
+double Balls2DSobogusInterface::solve( Eigen::VectorXd& r, Eigen::VectorXd& v, unsigned& num_iterations, const unsigned max_threads, const bool use_coloring, const double& tol, const unsigned max_iters, const unsigned eval_every, const bool use_infinity_norm )
 {
   assert( m_primal != nullptr );
   assert( r.size() == 2 * m_primal->H.rowsOfBlocks() );
@@ -123,11 +123,11 @@ double Balls2DSobogusInterface::solve( Eigen::VectorXd& r, Eigen::VectorXd& v, u
   gs.setAutoRegularization( 0.0 );
   gs.useInfinityNorm( use_infinity_norm );
 
-  // Compute coloring if multithreading
-  gs.coloring().update( max_threads > 1, m_dual->W );
+  // Color the contacts so that parallel sweeps never update a body concurrently
+  gs.coloring().update( use_coloring, m_dual->W );
 
   m_dual->undoPermutation();
-  if( max_threads > 1 )
+  if( use_coloring )
   {
     m_dual->applyPermutation( gs.coloring().permutation );
     gs.coloring().resetPermutation();
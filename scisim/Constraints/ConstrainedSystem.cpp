@@ -6,3 +6,8 @@
 #include "ConstrainedSystem.h"
 
 ConstrainedSystem::~ConstrainedSystem() = default;
+
+const ContactBatch* ConstrainedSystem::contactBatch( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set ) const
+{
+  return nullptr;
+}
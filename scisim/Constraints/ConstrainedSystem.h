@@ -11,6 +11,7 @@
 #include "scisim/Math/MathDefines.h"
 
 class Constraint;
+class ContactBatch;
 
 class ConstrainedSystem
 {
@@ -20,6 +21,9 @@ public:
   virtual void computeActiveSet( const VectorXs& q0, const VectorXs& qp, const VectorXs& v, std::vector<std::unique_ptr<Constraint>>& active_set ) = 0;
   virtual void computeImpactBases( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& impact_bases ) const = 0;
   virtual void computeContactBases( const VectorXs& q, const VectorXs& v, const std::vector<std::unique_ptr<Constraint>>& active_set, MatrixXXsc& contact_bases ) const = 0;
+  // Structure of arrays form of the active set at configuration q, or nullptr if the system does not
+  // batch its contacts or did not batch this active set at q
+  virtual const ContactBatch* contactBatch( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set ) const;
 
   virtual void clearConstraintCache() = 0;
   virtual void cacheConstraint( const Constraint& constraint, const VectorXs& r ) = 0;
@@ -5,6 +5,7 @@
 
 #include "Constraint.h"
 
+#include <atomic>
 #include <iostream>
 
 void Constraint::computeBasis( const VectorXs& q, const VectorXs& v, MatrixXXsc& basis ) const
@@ -125,9 +126,20 @@ void Constraint::evalKinematicRelVelGivenBases( const VectorXs& q, const VectorX
   }
 }
 
+static std::atomic<std::uint64_t> s_next_constraint_id{ 0 };
+
+Constraint::Constraint()
+: m_id( s_next_constraint_id++ )
+{}
+
 Constraint::~Constraint()
 {}
 
+std::uint64_t Constraint::id() const
+{
+  return m_id;
+}
+
 void Constraint::resolveImpact( const scalar& CoR, const SparseMatrixsc& M, const scalar& ndotv, VectorXs& vout, scalar& alpha ) const
 {
   std::cerr << "Constraint::resolveImpact not implemented for: " << name() << std::endl;
@@ -188,6 +200,11 @@ void Constraint::evalH( const VectorXs& q, const MatrixXXsc& basis, MatrixXXsc&
   std::exit( EXIT_FAILURE );
 }
 
+bool Constraint::addToContactBatch( const VectorXs& q, ContactBatch& batch ) const
+{
+  return false;
+}
+
 void Constraint::computeContactBasis( const VectorXs& q, const VectorXs& v, MatrixXXsc& basis ) const
 {
   std::cerr << "Constraint::computeContactBasis not implemented for: " << name() << std::endl;
@@ -8,12 +8,14 @@
 #ifndef CONSTRAINT_H
 #define CONSTRAINT_H
 
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
 
 #include "scisim/Math/MathDefines.h"
 
 class FlowableSystem;
+class ContactBatch;
 
 class Constraint
 {
@@ -27,6 +29,10 @@ public:
 
   virtual ~Constraint() = 0;
 
+  // Unique over the life of the program, unlike the address of the constraint, which a later
+  // constraint can reuse
+  std::uint64_t id() const;
+
   // Returns the full contact basis
   void computeBasis( const VectorXs& q, const VectorXs& v, MatrixXXsc& basis ) const;
 
@@ -81,6 +87,10 @@ public:
 
   virtual void evalH( const VectorXs& q, const MatrixXXsc& basis, MatrixXXsc& H0, MatrixXXsc& H1 ) const;
 
+  // Appends this constraint to a structure of arrays batch of 3D rigid body contacts. Returns false
+  // if this constraint type can not be batched.
+  virtual bool addToContactBatch( const VectorXs& q, ContactBatch& batch ) const;
+
   virtual bool conservesTranslationalMomentum() const = 0;
   virtual bool conservesAngularMomentumUnderImpact() const = 0;
   virtual bool conservesAngularMomentumUnderImpactAndFriction() const = 0;
@@ -97,7 +107,7 @@ public:
 
 protected:
 
-  Constraint() = default;
+  Constraint();
 
 private:
 
@@ -108,6 +118,8 @@ private:
   virtual scalar computeOverlapVolume( const VectorXs& q ) const;
   virtual VectorXs computeKinematicRelativeVelocity( const VectorXs& q, const VectorXs& v ) const = 0;
 
+  const std::uint64_t m_id;
+
 };
 
 #endif
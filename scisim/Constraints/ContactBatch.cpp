@@ -0,0 +1,406 @@
+#include "ContactBatch.h"
+
+#include "Constraint.h"
+
+#ifndef NDEBUG
+#include "scisim/Math/MathUtilities.h"
+#endif
+
+// Same choice of tangent as FrictionUtilities::orthogonalVector
+static Vector3s orthogonalVector( const Vector3s& n )
+{
+  assert( fabs( n.norm() - 1.0 ) <= 1.0e-6 );
+  // Chose the most orthogonal direction among x, y, z
+  Vector3s orthog{ fabs(n.x()) <= fabs(n.y()) && fabs(n.x()) <= fabs(n.z()) ? Vector3s::UnitX() : fabs(n.y()) <= fabs(n.z()) ? Vector3s::UnitY() : Vector3s::UnitZ() };
+  assert( orthog.cross(n).squaredNorm() != 0.0 );
+  // Project out any non-orthogonal component
+  orthog -= n.dot( orthog ) * n;
+  assert( orthog.norm() != 0.0 );
+  return orthog.normalized();
+}
+
+ContactBatch::ContactBatch()
+: m_size( 0 )
+, m_constraint_ids()
+, m_q()
+, m_body0()
+, m_body1()
+, m_n()
+, m_r0()
+, m_r1()
+, m_u()
+, m_normal_torque()
+{}
+
+bool ContactBatch::build( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set )
+{
+  const unsigned num_contacts{ static_cast<unsigned>( active_set.size() ) };
+  m_size = 0;
+  m_constraint_ids.resize( num_contacts );
+  m_q = q;
+  m_body0.resize( num_contacts );
+  m_body1.resize( num_contacts );
+  m_n.resize( 3, num_contacts );
+  m_r0.resize( 3, num_contacts );
+  m_r1.resize( 3, num_contacts );
+  m_u.resize( 3, num_contacts );
+  m_normal_torque.resize( num_contacts );
+
+  for( const std::unique_ptr<Constraint>& constraint : active_set )
+  {
+    assert( constraint != nullptr );
+    m_constraint_ids[m_size] = constraint->id();
+    if( !constraint->addToContactBatch( q, *this ) )
+    {
+      clear();
+      return false;
+    }
+  }
+  assert( m_size == num_contacts );
+
+  return true;
+}
+
+bool ContactBatch::matches( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set ) const
+{
+  if( active_set.size() != m_constraint_ids.size() || q.size() != m_q.size() || q != m_q )
+  {
+    return false;
+  }
+  for( std::vector<std::unique_ptr<Constraint>>::size_type con_idx = 0; con_idx < active_set.size(); ++con_idx )
+  {
+    if( active_set[con_idx]->id() != m_constraint_ids[con_idx] )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ContactBatch::extract( const std::vector<unsigned>& contacts, ContactBatch& subset ) const
+{
+  const unsigned num_contacts{ static_cast<unsigned>( contacts.size() ) };
+  subset.m_size = num_contacts;
+  subset.m_constraint_ids.resize( num_contacts );
+  // A subset does not hold every contact of an active set, so it never matches one
+  subset.m_q.resize( 0 );
+  subset.m_body0.resize( num_contacts );
+  subset.m_body1.resize( num_contacts );
+  subset.m_n.resize( 3, num_contacts );
+  subset.m_r0.resize( 3, num_contacts );
+  subset.m_r1.resize( 3, num_contacts );
+  subset.m_u.resize( 3, num_contacts );
+  subset.m_normal_torque.resize( num_contacts );
+  for( unsigned subset_idx = 0; subset_idx < num_contacts; ++subset_idx )
+  {
+    const unsigned cntct_idx{ contacts[subset_idx] };
+    assert( cntct_idx < m_size );
+    subset.m_constraint_ids[subset_idx] = m_constraint_ids[cntct_idx];
+    subset.m_body0( subset_idx ) = m_body0( cntct_idx );
+    subset.m_body1( subset_idx ) = m_body1( cntct_idx );
+    subset.m_n.col( subset_idx ) = m_n.col( cntct_idx );
+    subset.m_r0.col( subset_idx ) = m_r0.col( cntct_idx );
+    subset.m_r1.col( subset_idx ) = m_r1.col( cntct_idx );
+    subset.m_u.col( subset_idx ) = m_u.col( cntct_idx );
+    subset.m_normal_torque[subset_idx] = m_normal_torque[cntct_idx];
+  }
+}
+
+void ContactBatch::renumberBodies( const VectorXi& new_indices )
+{
+  for( unsigned cntct_idx = 0; cntct_idx < m_size; ++cntct_idx )
+  {
+    assert( m_body0( cntct_idx ) < new_indices.size() );
+    m_body0( cntct_idx ) = new_indices( m_body0( cntct_idx ) );
+    assert( m_body0( cntct_idx ) >= 0 );
+    if( m_body1( cntct_idx ) >= 0 )
+    {
+      assert( m_body1( cntct_idx ) < new_indices.size() );
+      m_body1( cntct_idx ) = new_indices( m_body1( cntct_idx ) );
+      assert( m_body1( cntct_idx ) >= 0 );
+    }
+  }
+}
+
+void ContactBatch::addContact( const int body0, const int body1, const Vector3s& n, const Vector3s& r0, const Vector3s& r1, const Vector3s& u, const bool normal_torque )
+{
+  assert( m_size < unsigned( m_n.cols() ) );
+  assert( body0 >= 0 ); assert( body1 >= -1 ); assert( body0 != body1 );
+  assert( fabs( n.norm() - 1.0 ) <= 1.0e-6 );
+
+  m_body0( m_size ) = body0;
+  m_body1( m_size ) = body1;
+  m_n.col( m_size ) = n;
+  m_r0.col( m_size ) = r0;
+  m_r1.col( m_size ) = r1;
+  m_u.col( m_size ) = u;
+  m_normal_torque[m_size] = normal_torque;
+  ++m_size;
+}
+
+unsigned ContactBatch::size() const
+{
+  return m_size;
+}
+
+void ContactBatch::getBodyIndices( VectorXi& body0, VectorXi& body1 ) const
+{
+  body0 = m_body0.head( m_size );
+  body1 = m_body1.head( m_size );
+}
+
+// Index into the batch of the idx-th contact of an ordered view
+static unsigned viewContact( const std::vector<unsigned>& contacts, const unsigned idx )
+{
+  return contacts.empty() ? idx : contacts[idx];
+}
+
+// Index of a body of the batch, -1 for static geometry, in the numbering of a view
+static int viewBody( const VectorXi& body_map, const int body )
+{
+  assert( body >= -1 );
+  return body < 0 || body_map.size() == 0 ? body : body_map( body );
+}
+
+void ContactBatch::getBodyIndices( const std::vector<unsigned>& contacts, const VectorXi& body_map, VectorXi& body0, VectorXi& body1 ) const
+{
+  const unsigned num_contacts{ contacts.empty() ? m_size : static_cast<unsigned>( contacts.size() ) };
+  body0.resize( num_contacts );
+  body1.resize( num_contacts );
+  for( unsigned view_idx = 0; view_idx < num_contacts; ++view_idx )
+  {
+    const unsigned cntct_idx{ viewContact( contacts, view_idx ) };
+    assert( cntct_idx < m_size );
+    body0( view_idx ) = viewBody( body_map, m_body0( cntct_idx ) );
+    body1( view_idx ) = viewBody( body_map, m_body1( cntct_idx ) );
+    assert( body0( view_idx ) >= 0 ); assert( body1( view_idx ) >= -1 );
+  }
+}
+
+void ContactBatch::computeN( SparseMatrixsc& N ) const
+{
+  assert( N.cols() == int( m_size ) ); assert( N.rows() % 6 == 0 );
+
+  const int nbodies{ int( N.rows() / 6 ) };
+
+  // Size the compressed storage exactly: three entries per body for the force, and three more per
+  // body if the normal impulse exerts a torque
+  N.resize( N.rows(), N.cols() );
+  int* const outer_index{ N.outerIndexPtr() };
+  outer_index[0] = 0;
+  for( unsigned cntct_idx = 0; cntct_idx < m_size; ++cntct_idx )
+  {
+    const int body_nonzeros{ m_normal_torque[cntct_idx] ? 6 : 3 };
+    outer_index[cntct_idx + 1] = outer_index[cntct_idx] + ( m_body1( cntct_idx ) >= 0 ? 2 * body_nonzeros : body_nonzeros );
+  }
+  N.resizeNonZeros( outer_index[m_size] );
+
+  // Fill each column in order of increasing row: the force on each body, then the torque on each body
+  for( unsigned cntct_idx = 0; cntct_idx < m_size; ++cntct_idx )
+  {
+    int* inner_index{ N.innerIndexPtr() + outer_index[cntct_idx] };
+    scalar* value{ N.valuePtr() + outer_index[cntct_idx] };
+    const auto setBlock = [&inner_index, &value]( const int row, const Vector3s& block )
+    {
+      for( int entry = 0; entry < 3; ++entry )
+      {
+        *inner_index++ = row + entry;
+        *value++ = block( entry );
+      }
+    };
+
+    const Vector3s n{ m_n.col( cntct_idx ) };
+    const bool normal_torque{ m_normal_torque[cntct_idx] };
+    const int body0{ m_body0( cntct_idx ) };
+    const int body1{ m_body1( cntct_idx ) };
+    assert( 3 * ( nbodies + body0 ) + 2 < N.rows() );
+    const Vector3s ntilde_0{ normal_torque ? Vector3s{ Vector3s{ m_r0.col( cntct_idx ) }.cross( n ) } : Vector3s::Zero() };
+
+    if( body1 < 0 )
+    {
+      setBlock( 3 * body0, n );
+      if( normal_torque )
+      {
+        setBlock( 3 * ( nbodies + body0 ), ntilde_0 );
+      }
+      continue;
+    }
+
+    assert( 3 * ( nbodies + body1 ) + 2 < N.rows() );
+    const Vector3s ntilde_1{ normal_torque ? Vector3s{ - Vector3s{ m_r1.col( cntct_idx ) }.cross( n ) } : Vector3s::Zero() };
+    if( body0 < body1 )
+    {
+      setBlock( 3 * body0, n );
+      setBlock( 3 * body1, -n );
+      if( normal_torque )
+      {
+        setBlock( 3 * ( nbodies + body0 ), ntilde_0 );
+        setBlock( 3 * ( nbodies + body1 ), ntilde_1 );
+      }
+    }
+    else
+    {
+      setBlock( 3 * body1, -n );
+      setBlock( 3 * body0, n );
+      if( normal_torque )
+      {
+        setBlock( 3 * ( nbodies + body1 ), ntilde_1 );
+        setBlock( 3 * ( nbodies + body0 ), ntilde_0 );
+      }
+    }
+    assert( inner_index == N.innerIndexPtr() + outer_index[cntct_idx + 1] );
+  }
+}
+
+void ContactBatch::computeBases( const VectorXs& v, MatrixXXsc& bases ) const
+{
+  bases.resize( 3, 3 * m_size );
+  for( unsigned cntct_idx = 0; cntct_idx < m_size; ++cntct_idx )
+  {
+    const Vector3s n{ m_n.col( cntct_idx ) };
+
+    // Compute the relative velocity to use as a direction for the tangent sample
+    Vector3s s{ computeRelativeVelocity( cntct_idx, VectorXi{}, v ) };
+    // If the relative velocity is zero, any vector will do
+    if( n.cross( s ).squaredNorm() < 1.0e-9 )
+    {
+      s = orthogonalVector( n );
+    }
+    // Otherwise project out the component along the normal and normalize the relative velocity
+    else
+    {
+      s = ( s - s.dot( n ) * n ).normalized();
+    }
+    // Invert the tangent vector in order to oppose
+    s *= -1.0;
+
+    // Create a second orthogonal sample in the tangent plane
+    const Vector3s t{ n.cross( s ).normalized() };
+
+    assert( MathUtilities::isRightHandedOrthoNormal( n, s, t, 1.0e-6 ) );
+    bases.col( 3 * cntct_idx + 0 ) = n;
+    bases.col( 3 * cntct_idx + 1 ) = s;
+    bases.col( 3 * cntct_idx + 2 ) = t;
+  }
+}
+
+void ContactBatch::computeForcingTerms( const VectorXs& v, const MatrixXXsc& bases, const VectorXs& CoR, const VectorXs& nrel, const VectorXs& drel, VectorXs& forcing_terms ) const
+{
+  computeForcingTerms( std::vector<unsigned>{}, VectorXi{}, v, bases, CoR, nrel, drel, forcing_terms );
+}
+
+void ContactBatch::computeForcingTerms( const std::vector<unsigned>& contacts, const VectorXi& body_map, const VectorXs& v, const MatrixXXsc& bases, const VectorXs& CoR, const VectorXs& nrel, const VectorXs& drel, VectorXs& forcing_terms ) const
+{
+  const unsigned num_contacts{ contacts.empty() ? m_size : static_cast<unsigned>( contacts.size() ) };
+  assert( bases.rows() == 3 ); assert( bases.cols() == 3 * int( num_contacts ) );
+  assert( CoR.size() == int( num_contacts ) ); assert( nrel.size() == int( num_contacts ) ); assert( drel.size() == 2 * int( num_contacts ) );
+
+  forcing_terms.resize( 3 * num_contacts );
+  for( unsigned view_idx = 0; view_idx < num_contacts; ++view_idx )
+  {
+    const unsigned cntct_idx{ viewContact( contacts, view_idx ) };
+    assert( cntct_idx < m_size );
+    assert( CoR( view_idx ) >= 0.0 ); assert( CoR( view_idx ) <= 1.0 );
+    assert( ( bases.col( 3 * view_idx ) - m_n.col( cntct_idx ) ).lpNorm<Eigen::Infinity>() <= 1.0e-6 );
+    const scalar ndotv{ m_n.col( cntct_idx ).dot( computeRelativeVelocity( cntct_idx, body_map, v ) ) };
+    forcing_terms.segment<3>( 3 * view_idx ) = bases.col( 3 * view_idx ) * ( CoR( view_idx ) * ndotv + nrel( view_idx ) )
+                                             + bases.col( 3 * view_idx + 1 ) * drel( 2 * view_idx )
+                                             + bases.col( 3 * view_idx + 2 ) * drel( 2 * view_idx + 1 );
+  }
+}
+
+void ContactBatch::computeH( const MatrixXXsc& bases, MatrixXXsr& H0, MatrixXXsr& H1 ) const
+{
+  computeH( std::vector<unsigned>{}, bases, H0, H1 );
+}
+
+void ContactBatch::computeH( const std::vector<unsigned>& contacts, const MatrixXXsc& bases, MatrixXXsr& H0, MatrixXXsr& H1 ) const
+{
+  const unsigned num_contacts{ contacts.empty() ? m_size : static_cast<unsigned>( contacts.size() ) };
+  assert( bases.rows() == 3 ); assert( bases.cols() == 3 * int( num_contacts ) );
+
+  // Format for H:
+  //   n^T  \tilde{n}^T
+  //   s^T  \tilde{s}^T
+  //   t^T  \tilde{t}^T
+  H0.resize( 3 * num_contacts, 6 );
+  H1.resize( 3 * num_contacts, 6 );
+  for( unsigned view_idx = 0; view_idx < num_contacts; ++view_idx )
+  {
+    const unsigned cntct_idx{ viewContact( contacts, view_idx ) };
+    assert( cntct_idx < m_size );
+    const Vector3s n{ bases.col( 3 * view_idx + 0 ) };
+    const Vector3s s{ bases.col( 3 * view_idx + 1 ) };
+    const Vector3s t{ bases.col( 3 * view_idx + 2 ) };
+    assert( MathUtilities::isRightHandedOrthoNormal( n, s, t, 1.0e-6 ) );
+    const Vector3s r0{ m_r0.col( cntct_idx ) };
+
+    H0.block<1,3>( 3 * view_idx + 0, 0 ) = n;
+    if( m_normal_torque[cntct_idx] )
+    {
+      H0.block<1,3>( 3 * view_idx + 0, 3 ) = r0.cross( n );
+    }
+    else
+    {
+      H0.block<1,3>( 3 * view_idx + 0, 3 ).setZero();
+    }
+    H0.block<1,3>( 3 * view_idx + 1, 0 ) = s;
+    H0.block<1,3>( 3 * view_idx + 1, 3 ) = r0.cross( s );
+    H0.block<1,3>( 3 * view_idx + 2, 0 ) = t;
+    H0.block<1,3>( 3 * view_idx + 2, 3 ) = r0.cross( t );
+
+    if( m_body1( cntct_idx ) < 0 )
+    {
+      H1.block<3,6>( 3 * view_idx, 0 ).setZero();
+      continue;
+    }
+    const Vector3s r1{ m_r1.col( cntct_idx ) };
+
+    H1.block<1,3>( 3 * view_idx + 0, 0 ) = n;
+    if( m_normal_torque[cntct_idx] )
+    {
+      H1.block<1,3>( 3 * view_idx + 0, 3 ) = r1.cross( n );
+    }
+    else
+    {
+      H1.block<1,3>( 3 * view_idx + 0, 3 ).setZero();
+    }
+    H1.block<1,3>( 3 * view_idx + 1, 0 ) = s;
+    H1.block<1,3>( 3 * view_idx + 1, 3 ) = r1.cross( s );
+    H1.block<1,3>( 3 * view_idx + 2, 0 ) = t;
+    H1.block<1,3>( 3 * view_idx + 2, 3 ) = r1.cross( t );
+  }
+}
+
+void ContactBatch::clear()
+{
+  m_size = 0;
+  m_constraint_ids.clear();
+  m_q.resize( 0 );
+  m_body0.resize( 0 );
+  m_body1.resize( 0 );
+  m_n.resize( 3, 0 );
+  m_r0.resize( 3, 0 );
+  m_r1.resize( 3, 0 );
+  m_u.resize( 3, 0 );
+  m_normal_torque.clear();
+}
+
+Vector3s ContactBatch::computeRelativeVelocity( const unsigned cntct_idx, const VectorXi& body_map, const VectorXs& v ) const
+{
+  assert( cntct_idx < m_size ); assert( v.size() % 6 == 0 );
+
+  const int nbodies{ int( v.size() / 6 ) };
+  const int body0{ viewBody( body_map, m_body0( cntct_idx ) ) };
+  const int body1{ viewBody( body_map, m_body1( cntct_idx ) ) };
+  assert( 3 * ( nbodies + body0 ) + 2 < v.size() );
+
+  // v_0 + omega_0 x r_0 - ( v_1 + omega_1 x r_1 ) - u
+  Vector3s relvel{ v.segment<3>( 3 * body0 ) + v.segment<3>( 3 * ( nbodies + body0 ) ).cross( m_r0.col( cntct_idx ) ) };
+  if( body1 >= 0 )
+  {
+    assert( 3 * ( nbodies + body1 ) + 2 < v.size() );
+    relvel = relvel - v.segment<3>( 3 * body1 ) - v.segment<3>( 3 * ( nbodies + body1 ) ).cross( m_r1.col( cntct_idx ) );
+  }
+  return relvel - m_u.col( cntct_idx );
+}
@@ -0,0 +1,92 @@
+#ifndef CONTACT_BATCH_H
+#define CONTACT_BATCH_H
+
+#include "scisim/Math/MathDefines.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Constraint;
+
+// Structure of arrays storage for contacts between 3D rigid bodies. Each contact is described by
+// the indices of the bodies involved, a normal, the arms from each body's center of mass to the
+// contact point, and the velocity of any static or scripted geometry at the contact point. The
+// impact, basis, and friction operators are then assembled by tight loops over these arrays
+// rather than by a virtual call, with temporary storage, per constraint.
+class ContactBatch final
+{
+
+public:
+
+  ContactBatch();
+
+  // Gathers every constraint of the active set into the batch. Returns false, leaving the batch
+  // empty, if any constraint does not support batching; callers then fall back to the virtual
+  // Constraint interface.
+  bool build( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set );
+
+  // True if the batch was built at configuration q from exactly the constraints of active_set, in
+  // the same order. Constraints are compared by id, so a new constraint that reuses the address of
+  // a destroyed one does not match.
+  bool matches( const VectorXs& q, const std::vector<std::unique_ptr<Constraint>>& active_set ) const;
+
+  // Copies the given contacts, in the given order, into subset. The subset matches no active set.
+  void extract( const std::vector<unsigned>& contacts, ContactBatch& subset ) const;
+
+  // Renumbers the bodies of each contact, body i becoming body new_indices(i)
+  void renumberBodies( const VectorXi& new_indices );
+
+  // Appends a contact, called by Constraint::addToContactBatch. body1 is -1 for contacts with
+  // static geometry. u is the velocity of the static geometry at the contact point. If
+  // normal_torque is false, the normal impulse does not produce a torque (e.g. for spheres).
+  void addContact( const int body0, const int body1, const Vector3s& n, const Vector3s& r0, const Vector3s& r1, const Vector3s& u, const bool normal_torque );
+
+  unsigned size() const;
+
+  // Indices of the simulated bodies involved in each contact, -1 in body1 for static geometry
+  void getBodyIndices( VectorXi& body0, VectorXi& body1 ) const;
+
+  // Writes the compressed storage of N directly, with an exact count of nonzeros. The result is the
+  // same as calling Constraint::evalgradg on each constraint. N must already have one column per
+  // contact and six rows per body.
+  void computeN( SparseMatrixsc& N ) const;
+
+  // Contact bases stacked horizontally, same as Constraint::computeBasis for each constraint
+  void computeBases( const VectorXs& v, MatrixXXsc& bases ) const;
+
+  // Stacked 'forcing' terms, same as Constraint::computeForcingTerm for each constraint
+  void computeForcingTerms( const VectorXs& v, const MatrixXXsc& bases, const VectorXs& CoR, const VectorXs& nrel, const VectorXs& drel, VectorXs& forcing_terms ) const;
+
+  // Stacked 3x6 blocks of H for each body, same as Constraint::evalH for each constraint. The
+  // blocks of H1 are zero for contacts with static geometry.
+  void computeH( const MatrixXXsc& bases, MatrixXXsr& H0, MatrixXXsr& H1 ) const;
+
+  // Same as extracting the given contacts and renumbering their bodies by body_map before calling
+  // getBodyIndices, computeForcingTerms, or computeH, without copying the batch. An empty contacts
+  // takes every contact in order, and an empty body_map keeps the numbering of the batch.
+  void getBodyIndices( const std::vector<unsigned>& contacts, const VectorXi& body_map, VectorXi& body0, VectorXi& body1 ) const;
+  void computeForcingTerms( const std::vector<unsigned>& contacts, const VectorXi& body_map, const VectorXs& v, const MatrixXXsc& bases, const VectorXs& CoR, const VectorXs& nrel, const VectorXs& drel, VectorXs& forcing_terms ) const;
+  void computeH( const std::vector<unsigned>& contacts, const MatrixXXsc& bases, MatrixXXsr& H0, MatrixXXsr& H1 ) const;
+
+private:
+
+  void clear();
+  Vector3s computeRelativeVelocity( const unsigned cntct_idx, const VectorXi& body_map, const VectorXs& v ) const;
+
+  unsigned m_size;
+  // Ids of the constraints and the configuration the batch was built from, only used to check that
+  // it matches an active set
+  std::vector<std::uint64_t> m_constraint_ids;
+  VectorXs m_q;
+  VectorXi m_body0;
+  VectorXi m_body1;
+  Matrix3Xsc m_n;
+  Matrix3Xsc m_r0;
+  Matrix3Xsc m_r1;
+  Matrix3Xsc m_u;
+  std::vector<bool> m_normal_torque;
+
+};
+
+#endif
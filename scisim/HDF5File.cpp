@@ -54,6 +54,9 @@ void HDF5File::open( const std::string& file_name, const HDF5AccessType& access_
     case HDF5AccessType::READ_ONLY:
       m_hdf_file_id = H5Fopen( file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT );
       break;
+    case HDF5AccessType::APPEND:
+      m_hdf_file_id = H5Fopen( file_name.c_str(), H5F_ACC_RDWR, H5P_DEFAULT );
+      break;
   }
   // Check that the file successfully opened
   if( m_hdf_file_id < 0 )
@@ -155,3 +158,65 @@ HDFID<H5Gclose> HDF5File::findGroup( const std::string& group_name ) const
   }
   return group_id;
 }
+
+bool HDF5File::exists( const std::string& full_name ) const
+{
+  assert( m_hdf_file_id >= 0 );
+  // Each link along the path must be checked in turn
+  std::string::size_type separator{ full_name.find( '/', 1 ) };
+  while( true )
+  {
+    const std::string path{ full_name.substr( 0, separator ) };
+    if( H5Lexists( m_hdf_file_id, path.c_str(), H5P_DEFAULT ) <= 0 )
+    {
+      return false;
+    }
+    if( separator == std::string::npos )
+    {
+      return true;
+    }
+    separator = full_name.find( '/', separator + 1 );
+  }
+}
+
+hsize_t HDF5File::numRows( const std::string& full_name ) const
+{
+  const auto split_name = splitFullName( full_name );
+  const HDFGID grp_id{ findGroup( split_name.first ) };
+  const HDFDID dataset_id{ H5Dopen2( grp_id, split_name.second.c_str(), H5P_DEFAULT ) };
+  if( dataset_id < 0 )
+  {
+    throw std::string{ "Failed to open HDF data set" };
+  }
+  const Eigen::ArrayXi dimensions{ getDimensions( dataset_id ) };
+  if( dimensions.size() != 2 )
+  {
+    throw std::string{ "Invalid dimensions for Eigen matrix type in file" };
+  }
+  return hsize_t( dimensions( 0 ) );
+}
+
+void HDF5File::truncateRows( const std::string& full_name, const hsize_t num_rows ) const
+{
+  const auto split_name = splitFullName( full_name );
+  const HDFGID grp_id{ findGroup( split_name.first ) };
+  const HDFDID dataset_id{ H5Dopen2( grp_id, split_name.second.c_str(), H5P_DEFAULT ) };
+  if( dataset_id < 0 )
+  {
+    throw std::string{ "Failed to open HDF data set" };
+  }
+  const Eigen::ArrayXi dimensions{ getDimensions( dataset_id ) };
+  if( dimensions.size() != 2 )
+  {
+    throw std::string{ "Invalid dimensions for Eigen matrix type in file" };
+  }
+  if( num_rows > hsize_t( dimensions( 0 ) ) )
+  {
+    throw std::string{ "Can not truncate an HDF data set to more rows than it has" };
+  }
+  const hsize_t new_dims[2] = { num_rows, hsize_t( dimensions( 1 ) ) };
+  if( H5Dset_extent( dataset_id, new_dims ) < 0 )
+  {
+    throw std::string{ "Failed to truncate HDF data set" };
+  }
+}
@@ -12,6 +12,7 @@
 #ifndef HDF5_FILE_H
 #define HDF5_FILE_H
 
+#include <algorithm>
 #include <string>
 #include <Eigen/Core>
 #include <Eigen/Sparse>
@@ -110,7 +111,9 @@ namespace HDF5SupportedTypes
 enum class HDF5AccessType
 {
   READ_ONLY,
-  READ_WRITE
+  READ_WRITE,
+  // Opens an existing file for reading and writing without truncating it
+  APPEND
 };
 
 class HDF5File final
@@ -134,6 +137,8 @@ public:
 
   HDFID<H5Gclose> findGroup( const std::string& group_name ) const;
 
+  bool exists( const std::string& full_name ) const;
+
   void write( const std::string& full_name, const std::string& string_variable ) const;
 
   template<typename Scalar>
@@ -257,6 +262,202 @@ public:
     write( full_name + "_val", val );
   }
 
+  // Creates an empty matrix with the given number of columns that grows by appending rows. The matrix
+  // is stored in chunks of chunk_rows rows, each compressed with deflate at the given level, from 1
+  // to 9, or left uncompressed if the level is 0.
+  template<typename Scalar>
+  void createExtendibleMatrix( const std::string& full_name, const hsize_t cols, const hsize_t chunk_rows, const unsigned compression_level ) const
+  {
+    using HDFSID = HDFID<H5Sclose>;
+    using HDFGID = HDFID<H5Gclose>;
+    using HDFDID = HDFID<H5Dclose>;
+    using HDFPID = HDFID<H5Pclose>;
+
+    static_assert( HDF5SupportedTypes::isSupportedEigenType<Scalar>(), "Error, scalar type must be float, double, unsigned or integer" );
+    assert( chunk_rows > 0 ); assert( compression_level <= 9 );
+
+    const auto split_name = splitFullName( full_name );
+
+    const hsize_t dims[2] = { 0, cols };
+    const hsize_t max_dims[2] = { H5S_UNLIMITED, cols };
+    const HDFSID dataspace_id{ H5Screate_simple( 2, dims, max_dims ) };
+    if( dataspace_id < 0 )
+    {
+      throw std::string{ "Failed to create HDF data space" };
+    }
+
+    const HDFPID property_id{ H5Pcreate( H5P_DATASET_CREATE ) };
+    if( property_id < 0 )
+    {
+      throw std::string{ "Failed to create HDF property list" };
+    }
+    // HDF5 does not allow chunks of zero size
+    const hsize_t chunk_dims[2] = { chunk_rows, std::max( cols, hsize_t( 1 ) ) };
+    if( H5Pset_chunk( property_id, 2, chunk_dims ) < 0 )
+    {
+      throw std::string{ "Failed to set HDF chunk size" };
+    }
+    if( compression_level > 0 )
+    {
+      // Grouping the bytes of each scalar makes the deflate filter considerably more effective on floating point data
+      if( H5Pset_shuffle( property_id ) < 0 || H5Pset_deflate( property_id, compression_level ) < 0 )
+      {
+        throw std::string{ "Failed to set HDF compression" };
+      }
+    }
+
+    // Open the requested group
+    const HDFGID grp_id{ findOrCreateGroup( split_name.first ) };
+
+    const HDFDID dataset_id{ H5Dcreate2( grp_id, split_name.second.c_str(), computeHDFType<Scalar>(), dataspace_id, H5P_DEFAULT, property_id, H5P_DEFAULT ) };
+    if( dataset_id < 0 )
+    {
+      throw std::string{ "Failed to create HDF data set" };
+    }
+  }
+
+  // Appends a row to a matrix created with createExtendibleMatrix
+  template<typename Derived>
+  void appendRow( const std::string& full_name, const Eigen::DenseBase<Derived>& row ) const
+  {
+    using HDFSID = HDFID<H5Sclose>;
+    using HDFGID = HDFID<H5Gclose>;
+    using HDFDID = HDFID<H5Dclose>;
+
+    using Scalar = typename Derived::Scalar;
+    static_assert( HDF5SupportedTypes::isSupportedEigenType<Scalar>(), "Error, scalar type of Eigen variable must be float, double, unsigned or integer" );
+    static_assert( Derived::IsVectorAtCompileTime, "Error, rows must be vectors" );
+
+    const auto split_name = splitFullName( full_name );
+
+    // Open the requested group
+    const HDFGID grp_id{ findGroup( split_name.first ) };
+
+    const HDFDID dataset_id{ H5Dopen2( grp_id, split_name.second.c_str(), H5P_DEFAULT ) };
+    if( dataset_id < 0 )
+    {
+      throw std::string{ "Failed to open HDF data set" };
+    }
+    if( getNativeType( dataset_id ) != computeHDFType<Scalar>() )
+    {
+      throw std::string{ "Requested HDF data set is not of given type from Eigen variable" };
+    }
+    const Eigen::ArrayXi dimensions{ getDimensions( dataset_id ) };
+    if( dimensions.size() != 2 || dimensions( 1 ) != row.size() )
+    {
+      throw std::string{ "Row size does not match the HDF data set" };
+    }
+
+    // Grow the data set by one row
+    const hsize_t new_dims[2] = { hsize_t( dimensions( 0 ) ) + 1, hsize_t( dimensions( 1 ) ) };
+    if( H5Dset_extent( dataset_id, new_dims ) < 0 )
+    {
+      throw std::string{ "Failed to extend HDF data set" };
+    }
+
+    // Select the new row in the file
+    const HDFSID file_space_id{ H5Dget_space( dataset_id ) };
+    if( file_space_id < 0 )
+    {
+      throw std::string{ "Failed to open data space" };
+    }
+    const hsize_t start[2] = { hsize_t( dimensions( 0 ) ), 0 };
+    const hsize_t count[2] = { 1, hsize_t( dimensions( 1 ) ) };
+    if( H5Sselect_hyperslab( file_space_id, H5S_SELECT_SET, start, nullptr, count, nullptr ) < 0 )
+    {
+      throw std::string{ "Failed to select HDF hyperslab" };
+    }
+    const HDFSID memory_space_id{ H5Screate_simple( 2, count, nullptr ) };
+    if( memory_space_id < 0 )
+    {
+      throw std::string{ "Failed to create HDF data space" };
+    }
+
+    // Ensure the row is contiguous in memory
+    Eigen::Matrix<Scalar,Eigen::Dynamic,1> row_data{ row.size() };
+    for( Eigen::Index idx = 0; idx < row.size(); ++idx )
+    {
+      row_data( idx ) = row.derived()( idx );
+    }
+    if( H5Dwrite( dataset_id, computeHDFType<Scalar>(), memory_space_id, file_space_id, H5P_DEFAULT, row_data.data() ) < 0 )
+    {
+      throw std::string{ "Failed to write HDF data" };
+    }
+  }
+
+  // Reads a single row of a matrix as a column vector
+  template<typename T>
+  T readRow( const std::string& full_name, const hsize_t row ) const
+  {
+    using HDFSID = HDFID<H5Sclose>;
+    using HDFGID = HDFID<H5Gclose>;
+    using HDFDID = HDFID<H5Dclose>;
+
+    using Scalar = typename T::Scalar;
+    static_assert( HDF5SupportedTypes::isSupportedEigenType<Scalar>(), "Error, scalar type of Eigen variable must be float, double, unsigned or integer" );
+    static_assert( T::ColsAtCompileTime == 1, "Error, rows are read into column vectors" );
+
+    const auto split_name = splitFullName( full_name );
+
+    // Open the requested group
+    const HDFGID grp_id{ findGroup( split_name.first ) };
+
+    const HDFDID dataset_id{ H5Dopen2( grp_id, split_name.second.c_str(), H5P_DEFAULT ) };
+    if( dataset_id < 0 )
+    {
+      throw std::string{ "Failed to open HDF data set" };
+    }
+    if( getNativeType( dataset_id ) != computeHDFType<Scalar>() )
+    {
+      throw std::string{ "Requested HDF data set is not of given type from Eigen variable" };
+    }
+    const Eigen::ArrayXi dimensions{ getDimensions( dataset_id ) };
+    if( dimensions.size() != 2 )
+    {
+      throw std::string{ "Invalid dimensions for Eigen matrix type in file" };
+    }
+    if( row >= hsize_t( dimensions( 0 ) ) )
+    {
+      throw std::string{ "Requested row is past the end of the HDF data set" };
+    }
+
+    // Select the requested row in the file
+    const HDFSID file_space_id{ H5Dget_space( dataset_id ) };
+    if( file_space_id < 0 )
+    {
+      throw std::string{ "Failed to open data space" };
+    }
+    const hsize_t start[2] = { row, 0 };
+    const hsize_t count[2] = { 1, hsize_t( dimensions( 1 ) ) };
+    if( H5Sselect_hyperslab( file_space_id, H5S_SELECT_SET, start, nullptr, count, nullptr ) < 0 )
+    {
+      throw std::string{ "Failed to select HDF hyperslab" };
+    }
+    const HDFSID memory_space_id{ H5Screate_simple( 2, count, nullptr ) };
+    if( memory_space_id < 0 )
+    {
+      throw std::string{ "Failed to create HDF data space" };
+    }
+
+    T row_data;
+    if( rowsFixed<T>() && row_data.rows() != dimensions( 1 ) )
+    {
+      throw std::string{ "Eigen type of fixed row size does not have correct number of rows" };
+    }
+    row_data.resize( dimensions( 1 ) );
+    if( H5Dread( dataset_id, computeHDFType<Scalar>(), memory_space_id, file_space_id, H5P_DEFAULT, row_data.data() ) < 0 )
+    {
+      throw std::string{ "Failed to read data from HDF file" };
+    }
+    return row_data;
+  }
+
+  // Number of rows in a matrix
+  hsize_t numRows( const std::string& full_name ) const;
+
+  // Discards all but the first num_rows rows of a matrix created with createExtendibleMatrix
+  void truncateRows( const std::string& full_name, const hsize_t num_rows ) const;
+
   template<typename Scalar>
   typename std::enable_if<HDF5SupportedTypes::isSupportedEigenType<Scalar>(),Scalar>::type
   read( const std::string& full_name ) const
@@ -130,6 +130,119 @@ namespace ProjectionSolvers
     x0.swap( best_solution );
   }
 
+  // Same iteration as APGD, but A is only available through mult( x, Ax ). The products of A with
+  // the current iterate and the extrapolated point are carried between iterations, so gradients
+  // and the backtracking test are evaluated from cached products, and each iteration costs one
+  // product plus one per backtracking step.
+  template<typename Projection, typename Termination, typename Multiplication>
+  void APGDMatrixFree( const Projection& project, const Termination& term, Multiplication& mult, const scalar& tol, const unsigned max_iters, const VectorXs& b, VectorXs& x0, ProjectionSolveResults& results )
+  {
+    // Sanity check input sizes
+    assert( b.size() == x0.size() );
+    // Must have a non-negative tolerance to terminate
+    assert( tol >= 0.0 );
+
+    // Ensure a feasible initial iterate in case the warm start returns immediately
+    project( x0 );
+
+    VectorXs g{ b.size() };
+    VectorXs y1{ b.size() };
+    VectorXs Ay1{ b.size() };
+    VectorXs Ax0{ b.size() };
+    mult( x0, Ax0 );
+    // Store some iterate in x1
+    VectorXs x1{ VectorXs::Ones( b.size() ) };
+    VectorXs Ax1{ b.size() };
+    mult( x1, Ax1 );
+
+    VectorXs y0{ x0 };
+    VectorXs Ay0{ Ax0 };
+    scalar theta0{ 1.0 };
+    assert( ( x0.array() != x1.array() ).any() );
+    // Initial estimate of the Lipschitz constant
+    scalar Lk{ ( Ax0 - Ax1 ).norm() / ( x0 - x1 ).norm() };
+    assert( Lk != 0.0 );
+    scalar tk{ 1.0 / Lk };
+
+    scalar best_residual{ SCALAR_INFINITY };
+    VectorXs best_solution;
+    results.status = ProjectionSolveStatus::MaxItersExceeded;
+    unsigned iteration;
+    for( iteration = 0; iteration < max_iters; ++iteration )
+    {
+      // Determine if we should terminate
+      {
+        // Store the gradient in x1
+        x1 = Ax0 + b;
+        const scalar current_residual{ term( x0, x1 ) };
+        if( current_residual < best_residual )
+        {
+          best_residual = current_residual;
+          best_solution = x0;
+        }
+        if( best_residual <= tol )
+        {
+          results.status = ProjectionSolveStatus::Success;
+          break;
+        }
+      }
+
+      // Evaluate the gradient
+      g = Ay0 + b;
+      // Attempt a step in the negative gradient direction
+      x1 = y0 - tk * g;
+      project( x1 );
+      mult( x1, Ax1 );
+      // Backtrack if needed. With a quadratic objective, f(x1) - f(y0) - g^T (x1 - y0) reduces to
+      // 0.5 (x1 - y0)^T A (x1 - y0), so the test is formed from the cached products directly.
+      while( true )
+      {
+        y1 = x1 - y0;
+        const scalar lhs{ y1.dot( Ax1 - Ay0 ) };
+        const scalar rhs{ Lk * y1.squaredNorm() };
+        if( lhs <= rhs )
+        {
+          break;
+        }
+        Lk = 2.0 * Lk;
+        assert( Lk != 0.0 );
+        tk = 1.0 / Lk;
+        x1 = y0 - tk * g;
+        project( x1 );
+        mult( x1, Ax1 );
+      }
+      scalar theta1{ computeNewTheta( theta0 ) };
+      const scalar beta1{ computeNewBeta( theta0, theta1 ) };
+      y0 = x1 - x0;
+      // If momentum is hurting progress, restart
+      if( g.dot( y0 ) > 0.0 )
+      {
+        y1 = x1;
+        Ay1 = Ax1;
+        theta1 = 1.0;
+      }
+      else
+      {
+        y1 = x1 + beta1 * y0;
+        Ay1 = ( 1.0 + beta1 ) * Ax1 - beta1 * Ax0;
+      }
+      // Slightly increase the step size
+      Lk = 0.9 * Lk;
+      tk = 1.0 / Lk;
+      // Propagate new values
+      x1.swap( x0 );
+      Ax1.swap( Ax0 );
+      y1.swap( y0 );
+      Ay1.swap( Ay0 );
+      using std::swap;
+      swap( theta0, theta1 );
+    }
+
+    results.achieved_tolerance = best_residual;
+    results.num_iterations = iteration;
+    x0.swap( best_solution );
+  }
+
 }
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef RIGID_BODY_MASS_3D_H
+#define RIGID_BODY_MASS_3D_H
+
+#include "scisim/Math/MathDefines.h"
+
+// Typed views of the per body blocks of a 3D rigid body mass matrix, or of its inverse. The matrix
+// is block diagonal with 6 velocity degrees of freedom per body: the translational degrees of
+// freedom of all bodies, followed by the rotational degrees of freedom of all bodies. Its
+// compressed values hold the three diagonal translational entries of each body, followed by the
+// symmetric 3x3 rotational block of each body, so blocks are read and written in place. The body
+// space matrices are diagonal, with the three principal moments of each body in place of its
+// rotational block.
+namespace RigidBodyMass3D
+{
+
+  inline unsigned numBodies( const SparseMatrixsc& M )
+  {
+    assert( M.rows() == M.cols() ); assert( M.rows() % 6 == 0 );
+    return unsigned( M.rows() / 6 );
+  }
+
+  // True if the values of a world space matrix can be viewed as per body blocks
+  inline bool hasBlockLayout( const SparseMatrixsc& M )
+  {
+    return M.rows() == M.cols() && M.rows() % 6 == 0 && M.isCompressed() && M.nonZeros() == 2 * M.rows();
+  }
+
+  // True if the values of a body space matrix can be viewed as per body blocks
+  inline bool hasDiagonalLayout( const SparseMatrixsc& M0 )
+  {
+    return M0.rows() == M0.cols() && M0.rows() % 6 == 0 && M0.isCompressed() && M0.nonZeros() == M0.rows();
+  }
+
+  // Valid for both world and body space matrices
+  inline Eigen::Map<const Vector3s> translationalBlock( const SparseMatrixsc& M, const unsigned body )
+  {
+    assert( hasBlockLayout( M ) || hasDiagonalLayout( M ) ); assert( body < numBodies( M ) );
+    return Eigen::Map<const Vector3s>{ M.valuePtr() + 3 * body };
+  }
+
+  inline Eigen::Map<Vector3s> translationalBlock( SparseMatrixsc& M, const unsigned body )
+  {
+    assert( hasBlockLayout( M ) || hasDiagonalLayout( M ) ); assert( body < numBodies( M ) );
+    return Eigen::Map<Vector3s>{ M.valuePtr() + 3 * body };
+  }
+
+  inline Eigen::Map<const Matrix33sc> rotationalBlock( const SparseMatrixsc& M, const unsigned body )
+  {
+    assert( hasBlockLayout( M ) ); assert( body < numBodies( M ) );
+    return Eigen::Map<const Matrix33sc>{ M.valuePtr() + 3 * numBodies( M ) + 9 * body };
+  }
+
+  inline Eigen::Map<Matrix33sc> rotationalBlock( SparseMatrixsc& M, const unsigned body )
+  {
+    assert( hasBlockLayout( M ) ); assert( body < numBodies( M ) );
+    return Eigen::Map<Matrix33sc>{ M.valuePtr() + 3 * numBodies( M ) + 9 * body };
+  }
+
+  inline Eigen::Map<const Vector3s> principalMoments( const SparseMatrixsc& M0, const unsigned body )
+  {
+    assert( hasDiagonalLayout( M0 ) ); assert( body < numBodies( M0 ) );
+    return Eigen::Map<const Vector3s>{ M0.valuePtr() + 3 * numBodies( M0 ) + 3 * body };
+  }
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "SpaceFillingCurve.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+// Spreads the low 32 bits of x so that there is a zero bit between each
+static std::uint64_t spreadBits2D( std::uint64_t x )
+{
+  x &= 0x00000000FFFFFFFF;
+  x = ( x | ( x << 16 ) ) & 0x0000FFFF0000FFFF;
+  x = ( x | ( x << 8 ) ) & 0x00FF00FF00FF00FF;
+  x = ( x | ( x << 4 ) ) & 0x0F0F0F0F0F0F0F0F;
+  x = ( x | ( x << 2 ) ) & 0x3333333333333333;
+  x = ( x | ( x << 1 ) ) & 0x5555555555555555;
+  return x;
+}
+
+// Spreads the low 21 bits of x so that there are two zero bits between each
+static std::uint64_t spreadBits3D( std::uint64_t x )
+{
+  x &= 0x00000000001FFFFF;
+  x = ( x | ( x << 32 ) ) & 0x001F00000000FFFF;
+  x = ( x | ( x << 16 ) ) & 0x001F0000FF0000FF;
+  x = ( x | ( x << 8 ) ) & 0x100F00F00F00F00F;
+  x = ( x | ( x << 4 ) ) & 0x10C30C30C30C30C3;
+  x = ( x | ( x << 2 ) ) & 0x1249249249249249;
+  return x;
+}
+
+static std::uint64_t mortonCode( const Eigen::Matrix<std::uint64_t,2,1>& cell )
+{
+  return spreadBits2D( cell.x() ) | ( spreadBits2D( cell.y() ) << 1 );
+}
+
+static std::uint64_t mortonCode( const Eigen::Matrix<std::uint64_t,3,1>& cell )
+{
+  return spreadBits3D( cell.x() ) | ( spreadBits3D( cell.y() ) << 1 ) | ( spreadBits3D( cell.z() ) << 2 );
+}
+
+template<int DIM>
+static void computeMortonOrderND( const Eigen::Ref<const VectorXs>& stacked_x, const unsigned bits_per_axis, std::vector<unsigned>& order )
+{
+  assert( stacked_x.size() % DIM == 0 );
+  const Eigen::Map<const Eigen::Matrix<scalar,DIM,Eigen::Dynamic>> x{ stacked_x.data(), DIM, stacked_x.size() / DIM };
+
+  order.resize( std::vector<unsigned>::size_type( x.cols() ) );
+  std::iota( order.begin(), order.end(), 0 );
+  if( x.cols() == 0 )
+  {
+    return;
+  }
+
+  // Quantize each point to a cell of a uniform grid over the bounding box
+  const Eigen::Array<scalar,DIM,1> min_coords{ x.rowwise().minCoeff().array() };
+  const Eigen::Array<scalar,DIM,1> extent{ x.rowwise().maxCoeff().array() - min_coords };
+  const scalar max_cell{ scalar( ( std::uint64_t( 1 ) << bits_per_axis ) - 1 ) };
+  const Eigen::Array<scalar,DIM,1> scale{ ( extent > 0.0 ).select( max_cell / extent, 0.0 ) };
+
+  std::vector<std::uint64_t> codes( order.size() );
+  for( std::vector<std::uint64_t>::size_type pnt_idx = 0; pnt_idx < codes.size(); ++pnt_idx )
+  {
+    const Eigen::Array<scalar,DIM,1> scaled{ ( ( x.col( pnt_idx ).array() - min_coords ) * scale ).max( 0.0 ).min( max_cell ) };
+    codes[pnt_idx] = mortonCode( Eigen::Matrix<std::uint64_t,DIM,1>{ scaled.template cast<std::uint64_t>() } );
+  }
+
+  std::stable_sort( order.begin(), order.end(), [&codes]( const unsigned a, const unsigned b ) { return codes[a] < codes[b]; } );
+}
+
+void SpaceFillingCurve::computeMortonOrder2D( const Eigen::Ref<const VectorXs>& x, std::vector<unsigned>& order )
+{
+  computeMortonOrderND<2>( x, 32, order );
+}
+
+void SpaceFillingCurve::computeMortonOrder3D( const Eigen::Ref<const VectorXs>& x, std::vector<unsigned>& order )
+{
+  computeMortonOrderND<3>( x, 21, order );
+}
+
+void SpaceFillingCurve::invertOrder( const std::vector<unsigned>& order, std::vector<unsigned>& inverse )
+{
+  inverse.resize( order.size() );
+  for( std::vector<unsigned>::size_type new_idx = 0; new_idx < order.size(); ++new_idx )
+  {
+    assert( order[new_idx] < order.size() );
+    inverse[order[new_idx]] = unsigned( new_idx );
+  }
+}
@@ -0,0 +1,22 @@
+#ifndef SPACE_FILLING_CURVE_H
+#define SPACE_FILLING_CURVE_H
+
+#include "MathDefines.h"
+
+#include <vector>
+
+namespace SpaceFillingCurve
+{
+
+  // Computes an ordering of the points stacked in x along a Morton (Z-order) curve through their
+  // bounding box. order[i] is the index of the point that comes ith along the curve. Points that are
+  // close in space tend to be close in the ordering. Ties are broken by the original index.
+  void computeMortonOrder2D( const Eigen::Ref<const VectorXs>& x, std::vector<unsigned>& order );
+  void computeMortonOrder3D( const Eigen::Ref<const VectorXs>& x, std::vector<unsigned>& order );
+
+  // Given order[new_index] == old_index, builds inverse[old_index] == new_index
+  void invertOrder( const std::vector<unsigned>& order, std::vector<unsigned>& inverse );
+
+}
+
+#endif
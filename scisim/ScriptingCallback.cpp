@@ -7,6 +7,8 @@
 
 #include "ScriptingCallback.h"
 
+#include "scisim/Timer/Profiler.h"
+
 ScriptingCallback::~ScriptingCallback() = default;
 
 void ScriptingCallback::restitutionCoefficientCallback( const std::vector<std::unique_ptr<Constraint>>& active_set, VectorXs& cor )
@@ -15,6 +17,7 @@ void ScriptingCallback::restitutionCoefficientCallback( const std::vector<std::u
   {
     return;
   }
+  const ProfilerScope profiler_scope{ ProfilerTimer::SCRIPTING };
   restitutionCoefficient( active_set, cor );
   assert( ( cor.array() >= 0.0 ).all() );
   assert( ( cor.array() <= 1.0 ).all() );
@@ -26,6 +29,7 @@ void ScriptingCallback::frictionCoefficientCallback( const std::vector<std::uniq
   {
     return;
   }
+  const ProfilerScope profiler_scope{ ProfilerTimer::SCRIPTING };
   frictionCoefficient( active_set, mu );
   assert( ( mu.array() >= 0.0 ).all() );
 }
@@ -36,6 +40,7 @@ void ScriptingCallback::startOfSimCallback()
   {
     return;
   }
+  const ProfilerScope profiler_scope{ ProfilerTimer::SCRIPTING };
   startOfSim();
 }
 
@@ -45,6 +50,7 @@ void ScriptingCallback::endOfSimCallback()
   {
     return;
   }
+  const ProfilerScope profiler_scope{ ProfilerTimer::SCRIPTING };
   endOfSim();
 }
 
@@ -54,6 +60,7 @@ void ScriptingCallback::startOfStepCallback( const unsigned next_iteration, cons
   {
     return;
   }
+  const ProfilerScope profiler_scope{ ProfilerTimer::SCRIPTING };
   startOfStep( next_iteration, dt );
 }
 
@@ -63,5 +70,6 @@ void ScriptingCallback::endOfStepCallback( const unsigned next_iteration, const
   {
     return;
   }
+  const ProfilerScope profiler_scope{ ProfilerTimer::SCRIPTING };
   endOfStep( next_iteration, dt );
 }
@@ -0,0 +1,83 @@
+#include "SnapshotSchedule.h"
+
+#include <cassert>
+#include <istream>
+#include <sstream>
+
+#include "Checkpoint.h"
+#include "StringUtilities.h"
+#include "Utilities.h"
+
+static std::string fileNameWithoutDirectory( const std::string& file_name )
+{
+  const std::string::size_type separator{ file_name.find_last_of( '/' ) };
+  return separator == std::string::npos ? file_name : file_name.substr( separator + 1 );
+}
+
+static std::string directoryOfFile( const std::string& file_name )
+{
+  const std::string::size_type separator{ file_name.find_last_of( '/' ) };
+  return separator == std::string::npos ? std::string{} : file_name.substr( 0, separator + 1 );
+}
+
+SnapshotSchedule::SnapshotSchedule()
+: m_base_name()
+, m_base_iteration( 0 )
+, m_deltas_since_base( 0 )
+, m_needs_base( true )
+{}
+
+std::vector<SnapshotSchedule::File> SnapshotSchedule::nextSnapshot( const unsigned iteration, const unsigned deltas_per_base, const bool overwrite, const std::string& numbered_file_name )
+{
+  if( !m_needs_base && m_deltas_since_base < deltas_per_base )
+  {
+    ++m_deltas_since_base;
+    return { { overwrite ? "serial.bin" : numbered_file_name, true } };
+  }
+
+  m_needs_base = false;
+  m_base_iteration = iteration;
+  m_deltas_since_base = 0;
+  if( !overwrite )
+  {
+    m_base_name = fileNameWithoutDirectory( numbered_file_name );
+    return { { numbered_file_name, false } };
+  }
+  if( deltas_per_base == 0 )
+  {
+    m_base_name = "serial.bin";
+    return { { "serial.bin", false } };
+  }
+  m_base_name = m_base_name == "serial_base_0.bin" ? "serial_base_1.bin" : "serial_base_0.bin";
+  return { { m_base_name, false }, { "serial.bin", true } };
+}
+
+void SnapshotSchedule::resume( const std::string& base_file_name )
+{
+  m_base_name = fileNameWithoutDirectory( base_file_name );
+  m_base_iteration = 0;
+  m_deltas_since_base = 0;
+  m_needs_base = true;
+}
+
+void SnapshotSchedule::addDeltaBase( CheckpointWriter& checkpoint ) const
+{
+  assert( !m_needs_base ); assert( !m_base_name.empty() );
+  std::ostringstream base_stream{ std::ios::binary };
+  StringUtilities::serialize( m_base_name, base_stream );
+  Utilities::serialize( m_base_iteration, base_stream );
+  checkpoint.addSection( "delta_base", base_stream.str() );
+}
+
+std::unique_ptr<CheckpointReader> SnapshotSchedule::openDeltaBase( const CheckpointReader& delta, const std::string& delta_file_name, std::string& base_file_name )
+{
+  const std::unique_ptr<std::istream> base_stream{ delta.stream( "delta_base" ) };
+  base_file_name = directoryOfFile( delta_file_name ) + StringUtilities::deserialize( *base_stream );
+  const unsigned base_iteration{ Utilities::deserialize<unsigned>( *base_stream ) };
+  std::unique_ptr<CheckpointReader> base{ new CheckpointReader{ base_file_name } };
+  if( base->hasSection( "delta_base" ) || base->array<unsigned>( "snapshot_iteration" ).size() != 1 || base->array<unsigned>( "snapshot_iteration" )( 0 ) != base_iteration )
+  {
+    throw std::string{ "Snapshot " } + base_file_name + " is not the full snapshot that " + delta_file_name + " was written relative to";
+  }
+  return base;
+}
@@ -0,0 +1,58 @@
+#ifndef SNAPSHOT_SCHEDULE_H
+#define SNAPSHOT_SCHEDULE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class CheckpointReader;
+class CheckpointWriter;
+
+// Decides which files a run writes its snapshots to. After each full snapshot, the base, the next
+// deltas_per_base snapshots are deltas relative to it. A delta names its base by a file name in
+// the delta's directory and by the iteration the base was written at.
+//
+// When snapshots overwrite each other, serial.bin is always the snapshot to restart from. Bases
+// alternate between two files, so a new base never replaces the base that serial.bin refers to,
+// and each new base is followed by a delta in serial.bin relative to it.
+class SnapshotSchedule final
+{
+
+public:
+
+  struct File final
+  {
+    std::string name;
+    bool delta;
+  };
+
+  SnapshotSchedule();
+
+  // Files to write, in order, for a snapshot at the given iteration. Without overwriting, the
+  // snapshot is written to numbered_file_name.
+  std::vector<File> nextSnapshot( const unsigned iteration, const unsigned deltas_per_base, const bool overwrite, const std::string& numbered_file_name );
+
+  // After resuming, the next snapshot is a new base. In overwrite mode it must not replace the full
+  // snapshot the run resumed from, either directly or as the base of a delta, given in
+  // base_file_name.
+  void resume( const std::string& base_file_name );
+
+  // Records in a delta the base it is relative to
+  void addDeltaBase( CheckpointWriter& checkpoint ) const;
+
+  // Opens the base of a delta and verifies that it is the snapshot the delta was written relative
+  // to. Throws a std::string on failure.
+  static std::unique_ptr<CheckpointReader> openDeltaBase( const CheckpointReader& delta, const std::string& delta_file_name, std::string& base_file_name );
+
+private:
+
+  // File name of the current base, without its directory, empty before the first base
+  std::string m_base_name;
+  unsigned m_base_iteration;
+  unsigned m_deltas_since_base;
+  // True until a base is written after starting or resuming
+  bool m_needs_base;
+
+};
+
+#endif
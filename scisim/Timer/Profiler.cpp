@@ -0,0 +1,260 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <fstream>
+#include <iomanip>
+
+#include "scisim/StringUtilities.h"
+
+static constexpr unsigned NUM_TIMERS{ unsigned( ProfilerTimer::COUNT ) };
+static constexpr unsigned NUM_COUNTERS{ unsigned( ProfilerCounter::COUNT ) };
+
+namespace
+{
+
+  struct ProfilerState final
+  {
+    bool enabled{ false };
+    bool per_step{ false };
+    std::ofstream output;
+    unsigned num_steps{ 0 };
+
+    // Values accumulated over the current step
+    std::array<double,NUM_TIMERS> step_seconds{};
+    std::array<std::uint64_t,NUM_TIMERS> step_calls{};
+    std::array<std::uint64_t,NUM_COUNTERS> step_counts{};
+
+    // Values accumulated over all completed steps
+    std::array<double,NUM_TIMERS> total_seconds{};
+    std::array<double,NUM_TIMERS> max_step_seconds{};
+    std::array<std::uint64_t,NUM_TIMERS> total_calls{};
+    std::array<std::uint64_t,NUM_COUNTERS> total_counts{};
+    std::array<std::uint64_t,NUM_COUNTERS> max_step_counts{};
+  };
+
+}
+
+static ProfilerState& state()
+{
+  static ProfilerState profiler_state;
+  return profiler_state;
+}
+
+static void writeCSVHeader( std::ostream& output_stream )
+{
+  output_stream << "iteration";
+  for( unsigned timer = 0; timer < NUM_TIMERS; ++timer )
+  {
+    output_stream << ',' << Profiler::name( ProfilerTimer( timer ) ) << "_seconds";
+  }
+  for( unsigned counter = 0; counter < NUM_COUNTERS; ++counter )
+  {
+    output_stream << ',' << Profiler::name( ProfilerCounter( counter ) );
+  }
+  output_stream << '\n';
+}
+
+static void writeJSON( const ProfilerState& profiler_state, std::ostream& output_stream )
+{
+  const double num_steps{ double( std::max( profiler_state.num_steps, 1u ) ) };
+  output_stream << std::setprecision( 9 );
+  output_stream << "{\n";
+  output_stream << "  \"steps\": " << profiler_state.num_steps << ",\n";
+  output_stream << "  \"timers\": {\n";
+  for( unsigned timer = 0; timer < NUM_TIMERS; ++timer )
+  {
+    output_stream << "    \"" << Profiler::name( ProfilerTimer( timer ) ) << "\": { ";
+    output_stream << "\"total_seconds\": " << profiler_state.total_seconds[timer] << ", ";
+    output_stream << "\"mean_step_seconds\": " << profiler_state.total_seconds[timer] / num_steps << ", ";
+    output_stream << "\"max_step_seconds\": " << profiler_state.max_step_seconds[timer] << ", ";
+    output_stream << "\"calls\": " << profiler_state.total_calls[timer] << " }";
+    output_stream << ( timer + 1 < NUM_TIMERS ? ",\n" : "\n" );
+  }
+  output_stream << "  },\n";
+  output_stream << "  \"counters\": {\n";
+  for( unsigned counter = 0; counter < NUM_COUNTERS; ++counter )
+  {
+    output_stream << "    \"" << Profiler::name( ProfilerCounter( counter ) ) << "\": { ";
+    output_stream << "\"total\": " << profiler_state.total_counts[counter] << ", ";
+    output_stream << "\"mean_step\": " << double( profiler_state.total_counts[counter] ) / num_steps << ", ";
+    output_stream << "\"max_step\": " << profiler_state.max_step_counts[counter] << " }";
+    output_stream << ( counter + 1 < NUM_COUNTERS ? ",\n" : "\n" );
+  }
+  output_stream << "  }\n";
+  output_stream << "}\n";
+}
+
+bool Profiler::open( const std::string& file_name )
+{
+  ProfilerState& profiler_state{ state() };
+  assert( !profiler_state.enabled );
+
+  std::string file_name_root;
+  std::string extension;
+  StringUtilities::splitAtLastCharacterOccurence( file_name, file_name_root, extension, '.' );
+  if( extension != "csv" && extension != "json" )
+  {
+    return false;
+  }
+
+  profiler_state = ProfilerState{};
+  profiler_state.output.open( file_name );
+  if( !profiler_state.output.is_open() )
+  {
+    return false;
+  }
+  profiler_state.per_step = extension == "csv";
+  if( profiler_state.per_step )
+  {
+    profiler_state.output << std::setprecision( 9 );
+    writeCSVHeader( profiler_state.output );
+  }
+  profiler_state.enabled = true;
+  return true;
+}
+
+bool Profiler::close()
+{
+  ProfilerState& profiler_state{ state() };
+  if( !profiler_state.enabled )
+  {
+    return true;
+  }
+  profiler_state.enabled = false;
+  if( !profiler_state.per_step )
+  {
+    writeJSON( profiler_state, profiler_state.output );
+  }
+  profiler_state.output.close();
+  return !profiler_state.output.fail();
+}
+
+bool Profiler::enabled()
+{
+  return state().enabled;
+}
+
+void Profiler::addTime( const ProfilerTimer timer, const double seconds )
+{
+  assert( timer != ProfilerTimer::COUNT );
+  ProfilerState& profiler_state{ state() };
+  profiler_state.step_seconds[unsigned( timer )] += seconds;
+  ++profiler_state.step_calls[unsigned( timer )];
+}
+
+void Profiler::addCount( const ProfilerCounter counter, const std::uint64_t value )
+{
+  assert( counter != ProfilerCounter::COUNT );
+  if( !enabled() )
+  {
+    return;
+  }
+  state().step_counts[unsigned( counter )] += value;
+}
+
+void Profiler::endStep( const unsigned iteration )
+{
+  ProfilerState& profiler_state{ state() };
+  if( !profiler_state.enabled )
+  {
+    return;
+  }
+
+  if( profiler_state.per_step )
+  {
+    profiler_state.output << iteration;
+    for( const double seconds : profiler_state.step_seconds )
+    {
+      profiler_state.output << ',' << seconds;
+    }
+    for( const std::uint64_t count : profiler_state.step_counts )
+    {
+      profiler_state.output << ',' << count;
+    }
+    profiler_state.output << '\n';
+  }
+
+  for( unsigned timer = 0; timer < NUM_TIMERS; ++timer )
+  {
+    profiler_state.total_seconds[timer] += profiler_state.step_seconds[timer];
+    profiler_state.max_step_seconds[timer] = std::max( profiler_state.max_step_seconds[timer], profiler_state.step_seconds[timer] );
+    profiler_state.total_calls[timer] += profiler_state.step_calls[timer];
+  }
+  for( unsigned counter = 0; counter < NUM_COUNTERS; ++counter )
+  {
+    profiler_state.total_counts[counter] += profiler_state.step_counts[counter];
+    profiler_state.max_step_counts[counter] = std::max( profiler_state.max_step_counts[counter], profiler_state.step_counts[counter] );
+  }
+  profiler_state.step_seconds.fill( 0.0 );
+  profiler_state.step_calls.fill( 0 );
+  profiler_state.step_counts.fill( 0 );
+  ++profiler_state.num_steps;
+}
+
+std::string Profiler::name( const ProfilerTimer timer )
+{
+  switch( timer )
+  {
+    case ProfilerTimer::STEP:
+      return "step";
+    case ProfilerTimer::UNCONSTRAINED_MAP:
+      return "unconstrained_map";
+    case ProfilerTimer::ACTIVE_SET:
+      return "active_set";
+    case ProfilerTimer::BROAD_PHASE:
+      return "broad_phase";
+    case ProfilerTimer::NARROW_PHASE:
+      return "narrow_phase";
+    case ProfilerTimer::ASSEMBLY:
+      return "assembly";
+    case ProfilerTimer::IMPACT_SOLVE:
+      return "impact_solve";
+    case ProfilerTimer::FRICTION_SOLVE:
+      return "friction_solve";
+    case ProfilerTimer::WARM_START:
+      return "warm_start";
+    case ProfilerTimer::BOUNDARY:
+      return "boundary";
+    case ProfilerTimer::SCRIPTING:
+      return "scripting";
+    case ProfilerTimer::OUTPUT:
+      return "output";
+    case ProfilerTimer::COUNT:
+      break;
+  }
+  assert( false );
+  return "";
+}
+
+std::string Profiler::name( const ProfilerCounter counter )
+{
+  switch( counter )
+  {
+    case ProfilerCounter::CONTACTS:
+      return "contacts";
+    case ProfilerCounter::IMPACT_SOLVER_ITERATIONS:
+      return "impact_solver_iterations";
+    case ProfilerCounter::FRICTION_SOLVER_ITERATIONS:
+      return "friction_solver_iterations";
+    case ProfilerCounter::COUNT:
+      break;
+  }
+  assert( false );
+  return "";
+}
+
+ProfilerScope::ProfilerScope( const ProfilerTimer timer )
+: m_timer( timer )
+, m_enabled( Profiler::enabled() )
+, m_start( m_enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{} )
+{}
+
+ProfilerScope::~ProfilerScope()
+{
+  if( m_enabled )
+  {
+    Profiler::addTime( m_timer, std::chrono::duration<double>{ std::chrono::steady_clock::now() - m_start }.count() );
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Phases of a time step that are timed. Times are inclusive, so nested phases (e.g. the broad phase
+// within the active set computation) are also counted in their parent.
+enum class ProfilerTimer : unsigned
+{
+  STEP,
+  UNCONSTRAINED_MAP,
+  ACTIVE_SET,
+  BROAD_PHASE,
+  NARROW_PHASE,
+  ASSEMBLY,
+  IMPACT_SOLVE,
+  FRICTION_SOLVE,
+  WARM_START,
+  BOUNDARY,
+  SCRIPTING,
+  OUTPUT,
+  COUNT
+};
+
+// Quantities that are summed over each time step
+enum class ProfilerCounter : unsigned
+{
+  CONTACTS,
+  IMPACT_SOLVER_ITERATIONS,
+  FRICTION_SOLVER_ITERATIONS,
+  COUNT
+};
+
+// Per phase timers and counters for the step pipeline. Profiling is off by default, in which case
+// timers do not read the clock and each instrumented site costs a single branch. Timers and
+// counters must only be updated from the thread that drives the simulation.
+namespace Profiler
+{
+
+  // Starts profiling to the given file. A .csv file receives one row per step, a .json file
+  // receives totals, means, and maxima over all steps. Returns false on failure.
+  bool open( const std::string& file_name );
+
+  // Writes any aggregated output and stops profiling. Returns false on failure.
+  bool close();
+
+  bool enabled();
+
+  void addTime( const ProfilerTimer timer, const double seconds );
+
+  void addCount( const ProfilerCounter counter, const std::uint64_t value );
+
+  // Folds the current step's values into the totals, writing them out for per step output
+  void endStep( const unsigned iteration );
+
+  std::string name( const ProfilerTimer timer );
+  std::string name( const ProfilerCounter counter );
+
+}
+
+// Adds the time until destruction to a phase, when profiling is enabled
+class ProfilerScope final
+{
+
+public:
+
+  explicit ProfilerScope( const ProfilerTimer timer );
+  ~ProfilerScope();
+
+  ProfilerScope( const ProfilerScope& ) = delete;
+  ProfilerScope( ProfilerScope&& ) = delete;
+  ProfilerScope& operator=( const ProfilerScope& ) = delete;
+  ProfilerScope& operator=( ProfilerScope&& ) = delete;
+
+private:
+
+  const ProfilerTimer m_timer;
+  const bool m_enabled;
+  const std::chrono::steady_clock::time_point m_start;
+
+};
+
+#endif
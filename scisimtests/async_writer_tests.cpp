@@ -0,0 +1,176 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "scisim/AsyncWriter.h"
+
+// Jobs run in the order they are queued, and no more than the maximum number wait at once
+static int executeOrderTest( const unsigned max_pending_jobs )
+{
+  std::vector<unsigned> completed_jobs;
+  std::atomic<unsigned> queued_jobs{ 0 };
+  std::atomic<bool> queue_overflowed{ false };
+  {
+    AsyncWriter writer{ max_pending_jobs };
+    for( unsigned job_number = 0; job_number < 32; ++job_number )
+    {
+      ++queued_jobs;
+      const bool queued{ writer.push( [job_number, max_pending_jobs, &completed_jobs, &queued_jobs, &queue_overflowed]()
+      {
+        // Slow writes so that the queue fills
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        // This job, at most max_pending_jobs waiting jobs, and at most one job being pushed
+        if( queued_jobs.load() > max_pending_jobs + 2 )
+        {
+          queue_overflowed = true;
+        }
+        completed_jobs.emplace_back( job_number );
+        --queued_jobs;
+        return true;
+      } ) };
+      if( !queued )
+      {
+        std::cerr << "Failed to queue job " << job_number << std::endl;
+        return EXIT_FAILURE;
+      }
+      if( job_number == 15 )
+      {
+        if( !writer.flush() || completed_jobs.size() != 16 )
+        {
+          std::cerr << "Flush returned before all jobs completed" << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+    // Destroying the writer completes all queued jobs
+  }
+  if( queue_overflowed )
+  {
+    std::cerr << "More than " << max_pending_jobs << " jobs were pending" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( completed_jobs.size() != 32 )
+  {
+    std::cerr << "Only " << completed_jobs.size() << " of 32 jobs completed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for( unsigned job_number = 0; job_number < 32; ++job_number )
+  {
+    if( completed_jobs[job_number] != job_number )
+    {
+      std::cerr << "Jobs completed out of order" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+// A failed job is reported by later pushes and flushes
+static int executeFailureTest( const unsigned max_pending_jobs )
+{
+  AsyncWriter writer{ max_pending_jobs };
+  if( !writer.push( []{ return true; } ) || !writer.push( []{ return false; } ) )
+  {
+    if( max_pending_jobs != 0 )
+    {
+      std::cerr << "Failure reported before the failed job ran" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if( writer.flush() )
+  {
+    std::cerr << "Flush did not report the failed job" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( writer.push( []{ return true; } ) )
+  {
+    std::cerr << "Push did not report the failed job" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// An exception thrown by a job is rethrown once on the calling thread, after which the writer
+// reports failure as for a failed job
+static int executeExceptionTest( const unsigned max_pending_jobs )
+{
+  AsyncWriter writer{ max_pending_jobs };
+  bool rethrown{ false };
+  try
+  {
+    writer.push( []{ return true; } );
+    writer.push( []() -> bool { throw std::runtime_error{ "disk full" }; } );
+    writer.flush();
+  }
+  catch( const std::runtime_error& error )
+  {
+    rethrown = std::string{ error.what() } == "disk full";
+  }
+  if( !rethrown )
+  {
+    std::cerr << "Exception of the job was not rethrown" << std::endl;
+    return EXIT_FAILURE;
+  }
+  try
+  {
+    if( writer.flush() || writer.push( []{ return true; } ) )
+    {
+      std::cerr << "Writer did not report the failed job" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch( ... )
+  {
+    std::cerr << "Exception of the job was rethrown more than once" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "order_00" )
+  {
+    return executeOrderTest( 0 );
+  }
+  else if( test_name == "order_01" )
+  {
+    return executeOrderTest( 1 );
+  }
+  else if( test_name == "order_02" )
+  {
+    return executeOrderTest( 4 );
+  }
+  else if( test_name == "failure_00" )
+  {
+    return executeFailureTest( 0 );
+  }
+  else if( test_name == "failure_01" )
+  {
+    return executeFailureTest( 4 );
+  }
+  else if( test_name == "exception_00" )
+  {
+    return executeExceptionTest( 0 );
+  }
+  else if( test_name == "exception_01" )
+  {
+    return executeExceptionTest( 4 );
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scisim/Math/MathDefines.h"
+#include "scisim/Checkpoint.h"
+#include "scisim/SnapshotSchedule.h"
+#include "scisim/StringUtilities.h"
+#include "scisim/Utilities.h"
+
+// Byte and stream sections are read back by name, in any order
+static int executeSectionsTest00()
+{
+  const std::string file_name{ "checkpoint_test_sections_00.bin" };
+  try
+  {
+    {
+      CheckpointWriter checkpoint{ 7 };
+      checkpoint.addSection( "empty", "" );
+      checkpoint.addSection( "bytes", std::string{ "a\0b", 3 } );
+      std::ostringstream stream{ std::ios::binary };
+      Utilities::serialize( 42u, stream );
+      StringUtilities::serialize( "forty two", stream );
+      checkpoint.addSection( "stream", stream.str() );
+      checkpoint.write( file_name );
+    }
+    if( !CheckpointReader::isCheckpoint( file_name ) )
+    {
+      std::cerr << "Checkpoint not detected" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const CheckpointReader checkpoint{ file_name };
+    if( checkpoint.version() != 7 )
+    {
+      std::cerr << "Incorrect checkpoint version" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( !checkpoint.hasSection( "empty" ) || checkpoint.hasSection( "missing" ) || checkpoint.sectionSize( "empty" ) != 0 )
+    {
+      std::cerr << "Incorrect sections in checkpoint" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const std::unique_ptr<std::istream> stream{ checkpoint.stream( "stream" ) };
+    if( Utilities::deserialize<unsigned>( *stream ) != 42u || StringUtilities::deserialize( *stream ) != "forty two" )
+    {
+      std::cerr << "Stream section does not match" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( std::string( checkpoint.sectionData( "bytes" ), checkpoint.sectionSize( "bytes" ) ) != std::string{ "a\0b", 3 } )
+    {
+      std::cerr << "Byte section does not match" << std::endl;
+      return EXIT_FAILURE;
+    }
+    // Missing sections throw
+    bool threw{ false };
+    try
+    {
+      checkpoint.sectionData( "missing" );
+    }
+    catch( const std::string& )
+    {
+      threw = true;
+    }
+    if( !threw )
+    {
+      std::cerr << "Read a missing section" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Arrays are aligned in the mapped file and match the written values exactly
+static int executeArraysTest00()
+{
+  const std::string file_name{ "checkpoint_test_arrays_00.bin" };
+  const VectorXs q{ VectorXs::LinSpaced( 1001, -1.0, 1.0 ) };
+  const std::vector<unsigned> indices{ 3, 1, 4, 1, 5 };
+  try
+  {
+    {
+      CheckpointWriter checkpoint{ 1 };
+      checkpoint.addSection( "odd", "xyz" );
+      checkpoint.addArray( "q", q );
+      checkpoint.addArray( "indices", indices.data(), indices.size() );
+      checkpoint.write( file_name );
+    }
+    const CheckpointReader checkpoint{ file_name };
+    const Eigen::Map<const VectorXs> read_q{ checkpoint.array<scalar>( "q" ) };
+    if( reinterpret_cast<std::uintptr_t>( read_q.data() ) % 64 != 0 )
+    {
+      std::cerr << "Array is not aligned" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( read_q.size() != q.size() || ( read_q - q ).lpNorm<Eigen::Infinity>() != 0.0 )
+    {
+      std::cerr << "Scalar array does not match" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const Eigen::Map<const Eigen::Matrix<unsigned,Eigen::Dynamic,1>> read_indices{ checkpoint.array<unsigned>( "indices" ) };
+    if( std::size_t( read_indices.size() ) != indices.size() || !std::equal( indices.cbegin(), indices.cend(), read_indices.data() ) )
+    {
+      std::cerr << "Index array does not match" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Files that are not checkpoints or are truncated are rejected
+static int executeInvalidTest00()
+{
+  const std::string file_name{ "checkpoint_test_invalid_00.bin" };
+  {
+    std::ofstream output_stream{ file_name, std::ios::binary };
+    Utilities::serialize( 90210u, output_stream );
+    output_stream << "not a checkpoint, but long enough to hold a header";
+  }
+  if( CheckpointReader::isCheckpoint( file_name ) )
+  {
+    std::cerr << "Detected a checkpoint in an arbitrary file" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string truncated_file_name{ "checkpoint_test_invalid_01.bin" };
+  try
+  {
+    CheckpointWriter checkpoint{ 1 };
+    checkpoint.addArray( "q", VectorXs::Ones( 100 ).eval() );
+    checkpoint.write( truncated_file_name );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  {
+    std::ifstream input_stream{ truncated_file_name, std::ios::binary };
+    const std::string data{ std::istreambuf_iterator<char>{ input_stream }, std::istreambuf_iterator<char>{} };
+    std::ofstream output_stream{ truncated_file_name, std::ios::binary };
+    output_stream.write( data.data(), std::streamsize( data.size() - 8 ) );
+  }
+
+  for( const std::string& invalid_file_name : { file_name, truncated_file_name } )
+  {
+    bool threw{ false };
+    try
+    {
+      const CheckpointReader checkpoint{ invalid_file_name };
+    }
+    catch( const std::string& )
+    {
+      threw = true;
+    }
+    if( !threw )
+    {
+      std::cerr << "Opened invalid checkpoint " << invalid_file_name << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+// A failed write leaves the previous checkpoint of the same name intact
+static int executeAtomicWriteTest00()
+{
+  const std::string file_name{ "checkpoint_test_atomic_write_00.bin" };
+  const std::string temporary_file_name{ file_name + ".tmp" };
+  try
+  {
+    CheckpointWriter{ 1 }.write( file_name );
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // A directory in place of the temporary file makes the next write fail
+  if( mkdir( temporary_file_name.c_str(), 0700 ) != 0 )
+  {
+    std::cerr << "Failed to create " << temporary_file_name << std::endl;
+    return EXIT_FAILURE;
+  }
+  bool threw{ false };
+  try
+  {
+    CheckpointWriter{ 2 }.write( file_name );
+  }
+  catch( const std::string& )
+  {
+    threw = true;
+  }
+  rmdir( temporary_file_name.c_str() );
+  if( !threw )
+  {
+    std::cerr << "Write through a blocked temporary file succeeded" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try
+  {
+    if( CheckpointReader{ file_name }.version() != 1 )
+    {
+      std::cerr << "Failed write replaced the previous checkpoint" << std::endl;
+      return EXIT_FAILURE;
+    }
+    CheckpointWriter{ 2 }.write( file_name );
+    if( CheckpointReader{ file_name }.version() != 2 )
+    {
+      std::cerr << "Checkpoint was not replaced" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( std::ifstream{ temporary_file_name }.is_open() )
+  {
+    std::cerr << "Temporary file left behind" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Iteration of the snapshot a run restarts from, loading the base of a delta. Throws a
+// std::string if the run can not restart from the snapshot.
+static unsigned restartIteration( const std::string& file_name )
+{
+  const CheckpointReader checkpoint{ file_name };
+  if( checkpoint.hasSection( "delta_base" ) )
+  {
+    std::string base_file_name;
+    SnapshotSchedule::openDeltaBase( checkpoint, file_name, base_file_name );
+  }
+  return checkpoint.array<unsigned>( "snapshot_iteration" )( 0 );
+}
+
+// In overwrite mode a run can restart from serial.bin after every file written, including while a
+// new full snapshot is taken or after resuming, and serial.bin holds each snapshot once written
+static int executeSnapshotRolloverTest00()
+{
+  const std::vector<std::string> file_names{ "serial.bin", "serial_base_0.bin", "serial_base_1.bin" };
+  for( const std::string& file_name : file_names )
+  {
+    std::remove( file_name.c_str() );
+  }
+
+  constexpr unsigned deltas_per_base{ 2 };
+  SnapshotSchedule schedule;
+  unsigned num_bases{ 0 };
+  try
+  {
+    unsigned restart_iteration{ 0 };
+    for( unsigned iteration = 10; iteration <= 200; iteration += 10 )
+    {
+      // Resume part way through the run, as after a preemption
+      if( iteration == 110 )
+      {
+        const CheckpointReader checkpoint{ "serial.bin" };
+        std::string base_file_name{ "serial.bin" };
+        if( checkpoint.hasSection( "delta_base" ) )
+        {
+          SnapshotSchedule::openDeltaBase( checkpoint, "serial.bin", base_file_name );
+        }
+        schedule.resume( base_file_name );
+      }
+
+      for( const SnapshotSchedule::File& file : schedule.nextSnapshot( iteration, deltas_per_base, true, "unused.bin" ) )
+      {
+        CheckpointWriter checkpoint{ 1 };
+        checkpoint.addArray( "snapshot_iteration", &iteration, 1 );
+        if( file.delta )
+        {
+          schedule.addDeltaBase( checkpoint );
+        }
+        else
+        {
+          ++num_bases;
+        }
+        checkpoint.write( file.name );
+
+        // Stopping after any file leaves a snapshot to restart from, never an older one
+        if( !CheckpointReader::isCheckpoint( "serial.bin" ) )
+        {
+          continue;
+        }
+        const unsigned new_restart_iteration{ restartIteration( "serial.bin" ) };
+        if( new_restart_iteration < restart_iteration )
+        {
+          std::cerr << "Restart point moved back to iteration " << new_restart_iteration << std::endl;
+          return EXIT_FAILURE;
+        }
+        restart_iteration = new_restart_iteration;
+      }
+      if( restart_iteration != iteration )
+      {
+        std::cerr << "serial.bin does not hold the snapshot of iteration " << iteration << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for( const std::string& file_name : file_names )
+  {
+    std::remove( file_name.c_str() );
+  }
+  if( num_bases < 4 )
+  {
+    std::cerr << "Expected at least 4 full snapshots, found " << num_bases << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "sections_00" )
+  {
+    return executeSectionsTest00();
+  }
+  else if( test_name == "arrays_00" )
+  {
+    return executeArraysTest00();
+  }
+  else if( test_name == "invalid_00" )
+  {
+    return executeInvalidTest00();
+  }
+  else if( test_name == "atomic_write_00" )
+  {
+    return executeAtomicWriteTest00();
+  }
+  else if( test_name == "snapshot_rollover_00" )
+  {
+    return executeSnapshotRolloverTest00();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
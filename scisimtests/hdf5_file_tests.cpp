@@ -0,0 +1,146 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "scisim/Math/MathDefines.h"
+#include "scisim/HDF5File.h"
+
+static bool rowMatches( const HDF5File& file, const std::string& name, const hsize_t row, const VectorXs& expected )
+{
+  const VectorXs row_data{ file.readRow<VectorXs>( name, row ) };
+  if( row_data.size() != expected.size() || ( row_data - expected ).lpNorm<Eigen::Infinity>() != 0.0 )
+  {
+    std::cerr << "Row " << row << " of " << name << " does not match the appended row" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static VectorXs frame( const unsigned frame_number )
+{
+  return VectorXs::LinSpaced( 30, 0.0, 1.0 ) + VectorXs::Constant( 30, scalar( frame_number ) );
+}
+
+// Rows appended to a compressed, extendible matrix can be read back individually
+static int executeExtendibleTest00()
+{
+  const std::string file_name{ "hdf5_file_test_extendible_00.h5" };
+  try
+  {
+    {
+      HDF5File file{ file_name, HDF5AccessType::READ_WRITE };
+      file.createExtendibleMatrix<scalar>( "trajectory/q", 30, 4, 6 );
+      for( unsigned frame_number = 0; frame_number < 10; ++frame_number )
+      {
+        file.appendRow( "trajectory/q", frame( frame_number ) );
+      }
+    }
+    HDF5File file{ file_name, HDF5AccessType::READ_ONLY };
+    if( !file.exists( "trajectory/q" ) || file.exists( "trajectory/v" ) || file.exists( "other/q" ) )
+    {
+      std::cerr << "Incorrect existence of data sets" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( file.numRows( "trajectory/q" ) != 10 )
+    {
+      std::cerr << "Incorrect number of rows in extendible matrix" << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( const unsigned frame_number : { 7u, 0u, 9u, 3u } )
+    {
+      if( !rowMatches( file, "trajectory/q", frame_number, frame( frame_number ) ) )
+      {
+        return EXIT_FAILURE;
+      }
+    }
+    // The whole matrix can also be read at once
+    const MatrixXXsc all_frames{ file.read<MatrixXXsc>( "trajectory/q" ) };
+    if( all_frames.rows() != 10 || ( all_frames.row( 5 ).transpose() - frame( 5 ) ).lpNorm<Eigen::Infinity>() != 0.0 )
+    {
+      std::cerr << "Extendible matrix read in full does not match the appended rows" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// A file reopened for appending can be truncated and extended
+static int executeExtendibleTest01()
+{
+  const std::string file_name{ "hdf5_file_test_extendible_01.h5" };
+  try
+  {
+    {
+      HDF5File file{ file_name, HDF5AccessType::READ_WRITE };
+      file.createExtendibleMatrix<scalar>( "q", 30, 1, 0 );
+      for( unsigned frame_number = 0; frame_number < 5; ++frame_number )
+      {
+        file.appendRow( "q", frame( frame_number ) );
+      }
+    }
+    {
+      HDF5File file{ file_name, HDF5AccessType::APPEND };
+      file.truncateRows( "q", 3 );
+      file.appendRow( "q", frame( 10 ) );
+      // Rows of the wrong size are rejected
+      bool threw{ false };
+      try
+      {
+        file.appendRow( "q", VectorXs::Zero( 29 ) );
+      }
+      catch( const std::string& )
+      {
+        threw = true;
+      }
+      if( !threw )
+      {
+        std::cerr << "Appended a row of the wrong size" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    HDF5File file{ file_name, HDF5AccessType::READ_ONLY };
+    if( file.numRows( "q" ) != 4 )
+    {
+      std::cerr << "Incorrect number of rows after truncation" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( !rowMatches( file, "q", 2, frame( 2 ) ) || !rowMatches( file, "q", 3, frame( 10 ) ) )
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  catch( const std::string& error )
+  {
+    std::cerr << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "extendible_00" )
+  {
+    return executeExtendibleTest00();
+  }
+  else if( test_name == "extendible_01" )
+  {
+    return executeExtendibleTest01();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,265 @@
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "scisim/Math/MathDefines.h"
+#include "scisim/Constraints/Constraint.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/ImpactOperatorUtilities.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorAPGD.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/LCPOperatorMatrixFreeAPGD.h"
+#include "scisim/ConstrainedMaps/ImpactMaps/MinMapImpact.h"
+
+// Block diagonal inverse mass matrix laid out as in the 3D rigid body simulation: a scalar inverse
+// mass for each body's linear degrees of freedom, followed by a 3x3 inverse inertia per body
+static void generateRigidBodyMinv( const unsigned nbodies, std::mt19937_64& mt, SparseMatrixsc& Minv )
+{
+  std::uniform_real_distribution<scalar> gen{ 0.5, 2.0 };
+  Minv.resize( 6 * nbodies, 6 * nbodies );
+  Minv.reserve( VectorXi::Constant( 6 * nbodies, 3 ) );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  {
+    const scalar minv{ gen( mt ) };
+    for( unsigned dof = 0; dof < 3; ++dof )
+    {
+      Minv.insert( 3 * bdy_idx + dof, 3 * bdy_idx + dof ) = minv;
+    }
+    Matrix33sr A;
+    for( unsigned entry = 0; entry < 9; ++entry )
+    {
+      A.data()[entry] = gen( mt );
+    }
+    const Matrix33sr Iinv{ A * A.transpose() + Matrix33sr::Identity() };
+    for( unsigned row = 0; row < 3; ++row )
+    {
+      for( unsigned col = 0; col < 3; ++col )
+      {
+        Minv.insert( 3 * ( nbodies + bdy_idx ) + row, 3 * ( nbodies + bdy_idx ) + col ) = Iinv( row, col );
+      }
+    }
+  }
+  Minv.makeCompressed();
+}
+
+// Contacts between random pairs of bodies, and between random bodies and static geometry
+static void generateRigidBodyN( const unsigned nbodies, const unsigned ncons, std::mt19937_64& mt, SparseMatrixsc& N )
+{
+  std::uniform_int_distribution<unsigned> body_gen{ 0, nbodies - 1 };
+  std::uniform_real_distribution<scalar> gen{ -1.0, 1.0 };
+  std::vector<Eigen::Triplet<scalar>> triplets;
+  for( unsigned con = 0; con < ncons; ++con )
+  {
+    const unsigned body0{ body_gen( mt ) };
+    const unsigned body1{ body_gen( mt ) };
+    for( unsigned dof = 0; dof < 3; ++dof )
+    {
+      triplets.emplace_back( 3 * body0 + dof, con, gen( mt ) );
+      triplets.emplace_back( 3 * ( nbodies + body0 ) + dof, con, gen( mt ) );
+      // Every third contact is against static geometry
+      if( con % 3 != 0 && body1 != body0 )
+      {
+        triplets.emplace_back( 3 * body1 + dof, con, gen( mt ) );
+        triplets.emplace_back( 3 * ( nbodies + body1 ) + dof, con, gen( mt ) );
+      }
+    }
+  }
+  N.resize( 6 * nbodies, ncons );
+  N.setFromTriplets( triplets.begin(), triplets.end() );
+}
+
+static bool delassusOperatorMatchesProduct( const SparseMatrixsc& N, const SparseMatrixsc& Minv )
+{
+  SparseMatrixsc Q;
+  ImpactOperatorUtilities::computeDelassusOperator( N, Minv, Q );
+  const SparseMatrixsc Q_product{ N.transpose() * Minv * N };
+
+  if( Q.rows() != N.cols() || Q.cols() != N.cols() )
+  {
+    std::cerr << "Delassus operator has incorrect dimensions" << std::endl;
+    return false;
+  }
+  const scalar error{ ( MatrixXXsc{ Q } - MatrixXXsc{ Q_product } ).lpNorm<Eigen::Infinity>() };
+  if( error > 1.0e-12 )
+  {
+    std::cerr << "Delassus operator differs from N^T M^-1 N by " << error << std::endl;
+    return false;
+  }
+  if( Q.nonZeros() > Q_product.nonZeros() )
+  {
+    std::cerr << "Delassus operator has more nonzeros than N^T M^-1 N" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// 3D rigid bodies
+static int executeDelassusTest00()
+{
+  std::mt19937_64 mt{ 123 };
+  SparseMatrixsc Minv;
+  generateRigidBodyMinv( 50, mt, Minv );
+  SparseMatrixsc N;
+  generateRigidBodyN( 50, 200, mt, N );
+  return delassusOperatorMatchesProduct( N, Minv ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Diagonal mass matrix, as with balls, and contacts that only touch linear degrees of freedom
+static int executeDelassusTest01()
+{
+  std::mt19937_64 mt{ 456 };
+  constexpr unsigned nbodies{ 40 };
+  std::uniform_real_distribution<scalar> gen{ 0.5, 2.0 };
+  SparseMatrixsc Minv{ 2 * nbodies, 2 * nbodies };
+  Minv.reserve( VectorXi::Ones( 2 * nbodies ) );
+  for( unsigned bdy_idx = 0; bdy_idx < nbodies; ++bdy_idx )
+  {
+    const scalar minv{ gen( mt ) };
+    Minv.insert( 2 * bdy_idx, 2 * bdy_idx ) = minv;
+    Minv.insert( 2 * bdy_idx + 1, 2 * bdy_idx + 1 ) = minv;
+  }
+  Minv.makeCompressed();
+
+  std::uniform_int_distribution<unsigned> body_gen{ 0, nbodies - 1 };
+  std::vector<Eigen::Triplet<scalar>> triplets;
+  constexpr unsigned ncons{ 100 };
+  for( unsigned con = 0; con < ncons; ++con )
+  {
+    const unsigned body0{ body_gen( mt ) };
+    const unsigned body1{ ( body0 + 1 + body_gen( mt ) % ( nbodies - 1 ) ) % nbodies };
+    const Vector2s n{ Vector2s::Random().normalized() };
+    triplets.emplace_back( 2 * body0, con, n.x() );
+    triplets.emplace_back( 2 * body0 + 1, con, n.y() );
+    triplets.emplace_back( 2 * body1, con, -n.x() );
+    triplets.emplace_back( 2 * body1 + 1, con, -n.y() );
+  }
+  SparseMatrixsc N{ 2 * nbodies, ncons };
+  N.setFromTriplets( triplets.begin(), triplets.end() );
+
+  return delassusOperatorMatchesProduct( N, Minv ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// No contacts
+static int executeDelassusTest02()
+{
+  std::mt19937_64 mt{ 789 };
+  SparseMatrixsc Minv;
+  generateRigidBodyMinv( 5, mt, Minv );
+  const SparseMatrixsc N{ 30, 0 };
+  SparseMatrixsc Q;
+  ImpactOperatorUtilities::computeDelassusOperator( N, Minv, Q );
+  if( Q.rows() != 0 || Q.cols() != 0 )
+  {
+    std::cerr << "Delassus operator should be empty" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Matrix free application of the Delassus operator
+static int executeDelassusApplyTest00()
+{
+  std::mt19937_64 mt{ 1011 };
+  SparseMatrixsc Minv;
+  generateRigidBodyMinv( 50, mt, Minv );
+  SparseMatrixsc N;
+  generateRigidBodyN( 50, 200, mt, N );
+  SparseMatrixsc Q;
+  ImpactOperatorUtilities::computeDelassusOperator( N, Minv, Q );
+
+  const VectorXs x{ VectorXs::Random( N.cols() ) };
+  VectorXs Nx;
+  VectorXs MinvNx;
+  VectorXs y;
+  ImpactOperatorUtilities::applyDelassusOperator( N, Minv, x, Nx, MinvNx, y );
+  const scalar error{ ( y - Q * x ).lpNorm<Eigen::Infinity>() };
+  if( error > 1.0e-12 )
+  {
+    std::cerr << "Matrix free Delassus operator differs from Q x by " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Matrix free APGD reaches the same solution as APGD with Q formed
+static int executeMatrixFreeAPGDTest00()
+{
+  std::mt19937_64 mt{ 1213 };
+  constexpr unsigned nbodies{ 50 };
+  constexpr unsigned ncons{ 100 };
+  SparseMatrixsc Minv;
+  generateRigidBodyMinv( nbodies, mt, Minv );
+  SparseMatrixsc N;
+  generateRigidBodyN( nbodies, ncons, mt, N );
+  SparseMatrixsc Q;
+  ImpactOperatorUtilities::computeDelassusOperator( N, Minv, Q );
+
+  const SparseMatrixsc M{ 6 * nbodies, 6 * nbodies };
+  const VectorXs q0{ VectorXs::Zero( 12 * nbodies ) };
+  const VectorXs v0{ VectorXs::Random( 6 * nbodies ) };
+  const VectorXs nrel{ VectorXs::Zero( ncons ) };
+  const VectorXs CoR{ VectorXs::Constant( ncons, 0.5 ) };
+  const std::vector<std::unique_ptr<Constraint>> cons;
+
+  constexpr scalar tol{ 1.0e-7 };
+  VectorXs alpha{ VectorXs::Zero( ncons ) };
+  LCPOperatorAPGD{ tol, 10000 }.flow( cons, M, Minv, q0, v0, v0, N, Q, nrel, CoR, alpha );
+  LCPOperatorMatrixFreeAPGD matrix_free{ tol, 10000 };
+  if( matrix_free.usesDelassusOperator() )
+  {
+    std::cerr << "Matrix free APGD should not require the Delassus operator" << std::endl;
+    return EXIT_FAILURE;
+  }
+  VectorXs alpha_matrix_free{ VectorXs::Zero( ncons ) };
+  matrix_free.flow( cons, M, Minv, q0, v0, v0, N, SparseMatrixsc{}, nrel, CoR, alpha_matrix_free );
+
+  VectorXs b;
+  ImpactOperatorUtilities::computeLCPQPLinearTerm( N, nrel, CoR, v0, v0, b );
+  const scalar residual{ MinMapImpact{}( alpha_matrix_free, Q * alpha_matrix_free + b ) };
+  if( residual > tol )
+  {
+    std::cerr << "Matrix free APGD residual " << residual << " exceeds tolerance" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const scalar error{ ( alpha - alpha_matrix_free ).lpNorm<Eigen::Infinity>() };
+  if( error > 1.0e-6 )
+  {
+    std::cerr << "Matrix free APGD differs from APGD by " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "delassus_00" )
+  {
+    return executeDelassusTest00();
+  }
+  else if( test_name == "delassus_01" )
+  {
+    return executeDelassusTest01();
+  }
+  else if( test_name == "delassus_02" )
+  {
+    return executeDelassusTest02();
+  }
+  else if( test_name == "delassus_apply_00" )
+  {
+    return executeDelassusApplyTest00();
+  }
+  else if( test_name == "matrix_free_apgd_00" )
+  {
+    return executeMatrixFreeAPGDTest00();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,160 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "scisim/Timer/Profiler.h"
+
+static std::vector<std::string> readLines( const std::string& file_name )
+{
+  std::ifstream input_stream{ file_name };
+  std::vector<std::string> lines;
+  std::string line;
+  while( std::getline( input_stream, line ) )
+  {
+    lines.emplace_back( line );
+  }
+  return lines;
+}
+
+static void profileSteps( const unsigned num_steps )
+{
+  for( unsigned step = 1; step <= num_steps; ++step )
+  {
+    {
+      const ProfilerScope step_scope{ ProfilerTimer::STEP };
+      {
+        const ProfilerScope active_set_scope{ ProfilerTimer::ACTIVE_SET };
+        Profiler::addCount( ProfilerCounter::CONTACTS, step );
+      }
+      Profiler::addCount( ProfilerCounter::IMPACT_SOLVER_ITERATIONS, 2 );
+    }
+    Profiler::endStep( step );
+  }
+}
+
+// CSV output has a header and one row per step
+static int executeCSVTest00()
+{
+  const std::string file_name{ "profiler_test_csv_00.csv" };
+  if( !Profiler::open( file_name ) || !Profiler::enabled() )
+  {
+    std::cerr << "Failed to open " << file_name << std::endl;
+    return EXIT_FAILURE;
+  }
+  profileSteps( 3 );
+  if( !Profiler::close() || Profiler::enabled() )
+  {
+    std::cerr << "Failed to close " << file_name << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<std::string> lines{ readLines( file_name ) };
+  if( lines.size() != 4 )
+  {
+    std::cerr << "Incorrect number of rows: " << lines.size() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( lines[0].compare( 0, 23, "iteration,step_seconds," ) != 0 || lines[0].find( ",contacts,impact_solver_iterations," ) == std::string::npos )
+  {
+    std::cerr << "Incorrect header: " << lines[0] << std::endl;
+    return EXIT_FAILURE;
+  }
+  // The final columns hold the counters of the last step
+  if( lines[3].compare( 0, 2, "3," ) != 0 || lines[3].compare( lines[3].size() - 6, 6, ",3,2,0" ) != 0 )
+  {
+    std::cerr << "Incorrect final row: " << lines[3] << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// JSON output aggregates over all steps
+static int executeJSONTest00()
+{
+  const std::string file_name{ "profiler_test_json_00.json" };
+  if( !Profiler::open( file_name ) )
+  {
+    std::cerr << "Failed to open " << file_name << std::endl;
+    return EXIT_FAILURE;
+  }
+  profileSteps( 4 );
+  if( !Profiler::close() )
+  {
+    std::cerr << "Failed to close " << file_name << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string contents;
+  for( const std::string& line : readLines( file_name ) )
+  {
+    contents += line + '\n';
+  }
+  const std::vector<std::string> expected
+  {
+    "\"steps\": 4,",
+    "\"contacts\": { \"total\": 10, \"mean_step\": 2.5, \"max_step\": 4 }",
+    "\"impact_solver_iterations\": { \"total\": 8, \"mean_step\": 2, \"max_step\": 2 }",
+    "\"friction_solver_iterations\": { \"total\": 0, \"mean_step\": 0, \"max_step\": 0 }",
+    "\"calls\": 4 }"
+  };
+  for( const std::string& entry : expected )
+  {
+    if( contents.find( entry ) == std::string::npos )
+    {
+      std::cerr << "Missing entry " << entry << " in:" << std::endl << contents;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+// Disabled profiling records nothing and unsupported extensions are rejected
+static int executeDisabledTest00()
+{
+  if( Profiler::enabled() )
+  {
+    std::cerr << "Profiling enabled by default" << std::endl;
+    return EXIT_FAILURE;
+  }
+  profileSteps( 2 );
+  if( !Profiler::close() )
+  {
+    std::cerr << "Closing a disabled profiler failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( Profiler::open( "profiler_test_disabled_00.txt" ) || Profiler::enabled() )
+  {
+    std::cerr << "Opened a profile with an unsupported extension" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+  if( argc != 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " test_name" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const std::string test_name{ argv[1] };
+
+  if( test_name == "csv_00" )
+  {
+    return executeCSVTest00();
+  }
+  else if( test_name == "json_00" )
+  {
+    return executeJSONTest00();
+  }
+  else if( test_name == "disabled_00" )
+  {
+    return executeDisabledTest00();
+  }
+
+  std::cerr << "Invalid test specified: " << test_name << std::endl;
+  return EXIT_FAILURE;
+}